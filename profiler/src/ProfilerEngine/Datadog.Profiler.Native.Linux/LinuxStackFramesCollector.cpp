@@ -3,36 +3,96 @@
 
 #include "LinuxStackFramesCollector.h"
 
+#include <algorithm>
 #include <cassert>
 #include <errno.h>
+#include <linux/futex.h>
 #include <mutex>
 #include <signal.h>
 #include <sys/syscall.h>
+#include <time.h>
 
 #include <libunwind-x86_64.h>
 
 #include "Log.h"
 #include "ManagedThreadInfo.h"
-#include "ScopeFinalizer.h"
+#include "OpSysTools.h"
 #include "StackFrameCodeKind.h"
+#include "StackSamplerLoopManager.h"
 #include "StackSnapshotResultReusableBuffer.h"
 
-std::mutex LinuxStackFramesCollector::s_stackWalkInProgressMutex;
-LinuxStackFramesCollector* LinuxStackFramesCollector::s_pInstanceCurrentlyStackWalking = nullptr;
+std::atomic<LinuxStackFramesCollector*> LinuxStackFramesCollector::s_pInstanceCollectingStackSamples{nullptr};
+std::atomic<LinuxStackFramesCollector*> LinuxStackFramesCollector::s_pInstanceWithCpuTimers{nullptr};
+InFlightHandlers LinuxStackFramesCollector::s_stackWalkHandlers;
+InFlightHandlers LinuxStackFramesCollector::s_cpuTimerHandlers;
+
+using namespace std::chrono_literals;
+
+// maximum number of threads walking their stack at the same time
+constexpr std::uint32_t MaxStackWalkSlotsCount = 64;
+
+// a thread that did not handle the signal by then will be sampled another time
+constexpr std::chrono::nanoseconds StackWalksTimeout = 100ms;
+
+// a thread that did not complete its stack walk by then is abandoned: the batch is not blocked by a stalled walk
+// (same duration as the watcher tolerates for a non batched collection)
+constexpr std::chrono::nanoseconds StackWalksCompletionTimeout = StackSamplerLoopManager_MaxExpectedStackSampleCollectionDurationMs;
+
+// a signal handler that is still running by then is stuck: the data it uses is leaked instead of being freed
+constexpr std::chrono::nanoseconds InFlightHandlersTimeout = 1s;
+
+static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::int32_t), "the pending stack walks count is used as a futex word");
+static_assert(MaxStackWalkSlotsCount <= 0xFFFF, "the pending stack walks count is stored in 16 bits");
+
+// not exposed by all libc headers (i.e. musl)
+#ifndef SIGEV_THREAD_ID
+#define SIGEV_THREAD_ID 4
+#endif
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
 
 LinuxStackFramesCollector::LinuxStackFramesCollector(ICorProfilerInfo4* const _pCorProfilerInfo) :
     StackFramesCollectorBase(),
     _pCorProfilerInfo(_pCorProfilerInfo),
     _signalToSend{-1},
     _isSignalHandlerSetup{false},
-    _lastStackWalkErrorCode{0}
+    _pendingStackWalks{0},
+    _currentBatchId{0},
+    _areCpuTimersEnabled{false},
+    _cpuTimerInterval{0},
+    _cpuTimerSlotsCount{0},
+    _droppedCpuTimerSamplesCount{0}
 {
+    for (auto& slot : _cpuTimerSlots)
+    {
+        slot.store(nullptr);
+    }
+
+    _stackWalkSlots.reserve(MaxStackWalkSlotsCount);
+    for (std::uint32_t i = 0; i < MaxStackWalkSlotsCount; i++)
+    {
+        _stackWalkSlots.push_back(std::make_unique<StackWalkSlot>());
+    }
+    _batchSlots.reserve(MaxStackWalkSlotsCount);
+
     _pCorProfilerInfo->AddRef();
     _isSignalHandlerSetup = SetupSignalHandler();
 }
 
 LinuxStackFramesCollector::~LinuxStackFramesCollector()
 {
+    DisableCpuTimers();
+
+    // an abandoned stack walk could still be writing into its slot
+    LinuxStackFramesCollector* pExpected = this;
+    s_pInstanceCollectingStackSamples.compare_exchange_strong(pExpected, nullptr);
+    if (!s_stackWalkHandlers.WaitForAll(InFlightHandlersTimeout))
+    {
+        Log::Warn("LinuxStackFramesCollector: ", s_stackWalkHandlers.GetCount(), " stack walk signal handlers are still running after ",
+                  InFlightHandlersTimeout.count() / 1000000, " ms.");
+    }
+
     _pCorProfilerInfo->Release();
     // !! @ToDo: We must uninstall the signal handler!!
 }
@@ -43,71 +103,246 @@ StackSnapshotResultBuffer* LinuxStackFramesCollector::CollectStackSampleImplemen
     // For now we ignore isTargetThreadSameAsCurrentThread.
     // However, we should probably look at it, and if it is True, and do the stack walk synchronously, rather than using a signal.
 
+    StackSnapshotResultBuffer* pStackSnapshotResult;
+    CollectStackSamples(&pThreadInfo, 1, &pStackSnapshotResult, pHR);
+
+    return pStackSnapshotResult;
+}
+
+std::uint32_t LinuxStackFramesCollector::GetStackSamplesBatchCapacity()
+{
+    return static_cast<std::uint32_t>(_stackWalkSlots.size());
+}
+
+void LinuxStackFramesCollector::CollectStackSamples(ManagedThreadInfo* const* ppThreadInfos,
+                                                    std::uint32_t count,
+                                                    StackSnapshotResultBuffer** ppStackSnapshotResults,
+                                                    uint32_t* pHRs)
+{
+    // Only called by the sampler thread, for distinct threads
+    assert(count <= _stackWalkSlots.size());
+
+    // the threads without slot are not sampled this time
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+        ppStackSnapshotResults[i] = &_emptyStackSnapshotResult;
+        pHRs[i] = E_FAIL;
+    }
+
     if (!_isSignalHandlerSetup)
     {
-        Log::Debug("LinuxStackFramesCollector::CollectStackSampleImplementation:"
+        Log::Debug("LinuxStackFramesCollector::CollectStackSamples:"
                    " Signal handler not set up. Cannot collect callstacks."
                    " (Earlier log entry may contain additinal details.)");
+        return;
+    }
+
+    count = ReserveStackWalkSlots(ppThreadInfos, count);
+
+    // Reset() may allocate: it must be done before any signal is sent
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+        StackWalkSlot* pSlot = _batchSlots[i];
+        pSlot->StackSnapshotResult.Reset();
+        pSlot->ThreadInfo = ppThreadInfos[i];
+        pSlot->ErrorCode = E_FAIL;
+    }
+
+    s_pInstanceCollectingStackSamples.store(this);
+
+    SendStackWalkRequests(count);
+    WaitForStackWalks(count);
+
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+        StackWalkSlot* pSlot = _batchSlots[i];
+        if ((pSlot == nullptr) || (pSlot->State.load(std::memory_order_acquire) != StackWalkSlotCompleted))
+        {
+            // the signal could not be sent or was not handled in time (or the walk was abandoned)
+            continue;
+        }
 
-        *pHR = E_FAIL;
+        pSlot->State.store(StackWalkSlotFree);
+        ppStackSnapshotResults[i] = &pSlot->StackSnapshotResult;
+
+        // errorCode domain values
+        // * < 0 : libunwind error codes
+        // * > 0 : other errors (ex: failed to create frame while walking the stack)
+        // * == 0 : success
+        std::int32_t errorCode = pSlot->ErrorCode;
+        if (errorCode < 0)
+        {
+            Log::Info("LinuxStackFramesCollector::CollectStackSamples:"
+                      " A problem occured while collecting a stack sample:",
+                      " ", ErrorCodeToString(errorCode), " (", errorCode, ").",
+                      " The stack sample collection may have been aborted, and the sample may",
+                      " be invalid, however the execution will continue normally.");
+        }
 
-        return GetStackSnapshotResult();
+        pHRs[i] = (errorCode == 0) ? S_OK : E_FAIL;
     }
+}
 
-    long errorCode;
+std::uint32_t LinuxStackFramesCollector::ReserveStackWalkSlots(ManagedThreadInfo* const* ppThreadInfos, std::uint32_t count)
+{
+    // the slots abandoned by a previous batch are skipped until their stack walk is completed:
+    // the last threads of the batch may not get a slot this time
+    _batchSlots.clear();
+    for (auto const& pSlot : _stackWalkSlots)
     {
-        std::unique_lock<std::mutex> stackWalkInProgressLock(s_stackWalkInProgressMutex);
+        if (_batchSlots.size() == count)
+        {
+            break;
+        }
 
-        const DWORD osThreadId = pThreadInfo->GetOsThreadId();
+        pid_t state = pSlot->State.load(std::memory_order_acquire);
+        if (state == StackWalkSlotWalking)
+        {
+            continue;
+        }
+
+        // a late Completed state comes from an abandoned walk: its result is dropped
+        pSlot->State.store(StackWalkSlotFree);
+        _batchSlots.push_back(pSlot.get());
+    }
+
+    auto reservedCount = static_cast<std::uint32_t>(_batchSlots.size());
+    if (reservedCount < count)
+    {
+        Log::Debug("LinuxStackFramesCollector::ReserveStackWalkSlots: ", count - reservedCount,
+                   " threads will not be sampled because previous stack walks are still in progress.");
+    }
+
+    return reservedCount;
+}
 
-        Log::Debug("LinuxStackFramesCollector::CollectStackSampleImplementation:"
+void LinuxStackFramesCollector::SendStackWalkRequests(std::uint32_t count)
+{
+    // must be set before the first signal handler could decrement it
+    _currentBatchId++;
+    _pendingStackWalks.store((static_cast<std::uint32_t>(_currentBatchId) << 16) | count);
+
+    // a late signal of a previous batch may still read the index: the slot state tells whether the entry is its own
+    for (auto& entry : _stackWalkSlotsIndex)
+    {
+        entry.OsThreadId.store(0, std::memory_order_relaxed);
+    }
+
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+        StackWalkSlot* pSlot = _batchSlots[i];
+        const auto osThreadId = static_cast<pid_t>(pSlot->ThreadInfo->GetOsThreadId());
+        IndexStackWalkSlot(osThreadId, pSlot);
+
+        Log::Debug("LinuxStackFramesCollector::SendStackWalkRequests:"
                    " Sending signal ",
                    _signalToSend, " to thread with osThreadId=", osThreadId, ".");
 
-        s_pInstanceCurrentlyStackWalking = this;
-        auto scopeFinalizer = CreateScopeFinalizer(
-            [] {
-                s_pInstanceCurrentlyStackWalking = nullptr;
-            });
+        pSlot->BatchId = _currentBatchId;
+        pSlot->State.store(osThreadId, std::memory_order_release);
 
-        errorCode = syscall(SYS_tgkill, static_cast<::pid_t>(getpid()), static_cast<::pid_t>(osThreadId), _signalToSend);
-
-        if (errorCode == -1)
+        if (syscall(SYS_tgkill, static_cast<::pid_t>(getpid()), osThreadId, _signalToSend) == -1)
         {
-            Log::Warn("LinuxStackFramesCollector::CollectStackSampleImplementation:"
-                      " Unable to send signal USR1 to thread with osThreadId=",
+            pSlot->State.store(StackWalkSlotFree);
+            _pendingStackWalks.fetch_sub(1);
+
+            Log::Warn("LinuxStackFramesCollector::SendStackWalkRequests:"
+                      " Unable to send signal ", _signalToSend, " to thread with osThreadId=",
                       osThreadId, ". Error code: ",
                       strerror(errno));
         }
-        else
+    }
+}
+
+void LinuxStackFramesCollector::IndexStackWalkSlot(pid_t osThreadId, StackWalkSlot* pSlot)
+{
+    static_assert(StackWalkSlotsIndexSize >= 2 * MaxStackWalkSlotsCount, "the slots index must keep the probe sequences short");
+    static_assert((StackWalkSlotsIndexSize & (StackWalkSlotsIndexSize - 1)) == 0, "the slots index size must be a power of 2");
+
+    auto index = static_cast<std::uint32_t>(osThreadId);
+    for (std::uint32_t i = 0; i < StackWalkSlotsIndexSize; i++, index++)
+    {
+        auto& entry = _stackWalkSlotsIndex[index & (StackWalkSlotsIndexSize - 1)];
+        if (entry.OsThreadId.load(std::memory_order_relaxed) == 0)
         {
-            _stackWalkInProgressWaiter.wait(stackWalkInProgressLock);
-            errorCode = _lastStackWalkErrorCode;
+            // the slot must be visible before the thread id is found
+            entry.Slot.store(pSlot, std::memory_order_relaxed);
+            entry.OsThreadId.store(osThreadId, std::memory_order_release);
+            return;
         }
     }
+}
 
-    // errorCode domain values
-    // * < 0 : libunwind error codes
-    // * > 0 : other errors (ex: failed to create frame while walking the stack)
-    // * == 0 : success
-    if (errorCode < 0)
+LinuxStackFramesCollector::StackWalkSlot* LinuxStackFramesCollector::FindStackWalkSlot(pid_t osThreadId)
+{
+    // Running in the signal handler of the sampled thread: only async-signal-safe calls here
+
+    auto index = static_cast<std::uint32_t>(osThreadId);
+    for (std::uint32_t i = 0; i < StackWalkSlotsIndexSize; i++, index++)
     {
-        Log::Info("LinuxStackFramesCollector::CollectStackSampleImplementation:"
-                  " A problem occured while collecting a stack sample:",
-                  " ", ErrorCodeToString(errorCode), " (", errorCode, ").",
-                  " The stack sample collection may have been aborted, and the sample may",
-                  " be invalid, however the execution will continue normally.");
+        auto& entry = _stackWalkSlotsIndex[index & (StackWalkSlotsIndexSize - 1)];
+        pid_t entryOsThreadId = entry.OsThreadId.load(std::memory_order_acquire);
+        if (entryOsThreadId == osThreadId)
+        {
+            return entry.Slot.load(std::memory_order_relaxed);
+        }
+
+        if (entryOsThreadId == 0)
+        {
+            break;
+        }
     }
 
-    *pHR = (errorCode == 0) ? S_OK : E_FAIL;
+    return nullptr;
+}
 
-    return GetStackSnapshotResult();
+void LinuxStackFramesCollector::WaitForStackWalks(std::uint32_t count)
+{
+    const std::int64_t startTimestamp = OpSysTools::GetHighPrecisionNanoseconds();
+    WaitForPendingStackWalks(startTimestamp + StackWalksTimeout.count());
+
+    // give up on the threads that did not start to walk their stack yet
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+        StackWalkSlot* pSlot = _batchSlots[i];
+        pid_t state = pSlot->State.load();
+        if ((state > 0) && pSlot->State.compare_exchange_strong(state, StackWalkSlotFree))
+        {
+            _pendingStackWalks.fetch_sub(1);
+        }
+    }
+
+    // the others are about to be done...
+    WaitForPendingStackWalks(startTimestamp + StackWalksCompletionTimeout.count());
+
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+        // ...unless the thread is stuck in its signal handler: the slot is abandoned to the thread
+        if (_batchSlots[i]->State.load(std::memory_order_acquire) == StackWalkSlotWalking)
+        {
+            _batchSlots[i] = nullptr;
+        }
+    }
 }
 
-void LinuxStackFramesCollector::NotifyStackWalkCompleted(std::int32_t resultErrorCode)
+void LinuxStackFramesCollector::WaitForPendingStackWalks(std::int64_t deadline)
 {
-    _lastStackWalkErrorCode = resultErrorCode;
-    _stackWalkInProgressWaiter.notify_one();
+    std::uint32_t pendingStackWalks;
+    while (GetPendingCount(pendingStackWalks = _pendingStackWalks.load()) > 0)
+    {
+        std::int64_t remaining = deadline - OpSysTools::GetHighPrecisionNanoseconds();
+        if (remaining <= 0)
+        {
+            break;
+        }
+
+        struct timespec timeout;
+        timeout.tv_sec = remaining / 1000000000;
+        timeout.tv_nsec = remaining % 1000000000;
+
+        // returns immediately if the count has changed since it was read (EAGAIN)
+        syscall(SYS_futex, reinterpret_cast<std::int32_t*>(&_pendingStackWalks), FUTEX_WAIT_PRIVATE, pendingStackWalks, &timeout, nullptr, 0);
+    }
 }
 
 bool LinuxStackFramesCollector::TrySetHandlerForSignal(int signal, struct sigaction& action)
@@ -157,6 +392,9 @@ bool LinuxStackFramesCollector::SetupSignalHandler()
     sampleAction.sa_handler = LinuxStackFramesCollector::CollectStackSampleSignalHandler;
     sigemptyset(&sampleAction.sa_mask);
 
+    // don't let a CPU timer interrupt a stack walk
+    sigaddset(&sampleAction.sa_mask, SIGPROF);
+
     if (TrySetHandlerForSignal(SIGUSR1, sampleAction))
     {
         _signalToSend = SIGUSR1;
@@ -209,82 +447,458 @@ char const* LinuxStackFramesCollector::ErrorCodeToString(int errorCode)
 
 void LinuxStackFramesCollector::CollectStackSampleSignalHandler(int signal)
 {
-    LinuxStackFramesCollector* pCollectorInstanceCurrentlyStackWalking;
-    std::int32_t resultErrorCode;
+    // must be counted before the collector is loaded: see the destructor
+    s_stackWalkHandlers.Enter();
+
+    LinuxStackFramesCollector* pCollector = s_pInstanceCollectingStackSamples.load();
+    if (pCollector != nullptr)
+    {
+        // errno must be preserved for the interrupted code
+        int savedErrno = errno;
 
-    std::unique_lock<std::mutex> stackWalkInProgressLock(s_stackWalkInProgressMutex);
+        pCollector->CollectStackSampleInSlot(static_cast<pid_t>(syscall(SYS_gettid)));
 
-    pCollectorInstanceCurrentlyStackWalking = s_pInstanceCurrentlyStackWalking;
+        errno = savedErrno;
+    }
 
-    // Fail fast in DEBUG builds:
-    assert(pCollectorInstanceCurrentlyStackWalking != nullptr);
+    s_stackWalkHandlers.Leave();
+}
 
-    // Bail out in RELEASE builds:
-    if (pCollectorInstanceCurrentlyStackWalking == nullptr)
+void LinuxStackFramesCollector::CollectStackSampleInSlot(pid_t osThreadId)
+{
+    // Running in the signal handler of the sampled thread: only async-signal-safe calls here
+
+    // a signal that arrives after the sampler thread gave up finds no slot (or the slot of another request)
+    StackWalkSlot* pSlot = FindStackWalkSlot(osThreadId);
+    pid_t expected = osThreadId;
+    if ((pSlot == nullptr) ||
+        !pSlot->State.compare_exchange_strong(expected, StackWalkSlotWalking, std::memory_order_acquire))
     {
         return;
     }
 
+    pSlot->ErrorCode = WalkStack(pSlot);
+    auto batchId = pSlot->BatchId;
+
+    // the slot belongs to the sampler thread again: it must not be touched anymore
+    pSlot->State.store(StackWalkSlotCompleted, std::memory_order_release);
+
+    OnStackWalkCompleted(batchId);
+}
+
+void LinuxStackFramesCollector::OnStackWalkCompleted(std::uint16_t batchId)
+{
+    // Running in the signal handler of the sampled thread: only async-signal-safe calls here
+
+    std::uint32_t pendingStackWalks = _pendingStackWalks.load();
+    while (GetBatchId(pendingStackWalks) == batchId)
     {
-        auto scopeFinalizer = CreateScopeFinalizer(
-            [&pCollectorInstanceCurrentlyStackWalking, &stackWalkInProgressLock, resultErrorCode] {
-                // @ToDo: Is resultErrorCode used correctly, so that its later value change applies to the inside of this lambda?
+        if (_pendingStackWalks.compare_exchange_weak(pendingStackWalks, pendingStackWalks - 1))
+        {
+            // the last thread of the batch wakes the sampler thread up
+            if (GetPendingCount(pendingStackWalks) == 1)
+            {
+                syscall(SYS_futex, reinterpret_cast<std::int32_t*>(&_pendingStackWalks), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+            }
+            return;
+        }
+    }
+}
+
+std::int32_t LinuxStackFramesCollector::WalkStack(StackWalkSlot* pSlot)
+{
+    StackSnapshotResultReusableBuffer* pStackSnapshotResult = &pSlot->StackSnapshotResult;
 
-                if (pCollectorInstanceCurrentlyStackWalking != nullptr)
-                {
-                    stackWalkInProgressLock.unlock();
-                    pCollectorInstanceCurrentlyStackWalking->NotifyStackWalkCompleted(resultErrorCode);
-                }
-            });
+    // Collect data for TraceContext tracking:
 
-        // Collect data for TraceContext tracking:
+    ManagedThreadInfo* pThreadInfo = pSlot->ThreadInfo;
+    if (pThreadInfo->CanReadTraceContext())
+    {
+        pStackSnapshotResult->SetLocalRootSpanId(pThreadInfo->GetLocalRootSpanId());
+        pStackSnapshotResult->SetSpanId(pThreadInfo->GetSpanId());
+    }
 
-        bool traceContextDataCollected = pCollectorInstanceCurrentlyStackWalking->TryApplyTraceContextDataFromCurrentCollectionThreadToSnapshot();
-        assert(true == traceContextDataCollected);
+    // Now walk the stack:
 
-        // Now walk the stack:
+    unw_context_t uc;
+    unw_getcontext(&uc);
 
-        unw_context_t uc;
-        unw_getcontext(&uc);
+    unw_cursor_t cursor;
+    unw_init_local(&cursor, &uc);
 
-        unw_cursor_t cursor;
-        unw_init_local(&cursor, &uc);
+    // After every lib call that touches non-local state, check if the StackSamplerLoopManager requested this walk to abort:
+    if (IsCurrentCollectionAbortRequested())
+    {
+        TryAddFrame(pStackSnapshotResult, StackFrameCodeKind::MultipleMixed, 0, 0, 0);
+        return E_ABORT;
+    }
 
+    std::int32_t resultErrorCode = unw_step(&cursor);
+
+    // @ToDo: when do we stop? How do we signal normal vs abnormal completion via error codes here?
+    while (resultErrorCode > 0)
+    {
         // After every lib call that touches non-local state, check if the StackSamplerLoopManager requested this walk to abort:
-        if (pCollectorInstanceCurrentlyStackWalking->IsCurrentCollectionAbortRequested())
+        if (IsCurrentCollectionAbortRequested())
         {
-            pCollectorInstanceCurrentlyStackWalking->TryAddFrame(StackFrameCodeKind::MultipleMixed, 0, 0, 0);
-            resultErrorCode = E_ABORT;
-            return;
+            TryAddFrame(pStackSnapshotResult, StackFrameCodeKind::MultipleMixed, 0, 0, 0);
+            return E_ABORT;
+        }
+
+        unw_word_t nativeInstructionPointer;
+        resultErrorCode = unw_get_reg(&cursor, UNW_REG_IP, &nativeInstructionPointer);
+        if (resultErrorCode != 0)
+        {
+            return resultErrorCode;
+        }
+
+        if (!TryAddFrame(pStackSnapshotResult, StackFrameCodeKind::NotDetermined, 0, nativeInstructionPointer, 0))
+        {
+            return S_FALSE;
         }
 
         resultErrorCode = unw_step(&cursor);
+    }
+
+    return resultErrorCode;
+}
+
+bool LinuxStackFramesCollector::EnableCpuTimers(std::chrono::nanoseconds cpuInterval)
+{
+    std::lock_guard<std::mutex> lock(_cpuTimersLock);
+
+    if (_areCpuTimersEnabled)
+    {
+        return true;
+    }
+
+    // only one collector can receive the SIGPROF signals
+    LinuxStackFramesCollector* pExpected = nullptr;
+    if (!s_pInstanceWithCpuTimers.compare_exchange_strong(pExpected, this))
+    {
+        return false;
+    }
 
-        // @ToDo: when do we stop? How do we signal normal vs abnormal completion via error codes here?
-        while (resultErrorCode > 0)
+    struct sigaction timerAction;
+    timerAction.sa_flags = SA_RESTART | SA_SIGINFO;
+    timerAction.sa_sigaction = LinuxStackFramesCollector::CpuTimerSignalHandler;
+    sigemptyset(&timerAction.sa_mask);
+
+    // don't let a stack walk request interrupt a CPU sample collection
+    if (_signalToSend != -1)
+    {
+        sigaddset(&timerAction.sa_mask, _signalToSend);
+    }
+
+    if (!TrySetHandlerForSignal(SIGPROF, timerAction))
+    {
+        s_pInstanceWithCpuTimers.store(nullptr);
+        return false;
+    }
+
+    _cpuTimerInterval = cpuInterval;
+    _areCpuTimersEnabled = true;
+
+    Log::Info("LinuxStackFramesCollector::EnableCpuTimers: Successfully setup signal handler for SIGPROF signal.");
+    return true;
+}
+
+void LinuxStackFramesCollector::StartCpuTimer(ManagedThreadInfo* pThreadInfo)
+{
+    std::lock_guard<std::mutex> lock(_cpuTimersLock);
+
+    if (!_areCpuTimersEnabled || (_cpuTimerSlotByThread.find(pThreadInfo) != _cpuTimerSlotByThread.end()))
+    {
+        return;
+    }
+
+    std::uint32_t index;
+    if (!_freeCpuTimerSlots.empty())
+    {
+        index = _freeCpuTimerSlots.back();
+        _freeCpuTimerSlots.pop_back();
+    }
+    else if (_cpuTimerSlotsCount < MaxCpuTimersCount)
+    {
+        index = _cpuTimerSlotsCount++;
+        _cpuTimerSlots[index].store(new CpuTimerSlot());
+    }
+    else
+    {
+        Log::Debug("LinuxStackFramesCollector::StartCpuTimer: no more CPU timer available for thread with osThreadId=", pThreadInfo->GetOsThreadId(), ".");
+        return;
+    }
+
+    CpuTimerSlot* pSlot = _cpuTimerSlots[index].load();
+    pSlot->ThreadInfo = pThreadInfo;
+    pSlot->LastCpuTime = 0;
+
+    auto osThreadId = static_cast<pid_t>(pThreadInfo->GetOsThreadId());
+    auto generation = pSlot->Generation.load();
+
+    struct sigevent timerEvent = {};
+    timerEvent.sigev_notify = SIGEV_THREAD_ID;
+    timerEvent.sigev_signo = SIGPROF;
+    timerEvent.sigev_notify_thread_id = osThreadId;
+    timerEvent.sigev_value.sival_ptr = reinterpret_cast<void*>((static_cast<std::uintptr_t>(generation) << 32) | index);
+
+    if (timer_create(OpSysTools::GetThreadCpuClockId(osThreadId), &timerEvent, &pSlot->TimerId) != 0)
+    {
+        Log::Debug("LinuxStackFramesCollector::StartCpuTimer: Unable to create CPU timer for thread with osThreadId=", osThreadId, ". Reason: ", strerror(errno), ".");
+        pSlot->ThreadInfo = nullptr;
+        _freeCpuTimerSlots.push_back(index);
+        return;
+    }
+
+    // the slot keeps the thread info alive until its last samples are collected
+    pThreadInfo->AddRef();
+    _cpuTimerSlotByThread[pThreadInfo] = index;
+
+    auto intervalNs = _cpuTimerInterval.count();
+    struct itimerspec timerSpec;
+    timerSpec.it_interval.tv_sec = intervalNs / 1000000000;
+    timerSpec.it_interval.tv_nsec = intervalNs % 1000000000;
+    timerSpec.it_value = timerSpec.it_interval;
+
+    if (timer_settime(pSlot->TimerId, 0, &timerSpec, nullptr) != 0)
+    {
+        Log::Debug("LinuxStackFramesCollector::StartCpuTimer: Unable to start CPU timer for thread with osThreadId=", osThreadId, ". Reason: ", strerror(errno), ".");
+    }
+}
+
+void LinuxStackFramesCollector::StopCpuTimer(ManagedThreadInfo* pThreadInfo)
+{
+    std::lock_guard<std::mutex> lock(_cpuTimersLock);
+
+    auto entry = _cpuTimerSlotByThread.find(pThreadInfo);
+    if (entry == _cpuTimerSlotByThread.end())
+    {
+        return;
+    }
+
+    auto index = entry->second;
+    _cpuTimerSlotByThread.erase(entry);
+
+    CpuTimerSlot* pSlot = _cpuTimerSlots[index].load();
+    timer_delete(pSlot->TimerId);
+
+    // a signal could still be pending: the handler must ignore it
+    pSlot->Generation.fetch_add(1);
+    if (!pSlot->Handlers.WaitForAll(InFlightHandlersTimeout))
+    {
+        // the slot is not reused while its handler could still be writing into it: it is freed by DisableCpuTimers
+        Log::Warn("LinuxStackFramesCollector::StopCpuTimer: the CPU timer signal handler of thread with osThreadId=",
+                  pThreadInfo->GetOsThreadId(), " is still running after ", InFlightHandlersTimeout.count() / 1000000, " ms.");
+        return;
+    }
+
+    _stoppedCpuTimerSlots.push_back(index);
+}
+
+void LinuxStackFramesCollector::CollectCpuTimerSamples(std::vector<RawCpuSample>& samples)
+{
+    std::lock_guard<std::mutex> lock(_cpuTimersLock);
+
+    for (auto const& [pThreadInfo, index] : _cpuTimerSlotByThread)
+    {
+        ReadCpuTimerSamples(_cpuTimerSlots[index].load(), samples);
+    }
+
+    for (auto index : _stoppedCpuTimerSlots)
+    {
+        CpuTimerSlot* pSlot = _cpuTimerSlots[index].load();
+        ReadCpuTimerSamples(pSlot, samples);
+
+        pSlot->ThreadInfo->Release();
+        pSlot->ThreadInfo = nullptr;
+        _freeCpuTimerSlots.push_back(index);
+    }
+    _stoppedCpuTimerSlots.clear();
+}
+
+void LinuxStackFramesCollector::ReadCpuTimerSamples(CpuTimerSlot* pSlot, std::vector<RawCpuSample>& samples)
+{
+    auto readIndex = pSlot->ReadIndex.load(std::memory_order_relaxed);
+    auto writeIndex = pSlot->WriteIndex.load(std::memory_order_acquire);
+
+    for (; readIndex < writeIndex; readIndex++)
+    {
+        auto const& sample = pSlot->Samples[readIndex % CpuTimerSamplesCount];
+
+        RawCpuSample rawCpuSample;
+        rawCpuSample.Timestamp = sample.Timestamp;
+        rawCpuSample.LocalRootSpanId = sample.LocalRootSpanId;
+        rawCpuSample.SpanId = sample.SpanId;
+        rawCpuSample.Stack.assign(sample.Frames, sample.Frames + sample.FramesCount);
+        rawCpuSample.ThreadInfo = pSlot->ThreadInfo;
+        pSlot->ThreadInfo->AddRef();
+        rawCpuSample.Duration = sample.Duration;
+        samples.push_back(std::move(rawCpuSample));
+    }
+
+    pSlot->ReadIndex.store(readIndex, std::memory_order_release);
+    _droppedCpuTimerSamplesCount += pSlot->DroppedCount.exchange(0);
+}
+
+void LinuxStackFramesCollector::DisableCpuTimers()
+{
+    std::vector<CpuTimerSlot*> slots;
+    {
+        std::lock_guard<std::mutex> lock(_cpuTimersLock);
+
+        if (!_areCpuTimersEnabled)
         {
-            // After every lib call that touches non-local state, check if the StackSamplerLoopManager requested this walk to abort:
-            if (pCollectorInstanceCurrentlyStackWalking->IsCurrentCollectionAbortRequested())
-            {
-                pCollectorInstanceCurrentlyStackWalking->TryAddFrame(StackFrameCodeKind::MultipleMixed, 0, 0, 0);
-                resultErrorCode = E_ABORT;
-                return;
-            }
+            return;
+        }
 
-            unw_word_t nativeInstructionPointer;
-            resultErrorCode = unw_get_reg(&cursor, UNW_REG_IP, &nativeInstructionPointer);
-            if (resultErrorCode != 0)
-            {
-                return;
-            }
+        for (auto const& [pThreadInfo, index] : _cpuTimerSlotByThread)
+        {
+            CpuTimerSlot* pSlot = _cpuTimerSlots[index].load();
+            timer_delete(pSlot->TimerId);
+            pSlot->Generation.fetch_add(1);
+        }
 
-            if (!pCollectorInstanceCurrentlyStackWalking->TryAddFrame(StackFrameCodeKind::NotDetermined, 0, nativeInstructionPointer, 0))
-            {
-                resultErrorCode = S_FALSE;
-                return;
-            }
+        // the SIGPROF handler stays installed but ignores the signals from now on
+        s_pInstanceWithCpuTimers.store(nullptr);
 
-            resultErrorCode = unw_step(&cursor);
+        slots.reserve(_cpuTimerSlotsCount);
+        for (std::uint32_t index = 0; index < _cpuTimerSlotsCount; index++)
+        {
+            slots.push_back(_cpuTimerSlots[index].exchange(nullptr));
         }
+
+        Log::Debug("LinuxStackFramesCollector: ", _droppedCpuTimerSamplesCount, " CPU samples dropped because they were not collected in time.");
+
+        _cpuTimerSlotByThread.clear();
+        _stoppedCpuTimerSlots.clear();
+        _freeCpuTimerSlots.clear();
+        _cpuTimerSlotsCount = 0;
+        _areCpuTimersEnabled = false;
+    }
+
+    // A handler that already loaded this instance could still be using it and its slots:
+    // wait for all of them (outside of the lock) before the slots are freed
+    if (!s_cpuTimerHandlers.WaitForAll(InFlightHandlersTimeout))
+    {
+        Log::Warn("LinuxStackFramesCollector::DisableCpuTimers: ", s_cpuTimerHandlers.GetCount(), " CPU timer signal handlers are still running after ",
+                  InFlightHandlersTimeout.count() / 1000000, " ms: the CPU timer slots are not freed.");
+        return;
     }
+
+    for (auto* pSlot : slots)
+    {
+        if (pSlot->ThreadInfo != nullptr)
+        {
+            pSlot->ThreadInfo->Release();
+        }
+        delete pSlot;
+    }
+}
+
+void LinuxStackFramesCollector::CpuTimerSignalHandler(int signal, siginfo_t* info, void* context)
+{
+    // ignore SIGPROF signals that are not sent by our timers
+    if ((info == nullptr) || (info->si_code != SI_TIMER))
+    {
+        return;
+    }
+
+    // must be counted before the collector is loaded: see DisableCpuTimers
+    s_cpuTimerHandlers.Enter();
+
+    LinuxStackFramesCollector* pCollector = s_pInstanceWithCpuTimers.load();
+    if (pCollector != nullptr)
+    {
+        // errno must be preserved for the interrupted code
+        int savedErrno = errno;
+
+        auto value = reinterpret_cast<std::uintptr_t>(info->si_value.sival_ptr);
+        pCollector->CollectCpuTimerSample(static_cast<std::uint32_t>(value & 0xFFFFFFFF), static_cast<std::uint32_t>(value >> 32), info->si_overrun);
+
+        errno = savedErrno;
+    }
+
+    s_cpuTimerHandlers.Leave();
+}
+
+void LinuxStackFramesCollector::CollectCpuTimerSample(std::uint32_t index, std::uint32_t generation, int overrun)
+{
+    if (index >= MaxCpuTimersCount)
+    {
+        return;
+    }
+
+    CpuTimerSlot* pSlot = _cpuTimerSlots[index].load();
+    if (pSlot == nullptr)
+    {
+        return;
+    }
+
+    // StopCpuTimer waits for the in-flight handlers of the slot after changing the generation:
+    // a stale signal of the previous thread of the slot is counted too and cannot hide the handler of its new thread
+    pSlot->Handlers.Enter();
+    if (pSlot->Generation.load() == generation)
+    {
+        WriteCpuTimerSample(pSlot, overrun);
+    }
+    pSlot->Handlers.Leave();
+}
+
+void LinuxStackFramesCollector::WriteCpuTimerSample(CpuTimerSlot* pSlot, int overrun)
+{
+    // Running in the signal handler of the sampled thread: only async-signal-safe calls here
+
+    struct timespec time;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0)
+    {
+        return;
+    }
+
+    std::uint64_t cpuTime = static_cast<std::uint64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+    std::uint64_t duration = ((pSlot->LastCpuTime == 0) || (cpuTime <= pSlot->LastCpuTime))
+                                 ? _cpuTimerInterval.count() * (1 + static_cast<std::uint64_t>(overrun))
+                                 : cpuTime - pSlot->LastCpuTime;
+    pSlot->LastCpuTime = cpuTime;
+
+    auto writeIndex = pSlot->WriteIndex.load(std::memory_order_relaxed);
+    if (writeIndex - pSlot->ReadIndex.load(std::memory_order_acquire) >= CpuTimerSamplesCount)
+    {
+        pSlot->DroppedCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    auto& sample = pSlot->Samples[writeIndex % CpuTimerSamplesCount];
+    sample.Duration = duration;
+    sample.Timestamp = (clock_gettime(CLOCK_REALTIME, &time) == 0) ? time.tv_sec : 0;
+
+    ManagedThreadInfo* pThreadInfo = pSlot->ThreadInfo;
+    bool canReadTraceContext = pThreadInfo->CanReadTraceContext();
+    sample.LocalRootSpanId = canReadTraceContext ? pThreadInfo->GetLocalRootSpanId() : 0;
+    sample.SpanId = canReadTraceContext ? pThreadInfo->GetSpanId() : 0;
+
+    unw_context_t uc;
+    unw_getcontext(&uc);
+
+    unw_cursor_t cursor;
+    unw_init_local(&cursor, &uc);
+
+    std::uint32_t framesCount = 0;
+    while ((framesCount < MaxCpuTimerFramesCount) && (unw_step(&cursor) > 0))
+    {
+        unw_word_t nativeInstructionPointer;
+        if (unw_get_reg(&cursor, UNW_REG_IP, &nativeInstructionPointer) != 0)
+        {
+            break;
+        }
+
+        sample.Frames[framesCount++] = nativeInstructionPointer;
+    }
+
+    if (framesCount == 0)
+    {
+        return;
+    }
+
+    sample.FramesCount = framesCount;
+    pSlot->WriteIndex.store(writeIndex + 1, std::memory_order_release);
 }
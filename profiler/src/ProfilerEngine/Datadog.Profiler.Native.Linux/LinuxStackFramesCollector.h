@@ -8,12 +8,16 @@
 #include "corprof.h"
 // end
 
+#include "InFlightHandlers.h"
 #include "StackFramesCollectorBase.h"
 
-#include <condition_variable>
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <signal.h>
+#include <time.h>
+#include <unordered_map>
+#include <vector>
 
 class LinuxStackFramesCollector : public StackFramesCollectorBase
 {
@@ -23,6 +27,23 @@ public:
     LinuxStackFramesCollector(LinuxStackFramesCollector const&) = delete;
     LinuxStackFramesCollector& operator=(LinuxStackFramesCollector const&) = delete;
 
+    // Each managed thread gets a timer on its own CPU clock that sends SIGPROF to the thread itself
+    // every cpuInterval of consumed CPU: an idle thread is never interrupted.
+    // The signal handler walks the stack into preallocated buffers attached to the thread and the
+    // sampler thread later collects them (single producer/single consumer per thread)
+    bool EnableCpuTimers(std::chrono::nanoseconds cpuInterval) override;
+    void StartCpuTimer(ManagedThreadInfo* pThreadInfo) override;
+    void StopCpuTimer(ManagedThreadInfo* pThreadInfo) override;
+    void CollectCpuTimerSamples(std::vector<RawCpuSample>& samples) override;
+
+    // The signal is sent to all the threads of the batch at once and each one walks its own stack
+    // into its own slot: the whole batch is collected in about the time of the longest walk.
+    std::uint32_t GetStackSamplesBatchCapacity() override;
+    void CollectStackSamples(ManagedThreadInfo* const* ppThreadInfos,
+                             std::uint32_t count,
+                             StackSnapshotResultBuffer** ppStackSnapshotResults,
+                             uint32_t* pHRs) override;
+
 protected:
     // Linux collector is different from Windows:
     // There is no notion to Suspend/Resume a thread and to have an external thread walk the suspended thread.
@@ -35,22 +56,142 @@ protected:
 
 private:
     bool SetupSignalHandler();
-    void NotifyStackWalkCompleted(std::int32_t resultErrorCode);
 
     int _signalToSend;
     bool _isSignalHandlerSetup;
 
-    std::int32_t _lastStackWalkErrorCode;
-    std::condition_variable _stackWalkInProgressWaiter;
-
     ICorProfilerInfo4* const _pCorProfilerInfo;
 
+private:
+    // A slot is owned by the sampler thread while its state is Free or Completed.
+    // Otherwise, the state is the OS id of the thread that has been signaled (Requested)
+    // and this thread takes ownership by replacing it with Walking in its signal handler:
+    // a late signal (i.e. after the sampler gave up waiting) cannot write into a slot reused for another thread.
+    // A slot that is still Walking when the sampler stops waiting is abandoned to its thread:
+    // it is not used by the next batches until the thread marks it as Completed.
+    static constexpr pid_t StackWalkSlotFree = 0;
+    static constexpr pid_t StackWalkSlotWalking = -1;
+    static constexpr pid_t StackWalkSlotCompleted = -2;
+
+    struct StackWalkSlot
+    {
+        std::atomic<pid_t> State{StackWalkSlotFree};
+        std::uint16_t BatchId = 0;
+        ManagedThreadInfo* ThreadInfo = nullptr;
+        std::int32_t ErrorCode = 0;
+        StackSnapshotResultReusableBuffer StackSnapshotResult;
+    };
+
+    // open addressing table from the OS thread id to the slot of the current batch:
+    // the signal handler finds its slot without scanning all the slots
+    struct StackWalkSlotIndexEntry
+    {
+        std::atomic<pid_t> OsThreadId{0};
+        std::atomic<StackWalkSlot*> Slot{nullptr};
+    };
+
+    static constexpr std::uint32_t StackWalkSlotsIndexSize = 128; // power of 2, at least twice the slots count
+
+    std::uint32_t ReserveStackWalkSlots(ManagedThreadInfo* const* ppThreadInfos, std::uint32_t count);
+    void SendStackWalkRequests(std::uint32_t count);
+    void IndexStackWalkSlot(pid_t osThreadId, StackWalkSlot* pSlot);
+    StackWalkSlot* FindStackWalkSlot(pid_t osThreadId);
+    void WaitForStackWalks(std::uint32_t count);
+    void WaitForPendingStackWalks(std::int64_t deadline);
+    void CollectStackSampleInSlot(pid_t osThreadId);
+    void OnStackWalkCompleted(std::uint16_t batchId);
+    std::int32_t WalkStack(StackWalkSlot* pSlot);
+
+    // preallocated: one slot per thread sampled in parallel
+    std::vector<std::unique_ptr<StackWalkSlot>> _stackWalkSlots;
+
+    // slots used by the current batch (nullptr once abandoned)
+    std::vector<StackWalkSlot*> _batchSlots;
+
+    // rebuilt for each batch before the signals are sent
+    StackWalkSlotIndexEntry _stackWalkSlotsIndex[StackWalkSlotsIndexSize];
+
+    // returned for the threads that could not be sampled (i.e. no slot available)
+    StackSnapshotResultReusableBuffer _emptyStackSnapshotResult;
+
+    // futex word: id of the current batch (high 16 bits) and number of its signaled threads
+    // that did not complete their stack walk yet, nor were given up by the sampler thread (low 16 bits).
+    // A walk that completes after the sampler gave up waiting for it does not belong to the current batch anymore
+    // and must not be counted.
+    std::atomic<std::uint32_t> _pendingStackWalks;
+    std::uint16_t _currentBatchId;
+
+    static constexpr std::uint32_t GetPendingCount(std::uint32_t pendingStackWalks)
+    {
+        return pendingStackWalks & 0xFFFF;
+    }
+
+    static constexpr std::uint16_t GetBatchId(std::uint32_t pendingStackWalks)
+    {
+        return static_cast<std::uint16_t>(pendingStackWalks >> 16);
+    }
+
+private:
+    static const std::uint32_t MaxCpuTimersCount = 4096;
+    static const std::uint32_t CpuTimerSamplesCount = 4; // per thread between two collections
+    static const std::uint32_t MaxCpuTimerFramesCount = 512;
+
+    struct CpuTimerSample
+    {
+        std::uint64_t Timestamp;
+        std::uint64_t Duration;
+        std::uint64_t LocalRootSpanId;
+        std::uint64_t SpanId;
+        std::uint32_t FramesCount;
+        std::uintptr_t Frames[MaxCpuTimerFramesCount];
+    };
+
+    // Slots are reused for new threads but never freed before the CPU timers are disabled:
+    // a signal sent by the timer of a previous thread is ignored thanks to the generation
+    // stored with the slot index in the timer notification value.
+    // Handlers counts the in-flight handlers of the slot to stop the timer of a thread:
+    // DisableCpuTimers waits for all the in-flight handlers (s_cpuTimerHandlers) before freeing the slots.
+    struct CpuTimerSlot
+    {
+        ManagedThreadInfo* ThreadInfo = nullptr;
+        timer_t TimerId;
+        std::atomic<std::uint32_t> Generation{0};
+        InFlightHandlers Handlers;
+        std::uint64_t LastCpuTime = 0; // only accessed by the thread itself
+        std::atomic<std::uint64_t> WriteIndex{0};
+        std::atomic<std::uint64_t> ReadIndex{0};
+        std::atomic<std::uint64_t> DroppedCount{0};
+        CpuTimerSample Samples[CpuTimerSamplesCount];
+    };
+
+    void CollectCpuTimerSample(std::uint32_t index, std::uint32_t generation, int overrun);
+    void WriteCpuTimerSample(CpuTimerSlot* pSlot, int overrun);
+    void ReadCpuTimerSamples(CpuTimerSlot* pSlot, std::vector<RawCpuSample>& samples);
+    void DisableCpuTimers();
+
+    std::mutex _cpuTimersLock;
+    bool _areCpuTimersEnabled;
+    std::chrono::nanoseconds _cpuTimerInterval;
+    std::atomic<CpuTimerSlot*> _cpuTimerSlots[MaxCpuTimersCount];
+    std::uint32_t _cpuTimerSlotsCount;
+    std::vector<std::uint32_t> _freeCpuTimerSlots;
+    std::vector<std::uint32_t> _stoppedCpuTimerSlots; // not reused before their last samples are collected
+    std::unordered_map<ManagedThreadInfo*, std::uint32_t> _cpuTimerSlotByThread;
+    std::uint64_t _droppedCpuTimerSamplesCount;
+
 private:
     static bool TrySetHandlerForSignal(int signal, struct sigaction& action);
     static char const* ErrorCodeToString(int errorCode);
 
     static void CollectStackSampleSignalHandler(int signal);
+    static void CpuTimerSignalHandler(int signal, siginfo_t* info, void* context);
+
+    static std::atomic<LinuxStackFramesCollector*> s_pInstanceCollectingStackSamples;
+
+    // stack walk signal handlers currently using the instance collecting stack samples (and its slots)
+    static InFlightHandlers s_stackWalkHandlers;
+    static std::atomic<LinuxStackFramesCollector*> s_pInstanceWithCpuTimers;
 
-    static std::mutex s_stackWalkInProgressMutex;
-    static LinuxStackFramesCollector* s_pInstanceCurrentlyStackWalking;
+    // SIGPROF handlers currently using the instance with CPU timers (and its slots)
+    static InFlightHandlers s_cpuTimerHandlers;
 };
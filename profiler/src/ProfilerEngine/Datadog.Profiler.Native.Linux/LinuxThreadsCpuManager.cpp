@@ -2,12 +2,83 @@
 // This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
 
 #include "ThreadsCpuManager.h"
+#include "shared/src/native-src/string.h"
+
+#include "Log.h"
+#include "OpSysTools.h"
+
+#include <dirent.h>
+#include <iomanip>
+#include <sstream>
+#include <stdlib.h>
+#include <time.h>
 
-// -------------------------------------
-// Currently no implementation on Linux
-// -------------------------------------
 // List all threads in the current process
 // and dump their CPU consumption
 void ThreadsCpuManager::LogCpuTimes()
 {
+    DIR* pTasks = opendir("/proc/self/task");
+    if (pTasks == nullptr)
+    {
+        return;
+    }
+
+    // get process time to compute % per thread
+    struct timespec processCpuTime;
+    std::uint64_t processCpuTimeMs = 0;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &processCpuTime) == 0)
+    {
+        processCpuTimeMs = static_cast<std::uint64_t>(processCpuTime.tv_sec) * 1000 + processCpuTime.tv_nsec / 1000000;
+    }
+
+    std::stringstream builder;
+
+    builder << "\r\n";
+    builder << "   TID |    CPU Time     Usage  Name"
+            << "\r\n";
+    builder << "--------------------------------------------"
+            << "\r\n";
+
+    std::lock_guard<std::recursive_mutex> lock(_lockThreads);
+    struct dirent* pEntry;
+    while ((pEntry = readdir(pTasks)) != nullptr)
+    {
+        // skip "." and ".."
+        if (pEntry->d_name[0] == '.')
+        {
+            continue;
+        }
+
+        auto tid = static_cast<pid_t>(strtol(pEntry->d_name, nullptr, 10));
+        std::uint64_t cpuTime = 0;
+        if (!OpSysTools::GetThreadCpuTime(OpSysTools::GetThreadCpuClockId(tid), tid, cpuTime))
+        {
+            builder << std::setw(6) << tid << " | ???"
+                    << "\r\n";
+            continue;
+        }
+
+        auto threadMs = cpuTime / 1000000;
+        float percent = -1; // in case the process CPU time is not available
+        if (processCpuTimeMs != 0)
+            percent = ((static_cast<float>(threadMs) * 100) / processCpuTimeMs);
+
+        builder << std::setw(6) << tid << " | ";
+        builder << std::setw(8) << threadMs << " ms [";
+        builder << std::setw(5) << std::setprecision(2) << percent << " %]";
+
+        // show the thread name if any
+        auto element = _threads.find(static_cast<DWORD>(tid));
+        if (element != _threads.end())
+        {
+            builder << "  " << shared::ToString(*element->second->GetName());
+        }
+        builder << "\r\n";
+    }
+
+    closedir(pTasks);
+
+    builder << "\r\n";
+    auto output = builder.str();
+    Log::Debug(output);
 }
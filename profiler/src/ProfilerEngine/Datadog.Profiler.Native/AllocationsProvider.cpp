@@ -0,0 +1,125 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include <ctime>
+
+#include "AllocationsProvider.h"
+#include "EventPipePayload.h"
+#include "IAppDomainStore.h"
+#include "IConfiguration.h"
+#include "IFrameStore.h"
+#include "IManagedThreadList.h"
+#include "IRuntimeIdStore.h"
+#include "RawAllocationSample.h"
+
+// Payload layout (see ClrEtwAll.man in the runtime repository):
+//   GCAllocationTick V2: AllocationAmount (UInt32) | AllocationKind (UInt32) | ClrInstanceID (UInt16)
+//                        | AllocationAmount64 (UInt64) | TypeID (Pointer) | TypeName (UnicodeString) | HeapIndex (UInt32)
+//                    V3: ... | Address (Pointer)
+//                    V4: ... | ObjectSize (UInt64)
+constexpr ULONG AllocationAmount64Offset = 2 * sizeof(std::uint32_t) + sizeof(std::uint16_t);
+constexpr ULONG TypeIdOffset = AllocationAmount64Offset + sizeof(std::uint64_t);
+constexpr ULONG TypeNameOffset = TypeIdOffset + sizeof(void*);
+
+
+AllocationsProvider::AllocationsProvider(
+    ICorProfilerInfo4* pCorProfilerInfo,
+    IManagedThreadList* pManagedThreadList,
+    IConfiguration* pConfiguration,
+    IFrameStore* pFrameStore,
+    IAppDomainStore* pAppDomainStore,
+    IRuntimeIdStore* pRuntimeIdStore,
+    SamplesTransformerPool* pTransformerPool
+    )
+    :
+    CollectorBase<RawAllocationSample>(pConfiguration, pFrameStore, pAppDomainStore, pRuntimeIdStore, pTransformerPool),
+    _pCorProfilerInfo{pCorProfilerInfo},
+    _pManagedThreadList{pManagedThreadList},
+    _pFrameStore{pFrameStore}
+{
+}
+
+const char* AllocationsProvider::GetName()
+{
+    return _serviceName;
+}
+
+void AllocationsProvider::OnEventPipeEvent(
+    DWORD eventId,
+    DWORD eventVersion,
+    ULONG cbEventData,
+    LPCBYTE eventData,
+    ThreadID eventThread,
+    ULONG numStackFrames,
+    UINT_PTR stackFrames[])
+{
+    if (eventId == AllocationTickEventId)
+    {
+        OnAllocationTick(eventVersion, cbEventData, eventData, eventThread, numStackFrames, stackFrames);
+    }
+}
+
+void AllocationsProvider::OnAllocationTick(DWORD eventVersion, ULONG cbEventData, LPCBYTE eventData, ThreadID eventThread, ULONG numStackFrames, UINT_PTR stackFrames[])
+{
+    // the type of the allocated object is provided since V2
+    std::uint64_t allocationAmount;
+    std::uintptr_t typeId;
+    if ((eventVersion < 2) ||
+        !EventPipePayload::TryRead(eventData, cbEventData, AllocationAmount64Offset, allocationAmount) ||
+        !EventPipePayload::TryRead(eventData, cbEventData, TypeIdOffset, typeId))
+    {
+        return;
+    }
+
+    if (numStackFrames == 0)
+    {
+        return;
+    }
+
+    RawAllocationSample rawSample;
+    rawSample.Timestamp = static_cast<std::uint64_t>(std::time(nullptr));
+    rawSample.AllocationAmount = allocationAmount;
+    rawSample.AllocationSize = 0;
+    if (eventVersion >= 4)
+    {
+        // the object size follows the type name, the heap index and the object address
+        ULONG offset = TypeNameOffset;
+        if (EventPipePayload::TrySkipString(eventData, cbEventData, offset))
+        {
+            EventPipePayload::TryRead(eventData, cbEventData, offset + sizeof(std::uint32_t) + sizeof(void*), rawSample.AllocationSize);
+        }
+    }
+
+    if (!_pFrameStore->GetTypeName(static_cast<ClassID>(typeId), rawSample.AllocationClass))
+    {
+        rawSample.AllocationClass = "Unknown-Type";
+    }
+
+    rawSample.Stack.assign(stackFrames, stackFrames + numStackFrames);
+
+    _pCorProfilerInfo->GetThreadAppDomain(eventThread, &rawSample.AppDomainId);
+
+    // GetThreadInfo() calls AddRef() on the threadInfo: it is released after the sample is transformed
+    rawSample.ThreadInfo = _pManagedThreadList->GetThreadInfo(eventThread);
+    if ((rawSample.ThreadInfo != nullptr) && rawSample.ThreadInfo->CanReadTraceContext())
+    {
+        rawSample.LocalRootSpanId = rawSample.ThreadInfo->GetLocalRootSpanId();
+        rawSample.SpanId = rawSample.ThreadInfo->GetSpanId();
+    }
+
+    std::lock_guard<std::mutex> lock(_addLock);
+    Add(std::move(rawSample));
+}
+
+void AllocationsProvider::OnTransformRawSample(const RawAllocationSample& rawSample, Sample& sample)
+{
+    std::uint64_t count = 1;
+    if ((rawSample.AllocationSize != 0) && (rawSample.AllocationAmount > rawSample.AllocationSize))
+    {
+        count = rawSample.AllocationAmount / rawSample.AllocationSize;
+    }
+
+    sample.AddValue(static_cast<std::int64_t>(count), SampleValue::AllocationCount);
+    sample.AddValue(static_cast<std::int64_t>(rawSample.AllocationAmount), SampleValue::AllocationSize);
+    sample.AddLabel(Label{Sample::AllocationClassLabel, rawSample.AllocationClass});
+}
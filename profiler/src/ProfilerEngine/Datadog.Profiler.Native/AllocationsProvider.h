@@ -0,0 +1,79 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#pragma once
+#include <cstdint>
+#include <mutex>
+
+#include "cor.h"
+#include "corprof.h"
+
+#include "CollectorBase.h"
+#include "RawAllocationSample.h"
+
+// forward declarations
+class IConfiguration;
+class IFrameStore;
+class IAppDomainStore;
+class IRuntimeIdStore;
+class IManagedThreadList;
+
+
+// Allocations are received as GCAllocationTick events from the Microsoft-Windows-DotNETRuntime
+// EventPipe provider: the runtime emits one event every ~AllocationTickInterval bytes allocated
+// on a thread so that the other allocations do not pay anything. The event is delivered with the
+// callstack of the allocating thread and the type of the object that crossed the threshold.
+// The tick is deterministic (not a Poisson sample): each sample accounts for the bytes allocated
+// since the previous event (AllocationAmount64) and, when the runtime provides the size of the
+// sampled object, for as many objects of this size as these bytes represent.
+class AllocationsProvider
+    : public CollectorBase<RawAllocationSample> // accepts raw allocation samples
+{
+public:
+    // GCAllocationTick is only emitted at the verbose level of the GC keyword
+    static const std::uint64_t GCKeyword = 0x1;
+    static const std::uint32_t AllocationTickLevel = COR_PRF_EVENTPIPE_VERBOSE;
+    static const DWORD AllocationTickEventId = 10;
+
+    static const std::uint64_t AllocationTickInterval = 100 * 1024;
+
+public:
+    AllocationsProvider(
+        ICorProfilerInfo4* pCorProfilerInfo,
+        IManagedThreadList* pManagedThreadList,
+        IConfiguration* pConfiguration,
+        IFrameStore* pFrameStore,
+        IAppDomainStore* pAppDomainStore,
+        IRuntimeIdStore* pRuntimeIdStore,
+        SamplesTransformerPool* pTransformerPool = nullptr
+        );
+
+    // called by the CLR for each event of the runtime provider
+    void OnEventPipeEvent(
+        DWORD eventId,
+        DWORD eventVersion,
+        ULONG cbEventData,
+        LPCBYTE eventData,
+        ThreadID eventThread,
+        ULONG numStackFrames,
+        UINT_PTR stackFrames[]);
+
+// interfaces implementation
+public:
+    const char* GetName() override;
+
+private:
+    virtual void OnTransformRawSample(const RawAllocationSample& rawSample, Sample& sample) override;
+
+    void OnAllocationTick(DWORD eventVersion, ULONG cbEventData, LPCBYTE eventData, ThreadID eventThread, ULONG numStackFrames, UINT_PTR stackFrames[]);
+
+private:
+    const char* _serviceName = "AllocationsProvider";
+
+    ICorProfilerInfo4* _pCorProfilerInfo;
+    IManagedThreadList* _pManagedThreadList;
+    IFrameStore* _pFrameStore;
+
+    // the raw samples queue accepts only one producer at a time but allocation ticks are received on any thread
+    std::mutex _addLock;
+};
@@ -2,10 +2,13 @@
 // This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
 
 #pragma once
-#include <list>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 #include "Log.h"
 #include "OpSysTools.h"
 
@@ -17,6 +20,8 @@
 #include "IRuntimeIdStore.h"
 #include "ProviderBase.h"
 #include "RawSample.h"
+#include "RawSamplesRingBuffer.h"
+#include "SamplesTransformerPool.h"
 
 #include "shared/src/native-src/string.h"
 
@@ -29,11 +34,17 @@ using namespace std::chrono_literals;
 
 
 // Base class used for storing raw samples that are transformed into exportable Sample
-// every hundreds of milliseconds. The transformation code is setting :
+// by a dedicated thread. This thread sleeps while there is nothing to transform and is
+// woken up when enough raw samples are queued or when the oldest one has been waiting
+// for too long. The transformation code is setting :
 //  - common labels (process id, thread id, appdomain, span ids) into Sample instances
 //  - symbolized call stack (TODO: how to define a fake call stack? should we support
 //    "hardcoded" fake IPs in the symbol store (0 = "Heap Profiler")?)
 //
+// When a transformer pool is given, this thread only dispatches batches of raw samples to the
+// workers of the pool (shared by all collectors) and each worker stores its samples in its own
+// shard of ProviderBase.
+//
 // Each profiler has to implement an inherited class responsible for setting its
 // specific labels (such as exception name or exception message) if any but more important,
 // to set its value(s) like wall time duration or cpu time duration.
@@ -50,12 +61,18 @@ public:
         IConfiguration* pConfiguration,
         IFrameStore* pFrameStore,
         IAppDomainStore* pAppDomainStore,
-        IRuntimeIdStore* pRuntimeIdStore
+        IRuntimeIdStore* pRuntimeIdStore,
+        SamplesTransformerPool* pTransformerPool = nullptr
         ) :
+        ProviderBase((pTransformerPool == nullptr) ? 1 : pTransformerPool->GetWorkersCount()),
         _isNativeFramesEnabled{pConfiguration->IsNativeFramesEnabled()},
         _pFrameStore{pFrameStore},
         _pAppDomainStore{pAppDomainStore},
-        _pRuntimeIdStore{pRuntimeIdStore}
+        _pRuntimeIdStore{pRuntimeIdStore},
+        _pTransformerPool{pTransformerPool},
+        _rawSamples{(std::max)(pConfiguration->GetRawSamplesCapacity(), MinRawSamplesCapacity), MaxFramesCount},
+        _highWatermark{_rawSamples.GetCapacity() / 4},
+        _lowWatermark{_rawSamples.GetCapacity() / 16}
     {
     }
 
@@ -74,63 +91,101 @@ public:
 
     bool Stop() override
     {
-        _stopRequested.store(true);
+        {
+            std::lock_guard<std::mutex> lock(_wakeUpLock);
+            _stopRequested.store(true);
+        }
+        _wakeUpCondition.notify_one();
         _transformerThread.join();
 
+        // release the ManagedThreadInfo references still held by the pending raw samples
+        TRawSample rawSample;
+        while (_rawSamples.TryPop(rawSample))
+        {
+            if (rawSample.ThreadInfo != nullptr)
+            {
+                rawSample.ThreadInfo->Release();
+            }
+        }
+
+        auto droppedCount = _rawSamples.GetDroppedCount();
+        auto truncatedCount = _rawSamples.GetTruncatedCount();
+        if ((droppedCount != 0) || (truncatedCount != 0))
+        {
+            Log::Info(GetName(), ": ", droppedCount, " raw samples dropped and ", truncatedCount, " stacks truncated.");
+        }
+
+        Log::Info(GetName(), ": max queue depth = ", _maxQueueDepth.load(), " - last transform latency = ", GetLastTransformLatency().count(), " ns.");
+
         return true;
     }
 
+    // Must be called by a single producer thread at a time
     void Add(TRawSample&& sample) override
     {
-        std::lock_guard<std::mutex> lock(_rawSamplesLock);
-
-        _collectedSamples.push_back(std::forward<TRawSample>(sample));
+        Add(std::forward<TRawSample>(sample), sample.Stack.data(), sample.Stack.size());
     }
 
-protected:
-    // set values and additional labels
-    virtual void OnTransformRawSample(const TRawSample& rawSample, Sample& sample) = 0;
+    // Must be called by a single producer thread at a time
+    void Add(TRawSample&& sample, std::uintptr_t const* pFrames, std::size_t framesCount) override
+    {
+        if (!_rawSamples.TryPush(std::forward<TRawSample>(sample), pFrames, framesCount))
+        {
+            // the sample is dropped so the reference on ManagedThreadInfo must be released here
+            if (sample.ThreadInfo != nullptr)
+            {
+                sample.ThreadInfo->Release();
+            }
 
-private:
-    inline static const std::chrono::nanoseconds CollectingPeriod = 50ms;
+            return;
+        }
 
-    void ProcessSamples()
-    {
-        Log::Info("Starting to process raw '", GetName(), "' samples.");
+        // The transformer thread needs to be woken up only when it is idle (first sample)
+        // or when the high watermark is reached; the max latency deadline covers the rest
+        auto queueDepth = _rawSamples.Size();
+        if (queueDepth > _maxQueueDepth.load(std::memory_order_relaxed))
+        {
+            _maxQueueDepth.store(queueDepth, std::memory_order_relaxed);
+        }
 
-        while (!_stopRequested.load())
+        if ((queueDepth == 1) || (queueDepth == _highWatermark))
         {
-            std::list<TRawSample> input = FetchRawSamples();
-            if (input.size() != 0)
             {
-                TransformRawSamples(input);
+                // taking the lock ensures that the notification is not lost if the transformer
+                // thread is between checking the queue and starting to wait
+                std::lock_guard<std::mutex> lock(_wakeUpLock);
             }
-
-            // TODO: instead of sleeping, we could wait on an event
-            //       that would be set in the Add() method
-            std::this_thread::sleep_for(CollectingPeriod);
+            _wakeUpCondition.notify_one();
         }
+    }
 
-        Log::Info("Stop processing raw '", GetName(), "' samples.");
+    std::uint64_t GetDroppedSamplesCount() const
+    {
+        return _rawSamples.GetDroppedCount();
     }
 
-    std::list<TRawSample> FetchRawSamples()
+    std::size_t GetQueueDepth() const
     {
-        std::lock_guard<std::mutex> lock(_rawSamplesLock);
+        return _rawSamples.Size();
+    }
 
-        std::list<TRawSample> input = std::move(_collectedSamples); // _collectedSamples is empty now
-        return input;
+    std::size_t GetMaxQueueDepth() const
+    {
+        return _maxQueueDepth.load();
     }
 
-    void TransformRawSamples(const std::list<TRawSample>& input)
+    // Time between the transformer thread noticing queued raw samples and the end of their transformation
+    std::chrono::nanoseconds GetLastTransformLatency() const
     {
-        for (auto const& rawSample : input)
-        {
-            TransformRawSample(rawSample);
-        }
+        return std::chrono::nanoseconds(_lastTransformLatency.load());
     }
 
-    void TransformRawSample(const TRawSample& rawSample)
+protected:
+    // set values and additional labels
+    virtual void OnTransformRawSample(const TRawSample& rawSample, Sample& sample) = 0;
+
+    // transforms the raw sample synchronously and stores the resulting sample in the given shard
+    void TransformRawSample(const TRawSample& rawSample, std::size_t shardIndex)
     {
         Sample sample(rawSample.Timestamp, _pRuntimeIdStore->GetId(rawSample.AppDomainId));
         if (rawSample.LocalRootSpanId != 0 && rawSample.SpanId != 0)
@@ -149,8 +204,109 @@ private:
         // allow inherited classes to add values and specific labels
         OnTransformRawSample(rawSample, sample);
 
-        // save it in the output list
-        Store(std::move(sample));
+        // save it in the output list of the worker
+        Store(std::move(sample), shardIndex);
+    }
+
+private:
+    // Queued raw samples never wait more than MaxTransformLatency before being transformed
+    inline static const std::chrono::nanoseconds MaxTransformLatency = 50ms;
+
+    // The raw samples buffer preallocates MaxFramesCount instruction pointers per sample: 4 KB per sample
+    // (i.e. 1 MB per provider with the default capacity of 256 samples, enough to absorb bursts with a 50 ms
+    // max latency). Frames deeper than MaxFramesCount are rare enough to be truncated
+    inline static const std::size_t MinRawSamplesCapacity = 64;
+    static const std::size_t MaxFramesCount = 512;
+
+    // below this count, splitting a batch costs more than transforming the samples
+    inline static const std::size_t MinSamplesPerTask = 16;
+
+    void ProcessSamples()
+    {
+        Log::Info("Starting to process raw '", GetName(), "' samples.");
+
+        while (!_stopRequested.load())
+        {
+            auto start = WaitForRawSamples();
+
+            TransformRawSamples();
+
+            _lastTransformLatency.store((std::chrono::steady_clock::now() - start).count());
+        }
+
+        Log::Info("Stop processing raw '", GetName(), "' samples.");
+    }
+
+    // Returns when raw samples need to be transformed (or stop is requested) with the time
+    // at which queued samples were noticed
+    std::chrono::steady_clock::time_point WaitForRawSamples()
+    {
+        if (_rawSamples.Size() >= _lowWatermark)
+        {
+            return std::chrono::steady_clock::now();
+        }
+
+        std::unique_lock<std::mutex> lock(_wakeUpLock);
+
+        // nothing to do: sleep until the first sample is added
+        _wakeUpCondition.wait(lock, [this] { return _stopRequested.load() || (_rawSamples.Size() != 0); });
+
+        // give a chance to other samples to be queued but without exceeding the latency deadline
+        auto start = std::chrono::steady_clock::now();
+        _wakeUpCondition.wait_until(
+            lock,
+            start + MaxTransformLatency,
+            [this] { return _stopRequested.load() || (_rawSamples.Size() >= _highWatermark); });
+
+        return start;
+    }
+
+    void TransformRawSamples()
+    {
+        if (_pTransformerPool == nullptr)
+        {
+            // the same raw sample is reused to avoid allocating a stack per sample
+            TRawSample rawSample;
+            while (_rawSamples.TryPop(rawSample))
+            {
+                TransformRawSample(rawSample, 0);
+            }
+
+            return;
+        }
+
+        // the raw samples of the batch (and their stack) are reused from one batch to the other
+        std::size_t count = 0;
+        while (true)
+        {
+            if (count == _batch.size())
+            {
+                _batch.emplace_back();
+            }
+
+            if (!_rawSamples.TryPop(_batch[count]))
+            {
+                break;
+            }
+            count++;
+        }
+
+        // split the batch into one contiguous range of raw samples per worker
+        auto workersCount = _pTransformerPool->GetWorkersCount();
+        auto samplesPerTask = (std::max)(MinSamplesPerTask, (count + workersCount - 1) / workersCount);
+        _tasks.clear();
+        for (std::size_t begin = 0; begin < count; begin += samplesPerTask)
+        {
+            auto end = (std::min)(begin + samplesPerTask, count);
+            _tasks.emplace_back([this, begin, end](std::size_t workerIndex) {
+                for (auto current = begin; current < end; current++)
+                {
+                    TransformRawSample(_batch[current], workerIndex);
+                }
+            });
+        }
+
+        _pTransformerPool->Run(_tasks);
     }
 
     void SetAppDomainDetails(const TRawSample& rawSample, Sample& sample)
@@ -212,12 +368,12 @@ private:
     {
         for (auto const& instructionPointer : rawSample.Stack)
         {
-            auto [isManaged, moduleName, frame] = _pFrameStore->GetFrame(instructionPointer);
+            auto [isManaged, frame] = _pFrameStore->GetFrame(instructionPointer);
 
             // filter out native frames if needed
             if (isManaged || _isNativeFramesEnabled)
             {
-                sample.AddFrame(moduleName, frame);
+                sample.AddFrame(frame);
             }
         }
     }
@@ -227,12 +383,29 @@ private:
     IAppDomainStore* _pAppDomainStore = nullptr;
     IRuntimeIdStore* _pRuntimeIdStore = nullptr;
     bool _isNativeFramesEnabled = false;
+    SamplesTransformerPool* _pTransformerPool = nullptr;
 
     // A thread is responsible for asynchronously fetching raw samples from the input queue
     // and feeding the output sample list with symbolized frames and thread/appdomain names
     std::atomic<bool> _stopRequested = false;
     std::thread _transformerThread;
+    std::mutex _wakeUpLock;
+    std::condition_variable _wakeUpCondition;
+
+    // statistics
+    std::atomic<std::size_t> _maxQueueDepth = 0;
+    std::atomic<std::int64_t> _lastTransformLatency = 0;
+
+    // filled by the sampler thread and emptied by the transformer thread
+    RawSamplesRingBuffer<TRawSample> _rawSamples;
+
+    // - reaching the high watermark wakes the transformer up before the max latency deadline
+    // - if more than the low watermark samples were queued during a transformation,
+    //   the transformer goes on without waiting
+    const std::size_t _highWatermark;
+    const std::size_t _lowWatermark;
 
-    std::mutex _rawSamplesLock;
-    std::list<TRawSample> _collectedSamples;
+    // only used by the transformer thread when the raw samples are dispatched to the pool
+    std::vector<TRawSample> _batch;
+    std::vector<SamplesTransformerPool::Task> _tasks;
 };
@@ -5,6 +5,9 @@
 
 #include "TagsHelper.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
 #include <type_traits>
 
 #include "EnvironmentVariables.h"
@@ -26,15 +29,29 @@ int const Configuration::DefaultAgentPort = 8126;
 std::string const Configuration::DefaultEmptyString = "";
 std::chrono::seconds const Configuration::DefaultDevUploadInterval = 20s;
 std::chrono::seconds const Configuration::DefaultProdUploadInterval = 60s;
+int const Configuration::DefaultSpoolMaxSizePerServiceMB = 50;
+int const Configuration::DefaultRawSamplesCapacity = 256;
 
 Configuration::Configuration()
 {
     _debugLogEnabled = GetEnvironmentValue(EnvironmentVariables::DebugLogEnabled, GetDefaultDebugLogEnabled());
     _logDirectory = ExtractLogDirectory();
     _pprofDirectory = ExtractPprofDirectory();
+    _spoolDirectory = ExtractSpoolDirectory();
+    auto transformerThreadsCount = GetEnvironmentValue(EnvironmentVariables::TransformerThreadsCount, 0);
+    _transformerThreadsCount = (transformerThreadsCount > 0) ? static_cast<std::size_t>(transformerThreadsCount) : GetDefaultTransformerThreadsCount();
+    auto rawSamplesCapacity = GetEnvironmentValue(EnvironmentVariables::RawSamplesCapacity, DefaultRawSamplesCapacity);
+    _rawSamplesCapacity = static_cast<std::size_t>((rawSamplesCapacity > 0) ? rawSamplesCapacity : DefaultRawSamplesCapacity);
+    _spoolMaxSizePerService = static_cast<std::uint64_t>((std::max)(0, GetEnvironmentValue(EnvironmentVariables::SpoolMaxSizePerService, DefaultSpoolMaxSizePerServiceMB))) * 1024 * 1024;
     _isOperationalMetricsEnabled = GetEnvironmentValue(EnvironmentVariables::OperationalMetricsEnabled, false);
     _isNativeFrameEnabled = GetEnvironmentValue(EnvironmentVariables::NativeFramesEnabled, false);
     _isCpuProfilingEnabled = GetEnvironmentValue(EnvironmentVariables::CpuProfilingEnabled, false);
+    _isCpuTimerSamplingEnabled = GetEnvironmentValue(EnvironmentVariables::CpuTimerSamplingEnabled, false);
+    _samplingOverheadBudget = GetEnvironmentValue(EnvironmentVariables::SamplingOverheadBudget, 0.0);
+    _isAllocationProfilingEnabled = GetEnvironmentValue(EnvironmentVariables::AllocationProfilingEnabled, false);
+    _isContentionProfilingEnabled = GetEnvironmentValue(EnvironmentVariables::ContentionProfilingEnabled, false);
+    _isExceptionProfilingEnabled = GetEnvironmentValue(EnvironmentVariables::ExceptionProfilingEnabled, false);
+    _isGarbageCollectionProfilingEnabled = GetEnvironmentValue(EnvironmentVariables::GarbageCollectionProfilingEnabled, false);
     _uploadPeriod = ExtractUploadInterval();
     _userTags = ExtractUserTags();
     _version = GetEnvironmentValue(EnvironmentVariables::Version, DefaultVersion);
@@ -78,6 +95,35 @@ fs::path const& Configuration::GetProfilesOutputDirectory() const
     return _pprofDirectory;
 }
 
+fs::path Configuration::ExtractSpoolDirectory()
+{
+    auto value = shared::GetEnvironmentValue(EnvironmentVariables::SpoolDirectory);
+    if (value.empty())
+        return fs::path();
+
+    return fs::path(value);
+}
+
+fs::path const& Configuration::GetSpoolDirectory() const
+{
+    return _spoolDirectory;
+}
+
+std::uint64_t Configuration::GetSpoolMaxSizePerService() const
+{
+    return _spoolMaxSizePerService;
+}
+
+std::size_t Configuration::GetTransformerThreadsCount() const
+{
+    return _transformerThreadsCount;
+}
+
+std::size_t Configuration::GetRawSamplesCapacity() const
+{
+    return _rawSamplesCapacity;
+}
+
 bool Configuration::IsOperationalMetricsEnabled() const
 {
     return _isOperationalMetricsEnabled;
@@ -93,6 +139,36 @@ bool Configuration::IsCpuProfilingEnabled() const
     return _isCpuProfilingEnabled;
 }
 
+bool Configuration::IsCpuTimerSamplingEnabled() const
+{
+    return _isCpuTimerSamplingEnabled;
+}
+
+double Configuration::GetSamplingOverheadBudget() const
+{
+    return _samplingOverheadBudget;
+}
+
+bool Configuration::IsAllocationProfilingEnabled() const
+{
+    return _isAllocationProfilingEnabled;
+}
+
+bool Configuration::IsContentionProfilingEnabled() const
+{
+    return _isContentionProfilingEnabled;
+}
+
+bool Configuration::IsExceptionProfilingEnabled() const
+{
+    return _isExceptionProfilingEnabled;
+}
+
+bool Configuration::IsGarbageCollectionProfilingEnabled() const
+{
+    return _isGarbageCollectionProfilingEnabled;
+}
+
 
 std::chrono::seconds Configuration::GetUploadInterval() const
 {
@@ -217,6 +293,13 @@ std::chrono::seconds Configuration::GetDefaultUploadInterval()
     return DefaultProdUploadInterval;
 }
 
+std::size_t Configuration::GetDefaultTransformerThreadsCount()
+{
+    // a fraction of the cores (between 1 and 4 threads): the transformation must not compete with the application
+    auto coresCount = static_cast<std::size_t>(std::thread::hardware_concurrency());
+    return (std::min)((std::max)(coresCount / 4, std::size_t(1)), std::size_t(4));
+}
+
 //
 // shared::TryParse does not work on Linux
 // not found the issue yet.
@@ -299,6 +382,14 @@ bool convert_to(shared::WSTRING const& s, int& result)
     return TryParse(s, result);
 }
 
+bool convert_to(shared::WSTRING const& s, double& result)
+{
+    auto str = shared::ToString(s);
+    char* end = nullptr;
+    result = strtod(str.c_str(), &end);
+    return (end != str.c_str()) && (*end == '\0') && (result >= 0);
+}
+
 template <typename T>
 T Configuration::GetEnvironmentValue(shared::WSTRING const& name, T const& defaultValue)
 {
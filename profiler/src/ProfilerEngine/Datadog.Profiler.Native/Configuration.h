@@ -21,6 +21,10 @@ public:
 
     fs::path const& GetLogDirectory() const override;
     fs::path const& GetProfilesOutputDirectory() const override;
+    fs::path const& GetSpoolDirectory() const override;
+    std::uint64_t GetSpoolMaxSizePerService() const override;
+    std::size_t GetTransformerThreadsCount() const override;
+    std::size_t GetRawSamplesCapacity() const override;
     bool IsOperationalMetricsEnabled() const override;
     bool IsNativeFramesEnabled() const override;
     std::chrono::seconds GetUploadInterval() const override;
@@ -38,6 +42,12 @@ public:
     std::string const& GetApiKey() const override;
     std::string const& GetServiceName() const override;
     bool IsCpuProfilingEnabled() const override;
+    bool IsCpuTimerSamplingEnabled() const override;
+    double GetSamplingOverheadBudget() const override;
+    bool IsAllocationProfilingEnabled() const override;
+    bool IsContentionProfilingEnabled() const override;
+    bool IsExceptionProfilingEnabled() const override;
+    bool IsGarbageCollectionProfilingEnabled() const override;
 
     // feature flags
     bool IsFFLibddprofEnabled() const override;
@@ -51,7 +61,9 @@ private:
     static fs::path GetApmBaseDirectory();
     static fs::path ExtractLogDirectory();
     static fs::path ExtractPprofDirectory();
+    static fs::path ExtractSpoolDirectory();
     static std::chrono::seconds GetDefaultUploadInterval();
+    static std::size_t GetDefaultTransformerThreadsCount();
     static bool GetDefaultDebugLogEnabled();
     template <typename T>
     static T GetEnvironmentValue(shared::WSTRING const& name, T const& defaultValue);
@@ -66,12 +78,24 @@ private:
     static int const DefaultAgentPort;
     static std::chrono::seconds const DefaultDevUploadInterval;
     static std::chrono::seconds const DefaultProdUploadInterval;
+    static int const DefaultSpoolMaxSizePerServiceMB;
+    static int const DefaultRawSamplesCapacity;
 
     bool _isProfilingEnabled;
     bool _isCpuProfilingEnabled;
+    bool _isCpuTimerSamplingEnabled;
+    double _samplingOverheadBudget;
+    bool _isAllocationProfilingEnabled;
+    bool _isContentionProfilingEnabled;
+    bool _isExceptionProfilingEnabled;
+    bool _isGarbageCollectionProfilingEnabled;
     bool _debugLogEnabled;
     fs::path _logDirectory;
     fs::path _pprofDirectory;
+    fs::path _spoolDirectory;
+    std::uint64_t _spoolMaxSizePerService;
+    std::size_t _transformerThreadsCount;
+    std::size_t _rawSamplesCapacity;
     bool _isOperationalMetricsEnabled;
     std::string _version;
     std::string _serviceName;
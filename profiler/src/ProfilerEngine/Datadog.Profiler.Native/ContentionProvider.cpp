@@ -0,0 +1,181 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include <ctime>
+#include <string>
+
+#include "ContentionProvider.h"
+#include "EventPipePayload.h"
+#include "IAppDomainStore.h"
+#include "IConfiguration.h"
+#include "IFrameStore.h"
+#include "IManagedThreadList.h"
+#include "IRuntimeIdStore.h"
+#include "OpSysTools.h"
+#include "PoissonSampler.h"
+#include "RawContentionSample.h"
+
+// Payload layouts (see ClrEtwAll.man in the runtime repository):
+//   ContentionStart V1: ContentionFlags (UInt8) | ClrInstanceID (UInt16)
+//                   V2: ... | LockID (Pointer) | AssociatedObjectID (Pointer) | LockOwnerThreadID (UInt64)
+//   ContentionStop  V0: ContentionFlags (UInt8) | ClrInstanceID (UInt16)
+//                   V1: ... | DurationNs (Double)
+constexpr ULONG ContentionCommonPayloadSize = sizeof(std::uint8_t) + sizeof(std::uint16_t);
+constexpr ULONG LockOwnerThreadIdOffset = ContentionCommonPayloadSize + 2 * sizeof(void*);
+constexpr ULONG DurationNsOffset = ContentionCommonPayloadSize;
+
+// details of the current contention of this thread (zero-initialized: no allocation)
+struct ContentionStartInfo
+{
+    std::int64_t StartTimestampNs;
+    std::uint64_t LockOwnerThreadId;
+};
+
+thread_local ContentionStartInfo t_contentionStart;
+
+
+ContentionProvider::ContentionProvider(
+    ICorProfilerInfo4* pCorProfilerInfo,
+    IManagedThreadList* pManagedThreadList,
+    IConfiguration* pConfiguration,
+    IFrameStore* pFrameStore,
+    IAppDomainStore* pAppDomainStore,
+    IRuntimeIdStore* pRuntimeIdStore,
+    SamplesTransformerPool* pTransformerPool
+    )
+    :
+    CollectorBase<RawContentionSample>(pConfiguration, pFrameStore, pAppDomainStore, pRuntimeIdStore, pTransformerPool),
+    _pCorProfilerInfo{pCorProfilerInfo},
+    _pManagedThreadList{pManagedThreadList}
+{
+}
+
+const char* ContentionProvider::GetName()
+{
+    return _serviceName;
+}
+
+const char* ContentionProvider::GetDurationBucket(std::uint64_t durationNs)
+{
+    if (durationNs < 1000000)
+    {
+        return "< 1 ms";
+    }
+
+    if (durationNs < 10000000)
+    {
+        return "1 - 10 ms";
+    }
+
+    if (durationNs < 100000000)
+    {
+        return "10 - 100 ms";
+    }
+
+    if (durationNs < 1000000000)
+    {
+        return "100 ms - 1 s";
+    }
+
+    return ">= 1 s";
+}
+
+void ContentionProvider::OnEventPipeEvent(
+    DWORD eventId,
+    DWORD eventVersion,
+    ULONG cbEventData,
+    LPCBYTE eventData,
+    ThreadID eventThread,
+    ULONG numStackFrames,
+    UINT_PTR stackFrames[])
+{
+    if (eventId == ContentionStartEventId)
+    {
+        OnContentionStart(eventVersion, cbEventData, eventData);
+    }
+    else if (eventId == ContentionStopEventId)
+    {
+        OnContentionStop(eventVersion, cbEventData, eventData, eventThread, numStackFrames, stackFrames);
+    }
+}
+
+void ContentionProvider::OnContentionStart(DWORD eventVersion, ULONG cbEventData, LPCBYTE eventData)
+{
+    t_contentionStart.StartTimestampNs = OpSysTools::GetHighPrecisionNanoseconds();
+    t_contentionStart.LockOwnerThreadId = 0;
+
+    if (eventVersion >= 2)
+    {
+        EventPipePayload::TryRead(eventData, cbEventData, LockOwnerThreadIdOffset, t_contentionStart.LockOwnerThreadId);
+    }
+}
+
+void ContentionProvider::OnContentionStop(DWORD eventVersion, ULONG cbEventData, LPCBYTE eventData, ThreadID eventThread, ULONG numStackFrames, UINT_PTR stackFrames[])
+{
+    // each thread counts down its own wait time before the next sampled contention
+    thread_local std::int64_t waitBeforeNextSample = PoissonSampler::GetNextSamplingDistance(SamplingInterval);
+
+    auto start = t_contentionStart;
+    t_contentionStart = {};
+
+    // recent runtimes provide the duration; otherwise, it is computed from the start event
+    std::uint64_t durationNs = 0;
+    double payloadDurationNs;
+    if ((eventVersion >= 1) && EventPipePayload::TryRead(eventData, cbEventData, DurationNsOffset, payloadDurationNs))
+    {
+        durationNs = static_cast<std::uint64_t>(payloadDurationNs);
+    }
+    else if (start.StartTimestampNs != 0)
+    {
+        durationNs = static_cast<std::uint64_t>(OpSysTools::GetHighPrecisionNanoseconds() - start.StartTimestampNs);
+    }
+    else
+    {
+        // the start event was missed
+        return;
+    }
+
+    waitBeforeNextSample -= static_cast<std::int64_t>(durationNs);
+    if (waitBeforeNextSample > 0)
+    {
+        return;
+    }
+    waitBeforeNextSample = PoissonSampler::GetNextSamplingDistance(SamplingInterval);
+
+    if (numStackFrames == 0)
+    {
+        return;
+    }
+
+    RawContentionSample rawSample;
+    rawSample.Timestamp = static_cast<std::uint64_t>(std::time(nullptr));
+    rawSample.ContentionDuration = durationNs;
+    rawSample.LockOwnerThreadId = start.LockOwnerThreadId;
+    rawSample.Stack.assign(stackFrames, stackFrames + numStackFrames);
+
+    _pCorProfilerInfo->GetThreadAppDomain(eventThread, &rawSample.AppDomainId);
+
+    // GetThreadInfo() calls AddRef() on the threadInfo: it is released after the sample is transformed
+    rawSample.ThreadInfo = _pManagedThreadList->GetThreadInfo(eventThread);
+    if ((rawSample.ThreadInfo != nullptr) && rawSample.ThreadInfo->CanReadTraceContext())
+    {
+        rawSample.LocalRootSpanId = rawSample.ThreadInfo->GetLocalRootSpanId();
+        rawSample.SpanId = rawSample.ThreadInfo->GetSpanId();
+    }
+
+    std::lock_guard<std::mutex> lock(_addLock);
+    Add(std::move(rawSample));
+}
+
+void ContentionProvider::OnTransformRawSample(const RawContentionSample& rawSample, Sample& sample)
+{
+    auto [count, duration] = PoissonSampler::Upscale(rawSample.ContentionDuration, SamplingInterval);
+    sample.AddValue(count, SampleValue::ContentionCount);
+    sample.AddValue(duration, SampleValue::ContentionDuration);
+
+    sample.AddLabel(Label{Sample::ContentionDurationBucketLabel, GetDurationBucket(rawSample.ContentionDuration)});
+    if (rawSample.LockOwnerThreadId != 0)
+    {
+        sample.AddLabel(Label{Sample::LockOwnerThreadIdLabel, std::to_string(rawSample.LockOwnerThreadId)});
+    }
+}
@@ -0,0 +1,80 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#pragma once
+#include <cstdint>
+#include <mutex>
+
+#include "cor.h"
+#include "corprof.h"
+
+#include "CollectorBase.h"
+#include "RawContentionSample.h"
+
+// forward declarations
+class IConfiguration;
+class IFrameStore;
+class IAppDomainStore;
+class IRuntimeIdStore;
+class IManagedThreadList;
+
+
+// Lock contentions are received as ContentionStart/ContentionStop events from the
+// Microsoft-Windows-DotNETRuntime EventPipe provider. These events are delivered synchronously
+// on the contended thread so the start details are kept in thread local storage until the
+// corresponding stop event: pairing them does not allocate.
+// Contentions are sampled per thread based on the wait duration (see PoissonSampler) with a mean
+// of SamplingInterval nanoseconds between two samples and their values are upscaled accordingly.
+class ContentionProvider
+    : public CollectorBase<RawContentionSample> // accepts raw contention samples
+{
+public:
+    static const std::uint64_t ContentionKeyword = 0x4000;
+    static const DWORD ContentionStartEventId = 81;
+    static const DWORD ContentionStopEventId = 91;
+
+    static const std::uint64_t SamplingInterval = 1000000; // 1 ms of wait
+
+public:
+    ContentionProvider(
+        ICorProfilerInfo4* pCorProfilerInfo,
+        IManagedThreadList* pManagedThreadList,
+        IConfiguration* pConfiguration,
+        IFrameStore* pFrameStore,
+        IAppDomainStore* pAppDomainStore,
+        IRuntimeIdStore* pRuntimeIdStore,
+        SamplesTransformerPool* pTransformerPool = nullptr
+        );
+
+    // called by the CLR for each event of the runtime provider
+    void OnEventPipeEvent(
+        DWORD eventId,
+        DWORD eventVersion,
+        ULONG cbEventData,
+        LPCBYTE eventData,
+        ThreadID eventThread,
+        ULONG numStackFrames,
+        UINT_PTR stackFrames[]);
+
+    // label value used to build a histogram of the wait durations
+    static const char* GetDurationBucket(std::uint64_t durationNs);
+
+// interfaces implementation
+public:
+    const char* GetName() override;
+
+private:
+    virtual void OnTransformRawSample(const RawContentionSample& rawSample, Sample& sample) override;
+
+    void OnContentionStart(DWORD eventVersion, ULONG cbEventData, LPCBYTE eventData);
+    void OnContentionStop(DWORD eventVersion, ULONG cbEventData, LPCBYTE eventData, ThreadID eventThread, ULONG numStackFrames, UINT_PTR stackFrames[]);
+
+private:
+    const char* _serviceName = "ContentionProvider";
+
+    ICorProfilerInfo4* _pCorProfilerInfo;
+    IManagedThreadList* _pManagedThreadList;
+
+    // the raw samples queue accepts only one producer at a time but contentions are sampled on any thread
+    std::mutex _addLock;
+};
@@ -28,6 +28,8 @@
 #include "ManagedThreadList.h"
 #include "OpSysTools.h"
 #include "OsSpecificApi.h"
+#include "ProfileUploadQueue.h"
+#include "SamplesTransformerPool.h"
 #include "ProfilerEngineStatus.h"
 #include "RuntimeIdStore.h"
 #include "SamplesAggregator.h"
@@ -37,6 +39,10 @@
 #include "ThreadsCpuManager.h"
 #include "WallTimeProvider.h"
 #include "CpuTimeProvider.h"
+#include "AllocationsProvider.h"
+#include "ContentionProvider.h"
+#include "ExceptionsProvider.h"
+#include "GarbageCollectionProvider.h"
 #include "Configuration.h"
 #include "LibddprofExporter.h"
 #include "SamplesAggregator.h"
@@ -114,7 +120,7 @@ bool CorProfilerCallback::InitializeServices()
 
     _pAppDomainStore = std::make_unique<AppDomainStore>(_pCorProfilerInfo);
 
-    _pFrameStore = std::make_unique<FrameStore>(_pCorProfilerInfo);
+    _pFrameStore = std::make_unique<FrameStore>(_pCorProfilerInfo, _pConfiguration.get());
 
     // Create service instances
     _pThreadsCpuManager = RegisterService<ThreadsCpuManager>();
@@ -126,13 +132,64 @@ bool CorProfilerCallback::InitializeServices()
     _pStackSnapshotsBufferManager = RegisterService<StackSnapshotsBufferManager>(_pThreadsCpuManager, _pSymbolsResolver);
 
     auto* pRuntimeIdStore = RegisterService<RuntimeIdStore>();
-    auto* pWallTimeProvider = RegisterService<WallTimeProvider>(_pConfiguration.get(), _pFrameStore.get(), _pAppDomainStore.get(), pRuntimeIdStore);
+
+    // registered before the providers so that it is stopped after them (services are stopped in reverse order)
+    auto* pTransformerPool = RegisterService<SamplesTransformerPool>(_pConfiguration->GetTransformerThreadsCount());
+
+    auto* pWallTimeProvider = RegisterService<WallTimeProvider>(_pConfiguration.get(), _pFrameStore.get(), _pAppDomainStore.get(), pRuntimeIdStore, pTransformerPool);
     CpuTimeProvider* pCpuTimeProvider = nullptr;
     if (_pConfiguration->IsFFLibddprofEnabled())
     {
         if (_pConfiguration->IsCpuProfilingEnabled())
         {
-            pCpuTimeProvider = RegisterService<CpuTimeProvider>(_pConfiguration.get(), _pFrameStore.get(), _pAppDomainStore.get(), pRuntimeIdStore);
+            pCpuTimeProvider = RegisterService<CpuTimeProvider>(_pConfiguration.get(), _pFrameStore.get(), _pAppDomainStore.get(), pRuntimeIdStore, pTransformerPool);
+        }
+
+        if (_pConfiguration->IsAllocationProfilingEnabled())
+        {
+            _pAllocationsProvider = RegisterService<AllocationsProvider>(
+                _pCorProfilerInfo,
+                _pManagedThreadList,
+                _pConfiguration.get(),
+                _pFrameStore.get(),
+                _pAppDomainStore.get(),
+                pRuntimeIdStore,
+                pTransformerPool);
+        }
+
+        if (_pConfiguration->IsContentionProfilingEnabled())
+        {
+            _pContentionProvider = RegisterService<ContentionProvider>(
+                _pCorProfilerInfo,
+                _pManagedThreadList,
+                _pConfiguration.get(),
+                _pFrameStore.get(),
+                _pAppDomainStore.get(),
+                pRuntimeIdStore,
+                pTransformerPool);
+        }
+
+        if (_pConfiguration->IsExceptionProfilingEnabled())
+        {
+            _pExceptionsProvider = RegisterService<ExceptionsProvider>(
+                _pCorProfilerInfo,
+                _pManagedThreadList,
+                _pConfiguration.get(),
+                _pFrameStore.get(),
+                _pAppDomainStore.get(),
+                pRuntimeIdStore,
+                pTransformerPool);
+        }
+
+        if (_pConfiguration->IsGarbageCollectionProfilingEnabled())
+        {
+            _pGarbageCollectionProvider = RegisterService<GarbageCollectionProvider>(
+                _pCorProfilerInfo,
+                _pConfiguration.get(),
+                _pFrameStore.get(),
+                _pAppDomainStore.get(),
+                pRuntimeIdStore,
+                pTransformerPool);
         }
     }
 
@@ -146,7 +203,8 @@ bool CorProfilerCallback::InitializeServices()
         _pManagedThreadList,
         _pSymbolsResolver,
         pWallTimeProvider,
-        pCpuTimeProvider
+        pCpuTimeProvider,
+        _pGarbageCollectionProvider
         );
 
     // The different elements of the libddprof pipeline are created and linked together
@@ -154,13 +212,40 @@ bool CorProfilerCallback::InitializeServices()
     if (_pConfiguration->IsFFLibddprofEnabled())
     {
         _pApplicationStore = std::make_unique<ApplicationStore>(_pConfiguration.get());
-        _pExporter = std::make_unique<LibddprofExporter>(_pConfiguration.get(), _pApplicationStore.get());
+
+        // registered before the aggregator so that it is stopped after the last profile has been exported
+        auto* pUploadQueue = RegisterService<ProfileUploadQueue>(_metricsSender.get());
+        if (!_pConfiguration->GetSpoolDirectory().empty())
+        {
+            _pProfileSpool = std::make_unique<ProfileSpool>(_pConfiguration->GetSpoolDirectory(), _pConfiguration->GetSpoolMaxSizePerService());
+        }
+        _pExporter = std::make_unique<LibddprofExporter>(_pConfiguration.get(), _pApplicationStore.get(), pUploadQueue, _pProfileSpool.get());
         auto* pSamplesAggregrator = RegisterService<SamplesAggregator>(_pConfiguration.get(), _pExporter.get(), _metricsSender.get());
         pSamplesAggregrator->Register(pWallTimeProvider);
         if (_pConfiguration->IsCpuProfilingEnabled())
         {
             pSamplesAggregrator->Register(pCpuTimeProvider);
         }
+
+        if (_pAllocationsProvider != nullptr)
+        {
+            pSamplesAggregrator->Register(_pAllocationsProvider);
+        }
+
+        if (_pContentionProvider != nullptr)
+        {
+            pSamplesAggregrator->Register(_pContentionProvider);
+        }
+
+        if (_pExceptionsProvider != nullptr)
+        {
+            pSamplesAggregrator->Register(_pExceptionsProvider);
+        }
+
+        if (_pGarbageCollectionProvider != nullptr)
+        {
+            pSamplesAggregrator->Register(_pGarbageCollectionProvider);
+        }
     }
 
     auto started = StartServices();
@@ -206,13 +291,19 @@ bool CorProfilerCallback::DisposeServices()
     // keep loader as static singleton for now
     shared::Loader::DeleteSingletonInstance();
 
-    _services.clear();
-
+    // the observable pointers are reset before the services are deleted so that a callback
+    // that is still running during the shutdown does not use a deleted service
     _pThreadsCpuManager = nullptr;
     _pStackSnapshotsBufferManager = nullptr;
     _pStackSamplerLoopManager = nullptr;
     _pManagedThreadList = nullptr;
     _pSymbolsResolver = nullptr;
+    _pAllocationsProvider = nullptr;
+    _pContentionProvider = nullptr;
+    _pExceptionsProvider = nullptr;
+    _pGarbageCollectionProvider = nullptr;
+
+    _services.clear();
 
     return result;
 }
@@ -265,6 +356,8 @@ void CorProfilerCallback::DisposeInternal(void)
         // From that time, we need to ensure that ALL native threads are stop and don't call back to managed world
         // So, don't sleep before stopping the threads
 
+        StopEventPipeSessions();
+
         DisposeServices();
 
         ICorProfilerInfo4* pCorProfilerInfo = _pCorProfilerInfo;
@@ -621,18 +714,72 @@ HRESULT STDMETHODCALLTYPE CorProfilerCallback::Initialize(IUnknown* corProfilerI
                                                ManagedAssembliesToLoad_AppDomainNonDefault_ProcIIS);
 
     // Configure which profiler callbacks we want to receive by setting the event mask:
-    const DWORD eventMask =
+    DWORD eventMask =
         shared::Loader::GetSingletonInstance()->GetLoaderProfilerEventMask() |
         COR_PRF_MONITOR_THREADS |
         COR_PRF_ENABLE_STACK_SNAPSHOT;
 
-    hr = _pCorProfilerInfo->SetEventMask(eventMask);
+    // ExceptionThrown is called for each thrown exception: ExceptionsProvider rate limits them per type
+    if (_pExceptionsProvider != nullptr)
+    {
+        eventMask |= COR_PRF_MONITOR_EXCEPTIONS;
+    }
+
+    // unlike COR_PRF_MONITOR_GC, COR_PRF_HIGH_BASIC_GC does not disable concurrent GC
+    DWORD highEventMask = 0;
+    if (_pGarbageCollectionProvider != nullptr)
+    {
+        eventMask |= COR_PRF_MONITOR_SUSPENDS;
+        highEventMask |= COR_PRF_HIGH_BASIC_GC;
+    }
+
+    // allocations and lock contentions are received as events from an EventPipe session (.NET 5+ only)
+    // instead of ObjectAllocated that would be called for each allocation
+    if ((_pAllocationsProvider != nullptr) || (_pContentionProvider != nullptr))
+    {
+        hr = _pCorProfilerInfo->QueryInterface(__uuidof(ICorProfilerInfo12), (void**)&_pCorProfilerInfoEvents);
+        if (FAILED(hr))
+        {
+            Log::Info("Allocations and lock contention profiling are not supported by this runtime (ICorProfilerInfo12 is not available).");
+            _pCorProfilerInfoEvents = nullptr;
+        }
+    }
+
+    if (_pCorProfilerInfoEvents != nullptr)
+    {
+        highEventMask |= COR_PRF_HIGH_MONITOR_EVENT_PIPE;
+    }
+
+    if (highEventMask != 0)
+    {
+        ICorProfilerInfo5* pCorProfilerInfo5 = nullptr;
+        hr = _pCorProfilerInfo->QueryInterface(__uuidof(ICorProfilerInfo5), (void**)&pCorProfilerInfo5);
+        if (SUCCEEDED(hr))
+        {
+            hr = pCorProfilerInfo5->SetEventMask2(eventMask, highEventMask);
+            pCorProfilerInfo5->Release();
+        }
+        else
+        {
+            Log::Info("Garbage collections profiling is not supported by this runtime (ICorProfilerInfo5 is not available).");
+            hr = _pCorProfilerInfo->SetEventMask(eventMask);
+        }
+    }
+    else
+    {
+        hr = _pCorProfilerInfo->SetEventMask(eventMask);
+    }
     if (FAILED(hr))
     {
         Log::Error("SetEventMask(0x", std::hex, eventMask, ") returned an unexpected result: 0x", std::hex, hr, std::dec, ".");
         return E_FAIL;
     }
 
+    if (_pCorProfilerInfoEvents != nullptr)
+    {
+        StartEventPipeSessions();
+    }
+
     // Initialization complete:
     _isInitialized.store(true);
     ProfilerEngineStatus::WriteIsProfilerEngineActive(true);
@@ -640,6 +787,63 @@ HRESULT STDMETHODCALLTYPE CorProfilerCallback::Initialize(IUnknown* corProfilerI
     return S_OK;
 }
 
+EVENTPIPE_SESSION CorProfilerCallback::StartEventPipeSession(std::uint64_t keywords, std::uint32_t level)
+{
+    COR_PRF_EVENTPIPE_PROVIDER_CONFIG providers[] =
+    {
+        {WStr("Microsoft-Windows-DotNETRuntime"), keywords, level, nullptr}
+    };
+
+    EVENTPIPE_SESSION session = 0;
+    HRESULT hr = _pCorProfilerInfoEvents->EventPipeStartSession(sizeof(providers) / sizeof(providers[0]), providers, false, &session);
+    if (FAILED(hr))
+    {
+        Log::Error("Failed to start the EventPipe session for keywords 0x", std::hex, keywords, ": 0x", hr, std::dec, ".");
+        return 0;
+    }
+
+    return session;
+}
+
+void CorProfilerCallback::StartEventPipeSessions()
+{
+    // The level applies to all the keywords of a session: GCAllocationTick is the only event that
+    // needs the verbose level so it gets a session of its own with the GC keyword only
+    // instead of raising the level of the contention events too
+    if (_pAllocationsProvider != nullptr)
+    {
+        _allocationsEventPipeSession = StartEventPipeSession(AllocationsProvider::GCKeyword, AllocationsProvider::AllocationTickLevel);
+    }
+
+    if (_pContentionProvider != nullptr)
+    {
+        _contentionEventPipeSession = StartEventPipeSession(ContentionProvider::ContentionKeyword, COR_PRF_EVENTPIPE_INFORMATIONAL);
+    }
+}
+
+void CorProfilerCallback::StopEventPipeSessions()
+{
+    if (_pCorProfilerInfoEvents == nullptr)
+    {
+        return;
+    }
+
+    if (_allocationsEventPipeSession != 0)
+    {
+        _pCorProfilerInfoEvents->EventPipeStopSession(_allocationsEventPipeSession);
+        _allocationsEventPipeSession = 0;
+    }
+
+    if (_contentionEventPipeSession != 0)
+    {
+        _pCorProfilerInfoEvents->EventPipeStopSession(_contentionEventPipeSession);
+        _contentionEventPipeSession = 0;
+    }
+
+    _pCorProfilerInfoEvents->Release();
+    _pCorProfilerInfoEvents = nullptr;
+}
+
 HRESULT STDMETHODCALLTYPE CorProfilerCallback::Shutdown(void)
 {
     Log::Info("CorProfilerCallback::Shutdown()");
@@ -717,6 +921,14 @@ HRESULT STDMETHODCALLTYPE CorProfilerCallback::ModuleLoadFinished(ModuleID modul
 
 HRESULT STDMETHODCALLTYPE CorProfilerCallback::ModuleUnloadStarted(ModuleID moduleId)
 {
+    if (false == _isInitialized.load())
+    {
+        // If this CorProfilerCallback has not yet initialized, or if it has already shut down, then this callback is a No-Op.
+        return S_OK;
+    }
+
+    // collectible assemblies: forget about the methods and types defined in this module
+    _pFrameStore->OnModuleUnloaded(moduleId);
     return S_OK;
 }
 
@@ -826,6 +1038,7 @@ HRESULT STDMETHODCALLTYPE CorProfilerCallback::ThreadDestroyed(ThreadID threadId
         // The docs require that we do not allow to destroy a thread while it is being stack-walked.
         // TO ensure this, SetThreadDestroyed(..) acquires the StackWalkLock associated with this ThreadInfo.
         pThreadInfo->SetThreadDestroyed();
+        _pStackSamplerLoopManager->OnThreadDestroyed(pThreadInfo);
         pThreadInfo->Release();
     }
 
@@ -866,6 +1079,13 @@ HRESULT STDMETHODCALLTYPE CorProfilerCallback::ThreadAssignedToOSThread(ThreadID
 
     _pManagedThreadList->SetThreadOsInfo(managedThreadId, osThreadId, dupOsThreadHandle);
 
+    ManagedThreadInfo* pThreadInfo = _pManagedThreadList->GetThreadInfo(managedThreadId);
+    if (pThreadInfo != nullptr)
+    {
+        _pStackSamplerLoopManager->OnThreadAssignedToOsThread(pThreadInfo);
+        pThreadInfo->Release();
+    }
+
     return S_OK;
 }
 
@@ -939,6 +1159,17 @@ HRESULT STDMETHODCALLTYPE CorProfilerCallback::ManagedToUnmanagedTransition(Func
 
 HRESULT STDMETHODCALLTYPE CorProfilerCallback::RuntimeSuspendStarted(COR_PRF_SUSPEND_REASON suspendReason)
 {
+    if (false == _isInitialized.load())
+    {
+        // If this CorProfilerCallback has not yet initialized, or if it has already shut down, then this callback is a No-Op.
+        return S_OK;
+    }
+
+    if (_pGarbageCollectionProvider != nullptr)
+    {
+        _pGarbageCollectionProvider->OnRuntimeSuspendStarted(suspendReason);
+    }
+
     return S_OK;
 }
 
@@ -949,6 +1180,17 @@ HRESULT STDMETHODCALLTYPE CorProfilerCallback::RuntimeSuspendFinished(void)
 
 HRESULT STDMETHODCALLTYPE CorProfilerCallback::RuntimeSuspendAborted(void)
 {
+    if (false == _isInitialized.load())
+    {
+        // If this CorProfilerCallback has not yet initialized, or if it has already shut down, then this callback is a No-Op.
+        return S_OK;
+    }
+
+    if (_pGarbageCollectionProvider != nullptr)
+    {
+        _pGarbageCollectionProvider->OnRuntimeSuspendAborted();
+    }
+
     return S_OK;
 }
 
@@ -959,6 +1201,17 @@ HRESULT STDMETHODCALLTYPE CorProfilerCallback::RuntimeResumeStarted(void)
 
 HRESULT STDMETHODCALLTYPE CorProfilerCallback::RuntimeResumeFinished(void)
 {
+    if (false == _isInitialized.load())
+    {
+        // If this CorProfilerCallback has not yet initialized, or if it has already shut down, then this callback is a No-Op.
+        return S_OK;
+    }
+
+    if (_pGarbageCollectionProvider != nullptr)
+    {
+        _pGarbageCollectionProvider->OnRuntimeResumeFinished();
+    }
+
     return S_OK;
 }
 
@@ -999,6 +1252,17 @@ HRESULT STDMETHODCALLTYPE CorProfilerCallback::RootReferences(ULONG cRootRefs, O
 
 HRESULT STDMETHODCALLTYPE CorProfilerCallback::ExceptionThrown(ObjectID thrownObjectId)
 {
+    if (false == _isInitialized.load())
+    {
+        // If this CorProfilerCallback has not yet initialized, or if it has already shut down, then this callback is a No-Op.
+        return S_OK;
+    }
+
+    if (_pExceptionsProvider != nullptr)
+    {
+        _pExceptionsProvider->OnExceptionThrown(thrownObjectId);
+    }
+
     return S_OK;
 }
 
@@ -1089,6 +1353,17 @@ HRESULT STDMETHODCALLTYPE CorProfilerCallback::ExceptionCLRCatcherExecute(void)
 
 HRESULT STDMETHODCALLTYPE CorProfilerCallback::GarbageCollectionStarted(int cGenerations, BOOL generationCollected[], COR_PRF_GC_REASON reason)
 {
+    if (false == _isInitialized.load())
+    {
+        // If this CorProfilerCallback has not yet initialized, or if it has already shut down, then this callback is a No-Op.
+        return S_OK;
+    }
+
+    if (_pGarbageCollectionProvider != nullptr)
+    {
+        _pGarbageCollectionProvider->OnGarbageCollectionStarted(cGenerations, generationCollected, reason);
+    }
+
     return S_OK;
 }
 
@@ -1099,6 +1374,17 @@ HRESULT STDMETHODCALLTYPE CorProfilerCallback::SurvivingReferences(ULONG cSurviv
 
 HRESULT STDMETHODCALLTYPE CorProfilerCallback::GarbageCollectionFinished(void)
 {
+    if (false == _isInitialized.load())
+    {
+        // If this CorProfilerCallback has not yet initialized, or if it has already shut down, then this callback is a No-Op.
+        return S_OK;
+    }
+
+    if (_pGarbageCollectionProvider != nullptr)
+    {
+        _pGarbageCollectionProvider->OnGarbageCollectionFinished();
+    }
+
     return S_OK;
 }
 
@@ -1209,6 +1495,22 @@ HRESULT STDMETHODCALLTYPE CorProfilerCallback::EventPipeEventDelivered(EVENTPIPE
                                                                        ULONG numStackFrames,
                                                                        UINT_PTR stackFrames[])
 {
+    if (false == _isInitialized.load())
+    {
+        // If this CorProfilerCallback has not yet initialized, or if it has already shut down, then this callback is a No-Op.
+        return S_OK;
+    }
+
+    if (_pAllocationsProvider != nullptr)
+    {
+        _pAllocationsProvider->OnEventPipeEvent(eventId, eventVersion, cbEventData, eventData, eventThread, numStackFrames, stackFrames);
+    }
+
+    if (_pContentionProvider != nullptr)
+    {
+        _pContentionProvider->OnEventPipeEvent(eventId, eventVersion, cbEventData, eventData, eventThread, numStackFrames, stackFrames);
+    }
+
     return S_OK;
 }
 
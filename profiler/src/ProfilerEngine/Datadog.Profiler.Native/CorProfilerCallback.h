@@ -15,6 +15,7 @@
 #include "IExporter.h"
 #include "IFrameStore.h"
 #include "IMetricsSender.h"
+#include "ProfileSpool.h"
 #include "WallTimeProvider.h"
 #include "shared/src/native-src/string.h"
 
@@ -31,6 +32,10 @@ class IStackSamplerLoopManager;
 class IConfiguration;
 class IExporter;
 class SamplesAggregator;
+class AllocationsProvider;
+class ContentionProvider;
+class ExceptionsProvider;
+class GarbageCollectionProvider;
 
 namespace shared {
 class Loader;
@@ -184,6 +189,9 @@ private :
 
     std::atomic<ULONG> _refCount{0};
     ICorProfilerInfo4* _pCorProfilerInfo = nullptr;
+    ICorProfilerInfo12* _pCorProfilerInfoEvents = nullptr; // only set when an EventPipe session is needed
+    EVENTPIPE_SESSION _allocationsEventPipeSession = 0;
+    EVENTPIPE_SESSION _contentionEventPipeSession = 0;
     inline static bool _isNet46OrGreater = false;
     std::shared_ptr<IMetricsSender> _metricsSender;
     std::atomic<bool> _isInitialized{false}; // pay attention to keeping ProfilerEngineStatus::IsProfilerEngiveActive in sync with this!
@@ -196,6 +204,10 @@ private :
     IStackSamplerLoopManager* _pStackSamplerLoopManager = nullptr;
     IManagedThreadList* _pManagedThreadList = nullptr;
     ISymbolsResolver* _pSymbolsResolver = nullptr;
+    AllocationsProvider* _pAllocationsProvider = nullptr;
+    ContentionProvider* _pContentionProvider = nullptr;
+    ExceptionsProvider* _pExceptionsProvider = nullptr;
+    GarbageCollectionProvider* _pGarbageCollectionProvider = nullptr;
 
     std::vector<std::unique_ptr<IService>> _services;
 
@@ -204,6 +216,7 @@ private :
     std::unique_ptr<IAppDomainStore> _pAppDomainStore = nullptr;
     std::unique_ptr<IFrameStore> _pFrameStore = nullptr;
     std::unique_ptr<ApplicationStore> _pApplicationStore = nullptr;
+    std::unique_ptr<ProfileSpool> _pProfileSpool = nullptr;
 
 private:
     static void ConfigureDebugLog();
@@ -217,6 +230,9 @@ private:
     bool DisposeServices();
     bool StartServices();
     bool StopServices();
+    EVENTPIPE_SESSION StartEventPipeSession(std::uint64_t keywords, std::uint32_t level);
+    void StartEventPipeSessions();
+    void StopEventPipeSessions();
 
 
     template <class T, typename... ArgTypes>
@@ -12,10 +12,11 @@ CpuTimeProvider::CpuTimeProvider(
     IConfiguration* pConfiguration,
     IFrameStore* pFrameStore,
     IAppDomainStore* pAppDomainStore,
-    IRuntimeIdStore* pRuntimeIdStore
+    IRuntimeIdStore* pRuntimeIdStore,
+    SamplesTransformerPool* pTransformerPool
     )
     :
-    CollectorBase<RawCpuSample>(pConfiguration, pFrameStore, pAppDomainStore, pRuntimeIdStore)
+    CollectorBase<RawCpuSample>(pConfiguration, pFrameStore, pAppDomainStore, pRuntimeIdStore, pTransformerPool)
 {
 }
 
@@ -27,6 +28,5 @@ const char* CpuTimeProvider::GetName()
 
 void CpuTimeProvider::OnTransformRawSample(const RawCpuSample& rawSample, Sample& sample)
 {
-    // from milliseconds to nanoseconds
-    sample.AddValue(rawSample.Duration * 1000000, SampleValue::CpuTimeDuration);
+    sample.AddValue(rawSample.Duration, SampleValue::CpuTimeDuration);
 }
@@ -26,7 +26,17 @@ public:
     inline static const shared::WSTRING Tags                        = WStr("DD_TAGS");
     inline static const shared::WSTRING NativeFramesEnabled         = WStr("DD_PROFILING_FRAMES_NATIVE_ENABLED");
     inline static const shared::WSTRING CpuProfilingEnabled         = WStr("DD_PROFILING_CPU_ENABLED");
+    inline static const shared::WSTRING CpuTimerSamplingEnabled     = WStr("DD_INTERNAL_PROFILING_CPU_TIMER_ENABLED");
+    inline static const shared::WSTRING SamplingOverheadBudget      = WStr("DD_INTERNAL_PROFILING_SAMPLING_OVERHEAD_BUDGET");
+    inline static const shared::WSTRING AllocationProfilingEnabled  = WStr("DD_PROFILING_ALLOCATION_ENABLED");
+    inline static const shared::WSTRING ContentionProfilingEnabled  = WStr("DD_PROFILING_LOCK_ENABLED");
+    inline static const shared::WSTRING ExceptionProfilingEnabled   = WStr("DD_PROFILING_EXCEPTION_ENABLED");
+    inline static const shared::WSTRING GarbageCollectionProfilingEnabled = WStr("DD_PROFILING_GC_ENABLED");
     inline static const shared::WSTRING ProfilesOutputDir           = WStr("DD_INTERNAL_PROFILING_OUTPUT_DIR");
+    inline static const shared::WSTRING SpoolDirectory              = WStr("DD_INTERNAL_PROFILING_SPOOL_DIR");
+    inline static const shared::WSTRING SpoolMaxSizePerService      = WStr("DD_INTERNAL_PROFILING_SPOOL_MAX_SIZE_MB");
+    inline static const shared::WSTRING TransformerThreadsCount     = WStr("DD_INTERNAL_PROFILING_TRANSFORMER_THREADS");
+    inline static const shared::WSTRING RawSamplesCapacity          = WStr("DD_INTERNAL_PROFILING_RAW_SAMPLES_CAPACITY");
     inline static const shared::WSTRING DevelopmentConfiguration    = WStr("DD_INTERNAL_USE_DEVELOPMENT_CONFIGURATION");
     inline static const shared::WSTRING Agentless                   = WStr("DD_PROFILING_AGENTLESS");
 
@@ -0,0 +1,44 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "cor.h"
+#include "corprof.h"
+
+// Helpers to read the fields of the payload received by EventPipeEventDelivered
+class EventPipePayload
+{
+public:
+    template <typename T>
+    static bool TryRead(LPCBYTE eventData, ULONG cbEventData, ULONG offset, T& value)
+    {
+        if ((eventData == nullptr) || (offset + sizeof(T) > cbEventData))
+        {
+            return false;
+        }
+
+        // the payload fields are not aligned
+        std::memcpy(&value, eventData + offset, sizeof(T));
+        return true;
+    }
+
+    // returns the offset of the field following the null terminated UTF-16 string at the given offset
+    static bool TrySkipString(LPCBYTE eventData, ULONG cbEventData, ULONG& offset)
+    {
+        std::uint16_t character;
+        do
+        {
+            if (!TryRead(eventData, cbEventData, offset, character))
+            {
+                return false;
+            }
+            offset += sizeof(character);
+        } while (character != 0);
+
+        return true;
+    }
+};
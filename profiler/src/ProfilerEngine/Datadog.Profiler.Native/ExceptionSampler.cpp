@@ -0,0 +1,161 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include "ExceptionSampler.h"
+
+#include <algorithm>
+
+ExceptionSampler::ExceptionSampler(double samplesPerSecond, double maxBurst) :
+    _maxSamplesPerSecond{samplesPerSecond},
+    _maxBurst{maxBurst},
+    _samplesPerNanosecond{samplesPerSecond / 1000000000}
+{
+}
+
+// ClassIDs are aligned addresses: mix the bits so that the types are evenly spread among the shards
+std::size_t ExceptionSampler::GetShardIndex(ClassID classId)
+{
+    std::uint64_t hash = static_cast<std::uint64_t>(classId);
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return static_cast<std::size_t>(hash & (ShardsCount - 1));
+}
+
+std::uint64_t ExceptionSampler::Sample(ClassID classId, std::int64_t currentTimestampNs)
+{
+    auto samplesPerNanosecond = _samplesPerNanosecond.load(std::memory_order_relaxed);
+
+    auto& shard = _shards[GetShardIndex(classId)];
+    std::lock_guard<std::mutex> lock(shard.Lock);
+
+    auto it = shard.Types.find(classId);
+    if (it == shard.Types.end())
+    {
+        if (shard.Types.size() >= MaxTypesPerShard)
+        {
+            if (!shard.IsOverflowUsed)
+            {
+                shard.OverflowState = TypeState{_maxBurst, currentTimestampNs, 0, false, ""};
+                shard.IsOverflowUsed = true;
+            }
+
+            return Sample(shard.OverflowState, currentTimestampNs, samplesPerNanosecond);
+        }
+
+        // the first exception of a type starts with a full bucket
+        it = shard.Types.emplace(classId, TypeState{_maxBurst, currentTimestampNs, 0, false, ""}).first;
+    }
+
+    return Sample(it->second, currentTimestampNs, samplesPerNanosecond);
+}
+
+std::uint64_t ExceptionSampler::Sample(TypeState& state, std::int64_t currentTimestampNs, double samplesPerNanosecond)
+{
+    // refill the bucket with the time elapsed since the last refill
+    auto elapsed = currentTimestampNs - state.LastRefillTimestampNs;
+    if (elapsed > 0)
+    {
+        state.Tokens = (std::min)(_maxBurst, state.Tokens + elapsed * samplesPerNanosecond);
+        state.LastRefillTimestampNs = currentTimestampNs;
+    }
+
+    state.IsThrownSinceFlush = true;
+    state.ThrownCount++;
+    if (state.Tokens < 1)
+    {
+        return 0;
+    }
+
+    state.Tokens -= 1;
+
+    auto count = state.ThrownCount;
+    state.ThrownCount = 0;
+    return count;
+}
+
+void ExceptionSampler::GiveBack(ClassID classId, std::uint64_t count)
+{
+    auto& shard = _shards[GetShardIndex(classId)];
+    std::lock_guard<std::mutex> lock(shard.Lock);
+
+    // the type has been sampled just before: if it is not in the shard, it shares the overflow state
+    auto it = shard.Types.find(classId);
+    auto& state = (it != shard.Types.end()) ? it->second : shard.OverflowState;
+    if ((it == shard.Types.end()) && !shard.IsOverflowUsed)
+    {
+        // the state has been forgotten by Flush() in the meantime: the count is kept by the overflow state
+        state = TypeState{0, 0, 0, false, ""};
+        shard.IsOverflowUsed = true;
+    }
+
+    state.Tokens = (std::min)(_maxBurst, state.Tokens + 1);
+    state.ThrownCount += count;
+    state.IsThrownSinceFlush = true;
+}
+
+void ExceptionSampler::SetTypeName(ClassID classId, const std::string& typeName)
+{
+    auto& shard = _shards[GetShardIndex(classId)];
+    std::lock_guard<std::mutex> lock(shard.Lock);
+
+    // the types sharing the overflow state are reported without their name
+    auto it = shard.Types.find(classId);
+    if ((it != shard.Types.end()) && it->second.TypeName.empty())
+    {
+        it->second.TypeName = typeName;
+    }
+}
+
+std::vector<ExceptionSampler::SkippedExceptions> ExceptionSampler::Flush()
+{
+    std::vector<SkippedExceptions> skippedExceptions;
+    std::size_t thrownTypesCount = 0;
+    for (auto& shard : _shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.Lock);
+
+        for (auto it = shard.Types.begin(); it != shard.Types.end();)
+        {
+            auto& state = it->second;
+            if (!state.IsThrownSinceFlush)
+            {
+                it = shard.Types.erase(it);
+                continue;
+            }
+
+            thrownTypesCount++;
+            if (state.ThrownCount != 0)
+            {
+                skippedExceptions.push_back(SkippedExceptions{state.TypeName, state.ThrownCount});
+                state.ThrownCount = 0;
+            }
+
+            state.IsThrownSinceFlush = false;
+            ++it;
+        }
+
+        if (shard.IsOverflowUsed)
+        {
+            thrownTypesCount++;
+            if (shard.OverflowState.ThrownCount != 0)
+            {
+                skippedExceptions.push_back(SkippedExceptions{"", shard.OverflowState.ThrownCount});
+            }
+
+            shard.IsOverflowUsed = false;
+        }
+    }
+
+    // the more types are thrown, the fewer samples per type
+    auto samplesPerSecond = (std::max)(MinSamplesPerSecond, _maxSamplesPerSecond / (std::max)(thrownTypesCount, std::size_t(1)));
+    samplesPerSecond = (std::min)(samplesPerSecond, _maxSamplesPerSecond);
+    _samplesPerNanosecond.store(samplesPerSecond / 1000000000, std::memory_order_relaxed);
+
+    return skippedExceptions;
+}
+
+double ExceptionSampler::GetSamplesPerSecond() const
+{
+    return _samplesPerNanosecond.load(std::memory_order_relaxed) * 1000000000;
+}
@@ -0,0 +1,94 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cor.h"
+#include "corprof.h"
+
+// Rate limits the exceptions sampled per type with a token bucket per ClassID: a storm of exceptions
+// of one type cannot flood the pipeline nor starve the other types.
+// The rate is adaptive: the samples per second are shared by the types thrown during the previous
+// period (between two flushes), within [MinSamplesPerSecond, samplesPerSecond] per type.
+// All thrown exceptions are counted so that each sample represents the exceptions of the same type
+// thrown since the previous sample of this type; the exceptions thrown after the last sample of a
+// type are returned by Flush().
+//
+// The types are spread among shards, each one protected by its own lock, so that threads throwing
+// exceptions of different types rarely contend. The types that were not thrown during a whole period
+// are forgotten by Flush(); beyond MaxTypesPerShard, new types share the same bucket and counts.
+class ExceptionSampler
+{
+public:
+    static constexpr double MinSamplesPerSecond = 0.1;
+    static constexpr std::size_t MaxTypesPerShard = 64;
+
+public:
+    // exceptions thrown since the last sample of their type
+    struct SkippedExceptions
+    {
+        std::string TypeName;   // empty if the type name is not known
+        std::uint64_t Count;
+    };
+
+public:
+    ExceptionSampler(double samplesPerSecond, double maxBurst);
+
+    // returns 0 if the exception should not be sampled; otherwise, the number of exceptions
+    // of this type (including this one) thrown since the previous sample
+    std::uint64_t Sample(ClassID classId, std::int64_t currentTimestampNs);
+
+    // called when a sampled exception could not be reported (e.g. its callstack could not be collected):
+    // the token is refunded and the count is carried by the next sample of this type (or by Flush())
+    void GiveBack(ClassID classId, std::uint64_t count);
+
+    // called when an exception is sampled to keep the type name reported by Flush()
+    void SetTypeName(ClassID classId, const std::string& typeName);
+
+    // returns the exceptions thrown since the last sample of their type, adapts the rate to the number
+    // of types thrown since the previous flush and forgets the other types
+    std::vector<SkippedExceptions> Flush();
+
+    double GetSamplesPerSecond() const;
+
+private:
+    struct TypeState
+    {
+        double Tokens;
+        std::int64_t LastRefillTimestampNs;
+        std::uint64_t ThrownCount;
+        bool IsThrownSinceFlush;
+        std::string TypeName;
+    };
+
+    struct alignas(64) Shard
+    {
+        std::mutex Lock;
+        std::unordered_map<ClassID, TypeState> Types;
+
+        // shared by the types that do not fit in the shard
+        TypeState OverflowState;
+        bool IsOverflowUsed = false;
+    };
+
+    static const std::size_t ShardsCount = 16;
+
+private:
+    static std::size_t GetShardIndex(ClassID classId);
+    std::uint64_t Sample(TypeState& state, std::int64_t currentTimestampNs, double samplesPerNanosecond);
+
+private:
+    const double _maxSamplesPerSecond;
+    const double _maxBurst;
+    std::atomic<double> _samplesPerNanosecond;
+
+    std::array<Shard, ShardsCount> _shards;
+};
@@ -0,0 +1,220 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include <ctime>
+#include <memory>
+
+#include "ExceptionsProvider.h"
+#include "IAppDomainStore.h"
+#include "IConfiguration.h"
+#include "IFrameStore.h"
+#include "IManagedThreadList.h"
+#include "IRuntimeIdStore.h"
+#include "OpSysTools.h"
+#include "RawExceptionSample.h"
+#include "SynchronousStackCollector.h"
+
+#include "shared/src/native-src/com_ptr.h"
+#include "shared/src/native-src/string.h"
+
+
+ExceptionsProvider::ExceptionsProvider(
+    ICorProfilerInfo4* pCorProfilerInfo,
+    IManagedThreadList* pManagedThreadList,
+    IConfiguration* pConfiguration,
+    IFrameStore* pFrameStore,
+    IAppDomainStore* pAppDomainStore,
+    IRuntimeIdStore* pRuntimeIdStore,
+    SamplesTransformerPool* pTransformerPool
+    )
+    :
+    CollectorBase<RawExceptionSample>(pConfiguration, pFrameStore, pAppDomainStore, pRuntimeIdStore, pTransformerPool),
+    _pCorProfilerInfo{pCorProfilerInfo},
+    _pManagedThreadList{pManagedThreadList},
+    _pFrameStore{pFrameStore},
+    _sampler{SamplesPerSecond, MaxSamplesBurst},
+    _lastAppDomainId{0},
+    _messageFieldOffset{0},
+    _stringLengthOffset{0},
+    _stringBufferOffset{0}
+{
+}
+
+const char* ExceptionsProvider::GetName()
+{
+    return _serviceName;
+}
+
+std::list<Sample> ExceptionsProvider::GetSamples()
+{
+    // the exceptions thrown after the last sample of their type would never be counted otherwise
+    RawExceptionSample rawSample;
+    rawSample.Timestamp = static_cast<std::uint64_t>(std::time(nullptr));
+    rawSample.AppDomainId = _lastAppDomainId.load(std::memory_order_relaxed);
+    for (auto& skippedExceptions : _sampler.Flush())
+    {
+        rawSample.ExceptionType = skippedExceptions.TypeName.empty() ? "Unknown-Type" : std::move(skippedExceptions.TypeName);
+        rawSample.Count = skippedExceptions.Count;
+        TransformRawSample(rawSample, 0);
+    }
+
+    return CollectorBase<RawExceptionSample>::GetSamples();
+}
+
+void ExceptionsProvider::OnExceptionThrown(ObjectID thrownObjectId)
+{
+    ClassID classId;
+    if (FAILED(_pCorProfilerInfo->GetClassFromObject(thrownObjectId, &classId)))
+    {
+        return;
+    }
+
+    auto count = _sampler.Sample(classId, OpSysTools::GetHighPrecisionNanoseconds());
+    if (count == 0)
+    {
+        return;
+    }
+
+    // the exceptions counted by this sample must not be lost if it cannot be reported
+    ThreadID threadId;
+    if (FAILED(_pCorProfilerInfo->GetCurrentThreadID(&threadId)))
+    {
+        _sampler.GiveBack(classId, count);
+        return;
+    }
+
+    RawExceptionSample rawSample;
+    rawSample.Timestamp = static_cast<std::uint64_t>(std::time(nullptr));
+    rawSample.Count = count;
+    if (_pFrameStore->GetTypeName(classId, rawSample.ExceptionType))
+    {
+        _sampler.SetTypeName(classId, rawSample.ExceptionType);
+    }
+    else
+    {
+        rawSample.ExceptionType = "Unknown-Type";
+    }
+
+    GetExceptionMessage(thrownObjectId, classId, rawSample.ExceptionMessage);
+
+    if (!SynchronousStackCollector::Collect(_pCorProfilerInfo, rawSample.Stack))
+    {
+        _sampler.GiveBack(classId, count);
+        return;
+    }
+
+    if (SUCCEEDED(_pCorProfilerInfo->GetThreadAppDomain(threadId, &rawSample.AppDomainId)))
+    {
+        _lastAppDomainId.store(rawSample.AppDomainId, std::memory_order_relaxed);
+    }
+
+    // GetThreadInfo() calls AddRef() on the threadInfo: it is released after the sample is transformed
+    rawSample.ThreadInfo = _pManagedThreadList->GetThreadInfo(threadId);
+    if ((rawSample.ThreadInfo != nullptr) && rawSample.ThreadInfo->CanReadTraceContext())
+    {
+        rawSample.LocalRootSpanId = rawSample.ThreadInfo->GetLocalRootSpanId();
+        rawSample.SpanId = rawSample.ThreadInfo->GetSpanId();
+    }
+
+    std::lock_guard<std::mutex> lock(_addLock);
+    Add(std::move(rawSample));
+}
+
+bool ExceptionsProvider::GetExceptionMessage(ObjectID exceptionId, ClassID classId, std::string& message)
+{
+    std::call_once(_stringLayoutInitialized, [this]() {
+        _pCorProfilerInfo->GetStringLayout2(&_stringLengthOffset, &_stringBufferOffset);
+    });
+
+    if ((_stringBufferOffset == 0) || ((_messageFieldOffset == 0) && !LoadMessageFieldOffset(classId)))
+    {
+        return false;
+    }
+
+    // the exception is frozen during the ExceptionThrown callback: its fields can be read directly
+    auto messageId = *reinterpret_cast<ObjectID*>(exceptionId + _messageFieldOffset);
+    if (messageId == 0)
+    {
+        return false;
+    }
+
+    auto length = *reinterpret_cast<ULONG*>(messageId + _stringLengthOffset);
+    auto* buffer = reinterpret_cast<WCHAR*>(messageId + _stringBufferOffset);
+    message = shared::ToString(shared::WSTRING(buffer, length));
+    return true;
+}
+
+bool ExceptionsProvider::LoadMessageFieldOffset(ClassID classId)
+{
+    // look for System.Exception in the hierarchy of the thrown type
+    ModuleID moduleId = 0;
+    std::string typeName;
+    while (classId != 0)
+    {
+        ClassID parentClassId = 0;
+        if (FAILED(_pCorProfilerInfo->GetClassIDInfo2(classId, &moduleId, nullptr, &parentClassId, 0, nullptr, nullptr)))
+        {
+            return false;
+        }
+
+        if (_pFrameStore->GetTypeName(classId, typeName) && (typeName == "System.Exception"))
+        {
+            break;
+        }
+
+        classId = parentClassId;
+    }
+
+    if (classId == 0)
+    {
+        return false;
+    }
+
+    ComPtr<IMetaDataImport2> pMetadataImport;
+    if (FAILED(_pCorProfilerInfo->GetModuleMetaData(moduleId, CorOpenFlags::ofRead, IID_IMetaDataImport2, (IUnknown**)&pMetadataImport)))
+    {
+        return false;
+    }
+
+    ULONG fieldsCount = 0;
+    if (FAILED(_pCorProfilerInfo->GetClassLayout(classId, nullptr, 0, &fieldsCount, nullptr)) || (fieldsCount == 0))
+    {
+        return false;
+    }
+
+    auto fields = std::make_unique<COR_FIELD_OFFSET[]>(fieldsCount);
+    if (FAILED(_pCorProfilerInfo->GetClassLayout(classId, fields.get(), fieldsCount, &fieldsCount, nullptr)))
+    {
+        return false;
+    }
+
+    WCHAR fieldName[256];
+    for (ULONG i = 0; i < fieldsCount; i++)
+    {
+        ULONG nameLength = 0;
+        HRESULT hr = pMetadataImport->GetFieldProps(fields[i].ridOfField, nullptr, fieldName, 256, &nameLength, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+        if (SUCCEEDED(hr) && (shared::WSTRING(fieldName) == WStr("_message")))
+        {
+            _messageFieldOffset = fields[i].ulOffset;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ExceptionsProvider::OnTransformRawSample(const RawExceptionSample& rawSample, Sample& sample)
+{
+    // the skipped exceptions reported at export time don't have a callstack
+    if (rawSample.Stack.empty())
+    {
+        sample.AddFrame("CLR", "|lm:CLR |ns:CLR |ct:CLR |fn:Unsampled Exceptions");
+    }
+
+    sample.AddValue(rawSample.Count, SampleValue::ExceptionCount);
+    sample.AddLabel(Label{Sample::ExceptionTypeLabel, rawSample.ExceptionType});
+    if (!rawSample.ExceptionMessage.empty())
+    {
+        sample.AddLabel(Label{Sample::ExceptionMessageLabel, rawSample.ExceptionMessage});
+    }
+}
@@ -0,0 +1,79 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "cor.h"
+#include "corprof.h"
+
+#include "CollectorBase.h"
+#include "ExceptionSampler.h"
+#include "RawExceptionSample.h"
+
+// forward declarations
+class IConfiguration;
+class IFrameStore;
+class IAppDomainStore;
+class IRuntimeIdStore;
+class IManagedThreadList;
+
+
+// Thrown exceptions are counted per type but only a few of them per second and per type are sampled
+// (see ExceptionSampler): only the sampled exceptions pay for the callstack capture (synchronously on
+// the throwing thread) and the message lookup. Each sample is upscaled by the number of exceptions of
+// the same type thrown since the previous sample. The exceptions thrown after the last sample of their
+// type are reported, without callstack, when the samples are retrieved for the export.
+class ExceptionsProvider
+    : public CollectorBase<RawExceptionSample> // accepts raw exception samples
+{
+public:
+    static constexpr double SamplesPerSecond = 1;
+    static constexpr double MaxSamplesBurst = 10;
+
+public:
+    ExceptionsProvider(
+        ICorProfilerInfo4* pCorProfilerInfo,
+        IManagedThreadList* pManagedThreadList,
+        IConfiguration* pConfiguration,
+        IFrameStore* pFrameStore,
+        IAppDomainStore* pAppDomainStore,
+        IRuntimeIdStore* pRuntimeIdStore,
+        SamplesTransformerPool* pTransformerPool = nullptr
+        );
+
+    // called by the CLR on the throwing thread
+    void OnExceptionThrown(ObjectID thrownObjectId);
+
+// interfaces implementation
+public:
+    const char* GetName() override;
+    std::list<Sample> GetSamples() override;
+
+private:
+    virtual void OnTransformRawSample(const RawExceptionSample& rawSample, Sample& sample) override;
+
+    bool GetExceptionMessage(ObjectID exceptionId, ClassID classId, std::string& message);
+    bool LoadMessageFieldOffset(ClassID classId);
+
+private:
+    const char* _serviceName = "ExceptionsProvider";
+
+    ICorProfilerInfo4* _pCorProfilerInfo;
+    IManagedThreadList* _pManagedThreadList;
+    IFrameStore* _pFrameStore;
+    ExceptionSampler _sampler;
+    std::atomic<AppDomainID> _lastAppDomainId;
+
+    // offset of System.Exception._message in the exception objects (0 until found)
+    std::atomic<ULONG> _messageFieldOffset;
+    std::once_flag _stringLayoutInitialized;
+    ULONG _stringLengthOffset;
+    ULONG _stringBufferOffset;
+
+    // the raw samples queue accepts only one producer at a time but exceptions are sampled on any thread
+    std::mutex _addLock;
+};
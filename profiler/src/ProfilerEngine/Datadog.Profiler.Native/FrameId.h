@@ -0,0 +1,42 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+#include "StringTable.h"
+
+// Compact representation of a frame in a callstack: both the module name and the frame text
+// are interned in the process-wide StringTable
+struct FrameId
+{
+    StringId ModuleName;
+    StringId Frame;
+
+    std::string_view GetModuleName() const
+    {
+        return StringTable::GetInstance()->Get(ModuleName);
+    }
+
+    std::string_view GetFrame() const
+    {
+        return StringTable::GetInstance()->Get(Frame);
+    }
+
+    // unique 64 bit key that can be used for hashing
+    std::uint64_t GetKey() const
+    {
+        return (static_cast<std::uint64_t>(ModuleName) << 32) | Frame;
+    }
+
+    bool operator==(const FrameId& other) const
+    {
+        return (ModuleName == other.ModuleName) && (Frame == other.Frame);
+    }
+
+    bool operator!=(const FrameId& other) const
+    {
+        return !(*this == other);
+    }
+};
@@ -6,65 +6,197 @@
 #include "Log.h"
 #include "OpSysTools.h"
 
+#include <algorithm>
+
 #include "shared/src/native-src/com_ptr.h"
 #include "shared/src/native-src/dd_filesystem.hpp"
 // namespace fs is an alias defined in "dd_filesystem.hpp"
 
-FrameStore::FrameStore(ICorProfilerInfo4* pCorProfilerInfo) :
-    _pCorProfilerInfo{pCorProfilerInfo}
+FrameStore::FrameStore(ICorProfilerInfo4* pCorProfilerInfo, IConfiguration* pConfiguration) :
+    _pCorProfilerInfo{pCorProfilerInfo},
+    _isNativeFramesEnabled{pConfiguration->IsNativeFramesEnabled()},
+    _pStringTable{StringTable::GetInstance()},
+    _nextUnloadedImagesCheck{0}
 {
+    _unknownManagedFrame = InternFrame(UnknownManagedAssembly, UnknownManagedFrame);
+    _unknownNativeFrame = InternFrame("Unknown-Native-Module", "|lm:Unknown-Native-Module |ns:NativeCode |ct:Unknown-Native-Module |fn:Function");
 }
 
-std::tuple<bool, std::string, std::string> FrameStore::GetFrame(uintptr_t instructionPointer)
+FrameStore::~FrameStore()
+{
+    Log::Info("FrameStore methods cache: ", _methods.Size(), " entries (", _methods.GetHitCount(), " hits / ", _methods.GetMissCount(), " misses)");
+    Log::Info("FrameStore types cache: ", _types.Size(), " entries (", _types.GetHitCount(), " hits / ", _types.GetMissCount(), " misses)");
+    Log::Info("FrameStore native frames cache: ", _nativeFrames.Size(), " entries (", _nativeFrames.GetHitCount(), " hits / ", _nativeFrames.GetMissCount(), " misses)");
+}
+
+std::tuple<bool, FrameId> FrameStore::GetFrame(uintptr_t instructionPointer)
 {
     FunctionID functionId;
     HRESULT hr = _pCorProfilerInfo->GetFunctionFromIP((LPCBYTE)instructionPointer, &functionId);
 
     if (SUCCEEDED(hr))
     {
-        auto [moduleName, frame] = GetManagedFrame(functionId);
-        return {true, moduleName, frame};
+        return {true, GetManagedFrame(functionId)};
+    }
+    else
+    {
+        return {false, GetNativeFrame(instructionPointer)};
+    }
+}
+
+bool FrameStore::GetTypeName(ClassID classId, std::string& name)
+{
+    // arrays do not have metadata: use the element type instead
+    CorElementType elementType;
+    ClassID elementClassId;
+    ULONG rank;
+    if (_pCorProfilerInfo->IsArrayClass(classId, &elementType, &elementClassId, &rank) == S_OK)
+    {
+        if ((elementClassId == 0) || !GetTypeName(elementClassId, name))
+        {
+            return false;
+        }
+
+        name += "[" + std::string(rank - 1, ',') + "]";
+        return true;
+    }
+
+    TypeDesc typeDesc;
+    if (!_types.TryGet(classId, typeDesc))
+    {
+        ModuleID moduleId;
+        mdTypeDef mdTokenType;
+        HRESULT hr = _pCorProfilerInfo->GetClassIDInfo(classId, &moduleId, &mdTokenType);
+        if (FAILED(hr) || (moduleId == 0))
+        {
+            return false;
+        }
+
+        ComPtr<IMetaDataImport2> pMetadataImport;
+        hr = _pCorProfilerInfo->GetModuleMetaData(moduleId, CorOpenFlags::ofRead, IID_IMetaDataImport2, (IUnknown**)&pMetadataImport);
+        if (FAILED(hr))
+        {
+            return false;
+        }
+
+        if (!GetTypeDesc(pMetadataImport.Get(), classId, moduleId, mdTokenType, typeDesc))
+        {
+            return false;
+        }
+
+        typeDesc.ModuleId = moduleId;
+        _types.Set(classId, typeDesc);
+    }
+
+    if (typeDesc.Namespace.empty())
+    {
+        name = typeDesc.Type;
     }
     else
     {
-        auto [moduleName, frame] = GetNativeFrame(instructionPointer);
-        return {false, moduleName, frame};
+        name = typeDesc.Namespace + "." + typeDesc.Type;
     }
+
+    return true;
 }
 
-// It should be possible to use dbghlp.dll on Windows (and something else on Linux?)
-// to get function name + offset
+void FrameStore::OnModuleUnloaded(ModuleID moduleId)
+{
+    auto removedMethods = _methods.RemoveIf([moduleId](FunctionID, MethodDesc const& method) { return method.ModuleId == moduleId; });
+    auto removedTypes = _types.RemoveIf([moduleId](ClassID, TypeDesc const& type) { return type.ModuleId == moduleId; });
+
+    if ((removedMethods > 0) || (removedTypes > 0))
+    {
+        Log::Debug("Module 0x", std::hex, moduleId, std::dec, " unloaded: ", removedMethods, " methods and ", removedTypes, " types removed from FrameStore caches");
+    }
+}
+
+FrameId FrameStore::InternFrame(std::string_view moduleName, std::string_view frame)
+{
+    return {_pStringTable->Intern(moduleName), _pStringTable->Intern(frame)};
+}
+
+// On Linux, the function name is found in the ELF symbols of the module.
+// On Windows, it should be possible to use dbghlp.dll to get function name + offset
 // see https://docs.microsoft.com/en-us/windows/win32/api/dbghelp/nf-dbghelp-symfromaddr for more details
-// However, today, no symbol resolution is done; only the module implementing the function is provided
-std::pair<std::string, std::string> FrameStore::GetNativeFrame(uintptr_t instructionPointer)
+// However, today, only the module implementing the function is provided
+FrameId FrameStore::GetNativeFrame(uintptr_t instructionPointer)
 {
-    static const std::string UnknownNativeFrame("|lm:Unknown-Native-Module |ns:NativeCode |ct:Unknown-Native-Module |fn:Function");
-    auto moduleName = OpSysTools::GetModuleName(reinterpret_cast<void*>(instructionPointer));
-    if (moduleName.empty())
+    // native frames are filtered out by the collectors: no need to resolve them
+    if (!_isNativeFramesEnabled)
+    {
+        return _unknownNativeFrame;
+    }
+
+    RemoveUnloadedNativeFrames();
+
+    FrameId nativeFrame;
+    if (_nativeFrames.TryGet(instructionPointer, nativeFrame))
+    {
+        return nativeFrame;
+    }
+
+    std::string modulePath;
+    std::string functionName;
+    if (!_nativeSymbolResolver.Resolve(instructionPointer, modulePath, functionName))
     {
-        return {"Unknown-Native-Module", UnknownNativeFrame};
+        _nativeFrames.Set(instructionPointer, _unknownNativeFrame);
+        return _unknownNativeFrame;
     }
 
-    // moduleName contains the full path: keep only the filename
-    moduleName = fs::path(moduleName).filename().string();
+    // modulePath contains the full path: keep only the filename
+    auto moduleName = fs::path(modulePath).filename().string();
     std::stringstream builder;
-    builder << "|lm:" << moduleName << " |ns:NativeCode |ct:" << moduleName << " |fn:Function";
-    return {moduleName, builder.str()};
+    builder << "|lm:" << moduleName << " |ns:NativeCode |ct:" << moduleName << " |fn:";
+    if (functionName.empty())
+    {
+        builder << "Function";
+    }
+    else
+    {
+        builder << functionName;
+    }
+
+    nativeFrame = InternFrame(moduleName, builder.str());
+    _nativeFrames.Set(instructionPointer, nativeFrame);
+    return nativeFrame;
 }
 
 
 
-std::pair<std::string, std::string> FrameStore::GetManagedFrame(FunctionID functionId)
+void FrameStore::RemoveUnloadedNativeFrames()
 {
+    // only one thread checks per period
+    auto now = OpSysTools::GetHighPrecisionNanoseconds();
+    auto nextCheck = _nextUnloadedImagesCheck.load(std::memory_order_relaxed);
+    if ((now < nextCheck) || !_nextUnloadedImagesCheck.compare_exchange_strong(nextCheck, now + UnloadedImagesCheckPeriod.count()))
     {
-        std::lock_guard<std::mutex> lock(_methodsLock);
+        return;
+    }
 
-        // Look into the cache first
-        auto element = _methods.find(functionId);
-        if (element != _methods.end())
-        {
-            return element->second;
-        }
+    // the addresses of an unloaded image could be reused by another image: its frames must be resolved again
+    auto unloadedRanges = _nativeSymbolResolver.GetUnloadedRanges();
+    if (unloadedRanges.empty())
+    {
+        return;
+    }
+
+    auto removedFrames = _nativeFrames.RemoveIf([&unloadedRanges](uintptr_t instructionPointer, FrameId const&) {
+        return std::any_of(unloadedRanges.begin(), unloadedRanges.end(), [instructionPointer](auto const& range) {
+            return (instructionPointer >= range.first) && (instructionPointer < range.second);
+        });
+    });
+
+    Log::Debug(unloadedRanges.size(), " native ranges unloaded: ", removedFrames, " frames removed from FrameStore cache");
+}
+
+FrameId FrameStore::GetManagedFrame(FunctionID functionId)
+{
+    // Look into the cache first
+    MethodDesc method;
+    if (_methods.TryGet(functionId, method))
+    {
+        return method.Frame;
     }
 
     // Get the method generic parameters if any + metadata token + class ID + module ID
@@ -77,21 +209,21 @@ std::pair<std::string, std::string> FrameStore::GetManagedFrame(FunctionID funct
     ULONG32 genericParametersCount;
     if (!GetFunctionInfo(functionId, mdTokenFunc, classId, moduleId, genericParametersCount, genericParameters))
     {
-        return {UnknownManagedAssembly, UnknownManagedFrame};
+        return _unknownManagedFrame;
     }
 
     // Use metadata API to get method name
     ComPtr<IMetaDataImport2> pMetadataImport;
     if (!GetMetadataApi(moduleId, functionId, pMetadataImport))
     {
-        return {UnknownManagedAssembly, UnknownManagedFrame};
+        return _unknownManagedFrame;
     }
 
     // method name is resolved first because we also get the mdDefToken of its class
     auto [methodName, mdTokenType] = GetMethodName(pMetadataImport.Get(), mdTokenFunc, genericParametersCount, genericParameters.get());
     if (methodName.empty())
     {
-        return {UnknownManagedAssembly, UnknownManagedFrame};
+        return _unknownManagedFrame;
     }
 
     // get type related description (assembly, namespace and type name)
@@ -100,14 +232,7 @@ std::pair<std::string, std::string> FrameStore::GetManagedFrame(FunctionID funct
     bool typeInCache = false;
     if (classId != 0) // classId could be 0 in case of generic type with a generic parameter that is a reference type
     {
-        std::lock_guard<std::mutex> lock(_typesLock);
-
-        auto typeEntry = _types.find(classId);
-        if (typeEntry != _types.end())
-        {
-            typeDesc = typeEntry->second;
-            typeInCache = true;
-        }
+        typeInCache = _types.TryGet(classId, typeDesc);
     }
     // TODO: would it be interesting to have a (moduleId + mdTokenDef) -> TypeDesc cache for the non cached generic types?
 
@@ -116,14 +241,13 @@ std::pair<std::string, std::string> FrameStore::GetManagedFrame(FunctionID funct
         // try to get the type description
         if (!GetTypeDesc(pMetadataImport.Get(), classId, moduleId, mdTokenType, typeDesc))
         {
-            return {UnknownManagedAssembly, UnknownManagedType + " |fn:" + methodName};
+            return InternFrame(UnknownManagedAssembly, UnknownManagedType + " |fn:" + methodName);
         }
 
         if (classId != 0)
         {
-            std::lock_guard<std::mutex> lock(_typesLock);
-
-            _types[classId] = typeDesc;
+            typeDesc.ModuleId = moduleId;
+            _types.Set(classId, typeDesc);
         }
         // TODO: would it be interesting to have a (moduleId + mdTokenDef) -> TypeDesc cache for the non cached generic types?
     }
@@ -138,16 +262,13 @@ std::pair<std::string, std::string> FrameStore::GetManagedFrame(FunctionID funct
     builder << " |ct:" << typeDesc.Type;
     builder << " |fn:" << methodName;
 
-    std::string managedFrame = builder.str();
-
-    {
-        std::lock_guard<std::mutex> lock(_methodsLock);
+    method.Frame = InternFrame(typeDesc.Assembly, builder.str());
+    method.ModuleId = moduleId;
 
-        // store it into the function cache
-        _methods[functionId] = {typeDesc.Assembly, managedFrame};
-    }
+    // store it into the function cache
+    _methods.Set(functionId, method);
 
-    return {typeDesc.Assembly, managedFrame};
+    return method.Frame;
 }
 
 // More explanations in https://chnasarre.medium.com/dealing-with-modules-assemblies-and-types-with-clr-profiling-apis-a7522a5abaa9?source=friends_link&sk=3e010ab991456db0394d4cca29cb8cb2
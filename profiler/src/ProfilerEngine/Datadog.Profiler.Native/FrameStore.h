@@ -2,11 +2,15 @@
 // This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
 
 #pragma once
+#include <atomic>
+#include <chrono>
 #include <memory>
-#include <mutex>
-#include <unordered_map>
 #include <string>
+#include "IConfiguration.h"
 #include "IFrameStore.h"
+#include "NativeSymbolResolver.h"
+#include "ShardedCache.h"
+#include "StringTable.h"
 
 #include "shared/src/native-src/com_ptr.h"
 
@@ -25,13 +29,24 @@ private:
         std::string Assembly;
         std::string Namespace;
         std::string Type;
+        ModuleID ModuleId = 0; // used to remove the type from the cache when its module is unloaded
+    };
+
+    class MethodDesc
+    {
+    public:
+        FrameId Frame;
+        ModuleID ModuleId = 0; // used to remove the method from the cache when its module is unloaded
     };
 
 public:
-    FrameStore(ICorProfilerInfo4* pCorProfilerInfo);
+    FrameStore(ICorProfilerInfo4* pCorProfilerInfo, IConfiguration* pConfiguration);
+    ~FrameStore() override;
 
 public :
-    std::tuple<bool, std::string, std::string> GetFrame(uintptr_t instructionPointer) override;
+    std::tuple<bool, FrameId> GetFrame(uintptr_t instructionPointer) override;
+    bool GetTypeName(ClassID classId, std::string& name) override;
+    void OnModuleUnloaded(ModuleID moduleId) override;
 
 private:
     bool GetFunctionInfo(
@@ -50,8 +65,10 @@ private:
         ClassID* genericParameters
         );
     bool GetTypeDesc(IMetaDataImport2* pMetadataImport, ClassID classId, ModuleID moduleId, mdTypeDef mdTokenType, TypeDesc& typeDesc);
-    std::pair <std::string, std::string> GetManagedFrame(FunctionID functionId);
-    std::pair <std::string, std::string> GetNativeFrame(uintptr_t instructionPointer);
+    FrameId GetManagedFrame(FunctionID functionId);
+    FrameId GetNativeFrame(uintptr_t instructionPointer);
+    void RemoveUnloadedNativeFrames();
+    FrameId InternFrame(std::string_view moduleName, std::string_view frame);
 
 private:  // global helpers
     static bool GetAssemblyName(ICorProfilerInfo4* pInfo, ModuleID moduleId, std::string& assemblyName);
@@ -75,13 +92,22 @@ private:  // global helpers
 
 private:
     ICorProfilerInfo4* _pCorProfilerInfo;
+    bool _isNativeFramesEnabled;
+    StringTable* _pStringTable;
+    FrameId _unknownManagedFrame;
+    FrameId _unknownNativeFrame;
+
+    // caches are read far more often than written (once per function/type) and could be
+    // accessed by several threads at the same time (collectors, providers) --> use sharded locks
+    ShardedCache<FunctionID, MethodDesc> _methods;
+    ShardedCache<ClassID, TypeDesc> _types;
 
-    std::mutex _methodsLock;
-    std::mutex _typesLock;
-    // caches functions                      V-- module    V-- full frame
-    std::unordered_map<FunctionID, std::pair<std::string, std::string>> _methods;
-    std::unordered_map<ClassID, TypeDesc> _types;
-    // TODO: dump stats about caches size at the end of the application
+    // native frames are only resolved once per instruction pointer
+    // until the image they belong to is unloaded (checked at most every UnloadedImagesCheckPeriod)
+    static constexpr std::chrono::nanoseconds UnloadedImagesCheckPeriod = std::chrono::milliseconds(100);
+    NativeSymbolResolver _nativeSymbolResolver;
+    ShardedCache<uintptr_t, FrameId> _nativeFrames;
+    std::atomic<std::int64_t> _nextUnloadedImagesCheck;
 
     // TODO: would it be needed to have a cache (moduleId + mdTypeDef) -> TypeDesc?
 };
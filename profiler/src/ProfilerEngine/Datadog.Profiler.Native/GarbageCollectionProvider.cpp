@@ -0,0 +1,191 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+#include "GarbageCollectionProvider.h"
+#include "IAppDomainStore.h"
+#include "IConfiguration.h"
+#include "IFrameStore.h"
+#include "IRuntimeIdStore.h"
+#include "OpSysTools.h"
+#include "RawGarbageCollectionSample.h"
+
+
+GarbageCollectionProvider::GarbageCollectionProvider(
+    ICorProfilerInfo4* pCorProfilerInfo,
+    IConfiguration* pConfiguration,
+    IFrameStore* pFrameStore,
+    IAppDomainStore* pAppDomainStore,
+    IRuntimeIdStore* pRuntimeIdStore,
+    SamplesTransformerPool* pTransformerPool
+    )
+    :
+    CollectorBase<RawGarbageCollectionSample>(pConfiguration, pFrameStore, pAppDomainStore, pRuntimeIdStore, pTransformerPool),
+    _pCorProfilerInfo{pCorProfilerInfo},
+    _isGarbageCollectionInProgress{false},
+    _suspensionStartTimestampNs{0},
+    _suspensionId{0},
+    _runningCollections{},
+    _runningCollectionsCount{0},
+    _finishedCollections{},
+    _finishedCollectionsCount{0},
+    _lastAppDomainId{0}
+{
+}
+
+const char* GarbageCollectionProvider::GetName()
+{
+    return _serviceName;
+}
+
+bool GarbageCollectionProvider::IsGarbageCollectionInProgress() const
+{
+    return _isGarbageCollectionInProgress.load(std::memory_order_relaxed);
+}
+
+void GarbageCollectionProvider::AddGarbageCollectorFrame(Sample& sample)
+{
+    sample.AddFrame("CLR", "|lm:CLR |ns:CLR |ct:CLR |fn:Garbage Collector");
+}
+
+const char* GarbageCollectionProvider::GetReasonName(COR_PRF_GC_REASON reason)
+{
+    // the profiling API only distinguishes GC.Collect() from the other reasons (mostly allocations)
+    return (reason == COR_PRF_GC_INDUCED) ? "Induced" : "Other";
+}
+
+void GarbageCollectionProvider::OnRuntimeSuspendStarted(COR_PRF_SUSPEND_REASON suspendReason)
+{
+    if ((suspendReason != COR_PRF_SUSPEND_FOR_GC) && (suspendReason != COR_PRF_SUSPEND_FOR_GC_PREP))
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_stateLock);
+    _suspensionStartTimestampNs = OpSysTools::GetHighPrecisionNanoseconds();
+    _suspensionId++;
+    _isGarbageCollectionInProgress.store(true, std::memory_order_relaxed);
+}
+
+void GarbageCollectionProvider::OnRuntimeSuspendAborted()
+{
+    std::lock_guard<std::mutex> lock(_stateLock);
+    _suspensionStartTimestampNs = 0;
+    _isGarbageCollectionInProgress.store(false, std::memory_order_relaxed);
+}
+
+void GarbageCollectionProvider::OnGarbageCollectionStarted(int cGenerations, BOOL generationCollected[], COR_PRF_GC_REASON reason)
+{
+    // LOH and POH are only collected with gen 2
+    std::int32_t generation = 0;
+    for (int i = 0; i < cGenerations; i++)
+    {
+        if (generationCollected[i])
+        {
+            generation = (std::min)(i, 2);
+        }
+    }
+
+    auto appDomainId = GetCurrentAppDomain();
+
+    std::lock_guard<std::mutex> lock(_stateLock);
+    if (_runningCollectionsCount == MaxNestedCollections)
+    {
+        return;
+    }
+
+    auto suspensionId = (_suspensionStartTimestampNs == 0) ? 0 : _suspensionId;
+    _runningCollections[_runningCollectionsCount++] = {generation, reason, OpSysTools::GetHighPrecisionNanoseconds(), 0, appDomainId, suspensionId};
+}
+
+void GarbageCollectionProvider::OnGarbageCollectionFinished()
+{
+    std::lock_guard<std::mutex> lock(_stateLock);
+    if (_runningCollectionsCount == 0)
+    {
+        return;
+    }
+
+    // nested collections end before the outer one
+    auto collection = _runningCollections[--_runningCollectionsCount];
+    collection.EndTimestampNs = OpSysTools::GetHighPrecisionNanoseconds();
+
+    if ((_suspensionStartTimestampNs == 0) || (collection.SuspensionId != _suspensionId))
+    {
+        // background collection: its own suspensions are not part of the application pause
+        // and the current suspension (if any) is caused by a foreground collection
+        AddSample(collection, 0);
+        return;
+    }
+
+    if (_finishedCollectionsCount < MaxNestedCollections)
+    {
+        _finishedCollections[_finishedCollectionsCount++] = collection;
+    }
+}
+
+void GarbageCollectionProvider::OnRuntimeResumeFinished()
+{
+    std::lock_guard<std::mutex> lock(_stateLock);
+    if (_suspensionStartTimestampNs == 0)
+    {
+        return;
+    }
+
+    auto pauseDuration = static_cast<std::uint64_t>(OpSysTools::GetHighPrecisionNanoseconds() - _suspensionStartTimestampNs);
+    _suspensionStartTimestampNs = 0;
+    _isGarbageCollectionInProgress.store(false, std::memory_order_relaxed);
+
+    for (std::size_t i = 0; i < _finishedCollectionsCount; i++)
+    {
+        AddSample(_finishedCollections[i], pauseDuration);
+    }
+    _finishedCollectionsCount = 0;
+}
+
+AppDomainID GarbageCollectionProvider::GetCurrentAppDomain()
+{
+    ThreadID threadId;
+    AppDomainID appDomainId;
+    if (SUCCEEDED(_pCorProfilerInfo->GetCurrentThreadID(&threadId)) &&
+        SUCCEEDED(_pCorProfilerInfo->GetThreadAppDomain(threadId, &appDomainId)))
+    {
+        _lastAppDomainId.store(appDomainId, std::memory_order_relaxed);
+        return appDomainId;
+    }
+
+    return _lastAppDomainId.load(std::memory_order_relaxed);
+}
+
+// must be called under _stateLock: the raw samples queue accepts only one producer at a time
+void GarbageCollectionProvider::AddSample(const GarbageCollectionInfo& collection, std::uint64_t pauseDuration)
+{
+    // convert the end of the collection from the high precision clock to unix time
+    auto now = OpSysTools::GetHighPrecisionNanoseconds();
+    auto unixNow = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+    RawGarbageCollectionSample rawSample;
+    rawSample.EndTimestampNs = unixNow - (now - collection.EndTimestampNs);
+    rawSample.Timestamp = static_cast<std::uint64_t>(rawSample.EndTimestampNs / 1000000000);
+    rawSample.AppDomainId = collection.AppDomainId;
+    rawSample.Generation = collection.Generation;
+    rawSample.Reason = collection.Reason;
+    rawSample.Duration = static_cast<std::uint64_t>(collection.EndTimestampNs - collection.StartTimestampNs);
+    rawSample.PauseDuration = pauseDuration;
+
+    Add(std::move(rawSample));
+}
+
+void GarbageCollectionProvider::OnTransformRawSample(const RawGarbageCollectionSample& rawSample, Sample& sample)
+{
+    AddGarbageCollectorFrame(sample);
+
+    sample.AddValue(rawSample.Duration, SampleValue::GarbageCollectionDuration);
+    sample.AddLabel(Label{Sample::GarbageCollectionGenerationLabel, "gen " + std::to_string(rawSample.Generation)});
+    sample.AddLabel(Label{Sample::GarbageCollectionReasonLabel, GetReasonName(rawSample.Reason)});
+    sample.AddNumericLabel(NumericLabel{Sample::GarbageCollectionPauseDurationLabel, static_cast<std::int64_t>(rawSample.PauseDuration), "nanoseconds"});
+    sample.AddNumericLabel(NumericLabel{Sample::EndTimestampLabel, rawSample.EndTimestampNs, ""});
+}
@@ -0,0 +1,103 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include "cor.h"
+#include "corprof.h"
+
+#include "CollectorBase.h"
+#include "RawGarbageCollectionSample.h"
+
+// forward declarations
+class IConfiguration;
+class IFrameStore;
+class IAppDomainStore;
+class IRuntimeIdStore;
+
+
+// Each garbage collection is recorded with its generation, reason, duration and the duration of the
+// runtime suspension (if any) and becomes a timeline sample whose callstack is a synthetic
+// "Garbage Collector" frame. The raw samples are kept in the fixed-size ring of CollectorBase
+// until they are transformed so the GC callbacks never allocate nor wait for the pipeline.
+//
+// The collections are received with COR_PRF_HIGH_BASIC_GC (concurrent GC stays enabled) and can be
+// nested (a foreground collection during a background one): the end of a blocking collection is
+// known when the runtime resumes. Only the collections that started during a suspension are given
+// its pause duration: a background collection that finishes during the suspension of a foreground
+// one did not cause it.
+class GarbageCollectionProvider
+    : public CollectorBase<RawGarbageCollectionSample> // accepts raw garbage collection samples
+{
+public:
+    GarbageCollectionProvider(
+        ICorProfilerInfo4* pCorProfilerInfo,
+        IConfiguration* pConfiguration,
+        IFrameStore* pFrameStore,
+        IAppDomainStore* pAppDomainStore,
+        IRuntimeIdStore* pRuntimeIdStore,
+        SamplesTransformerPool* pTransformerPool = nullptr
+        );
+
+    // called by the CLR
+    void OnRuntimeSuspendStarted(COR_PRF_SUSPEND_REASON suspendReason);
+    void OnRuntimeSuspendAborted();
+    void OnRuntimeResumeFinished();
+    void OnGarbageCollectionStarted(int cGenerations, BOOL generationCollected[], COR_PRF_GC_REASON reason);
+    void OnGarbageCollectionFinished();
+
+    // true while the runtime is suspended for a garbage collection: the managed threads are not
+    // running application code and their wall time should be attributed to the garbage collector
+    bool IsGarbageCollectionInProgress() const;
+
+    // add the synthetic frame to which the time spent in garbage collections is attributed
+    static void AddGarbageCollectorFrame(Sample& sample);
+
+    static const char* GetReasonName(COR_PRF_GC_REASON reason);
+
+// interfaces implementation
+public:
+    const char* GetName() override;
+
+private:
+    struct GarbageCollectionInfo
+    {
+        std::int32_t Generation;
+        COR_PRF_GC_REASON Reason;
+        std::int64_t StartTimestampNs;
+        std::int64_t EndTimestampNs;
+        AppDomainID AppDomainId;
+        std::uint64_t SuspensionId; // 0 if the collection did not start while the runtime was suspended
+    };
+
+    // a foreground collection can happen during a background collection
+    static const std::size_t MaxNestedCollections = 2;
+
+private:
+    virtual void OnTransformRawSample(const RawGarbageCollectionSample& rawSample, Sample& sample) override;
+
+    AppDomainID GetCurrentAppDomain();
+    void AddSample(const GarbageCollectionInfo& collection, std::uint64_t pauseDuration);
+
+private:
+    const char* _serviceName = "GarbageCollectionProvider";
+
+    ICorProfilerInfo4* _pCorProfilerInfo;
+
+    std::atomic<bool> _isGarbageCollectionInProgress;
+
+    // GC callbacks are received from different threads (i.e. background GC)
+    std::mutex _stateLock;
+    std::int64_t _suspensionStartTimestampNs;
+    std::uint64_t _suspensionId; // of the current (or last) suspension
+    GarbageCollectionInfo _runningCollections[MaxNestedCollections];
+    std::size_t _runningCollectionsCount;
+    // collections finished while the runtime is suspended: sampled when it resumes
+    GarbageCollectionInfo _finishedCollections[MaxNestedCollections];
+    std::size_t _finishedCollectionsCount;
+    // background GC threads are not managed: use the last known AppDomain
+    std::atomic<AppDomainID> _lastAppDomainId;
+};
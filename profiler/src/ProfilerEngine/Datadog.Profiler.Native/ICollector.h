@@ -2,6 +2,8 @@
 // This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
 
 #pragma once
+#include <cstddef>
+#include <cstdint>
 
 
 template <class TRawSample>
@@ -12,4 +14,9 @@ public:
 
 public:
     virtual void Add(TRawSample&& rawSample) = 0;
+
+    // Same as Add() but the frames are given separately (the Stack of the raw sample is not used)
+    // so that the same instruction pointers can be added to several collectors without copying
+    // them into a vector per raw sample
+    virtual void Add(TRawSample&& rawSample, std::uintptr_t const* pFrames, std::size_t framesCount) = 0;
 };
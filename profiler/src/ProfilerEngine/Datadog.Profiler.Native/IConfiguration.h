@@ -20,6 +20,13 @@ public:
     virtual bool IsDebugLogEnabled() const = 0;
     virtual fs::path const& GetLogDirectory() const = 0;
     virtual fs::path const& GetProfilesOutputDirectory() const = 0;
+    // where the profiles that could not be uploaded are kept (empty = no spool)
+    virtual fs::path const& GetSpoolDirectory() const = 0;
+    virtual std::uint64_t GetSpoolMaxSizePerService() const = 0;
+    // number of threads shared by the providers to transform their raw samples
+    virtual std::size_t GetTransformerThreadsCount() const = 0;
+    // number of raw samples that each provider can queue before they are transformed
+    virtual std::size_t GetRawSamplesCapacity() const = 0;
     virtual bool IsNativeFramesEnabled() const = 0;
     virtual bool IsOperationalMetricsEnabled() const = 0;
     virtual std::chrono::seconds GetUploadInterval() const = 0;
@@ -35,6 +42,13 @@ public:
     virtual std::string const& GetServiceName() const = 0;
     virtual tags const& GetUserTags() const = 0;
     virtual bool IsCpuProfilingEnabled() const = 0;
+    virtual bool IsCpuTimerSamplingEnabled() const = 0;
+    // percent of one core that the stack sampling should not exceed (0 = fixed sampling period)
+    virtual double GetSamplingOverheadBudget() const = 0;
+    virtual bool IsAllocationProfilingEnabled() const = 0;
+    virtual bool IsContentionProfilingEnabled() const = 0;
+    virtual bool IsExceptionProfilingEnabled() const = 0;
+    virtual bool IsGarbageCollectionProfilingEnabled() const = 0;
 
     // feature flags
     virtual bool IsFFLibddprofEnabled() const = 0;
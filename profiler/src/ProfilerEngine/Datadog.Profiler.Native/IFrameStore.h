@@ -3,9 +3,12 @@
 
 #pragma once
 #include <string>
+#include <tuple>
 #include "cor.h"
 #include "corprof.h"
 
+#include "FrameId.h"
+
 
 class IFrameStore
 {
@@ -14,7 +17,13 @@ public:
 
     // return
     //  - true if managed frame
-    //  - module name
-    //  - frame text
-    virtual std::tuple<bool, std::string, std::string> GetFrame(uintptr_t instructionPointer) = 0;
+    //  - interned module name and frame text
+    virtual std::tuple<bool, FrameId> GetFrame(uintptr_t instructionPointer) = 0;
+
+    // return false if the name (including namespace) of the given type could not be computed
+    virtual bool GetTypeName(ClassID classId, std::string& name) = 0;
+
+    // called when the CLR unloads a module (i.e. collectible assemblies)
+    // so that the corresponding cached methods and types could be removed
+    virtual void OnModuleUnloaded(ModuleID moduleId) = 0;
 };
@@ -18,6 +18,7 @@ public:
     virtual bool SetThreadName(ThreadID clrThreadId, shared::WSTRING* pThreadName) = 0;
     virtual std::uint32_t Count() const = 0;
     virtual ManagedThreadInfo* LoopNext() = 0;
+    virtual ManagedThreadInfo* GetThreadInfo(ThreadID clrThreadId) = 0;
     virtual bool TryGetThreadInfo(const std::uint32_t profilerThreadInfoId,
                           ThreadID* pClrThreadId,
                           DWORD* pOsThreadId,
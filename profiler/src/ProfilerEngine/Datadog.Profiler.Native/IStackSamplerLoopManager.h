@@ -2,6 +2,9 @@
 // This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
 
 #pragma once
+
+#include <chrono>
+
 #include "IService.h"
 #include "ManagedThreadInfo.h"
 
@@ -14,4 +17,9 @@ public:
     virtual void NotifyCollectionStart() = 0;
     virtual void NotifyCollectionEnd() = 0;
     virtual void NotifyIterationFinished() = 0;
+    virtual bool AllowStackWalkInBatch(ManagedThreadInfo* pThreadInfo) = 0;
+    virtual void NotifyBatchIterationFinished(ManagedThreadInfo* const* ppThreadInfos, std::uint32_t count) = 0;
+    virtual void OnThreadAssignedToOsThread(ManagedThreadInfo* pThreadInfo) = 0;
+    virtual void OnThreadDestroyed(ManagedThreadInfo* pThreadInfo) = 0;
+    virtual std::chrono::nanoseconds GetAndResetCollectionTime() = 0;
 };
@@ -0,0 +1,66 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+
+// Counts the handlers (i.e. signal handlers) that are using data published through an atomic pointer
+// so that this data is not freed while one of them is still running.
+//
+// A handler must call Enter() BEFORE loading the published pointer and Leave() once it does not use it anymore.
+// The owner must first unpublish the pointer (i.e. store nullptr) and then call WaitForAll() before freeing
+// the data: a handler that enters after the pointer has been unpublished can only see nullptr.
+// The wait is bounded: if a handler is stuck, the data must be leaked instead of being freed.
+//
+// Enter() and Leave() are lock-free and async-signal-safe.
+//
+class InFlightHandlers
+{
+public:
+    InFlightHandlers() = default;
+
+    InFlightHandlers(const InFlightHandlers&) = delete;
+    InFlightHandlers& operator=(const InFlightHandlers&) = delete;
+
+    inline void Enter()
+    {
+        // seq_cst: the increment must be visible before the published pointer is loaded
+        _count.fetch_add(1);
+    }
+
+    inline void Leave()
+    {
+        _count.fetch_sub(1, std::memory_order_release);
+    }
+
+    // returns false if some handlers are still running after the timeout
+    inline bool WaitForAll(std::chrono::nanoseconds timeout) const
+    {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+        // seq_cst: the count must be read after the pointer has been unpublished
+        while (_count.load() != 0)
+        {
+            if (std::chrono::steady_clock::now() >= deadline)
+            {
+                return false;
+            }
+
+            std::this_thread::yield();
+        }
+
+        return true;
+    }
+
+    inline std::int32_t GetCount() const
+    {
+        return _count.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<std::int32_t> _count{0};
+};
@@ -8,15 +8,20 @@
 #include "IMetricsSender.h"
 #include "Log.h"
 #include "OpSysTools.h"
+#include "ProfileSpool.h"
+#include "ProfileUploadQueue.h"
 #include "Sample.h"
 #include "dd_profiler_version.h"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <fstream>
-#include <iomanip>
+#include <ctime>
 #include <iostream>
 #include <string.h>
 #include <time.h>
+#include <utility>
 
 #include "shared/src/native-src/dd_filesystem.hpp"
 // namespace fs is an alias defined in "dd_filesystem.hpp"
@@ -46,24 +51,21 @@ std::string const LibddprofExporter::ProfilePeriodType = "RealTime";
 
 std::string const LibddprofExporter::ProfilePeriodUnit = "Nanoseconds";
 
-LibddprofExporter::LibddprofExporter(IConfiguration* configuration, IApplicationStore* applicationStore) :
-    _locationsAndLinesSize{512},
-    _applicationStore{applicationStore}
+// "DDP1": version 1 of the spooled profile format
+std::uint32_t const LibddprofExporter::SpoolRecordMagic = 0x44445031;
+
+LibddprofExporter::LibddprofExporter(IConfiguration* configuration, IApplicationStore* applicationStore, ProfileUploadQueue* uploadQueue, ProfileSpool* spool) :
+    _applicationStore{applicationStore},
+    _uploadQueue{uploadQueue},
+    _spool{spool}
 {
     _exporterBaseTags = CreateTags(configuration);
     _endpoint = CreateEndpoint(configuration);
     _pprofOutputPath = CreatePprofOutputPath(configuration);
-    _locations.resize(_locationsAndLinesSize);
-    _lines.resize(_locationsAndLinesSize);
 }
 
 LibddprofExporter::~LibddprofExporter()
 {
-    for (auto [runtimeId, profileAndSamplesCount] : _profilePerApplication)
-    {
-        auto* profile = profileAndSamplesCount.first;
-        ddprof_ffi_Profile_free(profile);
-    }
     _profilePerApplication.clear();
 }
 
@@ -82,27 +84,6 @@ ddprof_ffi_ProfileExporterV3* LibddprofExporter::CreateExporter(ddprof_ffi_Slice
     }
 }
 
-struct ddprof_ffi_Profile* LibddprofExporter::CreateProfile()
-{
-    std::vector<ddprof_ffi_ValueType> samplesTypes;
-    samplesTypes.reserve(sizeof(SampleTypeDefinitions) / sizeof(SampleTypeDefinitions[0]));
-
-    for (auto const& type : SampleTypeDefinitions)
-    {
-        samplesTypes.push_back(FfiHelper::CreateValueType(type.Name, type.Unit));
-    }
-
-    struct ddprof_ffi_Slice_value_type sample_types = {samplesTypes.data(), samplesTypes.size()};
-
-    auto period_value_type = FfiHelper::CreateValueType(ProfilePeriodType, ProfilePeriodUnit);
-
-    auto period = ddprof_ffi_Period{};
-    period.type_ = period_value_type;
-    period.value = 1;
-
-    return ddprof_ffi_Profile_new(sample_types, &period);
-}
-
 LibddprofExporter::Tags LibddprofExporter::CreateTags(IConfiguration* configuration)
 {
     auto tags = LibddprofExporter::Tags{};
@@ -157,137 +138,282 @@ ddprof_ffi_EndpointV3 LibddprofExporter::CreateEndpoint(IConfiguration* configur
     return ddprof_ffi_EndpointV3_agent(FfiHelper::StringToByteSlice(_agentUrl));
 }
 
-std::pair<ddprof_ffi_Profile*, std::int32_t>& LibddprofExporter::GetProfileAndSamplesCount(std::string_view runtimeId)
+LibddprofExporter::ApplicationProfile& LibddprofExporter::GetProfile(std::string_view runtimeId)
 {
-    auto& profileAndSamplesCount = _profilePerApplication[runtimeId];
-    if (profileAndSamplesCount.first != nullptr)
+    std::lock_guard<std::mutex> lock(_profilesLock);
+
+    auto& profile = _profilePerApplication[runtimeId];
+    if (profile == nullptr)
     {
-        return profileAndSamplesCount;
+        profile = std::make_unique<ApplicationProfile>();
+        profile->Builder = AcquireBuilder();
+        profile->StartTimeNs = GetCurrentTimeNs();
     }
 
-    profileAndSamplesCount.second = 0;
-    profileAndSamplesCount.first = CreateProfile();
+    // the entries are never removed from the map so the reference stays valid
+    return *profile;
+}
 
-    return profileAndSamplesCount;
+std::unique_ptr<PprofBuilder> LibddprofExporter::AcquireBuilder()
+{
+    {
+        std::lock_guard<std::mutex> lock(_spareBuildersLock);
+        if (!_spareBuilders.empty())
+        {
+            auto builder = std::move(_spareBuilders.back());
+            _spareBuilders.pop_back();
+            return builder;
+        }
+    }
+
+    return std::make_unique<PprofBuilder>(ProfilePeriodType, ProfilePeriodUnit);
+}
+
+void LibddprofExporter::ReleaseBuilder(std::unique_ptr<PprofBuilder> builder)
+{
+    std::lock_guard<std::mutex> lock(_spareBuildersLock);
+    _spareBuilders.push_back(std::move(builder));
 }
 
 void LibddprofExporter::Add(Sample const& sample)
 {
-    auto& profileAndSamplesCount = GetProfileAndSamplesCount(sample.GetRuntimeId());
+    auto& profile = GetProfile(sample.GetRuntimeId());
+
+    std::lock_guard<std::mutex> lock(profile.Lock);
+    profile.Builder->Add(sample);
+}
+
+bool LibddprofExporter::Export()
+{
+    std::vector<std::shared_ptr<SerializedProfile>> frozenProfiles;
+
+    {
+        std::lock_guard<std::mutex> lock(_profilesLock);
+
+        auto now = GetCurrentTimeNs();
+        int idx = 0;
+        for (auto& [runtimeId, profile] : _profilePerApplication)
+        {
+            // acquired outside of the application lock to keep the swap as short as possible
+            auto spareBuilder = AcquireBuilder();
+            std::unique_ptr<PprofBuilder> frozenBuilder;
+            std::int64_t startTimeNs;
+            {
+                std::lock_guard<std::mutex> profileLock(profile->Lock);
+                if (profile->Builder->GetSamplesCount() <= 0)
+                {
+                    ReleaseBuilder(std::move(spareBuilder));
+                    continue;
+                }
+
+                frozenBuilder = std::exchange(profile->Builder, std::move(spareBuilder));
+                startTimeNs = std::exchange(profile->StartTimeNs, now);
+            }
+
+            auto frozenProfile = std::make_shared<SerializedProfile>();
+            frozenProfile->RuntimeId = runtimeId;
+            frozenProfile->ApplicationName = _applicationStore->GetName(runtimeId);
+            frozenProfile->Index = idx++;
+            frozenProfile->TimeRange = {startTimeNs, now};
+            frozenProfile->Builder = std::move(frozenBuilder);
+            frozenProfiles.push_back(std::move(frozenProfile));
+        }
+    }
+
+    bool exported = true;
+    for (auto& frozenProfile : frozenProfiles)
+    {
+        if (_uploadQueue != nullptr)
+        {
+            // the serialization (and the spooling if the upload fails) happens in the upload queue thread
+            _uploadQueue->Enqueue(
+                [this, frozenProfile](std::optional<std::chrono::milliseconds> shutdownTimeout) { return SerializeAndUpload(*frozenProfile, shutdownTimeout); },
+                [this, frozenProfile]() { SpoolProfile(*frozenProfile); });
+        }
+        else if (!SerializeAndUpload(*frozenProfile))
+        {
+            SpoolProfile(*frozenProfile);
+            exported = false;
+        }
+    }
+    return exported;
+}
+
+bool LibddprofExporter::SerializeAndUpload(SerializedProfile& profile, std::optional<std::chrono::milliseconds> shutdownTimeout)
+{
+    Serialize(profile);
 
-    auto* profile = profileAndSamplesCount.first;
+    std::uint64_t timeoutMs = RequestTimeOutMs;
+    if (shutdownTimeout.has_value())
+    {
+        timeoutMs = (std::min)(timeoutMs, static_cast<std::uint64_t>(shutdownTimeout->count()));
+    }
 
-    auto const& callstack = sample.GetCallstack();
-    auto nbFrames = callstack.size();
+    if (!Upload(profile, timeoutMs))
+    {
+        return false;
+    }
 
-    if (nbFrames > _locationsAndLinesSize)
+    // the agent is reachable: it is time to upload the profiles that failed before
+    // (unless the process is exiting: they will be replayed by the next one)
+    if (!shutdownTimeout.has_value())
     {
-        _locationsAndLinesSize = nbFrames;
-        _locations.resize(_locationsAndLinesSize);
-        _lines.resize(_locationsAndLinesSize);
+        ReplaySpooledProfiles();
     }
+    return true;
+}
 
-    std::size_t idx = 0UL;
-    for (auto const& frame : callstack)
+void LibddprofExporter::Serialize(SerializedProfile& profile)
+{
+    // an upload could be retried: the profile is serialized only the first time
+    if (profile.Builder == nullptr)
     {
-        auto& line = _lines[idx];
-        auto& location = _locations[idx];
-
-        line = {};
-        line.function.filename = {};
-        line.function.start_line = 0;
-        line.function.name = FfiHelper::StringToCharSlice(frame.second);
-
-        // add filename mapping
-        location.mapping = {};
-        location.mapping.filename = FfiHelper::StringToCharSlice(frame.first);
-        location.address = 0; // TODO check if we can get that information in the provider
-        location.lines = {&line, 1};
-        location.is_folded = false;
-
-        ++idx;
+        return;
     }
 
-    auto ffiSample = ddprof_ffi_Sample{};
-    ffiSample.locations = {_locations.data(), nbFrames};
+    profile.Builder->Serialize(profile.Buffer, profile.TimeRange.first, profile.TimeRange.second);
+    ReleaseBuilder(std::move(profile.Builder));
 
-    // Labels
-    auto const& labels = sample.GetLabels();
-    std::vector<ddprof_ffi_Label> ffiLabels{labels.size()};
+    if (!_pprofOutputPath.empty())
+    {
+        ExportToDisk(profile);
+    }
+}
 
-    for (auto const& [label, value] : labels)
+void LibddprofExporter::SpoolProfile(SerializedProfile& profile)
+{
+    if (_spool == nullptr)
     {
-        ffiLabels.push_back({{label.data(), label.size()}, {value.data(), value.size()}});
+        return;
     }
-    ffiSample.labels = {ffiLabels.data(), ffiLabels.size()};
 
-    //values
-    auto const& values = sample.GetValues();
-    ffiSample.values = {values.data(), values.size()};
+    // the profiles given up by the upload queue (i.e. too many pending profiles or shutdown
+    // timeout expired) have never been uploaded, hence never serialized
+    Serialize(profile);
 
-    ddprof_ffi_Profile_add(profile, ffiSample);
-    profileAndSamplesCount.second++;
+    ToSpoolRecord(profile, _spoolRecord);
+    if (_spool->Write(profile.ApplicationName, _spoolRecord))
+    {
+        Log::Info("The profile of ", profile.ApplicationName, " is spooled until the agent is reachable again.");
+    }
 }
 
-bool LibddprofExporter::Export()
+void LibddprofExporter::ReplaySpooledProfiles()
 {
-    bool exported = false;
+    if (_spool == nullptr)
+    {
+        return;
+    }
 
-    int idx = 0;
-    for (auto& [runtimeId, profileAndSamplesCount] : _profilePerApplication)
+    SerializedProfile profile;
+    while (_spool->ReadOldest(_spoolRecord))
     {
-        auto samplesCount = profileAndSamplesCount.second;
-        if (samplesCount <= 0)
+        if (!FromSpoolRecord(_spoolRecord, profile))
         {
+            Log::Warn("Invalid spooled profile: it is discarded.");
+            _spool->RemoveOldest();
             continue;
         }
 
-        // reset the samples count
-        profileAndSamplesCount.second = 0;
+        // keep it (and the more recent ones) for the next successful upload
+        if (!Upload(profile))
+        {
+            return;
+        }
 
-        auto* profile = profileAndSamplesCount.first;
-        auto profileAutoReset = ProfileAutoReset{profile};
+        _spool->RemoveOldest();
+    }
+}
 
-        auto serializedProfile = SerializedProfile{profile};
-        if (!serializedProfile.IsValid())
+// A spool record is made of the following fields (native endianness):
+//    magic | start | end | runtime ID size | runtime ID | application name size | application name | pprof
+void LibddprofExporter::ToSpoolRecord(SerializedProfile const& profile, std::vector<std::uint8_t>& record)
+{
+    auto append = [&record](void const* data, std::size_t size) {
+        auto bytes = static_cast<std::uint8_t const*>(data);
+        record.insert(record.end(), bytes, bytes + size);
+    };
+    auto appendString = [&append](std::string const& value) {
+        auto size = static_cast<std::uint32_t>(value.size());
+        append(&size, sizeof(size));
+        append(value.data(), value.size());
+    };
+
+    record.clear();
+    append(&SpoolRecordMagic, sizeof(SpoolRecordMagic));
+    append(&profile.TimeRange.first, sizeof(profile.TimeRange.first));
+    append(&profile.TimeRange.second, sizeof(profile.TimeRange.second));
+    appendString(profile.RuntimeId);
+    appendString(profile.ApplicationName);
+    append(profile.Buffer.data(), profile.Buffer.size());
+}
+
+bool LibddprofExporter::FromSpoolRecord(std::vector<std::uint8_t> const& record, SerializedProfile& profile)
+{
+    std::size_t offset = 0;
+    auto read = [&record, &offset](void* data, std::size_t size) {
+        if (record.size() - offset < size)
         {
-            Log::Error("Unable to serialize the libddprof profile. No profile will be sent.");
             return false;
         }
-
-        const auto& applicationName = _applicationStore->GetName(runtimeId);
-        if (!_pprofOutputPath.empty())
+        memcpy(data, record.data() + offset, size);
+        offset += size;
+        return true;
+    };
+    auto readString = [&record, &offset, &read](std::string& value) {
+        std::uint32_t size = 0;
+        if (!read(&size, sizeof(size)) || (record.size() - offset < size))
         {
-            ExportToDisk(applicationName, serializedProfile, idx++);
+            return false;
         }
+        value.assign(reinterpret_cast<char const*>(record.data() + offset), size);
+        offset += size;
+        return true;
+    };
 
-        Tags exporterTagsCopy = _exporterBaseTags;
+    std::uint32_t magic = 0;
+    if (!read(&magic, sizeof(magic)) || (magic != SpoolRecordMagic) ||
+        !read(&profile.TimeRange.first, sizeof(profile.TimeRange.first)) ||
+        !read(&profile.TimeRange.second, sizeof(profile.TimeRange.second)) ||
+        !readString(profile.RuntimeId) ||
+        !readString(profile.ApplicationName))
+    {
+        return false;
+    }
 
-        exporterTagsCopy.Add("service", applicationName);
-        exporterTagsCopy.Add("runtime-id", std::string(runtimeId));
+    profile.Buffer.assign(record.begin() + offset, record.end());
+    return true;
+}
 
-        auto* exporter = CreateExporter(exporterTagsCopy.GetFfiTags(), _endpoint);
+bool LibddprofExporter::Upload(SerializedProfile const& profile, std::uint64_t timeoutMs) const
+{
+    Tags exporterTagsCopy = _exporterBaseTags;
 
-        if (exporter == nullptr)
-        {
-            Log::Error("Unable to create exporter for application ", runtimeId);
-            return false;
-        }
+    exporterTagsCopy.Add("service", profile.ApplicationName);
+    exporterTagsCopy.Add("runtime-id", profile.RuntimeId);
 
-        auto* request = CreateRequest(serializedProfile, exporter);
+    auto* exporter = CreateExporter(exporterTagsCopy.GetFfiTags(), _endpoint);
 
-        if (request != nullptr)
-        {
-            exported &= Send(request, exporter);
-        }
-        else
-        {
-            exported = false;
-            Log::Error("Unable to create a request to send the profile.");
-        }
-        ddprof_ffi_ProfileExporterV3_delete(exporter);
+    if (exporter == nullptr)
+    {
+        Log::Error("Unable to create exporter for application ", profile.RuntimeId);
+        return false;
     }
-    return exported;
+
+    bool sent = false;
+    auto* request = CreateRequest(profile, exporter, timeoutMs);
+
+    if (request != nullptr)
+    {
+        sent = Send(request, exporter);
+    }
+    else
+    {
+        Log::Error("Unable to create a request to send the profile.");
+    }
+    ddprof_ffi_ProfileExporterV3_delete(exporter);
+
+    return sent;
 }
 
 std::string LibddprofExporter::GeneratePprofFilePath(const std::string& applicationName, int idx) const
@@ -301,25 +427,26 @@ std::string LibddprofExporter::GeneratePprofFilePath(const std::string& applicat
     localtime_r(&time, &buf);
 #endif
 
-    std::stringstream oss;
-    oss << applicationName + "_" << ProcessId << "_" << std::put_time(&buf, "%F_%H-%M-%S") << "_" << idx
-        << ".pprof";
-    auto pprofFilename = oss.str();
+    char timestamp[32];
+    std::strftime(timestamp, sizeof(timestamp), "%F_%H-%M-%S", &buf);
+
+    std::string pprofFilename;
+    pprofFilename.reserve(applicationName.size() + ProcessId.size() + sizeof(timestamp) + 16);
+    pprofFilename.append(applicationName).append("_").append(ProcessId).append("_");
+    pprofFilename.append(timestamp).append("_").append(std::to_string(idx)).append(".pprof");
 
     auto pprofFilePath = fs::path(_pprofOutputPath) / pprofFilename;
 
     return pprofFilePath.string();
 }
 
-void LibddprofExporter::ExportToDisk(const std::string& applicationName, SerializedProfile const& encodedProfile, int idx)
+void LibddprofExporter::ExportToDisk(SerializedProfile const& profile)
 {
-    auto pprofFilePath = GeneratePprofFilePath(applicationName, idx);
+    auto pprofFilePath = GeneratePprofFilePath(profile.ApplicationName, profile.Index);
 
     std::ofstream file{pprofFilePath, std::ios::out | std::ios::binary};
 
-    auto buffer = encodedProfile.GetBuffer();
-
-    file.write((char const*)buffer.ptr, buffer.len);
+    file.write((char const*)profile.Buffer.data(), profile.Buffer.size());
     file.close();
 
     if (file.fail())
@@ -339,11 +466,29 @@ void LibddprofExporter::ExportToDisk(const std::string& applicationName, Seriali
     }
 }
 
-ddprof_ffi_Request* LibddprofExporter::CreateRequest(SerializedProfile const& encodedProfile, ddprof_ffi_ProfileExporterV3* exporter) const
+ddprof_ffi_Timespec LibddprofExporter::ToTimespec(std::int64_t timestampNs)
 {
-    auto start = encodedProfile.GetStart();
-    auto end = encodedProfile.GetEnd();
-    auto buffer = encodedProfile.GetBuffer();
+    ddprof_ffi_Timespec timespec;
+    timespec.seconds = timestampNs / 1000000000;
+    timespec.nanoseconds = static_cast<std::uint32_t>(timestampNs % 1000000000);
+    return timespec;
+}
+
+std::int64_t LibddprofExporter::GetCurrentTimeNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+ddprof_ffi_Request* LibddprofExporter::CreateRequest(SerializedProfile const& profile, ddprof_ffi_ProfileExporterV3* exporter, std::uint64_t timeoutMs)
+{
+    auto start = ToTimespec(profile.TimeRange.first);
+    auto end = ToTimespec(profile.TimeRange.second);
+
+    // the serialized profile is only borrowed: libddprof copies it into the request
+    ddprof_ffi_Buffer buffer;
+    buffer.ptr = profile.Buffer.data();
+    buffer.len = profile.Buffer.size();
+    buffer.capacity = profile.Buffer.capacity();
 
     ddprof_ffi_File file{FfiHelper::StringToByteSlice(RequestFileName), &buffer};
 
@@ -352,7 +497,7 @@ ddprof_ffi_Request* LibddprofExporter::CreateRequest(SerializedProfile const& en
         &file, 1
     };
 
-    return ddprof_ffi_ProfileExporterV3_build(exporter, start, end, files, RequestTimeOutMs);
+    return ddprof_ffi_ProfileExporterV3_build(exporter, start, end, files, timeoutMs);
 }
 
 bool LibddprofExporter::Send(ddprof_ffi_Request* request, ddprof_ffi_ProfileExporterV3* exporter) const
@@ -397,39 +542,6 @@ fs::path LibddprofExporter::CreatePprofOutputPath(IConfiguration* configuration)
     return {};
 }
 
-//
-// LibddprofExporter::SerializedProfile class
-//
-LibddprofExporter::SerializedProfile::SerializedProfile(ddprof_ffi_Profile* profile) :
-    _encodedProfile{ddprof_ffi_Profile_serialize(profile)}
-{
-}
-
-bool LibddprofExporter::SerializedProfile::IsValid() const
-{
-    return _encodedProfile != nullptr;
-}
-
-LibddprofExporter::SerializedProfile::~SerializedProfile()
-{
-    ddprof_ffi_EncodedProfile_delete(_encodedProfile);
-}
-
-ddprof_ffi_Buffer LibddprofExporter::SerializedProfile::GetBuffer() const
-{
-    return _encodedProfile->buffer;
-}
-
-ddprof_ffi_Timespec LibddprofExporter::SerializedProfile::GetStart() const
-{
-    return _encodedProfile->start;
-}
-
-ddprof_ffi_Timespec LibddprofExporter::SerializedProfile::GetEnd() const
-{
-    return _encodedProfile->end;
-}
-
 //
 // LibddprofExporter::Tags class
 //
@@ -450,17 +562,3 @@ ddprof_ffi_Slice_tag LibddprofExporter::Tags::GetFfiTags() const
 {
     return {_ffiTags.data(), _ffiTags.size()};
 }
-
-//
-// LibddprofExporter::Profile class
-//
-
-LibddprofExporter::ProfileAutoReset::ProfileAutoReset(struct ddprof_ffi_Profile* profile) :
-    _profile{profile}
-{
-}
-
-LibddprofExporter::ProfileAutoReset::~ProfileAutoReset()
-{
-    ddprof_ffi_Profile_reset(_profile);
-}
\ No newline at end of file
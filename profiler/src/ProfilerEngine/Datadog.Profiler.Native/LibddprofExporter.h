@@ -4,6 +4,7 @@
 #pragma once
 #include "IConfiguration.h"
 #include "IExporter.h"
+#include "PprofBuilder.h"
 #include "TagsHelper.h"
 
 extern "C"
@@ -11,8 +12,11 @@ extern "C"
 #include "ddprof/ffi.h"
 }
 
+#include <chrono>
 #include <forward_list>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string_view>
 #include <unordered_map>
 #include <vector>
@@ -20,32 +24,42 @@ extern "C"
 class Sample;
 class IMetricsSender;
 class IApplicationStore;
+class ProfileSpool;
+class ProfileUploadQueue;
 
+// The samples of each application (i.e. runtime ID) are added to an active profile while the
+// profile of the previous period is serialized and uploaded: at the end of a period, Export()
+// only swaps the active profile with a spare one under a per-application lock, so Add() can be
+// called from another thread without waiting for the serialization.
 class LibddprofExporter : public IExporter
 {
 public:
-    LibddprofExporter(IConfiguration* configuration, IApplicationStore* applicationStore);
+    // without upload queue, the profiles are uploaded synchronously by Export()
+    // without spool, the profiles that could not be uploaded are lost
+    LibddprofExporter(IConfiguration* configuration, IApplicationStore* applicationStore, ProfileUploadQueue* uploadQueue = nullptr, ProfileSpool* spool = nullptr);
     ~LibddprofExporter() override;
     bool Export() override;
     void Add(Sample const& sample) override;
 
-private:
-    class SerializedProfile
+protected:
+    // everything needed to serialize and upload a frozen profile from the upload queue thread
+    struct SerializedProfile
     {
-    public:
-        SerializedProfile(struct ddprof_ffi_Profile* profile);
-        ~SerializedProfile();
-
-        ddprof_ffi_Buffer GetBuffer() const;
-        ddprof_ffi_Timespec GetStart() const;
-        ddprof_ffi_Timespec GetEnd() const;
+        std::string RuntimeId;
+        std::string ApplicationName;
+        int Index;
+        std::pair<std::int64_t, std::int64_t> TimeRange;
+        // released (i.e. given back to the spare builders) once serialized into Buffer
+        std::unique_ptr<PprofBuilder> Builder;
+        std::vector<std::uint8_t> Buffer;
+    };
 
-        bool IsValid() const;
+    // sends the serialized profile to the agent (or the intake in agentless mode); returns false if it could not be uploaded
+    virtual bool Upload(SerializedProfile const& profile, std::uint64_t timeoutMs = RequestTimeOutMs) const;
 
-    private:
-        struct ddprof_ffi_EncodedProfile* _encodedProfile;
-    };
+    static int const RequestTimeOutMs;
 
+private:
     class Tags
     {
     public:
@@ -58,34 +72,40 @@ private:
         std::vector<ddprof_ffi_Tag> _ffiTags;
     };
 
-    class ProfileAutoReset
+    // the active profile of an application
+    struct ApplicationProfile
     {
-    public:
-        ProfileAutoReset(struct ddprof_ffi_Profile* profile);
-        ~ProfileAutoReset();
-
-    private:
-        struct ddprof_ffi_Profile* _profile;
+        std::mutex Lock;
+        std::unique_ptr<PprofBuilder> Builder;
+        std::int64_t StartTimeNs;
     };
 
     static Tags CreateTags(IConfiguration* configuration);
     static ddprof_ffi_ProfileExporterV3* CreateExporter(ddprof_ffi_Slice_tag tags, ddprof_ffi_EndpointV3 endpoint);
-    static ddprof_ffi_Profile* CreateProfile();
+    static ddprof_ffi_Timespec ToTimespec(std::int64_t timestampNs);
+    static std::int64_t GetCurrentTimeNs();
 
-    ddprof_ffi_Request* CreateRequest(SerializedProfile const& encodedProfile, ddprof_ffi_ProfileExporterV3* exporter) const;
+    static ddprof_ffi_Request* CreateRequest(SerializedProfile const& profile, ddprof_ffi_ProfileExporterV3* exporter, std::uint64_t timeoutMs);
     ddprof_ffi_EndpointV3 CreateEndpoint(IConfiguration* configuration);
-    std::pair<ddprof_ffi_Profile*, std::int32_t>& GetProfileAndSamplesCount(std::string_view runtimeId);
-
-
-    void ExportToDisk(const std::string& applicationName, SerializedProfile const& encodedProfile, int idx);
-
+    ApplicationProfile& GetProfile(std::string_view runtimeId);
+    std::unique_ptr<PprofBuilder> AcquireBuilder();
+    void ReleaseBuilder(std::unique_ptr<PprofBuilder> builder);
+
+    void ExportToDisk(SerializedProfile const& profile);
+
+    void Serialize(SerializedProfile& profile);
+    // the shutdown timeout is only set when the upload queue is stopping
+    bool SerializeAndUpload(SerializedProfile& profile, std::optional<std::chrono::milliseconds> shutdownTimeout = std::nullopt);
+    void SpoolProfile(SerializedProfile& profile);
+    void ReplaySpooledProfiles();
+    static void ToSpoolRecord(SerializedProfile const& profile, std::vector<std::uint8_t>& record);
+    static bool FromSpoolRecord(std::vector<std::uint8_t> const& record, SerializedProfile& profile);
     bool Send(ddprof_ffi_Request* request, ddprof_ffi_ProfileExporterV3* exporter) const;
     std::string GeneratePprofFilePath(const std::string& applicationName, int idx) const;
     fs::path CreatePprofOutputPath(IConfiguration* configuration) const;
 
     static tags CommonTags;
     static std::string const ProcessId;
-    static int const RequestTimeOutMs;
     static std::string const LanguageFamily;
 
     // TODO: this should be passed in the constructor to avoid overwriting
@@ -93,15 +113,22 @@ private:
     static std::string const RequestFileName;
     static std::string const ProfilePeriodType;
     static std::string const ProfilePeriodUnit;
+    static std::uint32_t const SpoolRecordMagic;
 
     fs::path _pprofOutputPath;
 
-    std::vector<ddprof_ffi_Location> _locations;
-    std::vector<ddprof_ffi_Line> _lines;
     std::string _agentUrl;
-    std::size_t _locationsAndLinesSize;
-    std::unordered_map<std::string_view, std::pair<ddprof_ffi_Profile*, std::int32_t>> _profilePerApplication;
+    // the samples are encoded in pprof as they are added (no FFI call per sample)
+    std::mutex _profilesLock;
+    std::unordered_map<std::string_view, std::unique_ptr<ApplicationProfile>> _profilePerApplication;
+    // builders of serialized profiles, kept to reuse their buffers
+    std::mutex _spareBuildersLock;
+    std::vector<std::unique_ptr<PprofBuilder>> _spareBuilders;
     ddprof_ffi_EndpointV3 _endpoint;
     Tags _exporterBaseTags;
     IApplicationStore* const _applicationStore;
+    ProfileUploadQueue* const _uploadQueue;
+    // only used by the thread uploading the profiles
+    ProfileSpool* const _spool;
+    std::vector<std::uint8_t> _spoolRecord;
 };
\ No newline at end of file
@@ -41,8 +41,27 @@ ManagedThreadInfo::ManagedThreadInfo(ThreadID clrThreadId, DWORD osThreadId, HAN
     _stackWalkLock(1),
     _isThreadDestroyed{false},
     _traceContextTrackingInfo{},
-    _cpuConsumptionMilliseconds{0}
+    _cpuConsumptionNanoseconds{0},
+    _lastObservedCpuTimeNanoseconds{0}
 {
+#ifndef _WINDOWS
+    _cpuClockId = OpSysTools::GetThreadCpuClockId(static_cast<pid_t>(osThreadId));
+#endif
+}
+
+bool ManagedThreadInfo::GetCpuTime(std::uint64_t& cpuTimeNanoseconds) const
+{
+    if (_osThreadId == 0)
+    {
+        // not yet assigned to an OS thread
+        return false;
+    }
+
+#ifdef _WINDOWS
+    return OpSysTools::GetThreadCpuTime(_osThreadHandle, cpuTimeNanoseconds);
+#else
+    return OpSysTools::GetThreadCpuTime(_cpuClockId, static_cast<pid_t>(_osThreadId), cpuTimeNanoseconds);
+#endif
 }
 
 ManagedThreadInfo::~ManagedThreadInfo()
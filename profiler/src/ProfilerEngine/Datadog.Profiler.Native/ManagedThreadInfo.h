@@ -8,6 +8,7 @@
 #include "cor.h"
 #include "corprof.h"
 
+#include "OpSysTools.h"
 #include "RefCountingObject.h"
 #include "ResolvedSymbolsCache.h"
 #include "Semaphore.h"
@@ -48,8 +49,10 @@ public:
 
     inline std::uint64_t GetLastSampleHighPrecisionTimestampNanoseconds(void) const;
     inline std::uint64_t SetLastSampleHighPrecisionTimestampNanoseconds(std::uint64_t value);
-    inline std::uint64_t GetCpuConsumptionMilliseconds(void) const;
-    inline std::uint64_t SetCpuConsumptionMilliseconds(std::uint64_t value);
+    inline std::uint64_t GetCpuConsumptionNanoseconds(void) const;
+    inline std::uint64_t SetCpuConsumptionNanoseconds(std::uint64_t value);
+    bool GetCpuTime(std::uint64_t& cpuTimeNanoseconds) const;
+    inline std::uint64_t SetLastObservedCpuTimeNanoseconds(std::uint64_t value);
 
     inline void GetLastKnownSampleUnixTimestamp(std::uint64_t* realUnixTimeUtc, std::int64_t* highPrecisionNanosecsAtLastUnixTimeUpdate) const;
     inline void SetLastKnownSampleUnixTimestamp(std::uint64_t realUnixTimeUtc, std::int64_t highPrecisionNanosecsAtThisUnixTimeUpdate);
@@ -88,7 +91,12 @@ private:
     shared::WSTRING* _pThreadName;
 
     std::uint64_t _lastSampleHighPrecisionTimestampNanoseconds;
-    std::uint64_t _cpuConsumptionMilliseconds;
+    std::uint64_t _cpuConsumptionNanoseconds;
+    std::uint64_t _lastObservedCpuTimeNanoseconds; // used by the sampler to skip threads parked in a wait
+#ifndef _WINDOWS
+    // computed once the OS thread id is known
+    clockid_t _cpuClockId;
+#endif
     std::uint64_t _lastKnownSampleUnixTimeUtc;
     std::int64_t _highPrecisionNanosecsAtLastUnixTimeUpdate;
 
@@ -130,6 +138,9 @@ inline void ManagedThreadInfo::SetOsInfo(DWORD osThreadId, HANDLE osThreadHandle
 {
     _osThreadId = osThreadId;
     _osThreadHandle = osThreadHandle;
+#ifndef _WINDOWS
+    _cpuClockId = OpSysTools::GetThreadCpuClockId(static_cast<pid_t>(osThreadId));
+#endif
 }
 
 inline const shared::WSTRING& ManagedThreadInfo::GetThreadName(void) const
@@ -165,15 +176,22 @@ inline std::uint64_t ManagedThreadInfo::SetLastSampleHighPrecisionTimestampNanos
     return prevValue;
 }
 
-inline std::uint64_t ManagedThreadInfo::GetCpuConsumptionMilliseconds(void) const
+inline std::uint64_t ManagedThreadInfo::GetCpuConsumptionNanoseconds(void) const
 {
-    return _cpuConsumptionMilliseconds;
+    return _cpuConsumptionNanoseconds;
 }
 
-inline std::uint64_t ManagedThreadInfo::SetCpuConsumptionMilliseconds(std::uint64_t value)
+inline std::uint64_t ManagedThreadInfo::SetCpuConsumptionNanoseconds(std::uint64_t value)
 {
-    std::uint64_t prevValue = _cpuConsumptionMilliseconds;
-    _cpuConsumptionMilliseconds = value;
+    std::uint64_t prevValue = _cpuConsumptionNanoseconds;
+    _cpuConsumptionNanoseconds = value;
+    return prevValue;
+}
+
+inline std::uint64_t ManagedThreadInfo::SetLastObservedCpuTimeNanoseconds(std::uint64_t value)
+{
+    std::uint64_t prevValue = _lastObservedCpuTimeNanoseconds;
+    _lastObservedCpuTimeNanoseconds = value;
     return prevValue;
 }
 
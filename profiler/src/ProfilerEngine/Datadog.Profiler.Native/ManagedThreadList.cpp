@@ -283,6 +283,21 @@ ManagedThreadInfo* ManagedThreadList::LoopNext(void)
     return *pDataItem;
 }
 
+ManagedThreadInfo* ManagedThreadList::GetThreadInfo(ThreadID clrThreadId)
+{
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+
+    ManagedThreadInfo* pThreadInfo = nullptr;
+    if (!TryFindThreadByClrThreadId(clrThreadId, &pThreadInfo))
+    {
+        return nullptr;
+    }
+
+    pThreadInfo->AddRef(); // Caller must release
+
+    return pThreadInfo;
+}
+
 void ManagedThreadList::ResizeAndCompactData(void)
 {
     // This helper function must be called under the update lock (_mutex)!
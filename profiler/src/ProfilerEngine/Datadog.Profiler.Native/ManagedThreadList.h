@@ -36,6 +36,7 @@ public:
     bool SetThreadName(ThreadID clrThreadId, shared::WSTRING* pThreadName) override;
     std::uint32_t Count() const override;
     ManagedThreadInfo* LoopNext() override;
+    ManagedThreadInfo* GetThreadInfo(ThreadID clrThreadId) override;
     bool TryGetThreadInfo(const std::uint32_t profilerThreadInfoId,
                           ThreadID* pClrThreadId,
                           DWORD* pOsThreadId,
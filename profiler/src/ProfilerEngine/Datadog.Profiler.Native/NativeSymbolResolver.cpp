@@ -0,0 +1,395 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include "NativeSymbolResolver.h"
+#include "Log.h"
+#include "OpSysTools.h"
+
+#ifndef _WINDOWS
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <cxxabi.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <link.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+#ifdef _WINDOWS
+
+NativeSymbolResolver::NativeSymbolResolver() = default;
+NativeSymbolResolver::~NativeSymbolResolver() = default;
+
+bool NativeSymbolResolver::Resolve(std::uintptr_t instructionPointer, std::string& modulePath, std::string& functionName)
+{
+    // On Windows, native frames are only reported with the name of their module
+    functionName.clear();
+    modulePath = OpSysTools::GetModuleName(reinterpret_cast<void*>(instructionPointer));
+    return !modulePath.empty();
+}
+
+std::vector<std::pair<std::uintptr_t, std::uintptr_t>> NativeSymbolResolver::GetUnloadedRanges()
+{
+    return {};
+}
+
+#else
+
+// Symbols of an ELF file mapped in memory
+class NativeSymbolResolver::ElfImage
+{
+public:
+    ElfImage(std::string path, std::uintptr_t loadBias) :
+        _path{std::move(path)},
+        _loadBias{loadBias}
+    {
+    }
+
+    ~ElfImage()
+    {
+        if (_pMapping != nullptr)
+        {
+            munmap(_pMapping, _mappingSize);
+        }
+    }
+
+    ElfImage(const ElfImage&) = delete;
+    ElfImage& operator=(const ElfImage&) = delete;
+
+public:
+    const std::string& GetPath() const
+    {
+        return _path;
+    }
+
+    // return nullptr if no symbol contains the given address
+    const char* FindSymbol(std::uintptr_t instructionPointer)
+    {
+        std::call_once(_loadOnce, &ElfImage::LoadSymbols, this);
+
+        // symbols addresses are relative to the load address of the image
+        auto address = instructionPointer - _loadBias;
+        auto next = std::upper_bound(
+            _symbols.begin(), _symbols.end(), address,
+            [](std::uintptr_t value, Symbol const& symbol) { return value < symbol.Address; });
+        if (next == _symbols.begin())
+        {
+            return nullptr;
+        }
+
+        auto const& symbol = *(next - 1);
+        if ((symbol.Size != 0) && (address >= symbol.Address + symbol.Size))
+        {
+            return nullptr;
+        }
+
+        return symbol.Name;
+    }
+
+private:
+    struct Symbol
+    {
+        std::uintptr_t Address;
+        std::uintptr_t Size;
+        const char* Name; // points into the mapped file
+    };
+
+    void LoadSymbols()
+    {
+        int fd = open(_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+        {
+            // i.e. linux-vdso.so.1 does not exist on disk
+            return;
+        }
+
+        struct stat fileStat;
+        if ((fstat(fd, &fileStat) == 0) && (fileStat.st_size > static_cast<off_t>(sizeof(ElfW(Ehdr)))))
+        {
+            void* pMapping = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (pMapping != MAP_FAILED)
+            {
+                _pMapping = pMapping;
+                _mappingSize = static_cast<std::size_t>(fileStat.st_size);
+            }
+        }
+        close(fd);
+
+        if (_pMapping == nullptr)
+        {
+            return;
+        }
+
+        // look for the full symbol table first and fallback to the dynamic one for stripped binaries
+        if (!ReadSymbols(SHT_SYMTAB))
+        {
+            ReadSymbols(SHT_DYNSYM);
+        }
+
+        std::sort(_symbols.begin(), _symbols.end(), [](Symbol const& left, Symbol const& right) { return left.Address < right.Address; });
+
+        Log::Debug("NativeSymbolResolver: ", _symbols.size(), " symbols loaded from ", _path);
+    }
+
+    bool ReadSymbols(ElfW(Word) sectionType)
+    {
+        auto* pBase = static_cast<const std::uint8_t*>(_pMapping);
+        auto* pHeader = reinterpret_cast<const ElfW(Ehdr)*>(pBase);
+
+        if ((memcmp(pHeader->e_ident, ELFMAG, SELFMAG) != 0) ||
+            (pHeader->e_shentsize != sizeof(ElfW(Shdr))) ||
+            (pHeader->e_shoff + pHeader->e_shnum * sizeof(ElfW(Shdr)) > _mappingSize))
+        {
+            return false;
+        }
+
+        auto* pSections = reinterpret_cast<const ElfW(Shdr)*>(pBase + pHeader->e_shoff);
+        for (std::size_t current = 0; current < pHeader->e_shnum; current++)
+        {
+            auto const& section = pSections[current];
+            if ((section.sh_type != sectionType) || (section.sh_link >= pHeader->e_shnum))
+            {
+                continue;
+            }
+
+            auto const& stringsSection = pSections[section.sh_link];
+            if ((section.sh_offset + section.sh_size > _mappingSize) ||
+                (stringsSection.sh_offset + stringsSection.sh_size > _mappingSize))
+            {
+                return false;
+            }
+
+            auto* pStrings = reinterpret_cast<const char*>(pBase + stringsSection.sh_offset);
+            auto* pSymbols = reinterpret_cast<const ElfW(Sym)*>(pBase + section.sh_offset);
+            auto symbolsCount = section.sh_size / sizeof(ElfW(Sym));
+            for (std::size_t i = 0; i < symbolsCount; i++)
+            {
+                auto const& symbol = pSymbols[i];
+
+                // only keep defined functions
+                if ((ELF64_ST_TYPE(symbol.st_info) != STT_FUNC) ||
+                    (symbol.st_shndx == SHN_UNDEF) ||
+                    (symbol.st_value == 0) ||
+                    (symbol.st_name >= stringsSection.sh_size))
+                {
+                    continue;
+                }
+
+                _symbols.push_back({static_cast<std::uintptr_t>(symbol.st_value), static_cast<std::uintptr_t>(symbol.st_size), pStrings + symbol.st_name});
+            }
+
+            return !_symbols.empty();
+        }
+
+        return false;
+    }
+
+private:
+    const std::string _path;
+    const std::uintptr_t _loadBias;
+
+    std::once_flag _loadOnce;
+    std::vector<Symbol> _symbols;
+    void* _pMapping = nullptr;
+    std::size_t _mappingSize = 0;
+};
+
+
+NativeSymbolResolver::NativeSymbolResolver() = default;
+NativeSymbolResolver::~NativeSymbolResolver() = default;
+
+bool NativeSymbolResolver::Resolve(std::uintptr_t instructionPointer, std::string& modulePath, std::string& functionName)
+{
+    functionName.clear();
+
+    auto pIndex = std::atomic_load(&_pIndex);
+    const ImageRange* pRange = (pIndex == nullptr) ? nullptr : Find(*pIndex, instructionPointer);
+    if (pRange == nullptr)
+    {
+        // the address could belong to an image loaded since the last refresh
+        auto [adds, subs] = GetLoaderCounters();
+        if ((pIndex == nullptr) || (pIndex->Adds != adds) || (pIndex->Subs != subs))
+        {
+            pIndex = RefreshIndex();
+            pRange = Find(*pIndex, instructionPointer);
+        }
+
+        if (pRange == nullptr)
+        {
+            return false;
+        }
+    }
+
+    modulePath = pRange->Image->GetPath();
+
+    auto* symbol = pRange->Image->FindSymbol(instructionPointer);
+    if (symbol == nullptr)
+    {
+        return true;
+    }
+
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(symbol, nullptr, nullptr, &status);
+    if ((status == 0) && (demangled != nullptr))
+    {
+        functionName = demangled;
+    }
+    else
+    {
+        functionName = symbol;
+    }
+    free(demangled);
+
+    return true;
+}
+
+std::vector<std::pair<std::uintptr_t, std::uintptr_t>> NativeSymbolResolver::GetUnloadedRanges()
+{
+    // nothing has been resolved yet
+    auto pIndex = std::atomic_load(&_pIndex);
+    if (pIndex == nullptr)
+    {
+        return {};
+    }
+
+    // the unloaded images are found when the index is refreshed
+    auto [adds, subs] = GetLoaderCounters();
+    if (pIndex->Subs != subs)
+    {
+        RefreshIndex();
+    }
+
+    std::lock_guard<std::mutex> lock(_refreshLock);
+    std::vector<std::pair<std::uintptr_t, std::uintptr_t>> unloadedRanges;
+    unloadedRanges.swap(_unloadedRanges);
+    return unloadedRanges;
+}
+
+const NativeSymbolResolver::ImageRange* NativeSymbolResolver::Find(const ImagesIndex& index, std::uintptr_t instructionPointer)
+{
+    auto next = std::upper_bound(
+        index.Ranges.begin(), index.Ranges.end(), instructionPointer,
+        [](std::uintptr_t value, ImageRange const& range) { return value < range.Start; });
+    if (next == index.Ranges.begin())
+    {
+        return nullptr;
+    }
+
+    auto const& range = *(next - 1);
+    if (instructionPointer >= range.End)
+    {
+        return nullptr;
+    }
+
+    return &range;
+}
+
+std::pair<std::uint64_t, std::uint64_t> NativeSymbolResolver::GetLoaderCounters()
+{
+    // dlpi_adds/dlpi_subs are the same for all images: only look at the first one
+    std::pair<std::uint64_t, std::uint64_t> counters{0, 0};
+    dl_iterate_phdr(
+        [](struct dl_phdr_info* info, size_t size, void* data) {
+            if (size >= offsetof(struct dl_phdr_info, dlpi_subs) + sizeof(info->dlpi_subs))
+            {
+                auto* pCounters = static_cast<std::pair<std::uint64_t, std::uint64_t>*>(data);
+                pCounters->first = info->dlpi_adds;
+                pCounters->second = info->dlpi_subs;
+            }
+            return 1;
+        },
+        &counters);
+
+    return counters;
+}
+
+std::shared_ptr<const NativeSymbolResolver::ImagesIndex> NativeSymbolResolver::RefreshIndex()
+{
+    std::lock_guard<std::mutex> lock(_refreshLock);
+
+    struct RefreshContext
+    {
+        NativeSymbolResolver* pResolver;
+        ImagesIndex* pIndex;
+        std::map<std::pair<std::string, std::uintptr_t>, std::shared_ptr<ElfImage>> Images;
+    };
+
+    auto pIndex = std::make_shared<ImagesIndex>();
+    std::tie(pIndex->Adds, pIndex->Subs) = GetLoaderCounters();
+
+    RefreshContext context{this, pIndex.get(), {}};
+    dl_iterate_phdr(
+        [](struct dl_phdr_info* info, size_t, void* data) {
+            auto* pContext = static_cast<RefreshContext*>(data);
+
+            // the main executable has no name
+            std::string path = (info->dlpi_name == nullptr) ? "" : info->dlpi_name;
+            if (path.empty())
+            {
+                char buffer[PATH_MAX];
+                auto length = readlink("/proc/self/exe", buffer, sizeof(buffer) - 1);
+                if (length <= 0)
+                {
+                    return 0;
+                }
+                path.assign(buffer, length);
+            }
+
+            std::shared_ptr<ElfImage> pImage;
+            for (ElfW(Half) i = 0; i < info->dlpi_phnum; i++)
+            {
+                auto const& segment = info->dlpi_phdr[i];
+                if ((segment.p_type != PT_LOAD) || ((segment.p_flags & PF_X) == 0))
+                {
+                    continue;
+                }
+
+                if (pImage == nullptr)
+                {
+                    // reuse the image (and its symbols) if it was already loaded
+                    auto key = std::make_pair(path, static_cast<std::uintptr_t>(info->dlpi_addr));
+                    auto& images = pContext->pResolver->_images;
+                    auto entry = images.find(key);
+                    pImage = (entry != images.end()) ? entry->second : std::make_shared<ElfImage>(path, info->dlpi_addr);
+                    pContext->Images[key] = pImage;
+                }
+
+                auto start = static_cast<std::uintptr_t>(info->dlpi_addr + segment.p_vaddr);
+                pContext->pIndex->Ranges.push_back({start, start + segment.p_memsz, pImage});
+            }
+
+            return 0;
+        },
+        &context);
+
+    std::sort(pIndex->Ranges.begin(), pIndex->Ranges.end(), [](ImageRange const& left, ImageRange const& right) { return left.Start < right.Start; });
+
+    // the ranges of the images that are not loaded anymore (i.e. not reused) are reported by GetUnloadedRanges()
+    auto pPreviousIndex = std::atomic_load(&_pIndex);
+    if (pPreviousIndex != nullptr)
+    {
+        for (auto const& range : pPreviousIndex->Ranges)
+        {
+            auto isLoaded = std::any_of(context.Images.begin(), context.Images.end(), [&range](auto const& image) { return image.second == range.Image; });
+            if (!isLoaded)
+            {
+                _unloadedRanges.emplace_back(range.Start, range.End);
+            }
+        }
+    }
+
+    // unloaded images are released when the last snapshot referencing them is released
+    _images = std::move(context.Images);
+
+    std::shared_ptr<const ImagesIndex> pNewIndex = std::move(pIndex);
+    std::atomic_store(&_pIndex, pNewIndex);
+
+    Log::Debug("NativeSymbolResolver: index refreshed with ", pNewIndex->Ranges.size(), " executable ranges from ", _images.size(), " images");
+    return pNewIndex;
+}
+
+#endif
@@ -0,0 +1,80 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef _WINDOWS
+#include <map>
+#include <memory>
+#include <mutex>
+#endif
+
+
+// Resolves native instruction pointers into the path of their module and the name of their function.
+//
+// On Linux, the executable segments of the loaded ELF images are listed with dl_iterate_phdr and kept
+// in an immutable index sorted by start address: a lookup is a binary search in the current snapshot
+// of this index. It is rebuilt only when an address is not found and the loader reports that images
+// have been loaded or unloaded since the last refresh.
+// The symbols of an image are read from its .symtab section (or .dynsym if stripped) through a
+// read-only mapping of the file, the first time an address is resolved in this image.
+//
+// On Windows, only the module is found: the function name is left empty.
+//
+// Callers are expected to cache the results per instruction pointer and to drop the cached results
+// of the unloaded images (see GetUnloadedRanges): their addresses could be reused by other images.
+//
+class NativeSymbolResolver
+{
+public:
+    NativeSymbolResolver();
+    ~NativeSymbolResolver();
+    NativeSymbolResolver(const NativeSymbolResolver&) = delete;
+    NativeSymbolResolver& operator=(const NativeSymbolResolver&) = delete;
+
+public:
+    // Return false if the given address does not belong to any loaded module.
+    // functionName is left empty if no symbol is found for this address
+    bool Resolve(std::uintptr_t instructionPointer, std::string& modulePath, std::string& functionName);
+
+    // Return the [start, end) executable ranges of the images unloaded since the previous call.
+    // The loader is asked whether images have been unloaded: this is cheaper than a resolution but not free.
+    // On Windows, unloaded modules are not detected
+    std::vector<std::pair<std::uintptr_t, std::uintptr_t>> GetUnloadedRanges();
+
+#ifndef _WINDOWS
+private:
+    class ElfImage;
+
+    struct ImageRange
+    {
+        std::uintptr_t Start;
+        std::uintptr_t End;
+        std::shared_ptr<ElfImage> Image;
+    };
+
+    struct ImagesIndex
+    {
+        std::uint64_t Adds = 0;
+        std::uint64_t Subs = 0;
+        std::vector<ImageRange> Ranges; // sorted by Start
+    };
+
+    static const ImageRange* Find(const ImagesIndex& index, std::uintptr_t instructionPointer);
+    static std::pair<std::uint64_t, std::uint64_t> GetLoaderCounters();
+    std::shared_ptr<const ImagesIndex> RefreshIndex();
+
+private:
+    // readers only access a snapshot of the index with std::atomic_load
+    std::shared_ptr<const ImagesIndex> _pIndex;
+
+    // images are reused between two refreshes to avoid reloading their symbols
+    std::mutex _refreshLock;
+    std::map<std::pair<std::string, std::uintptr_t>, std::shared_ptr<ElfImage>> _images;
+    std::vector<std::pair<std::uintptr_t, std::uintptr_t>> _unloadedRanges; // since the last GetUnloadedRanges() call
+#endif
+};
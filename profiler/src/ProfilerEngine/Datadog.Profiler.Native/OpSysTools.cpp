@@ -16,7 +16,11 @@
 #include <dlfcn.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <signal.h>
+#include <fstream>
+#include <sstream>
 #include <stdlib.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <unistd.h>
 #define _GNU_SOURCE
@@ -62,15 +66,112 @@ int OpSysTools::GetProcId()
 #endif
 }
 
+bool OpSysTools::IsProcessAlive(int processId)
+{
+#ifdef _WINDOWS
+    HANDLE hProcess = ::OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, static_cast<DWORD>(processId));
+    if (hProcess == NULL)
+    {
+        // the process exists but belongs to another user
+        return ::GetLastError() == ERROR_ACCESS_DENIED;
+    }
+
+    DWORD exitCode = 0;
+    bool isAlive = !::GetExitCodeProcess(hProcess, &exitCode) || (exitCode == STILL_ACTIVE);
+    ::CloseHandle(hProcess);
+    return isAlive;
+#else
+    // no signal is sent: only the existence of the process is checked
+    return (kill(processId, 0) == 0) || (errno == EPERM);
+#endif
+}
+
 int OpSysTools::GetThreadId()
 {
 #ifdef _WINDOWS
     return ::GetCurrentThreadId();
 #else
-    return pthread_self();
+    // pthread_self() is not the thread id used by the kernel (and the CLR)
+    return static_cast<int>(syscall(SYS_gettid));
 #endif
 }
 
+#ifdef _WINDOWS
+bool OpSysTools::GetThreadCpuTime(HANDLE osThreadHandle, std::uint64_t& cpuTimeNanoseconds)
+{
+    FILETIME creationTime, exitTime = {}; // not used here
+    FILETIME kernelTime = {};
+    FILETIME userTime = {};
+
+    if (!::GetThreadTimes(osThreadHandle, &creationTime, &exitTime, &kernelTime, &userTime))
+    {
+        return false;
+    }
+
+    // kernel and user times are expressed in 100 nanoseconds units
+    auto kernel = (static_cast<std::uint64_t>(kernelTime.dwHighDateTime) << 32) | kernelTime.dwLowDateTime;
+    auto user = (static_cast<std::uint64_t>(userTime.dwHighDateTime) << 32) | userTime.dwLowDateTime;
+    cpuTimeNanoseconds = (kernel + user) * 100;
+    return true;
+}
+#else
+clockid_t OpSysTools::GetThreadCpuClockId(pid_t tid)
+{
+    // same encoding as MAKE_THREAD_CPUCLOCK(tid, CPUCLOCK_SCHED) in the kernel:
+    // it is what pthread_getcpuclockid() returns for the corresponding pthread_t
+    return static_cast<clockid_t>(((~static_cast<unsigned int>(tid)) << 3) | 6);
+}
+
+bool OpSysTools::GetThreadCpuTime(clockid_t cpuClockId, pid_t tid, std::uint64_t& cpuTimeNanoseconds)
+{
+    struct timespec cpuTime;
+    if (clock_gettime(cpuClockId, &cpuTime) == 0)
+    {
+        cpuTimeNanoseconds = static_cast<std::uint64_t>(cpuTime.tv_sec) * NanosecondsPerSecond + cpuTime.tv_nsec;
+        return true;
+    }
+
+    // fallback to /proc/self/task/<tid>/stat where utime and stime are the 14th and 15th fields (in clock ticks)
+    // The thread name (2nd field) is between parenthesis and could contain spaces
+    std::ifstream statFile("/proc/self/task/" + std::to_string(tid) + "/stat");
+    std::string line;
+    if (!std::getline(statFile, line))
+    {
+        return false;
+    }
+
+    auto nameEnd = line.rfind(')');
+    if (nameEnd == std::string::npos)
+    {
+        return false;
+    }
+
+    // skip the fields from state (3rd) to cstime (13th)
+    std::istringstream fields(line.substr(nameEnd + 1));
+    std::string field;
+    for (int current = 3; current <= 13; current++)
+    {
+        fields >> field;
+    }
+
+    std::uint64_t userTicks = 0;
+    std::uint64_t kernelTicks = 0;
+    if (!(fields >> userTicks >> kernelTicks))
+    {
+        return false;
+    }
+
+    static long ticksPerSecond = sysconf(_SC_CLK_TCK);
+    if (ticksPerSecond <= 0)
+    {
+        return false;
+    }
+
+    cpuTimeNanoseconds = (userTicks + kernelTicks) * (NanosecondsPerSecond / ticksPerSecond);
+    return true;
+}
+#endif
+
 bool OpSysTools::InitHighPrecisionTimer(void)
 {
 #ifdef _WINDOWS
@@ -11,6 +11,8 @@
 #else
 #include "pal.h"
 #include "pal_mstypes.h"
+#include <sys/types.h>
+#include <time.h>
 #endif
 
 class OpSysTools final
@@ -18,6 +20,8 @@ class OpSysTools final
 public:
     static std::string GetEnvironmentVariableValue(const char* varName);
     static int GetProcId();
+    // returns true if the process exists or if it is not possible to know
+    static bool IsProcessAlive(int processId);
     static int GetThreadId();
     // static std::string UnicodeToAnsi(const WCHAR* str);
 
@@ -40,6 +44,15 @@ public:
     static bool SetNativeThreadName(std::thread* pNativeThread, const WCHAR* description);
     static bool GetNativeThreadName(HANDLE windowsThreadHandle, WCHAR* pThreadDescrBuff, const std::uint32_t threadDescrBuffSize);
 
+    // CPU time (user + kernel) consumed by the given thread, in nanoseconds
+#ifdef _WINDOWS
+    static bool GetThreadCpuTime(HANDLE osThreadHandle, std::uint64_t& cpuTimeNanoseconds);
+#else
+    // pthread_getcpuclockid() needs a pthread_t that is not known for CLR threads: build the clock from the tid
+    static clockid_t GetThreadCpuClockId(pid_t tid);
+    static bool GetThreadCpuTime(clockid_t cpuClockId, pid_t tid, std::uint64_t& cpuTimeNanoseconds);
+#endif
+
     static bool GetModuleHandleFromInstructionPointer(void* nativeIP, std::uint64_t* pModuleHandle);
     static std::string GetModuleName(void* nativeIP);
 
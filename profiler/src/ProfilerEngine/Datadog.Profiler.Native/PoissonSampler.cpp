@@ -0,0 +1,27 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include "PoissonSampler.h"
+
+#include <cmath>
+#include <random>
+
+std::int64_t PoissonSampler::GetNextSamplingDistance(std::uint64_t meanDistance)
+{
+    thread_local std::minstd_rand generator{std::random_device{}()};
+    std::exponential_distribution<double> distribution(1.0 / meanDistance);
+
+    return static_cast<std::int64_t>(distribution(generator)) + 1;
+}
+
+std::pair<std::int64_t, std::int64_t> PoissonSampler::Upscale(std::uint64_t magnitude, std::uint64_t meanDistance)
+{
+    if ((magnitude == 0) || (meanDistance == 0))
+    {
+        return {1, static_cast<std::int64_t>(magnitude)};
+    }
+
+    double probability = 1 - std::exp(-static_cast<double>(magnitude) / meanDistance);
+
+    return {std::llround(1 / probability), std::llround(magnitude / probability)};
+}
@@ -0,0 +1,22 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#pragma once
+
+#include <cstdint>
+#include <utility>
+
+// Helpers to sample events weighted by a magnitude (allocated bytes, wait duration...):
+// the distance between two sampled events follows an exponential distribution (i.e. Poisson process)
+// with the given mean. The caller counts down the distance (usually per thread) and takes a sample
+// each time it is consumed.
+class PoissonSampler
+{
+public:
+    // random distance to the next sample (always > 0)
+    static std::int64_t GetNextSamplingDistance(std::uint64_t meanDistance);
+
+    // returns the count and the magnitude represented by a sampled event of the given magnitude:
+    // an event is sampled with a probability of 1 - exp(-magnitude / meanDistance)
+    static std::pair<std::int64_t, std::int64_t> Upscale(std::uint64_t magnitude, std::uint64_t meanDistance);
+};
@@ -0,0 +1,279 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include "PprofBuilder.h"
+
+#include "Sample.h"
+
+// see https://github.com/google/pprof/blob/main/proto/profile.proto for the fields numbers
+namespace Pprof
+{
+    namespace Profile
+    {
+        const std::uint32_t SampleType = 1;
+        const std::uint32_t Sample = 2;
+        const std::uint32_t Mapping = 3;
+        const std::uint32_t Location = 4;
+        const std::uint32_t Function = 5;
+        const std::uint32_t StringTable = 6;
+        const std::uint32_t TimeNanos = 9;
+        const std::uint32_t DurationNanos = 10;
+        const std::uint32_t PeriodType = 11;
+        const std::uint32_t Period = 12;
+    }
+
+    namespace ValueType
+    {
+        const std::uint32_t Type = 1;
+        const std::uint32_t Unit = 2;
+    }
+
+    namespace Sample
+    {
+        const std::uint32_t LocationId = 1;
+        const std::uint32_t Value = 2;
+        const std::uint32_t Label = 3;
+    }
+
+    namespace Label
+    {
+        const std::uint32_t Key = 1;
+        const std::uint32_t Str = 2;
+        const std::uint32_t Num = 3;
+        const std::uint32_t NumUnit = 4;
+    }
+
+    namespace Mapping
+    {
+        const std::uint32_t Id = 1;
+        const std::uint32_t Filename = 5;
+    }
+
+    namespace Location
+    {
+        const std::uint32_t Id = 1;
+        const std::uint32_t MappingId = 2;
+        const std::uint32_t Line = 4;
+    }
+
+    namespace Line
+    {
+        const std::uint32_t FunctionId = 1;
+    }
+
+    namespace Function
+    {
+        const std::uint32_t Id = 1;
+        const std::uint32_t Name = 2;
+    }
+}
+
+// protobuf wire format helpers
+namespace
+{
+    const std::uint32_t VarintWireType = 0;
+    const std::uint32_t LengthDelimitedWireType = 2;
+
+    void WriteVarint(std::vector<std::uint8_t>& buffer, std::uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            buffer.push_back(static_cast<std::uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        buffer.push_back(static_cast<std::uint8_t>(value));
+    }
+
+    void WriteVarintField(std::vector<std::uint8_t>& buffer, std::uint32_t field, std::uint64_t value)
+    {
+        WriteVarint(buffer, (field << 3) | VarintWireType);
+        WriteVarint(buffer, value);
+    }
+
+    void WriteBytesField(std::vector<std::uint8_t>& buffer, std::uint32_t field, std::uint8_t const* data, std::size_t size)
+    {
+        WriteVarint(buffer, (field << 3) | LengthDelimitedWireType);
+        WriteVarint(buffer, size);
+        buffer.insert(buffer.end(), data, data + size);
+    }
+
+    void WriteMessageField(std::vector<std::uint8_t>& buffer, std::uint32_t field, std::vector<std::uint8_t> const& message)
+    {
+        WriteBytesField(buffer, field, message.data(), message.size());
+    }
+}
+
+
+PprofBuilder::PprofBuilder(std::string_view periodType, std::string_view periodUnit) :
+    _periodType{periodType},
+    _periodUnit{periodUnit},
+    _samplesCount{0}
+{
+    Reset();
+}
+
+std::int32_t PprofBuilder::GetSamplesCount() const
+{
+    return _samplesCount;
+}
+
+void PprofBuilder::Add(Sample const& sample)
+{
+    _sampleScratch.clear();
+
+    // location ids (packed)
+    _scratch.clear();
+    for (auto const& frame : sample.GetCallstack())
+    {
+        WriteVarint(_scratch, GetLocationId(frame));
+    }
+    WriteMessageField(_sampleScratch, Pprof::Sample::LocationId, _scratch);
+
+    // values (packed)
+    _scratch.clear();
+    for (auto value : sample.GetValues())
+    {
+        WriteVarint(_scratch, static_cast<std::uint64_t>(value));
+    }
+    WriteMessageField(_sampleScratch, Pprof::Sample::Value, _scratch);
+
+    for (auto const& [name, value] : sample.GetLabels())
+    {
+        _scratch.clear();
+        WriteVarintField(_scratch, Pprof::Label::Key, GetStringIndex(name, false));
+        WriteVarintField(_scratch, Pprof::Label::Str, GetStringIndex(value, false));
+        WriteMessageField(_sampleScratch, Pprof::Sample::Label, _scratch);
+    }
+
+    for (auto const& label : sample.GetNumericLabels())
+    {
+        _scratch.clear();
+        WriteVarintField(_scratch, Pprof::Label::Key, GetStringIndex(label.Name, false));
+        WriteVarintField(_scratch, Pprof::Label::Num, static_cast<std::uint64_t>(label.Value));
+        if (!label.Unit.empty())
+        {
+            WriteVarintField(_scratch, Pprof::Label::NumUnit, GetStringIndex(label.Unit, false));
+        }
+        WriteMessageField(_sampleScratch, Pprof::Sample::Label, _scratch);
+    }
+
+    WriteMessageField(_samples, Pprof::Profile::Sample, _sampleScratch);
+    _samplesCount++;
+}
+
+void PprofBuilder::Serialize(std::vector<std::uint8_t>& buffer, std::int64_t startTimeNs, std::int64_t endTimeNs)
+{
+    buffer.clear();
+    buffer.reserve(_samples.size() + _mappings.size() + _locations.size() + _functions.size() + _strings.size() + 256);
+
+    for (auto const& type : SampleTypeDefinitions)
+    {
+        _scratch.clear();
+        WriteVarintField(_scratch, Pprof::ValueType::Type, GetStringIndex(type.Name, true));
+        WriteVarintField(_scratch, Pprof::ValueType::Unit, GetStringIndex(type.Unit, true));
+        WriteMessageField(buffer, Pprof::Profile::SampleType, _scratch);
+    }
+
+    _scratch.clear();
+    WriteVarintField(_scratch, Pprof::ValueType::Type, GetStringIndex(_periodType, true));
+    WriteVarintField(_scratch, Pprof::ValueType::Unit, GetStringIndex(_periodUnit, true));
+    WriteMessageField(buffer, Pprof::Profile::PeriodType, _scratch);
+    WriteVarintField(buffer, Pprof::Profile::Period, 1);
+
+    WriteVarintField(buffer, Pprof::Profile::TimeNanos, startTimeNs);
+    WriteVarintField(buffer, Pprof::Profile::DurationNanos, endTimeNs - startTimeNs);
+
+    // the tables are already encoded as repeated fields
+    buffer.insert(buffer.end(), _samples.begin(), _samples.end());
+    buffer.insert(buffer.end(), _mappings.begin(), _mappings.end());
+    buffer.insert(buffer.end(), _locations.begin(), _locations.end());
+    buffer.insert(buffer.end(), _functions.begin(), _functions.end());
+    buffer.insert(buffer.end(), _strings.begin(), _strings.end());
+
+    Reset();
+}
+
+void PprofBuilder::Reset()
+{
+    // the buffers keep their capacity for the next profile
+    _samples.clear();
+    _mappings.clear();
+    _locations.clear();
+    _functions.clear();
+    _strings.clear();
+    _stringIndexes.clear();
+    _ownedStrings.clear();
+    _mappingIds.clear();
+    _locationIds.clear();
+
+    _samplesCount = 0;
+
+    // the first string of the table must be the empty string
+    GetStringIndex("", true);
+}
+
+std::int64_t PprofBuilder::GetStringIndex(std::string_view value, bool isInterned)
+{
+    auto it = _stringIndexes.find(value);
+    if (it != _stringIndexes.end())
+    {
+        return it->second;
+    }
+
+    if (!isInterned)
+    {
+        value = _ownedStrings.emplace_back(value);
+    }
+
+    auto index = static_cast<std::int64_t>(_stringIndexes.size());
+    _stringIndexes.emplace(value, index);
+    WriteBytesField(_strings, Pprof::Profile::StringTable, reinterpret_cast<std::uint8_t const*>(value.data()), value.size());
+
+    return index;
+}
+
+std::uint64_t PprofBuilder::GetMappingId(StringId moduleName)
+{
+    auto [element, inserted] = _mappingIds.try_emplace(moduleName, _mappingIds.size() + 1);
+    auto id = element->second;
+    if (!inserted)
+    {
+        return id;
+    }
+
+    _tableScratch.clear();
+    WriteVarintField(_tableScratch, Pprof::Mapping::Id, id);
+    WriteVarintField(_tableScratch, Pprof::Mapping::Filename, GetStringIndex(StringTable::GetInstance()->Get(moduleName), true));
+    WriteMessageField(_mappings, Pprof::Profile::Mapping, _tableScratch);
+
+    return id;
+}
+
+std::uint64_t PprofBuilder::GetLocationId(FrameId const& frame)
+{
+    auto [element, inserted] = _locationIds.try_emplace(frame.GetKey(), _locationIds.size() + 1);
+    auto id = element->second;
+    if (!inserted)
+    {
+        return id;
+    }
+
+    auto mappingId = GetMappingId(frame.ModuleName);
+
+    // each frame has its own function with the same id
+    _tableScratch.clear();
+    WriteVarintField(_tableScratch, Pprof::Function::Id, id);
+    WriteVarintField(_tableScratch, Pprof::Function::Name, GetStringIndex(frame.GetFrame(), true));
+    WriteMessageField(_functions, Pprof::Profile::Function, _tableScratch);
+
+    _lineScratch.clear();
+    WriteVarintField(_lineScratch, Pprof::Line::FunctionId, id);
+
+    _tableScratch.clear();
+    WriteVarintField(_tableScratch, Pprof::Location::Id, id);
+    WriteVarintField(_tableScratch, Pprof::Location::MappingId, mappingId);
+    WriteMessageField(_tableScratch, Pprof::Location::Line, _lineScratch);
+    WriteMessageField(_locations, Pprof::Profile::Location, _tableScratch);
+
+    return id;
+}
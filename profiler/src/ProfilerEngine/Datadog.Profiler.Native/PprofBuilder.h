@@ -0,0 +1,72 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "FrameId.h"
+#include "StringTable.h"
+
+class Sample;
+
+// Encodes a pprof profile (protobuf) while the samples are added instead of building it through
+// per-sample FFI calls and serializing it at the end.
+// Each sample is encoded as soon as it is added and the string, mapping, function and location
+// tables grow with the new strings and frames it references: serializing only appends these
+// tables and the header fields after the samples (the order of protobuf fields does not matter).
+// The encoded buffers keep their capacity from one profile to the next so that they rarely grow
+// again; the string, mapping and location indexes (and the copied strings) are rebuilt for each profile.
+// A builder is not thread safe: the caller is responsible for not serializing it while samples are added.
+class PprofBuilder
+{
+public:
+    PprofBuilder(std::string_view periodType, std::string_view periodUnit);
+
+    PprofBuilder(const PprofBuilder&) = delete;
+    PprofBuilder& operator=(const PprofBuilder&) = delete;
+
+    void Add(Sample const& sample);
+    std::int32_t GetSamplesCount() const;
+
+    // Write the encoded profile into the given buffer and start a new profile.
+    // The start and end of the profile are unix times in nanoseconds
+    void Serialize(std::vector<std::uint8_t>& buffer, std::int64_t startTimeNs, std::int64_t endTimeNs);
+
+private:
+    void Reset();
+
+    std::int64_t GetStringIndex(std::string_view value, bool isInterned);
+    std::uint64_t GetMappingId(StringId moduleName);
+    std::uint64_t GetLocationId(FrameId const& frame);
+
+private:
+    const std::string _periodType;
+    const std::string _periodUnit;
+
+    std::int32_t _samplesCount;
+
+    // encoded messages, reused between profiles
+    std::vector<std::uint8_t> _samples;
+    std::vector<std::uint8_t> _mappings;
+    std::vector<std::uint8_t> _locations;
+    std::vector<std::uint8_t> _functions;
+    std::vector<std::uint8_t> _strings;
+    std::vector<std::uint8_t> _sampleScratch;
+    std::vector<std::uint8_t> _scratch;
+    std::vector<std::uint8_t> _tableScratch;
+    std::vector<std::uint8_t> _lineScratch;
+
+    // the strings interned in the process-wide StringTable (i.e. frames) are never copied;
+    // the others (i.e. label values) are copied in _ownedStrings (a deque never moves them)
+    std::unordered_map<std::string_view, std::int64_t> _stringIndexes;
+    std::deque<std::string> _ownedStrings;
+    std::unordered_map<StringId, std::uint64_t> _mappingIds;
+    //                 V-- FrameId key
+    std::unordered_map<std::uint64_t, std::uint64_t> _locationIds;
+};
@@ -0,0 +1,361 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include "ProfileSpool.h"
+
+#include <algorithm>
+#include <fstream>
+
+#include "Log.h"
+#include "OpSysTools.h"
+
+std::string const ProfileSpool::FileExtension = ".spool";
+std::string const ProfileSpool::TemporaryFileExtension = ".tmp";
+
+// A spooled file is made of the following fields (native endianness):
+//    service name size (uint32) | service name | content
+
+ProfileSpool::ProfileSpool(fs::path directory, std::uint64_t maxSizePerService) :
+    _rootDirectory{std::move(directory)},
+    _directory{_rootDirectory / std::to_string(OpSysTools::GetProcId())},
+    _maxSizePerService{maxSizePerService},
+    _isDirectoryAvailable{false},
+    _nextSequenceNumber{0}
+{
+    std::error_code errorCode;
+    if (fs::create_directories(_directory, errorCode) || (errorCode.value() == 0))
+    {
+        _isDirectoryAvailable = true;
+        LoadExistingFiles();
+    }
+    else
+    {
+        Log::Error("Unable to create the profiles spool directory '", _directory, "'. Error (code): ", errorCode.message(), " (", errorCode.value(), ")");
+    }
+}
+
+bool ProfileSpool::Write(std::string const& service, std::vector<std::uint8_t> const& content)
+{
+    if (!_isDirectoryAvailable)
+    {
+        return false;
+    }
+
+    // the files are counted under the name stored in their header
+    auto serviceName = service.substr(0, MaxServiceNameSize);
+
+    std::uint64_t size = content.size();
+    if (size > _maxSizePerService)
+    {
+        Log::Warn("The profile is too large (", size, " bytes) to be spooled.");
+        return false;
+    }
+
+    // make room by removing the oldest profiles of the same service
+    auto& spooledSize = _sizePerService[serviceName];
+    auto file = _files.begin();
+    while ((spooledSize + size > _maxSizePerService) && (file != _files.end()))
+    {
+        if (file->Service == serviceName)
+        {
+            Log::Info("The spooled profile ", file->Path, " is removed to make room for a more recent one.");
+            file = Remove(file);
+        }
+        else
+        {
+            ++file;
+        }
+    }
+
+    // the profile is written in a temporary file first so that a partially written file
+    // is never replayed
+    auto path = GetNextFilePath();
+    auto temporaryPath = path;
+    temporaryPath += TemporaryFileExtension;
+
+    auto serviceSize = static_cast<std::uint32_t>(serviceName.size());
+    std::ofstream stream{temporaryPath, std::ios::out | std::ios::binary};
+    stream.write(reinterpret_cast<char const*>(&serviceSize), sizeof(serviceSize));
+    stream.write(serviceName.data(), serviceSize);
+    stream.write(reinterpret_cast<char const*>(content.data()), content.size());
+    stream.close();
+
+    std::error_code errorCode;
+    if (stream.fail())
+    {
+        Log::Error("Unable to spool the profile in ", temporaryPath);
+        fs::remove(temporaryPath, errorCode);
+        return false;
+    }
+
+    fs::rename(temporaryPath, path, errorCode);
+    if (errorCode)
+    {
+        Log::Error("Unable to spool the profile in ", path, ". Error (code): ", errorCode.message(), " (", errorCode.value(), ")");
+        fs::remove(temporaryPath, errorCode);
+        return false;
+    }
+
+    _files.push_back({path, serviceName, sizeof(serviceSize) + serviceSize, size});
+    spooledSize += size;
+
+    return true;
+}
+
+bool ProfileSpool::ReadOldest(std::vector<std::uint8_t>& content)
+{
+    while (!_files.empty())
+    {
+        auto const& file = _files.front();
+
+        std::ifstream stream{file.Path, std::ios::in | std::ios::binary};
+        if (stream.is_open() && stream.seekg(file.HeaderSize))
+        {
+            content.resize(file.Size);
+            stream.read(reinterpret_cast<char*>(content.data()), content.size());
+            if (stream.gcount() == static_cast<std::streamsize>(file.Size))
+            {
+                return true;
+            }
+        }
+
+        // the file has been altered or removed: it is skipped
+        Log::Warn("Unable to read the spooled profile ", file.Path);
+        RemoveOldest();
+    }
+
+    return false;
+}
+
+void ProfileSpool::RemoveOldest()
+{
+    if (!_files.empty())
+    {
+        Remove(_files.begin());
+    }
+}
+
+std::size_t ProfileSpool::GetCount() const
+{
+    return _files.size();
+}
+
+std::uint64_t ProfileSpool::GetSize(std::string const& service) const
+{
+    auto it = _sizePerService.find(service.substr(0, MaxServiceNameSize));
+    if (it == _sizePerService.end())
+    {
+        return 0;
+    }
+
+    return it->second;
+}
+
+void ProfileSpool::LoadExistingFiles()
+{
+    AdoptFilesOfExitedProcesses();
+
+    struct ExistingFile
+    {
+        SpooledFile File;
+        fs::file_time_type LastWriteTime;
+    };
+
+    std::vector<ExistingFile> existingFiles;
+    std::error_code errorCode;
+    for (auto const& entry : fs::directory_iterator(_directory, errorCode))
+    {
+        auto const& path = entry.path();
+        auto extension = path.extension();
+
+        // a temporary file has not been completely written before a previous process with the same id exited
+        if (extension == TemporaryFileExtension)
+        {
+            fs::remove(path, errorCode);
+            continue;
+        }
+
+        if (extension != FileExtension)
+        {
+            continue;
+        }
+
+        ExistingFile existingFile;
+        existingFile.File.Path = path;
+        existingFile.LastWriteTime = fs::last_write_time(path, errorCode);
+        if (errorCode || !TryReadHeader(path, existingFile.File.Service, existingFile.File.HeaderSize))
+        {
+            Log::Warn("Invalid spooled profile ", path, ": it is discarded.");
+            fs::remove(path, errorCode);
+            continue;
+        }
+
+        existingFile.File.Size = entry.file_size(errorCode) - existingFile.File.HeaderSize;
+        existingFiles.push_back(std::move(existingFile));
+    }
+
+    if (errorCode)
+    {
+        Log::Warn("Unable to list the profiles spooled in ", _directory, ". Error (code): ", errorCode.message(), " (", errorCode.value(), ")");
+    }
+
+    // the files of a process are sorted by name when they are written during the same clock tick
+    std::sort(existingFiles.begin(), existingFiles.end(), [](ExistingFile const& left, ExistingFile const& right) {
+        return (left.LastWriteTime < right.LastWriteTime) ||
+               ((left.LastWriteTime == right.LastWriteTime) && (left.File.Path < right.File.Path));
+    });
+
+    for (auto& existingFile : existingFiles)
+    {
+        _sizePerService[existingFile.File.Service] += existingFile.File.Size;
+        _files.push_back(std::move(existingFile.File));
+    }
+
+    RemoveOldestOverLimit();
+
+    if (!_files.empty())
+    {
+        Log::Info(_files.size(), " spooled profiles left by previous processes will be replayed once the agent is reachable.");
+    }
+}
+
+void ProfileSpool::AdoptFilesOfExitedProcesses()
+{
+    auto processId = OpSysTools::GetProcId();
+
+    std::error_code errorCode;
+    for (auto const& entry : fs::directory_iterator(_rootDirectory, errorCode))
+    {
+        std::error_code entryErrorCode;
+        int ownerId = 0;
+        if (!entry.is_directory(entryErrorCode) ||
+            !TryParseProcessId(entry.path().filename().string(), ownerId) ||
+            (ownerId == processId) ||
+            OpSysTools::IsProcessAlive(ownerId))
+        {
+            continue;
+        }
+
+        AdoptFiles(entry.path());
+    }
+
+    if (errorCode)
+    {
+        Log::Warn("Unable to list the profiles spooled in ", _rootDirectory, ". Error (code): ", errorCode.message(), " (", errorCode.value(), ")");
+    }
+}
+
+void ProfileSpool::AdoptFiles(fs::path const& directory)
+{
+    std::error_code errorCode;
+    for (auto const& entry : fs::directory_iterator(directory, errorCode))
+    {
+        auto const& path = entry.path();
+        auto extension = path.extension();
+
+        // a temporary file has not been completely written before the process exited
+        if (extension == TemporaryFileExtension)
+        {
+            fs::remove(path, errorCode);
+            continue;
+        }
+
+        if (extension != FileExtension)
+        {
+            continue;
+        }
+
+        // the file names start with the id of the process that wrote them: they do not collide
+        // with the files of this process. The move is atomic: if several processes are adopting
+        // the files of the same exited process, each file is adopted only once
+        auto adoptedPath = _directory / path.filename();
+        if (!fs::exists(adoptedPath, errorCode))
+        {
+            fs::rename(path, adoptedPath, errorCode);
+        }
+    }
+
+    // kept if it is not empty
+    fs::remove(directory, errorCode);
+}
+
+bool ProfileSpool::TryParseProcessId(std::string const& name, int& processId)
+{
+    if (name.empty() || (name.size() > 9) || !std::all_of(name.begin(), name.end(), [](char c) { return (c >= '0') && (c <= '9'); }))
+    {
+        return false;
+    }
+
+    processId = std::stoi(name);
+    return true;
+}
+
+bool ProfileSpool::TryReadHeader(fs::path const& path, std::string& service, std::uint64_t& size)
+{
+    std::ifstream stream{path, std::ios::in | std::ios::binary};
+
+    std::uint32_t serviceSize = 0;
+    if (!stream.read(reinterpret_cast<char*>(&serviceSize), sizeof(serviceSize)) || (serviceSize > MaxServiceNameSize))
+    {
+        return false;
+    }
+
+    service.resize(serviceSize);
+    if (!stream.read(service.data(), serviceSize))
+    {
+        return false;
+    }
+
+    size = sizeof(serviceSize) + serviceSize;
+    return true;
+}
+
+void ProfileSpool::RemoveOldestOverLimit()
+{
+    // the limit could have been lowered since the files were written
+    auto file = _files.begin();
+    while (file != _files.end())
+    {
+        if (_sizePerService[file->Service] > _maxSizePerService)
+        {
+            Log::Info("The spooled profile ", file->Path, " is removed to keep the size of the spooled profiles of its service bounded.");
+            file = Remove(file);
+        }
+        else
+        {
+            ++file;
+        }
+    }
+}
+
+fs::path ProfileSpool::GetNextFilePath()
+{
+    // the sequence number is padded so that the files of a process are sorted by name
+    auto sequenceNumber = std::to_string(_nextSequenceNumber++);
+    std::string filename;
+    filename.reserve(64);
+    filename.append(std::to_string(OpSysTools::GetProcId()));
+    filename.push_back('_');
+    filename.append(20 - (std::min)(sequenceNumber.size(), static_cast<std::size_t>(20)), '0');
+    filename.append(sequenceNumber);
+    filename.append(FileExtension);
+
+    // the file of a previous process with the same id is not overwritten
+    auto path = _directory / filename;
+    std::error_code errorCode;
+    if (fs::exists(path, errorCode))
+    {
+        return GetNextFilePath();
+    }
+
+    return path;
+}
+
+std::deque<ProfileSpool::SpooledFile>::iterator ProfileSpool::Remove(std::deque<SpooledFile>::iterator file)
+{
+    std::error_code errorCode;
+    fs::remove(file->Path, errorCode);
+
+    _sizePerService[file->Service] -= file->Size;
+    return _files.erase(file);
+}
@@ -0,0 +1,74 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "shared/src/native-src/dd_filesystem.hpp"
+// namespace fs is an alias defined in "dd_filesystem.hpp"
+
+// Keeps on disk the profiles that could not be uploaded so that they can be replayed,
+// oldest first, once the agent is reachable again.
+// The size of the spooled profiles is bounded per service: the oldest profiles of a service
+// are removed to make room for the new ones.
+// Each file starts with the name of its service so that the files left by a previous process
+// (i.e. crashed or exited before the agent was reachable) are replayed too: they are loaded when
+// the spool is created and counted in the size of their service.
+// The directory is shared by the processes: each one writes its files in a subdirectory named
+// after its id and, when its spool is created, only adopts the files of the processes that have
+// exited. The files of the running processes are left untouched (they will upload them).
+// It is not thread safe: it is expected to be used by the thread uploading the profiles.
+class ProfileSpool
+{
+public:
+    ProfileSpool(fs::path directory, std::uint64_t maxSizePerService);
+
+    ProfileSpool(const ProfileSpool&) = delete;
+    ProfileSpool& operator=(const ProfileSpool&) = delete;
+
+    bool Write(std::string const& service, std::vector<std::uint8_t> const& content);
+    bool ReadOldest(std::vector<std::uint8_t>& content);
+    void RemoveOldest();
+
+    std::size_t GetCount() const;
+    std::uint64_t GetSize(std::string const& service) const;
+
+private:
+    struct SpooledFile
+    {
+        fs::path Path;
+        std::string Service;
+        std::uint64_t HeaderSize;
+        std::uint64_t Size; // of the content (without the header)
+    };
+
+    void LoadExistingFiles();
+    void AdoptFilesOfExitedProcesses();
+    void AdoptFiles(fs::path const& directory);
+    static bool TryParseProcessId(std::string const& name, int& processId);
+    bool TryReadHeader(fs::path const& path, std::string& service, std::uint64_t& size);
+    void RemoveOldestOverLimit();
+    fs::path GetNextFilePath();
+    // return the iterator following the removed file
+    std::deque<SpooledFile>::iterator Remove(std::deque<SpooledFile>::iterator file);
+
+private:
+    static std::string const FileExtension;
+    static std::string const TemporaryFileExtension;
+    static std::uint32_t const MaxServiceNameSize = 4096;
+
+    const fs::path _rootDirectory;
+    // files of this process
+    const fs::path _directory;
+    const std::uint64_t _maxSizePerService;
+    bool _isDirectoryAvailable;
+
+    // sorted from the oldest to the most recent
+    std::deque<SpooledFile> _files;
+    std::unordered_map<std::string, std::uint64_t> _sizePerService;
+    std::uint64_t _nextSequenceNumber;
+};
@@ -0,0 +1,256 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include "ProfileUploadQueue.h"
+
+#include "IMetricsSender.h"
+#include "Log.h"
+
+using namespace std::literals::chrono_literals;
+
+// with an upload every minute, a few profiles (one per application) are expected at most
+const std::size_t ProfileUploadQueue::DefaultMaxPendingUploads = 10;
+
+// 1s + 2s + 4s of backoff between the attempts
+const std::int32_t ProfileUploadQueue::DefaultMaxRetries = 3;
+const std::chrono::milliseconds ProfileUploadQueue::DefaultInitialBackoff = 1s;
+
+// the process exit is not delayed longer than that by the last upload
+const std::chrono::milliseconds ProfileUploadQueue::DefaultShutdownTimeout = 3s;
+
+std::string const ProfileUploadQueue::QueueDepthMetricName = "datadog.profiling.dotnet.operational.upload_queue_depth";
+std::string const ProfileUploadQueue::UploadDurationMetricName = "datadog.profiling.dotnet.operational.upload_duration_ms";
+std::string const ProfileUploadQueue::DroppedUploadsMetricName = "datadog.profiling.dotnet.operational.dropped_uploads";
+
+ProfileUploadQueue::ProfileUploadQueue(IMetricsSender* metricsSender,
+                                       std::size_t maxPendingUploads,
+                                       std::int32_t maxRetries,
+                                       std::chrono::milliseconds initialBackoff,
+                                       std::chrono::milliseconds shutdownTimeout) :
+    _metricsSender{metricsSender},
+    _maxPendingUploads{maxPendingUploads},
+    _maxRetries{maxRetries},
+    _initialBackoff{initialBackoff},
+    _shutdownTimeout{shutdownTimeout},
+    _mustStop{false},
+    _droppedUploadsCount{0}
+{
+}
+
+const char* ProfileUploadQueue::GetName()
+{
+    return _serviceName;
+}
+
+bool ProfileUploadQueue::Start()
+{
+    Log::Info("Starting the profile upload queue");
+    {
+        std::lock_guard<std::mutex> lock(_pendingUploadsLock);
+        _mustStop = false;
+    }
+    _worker = std::thread(&ProfileUploadQueue::Work, this);
+
+    return true;
+}
+
+bool ProfileUploadQueue::Stop()
+{
+    Log::Info("Stopping the profile upload queue");
+    {
+        std::lock_guard<std::mutex> lock(_pendingUploadsLock);
+        _mustStop = true;
+        _shutdownDeadline = std::chrono::steady_clock::now() + _shutdownTimeout;
+    }
+    _wakeUpCondition.notify_all();
+
+    // the most recent pending profile (i.e. exported by the aggregator when it stopped) is uploaded before leaving;
+    // the others are spooled
+    if (_worker.joinable())
+    {
+        _worker.join();
+    }
+
+    return true;
+}
+
+void ProfileUploadQueue::Enqueue(UploadTask task, FailureHandler onFailure)
+{
+    std::size_t depth = 0;
+    bool dropped = false;
+    {
+        std::lock_guard<std::mutex> lock(_pendingUploadsLock);
+        if (_pendingUploads.size() >= _maxPendingUploads)
+        {
+            // the profile is not lost: its failure handler (i.e. spooling) must run on the upload thread,
+            // as soon as the current upload is done
+            _droppedUploads.push_back(std::move(_pendingUploads.front()));
+            _pendingUploads.pop_front();
+            _droppedUploadsCount++;
+            dropped = true;
+        }
+
+        _pendingUploads.push_back({std::move(task), std::move(onFailure)});
+        depth = _pendingUploads.size();
+    }
+    _wakeUpCondition.notify_one();
+
+    if (dropped)
+    {
+        Log::Warn("Too many profiles are waiting to be uploaded: the oldest one is given up.");
+    }
+
+    if (_metricsSender != nullptr)
+    {
+        if (dropped)
+        {
+            _metricsSender->Counter(DroppedUploadsMetricName, 1);
+        }
+        _metricsSender->Gauge(QueueDepthMetricName, static_cast<double>(depth));
+    }
+}
+
+std::size_t ProfileUploadQueue::GetPendingUploadsCount()
+{
+    std::lock_guard<std::mutex> lock(_pendingUploadsLock);
+    return _pendingUploads.size();
+}
+
+std::uint64_t ProfileUploadQueue::GetDroppedUploadsCount()
+{
+    std::lock_guard<std::mutex> lock(_pendingUploadsLock);
+    return _droppedUploadsCount;
+}
+
+void ProfileUploadQueue::Work()
+{
+    while (true)
+    {
+        PendingUpload upload;
+        std::deque<PendingUpload> givenUpUploads;
+        bool isStopping;
+        {
+            std::unique_lock<std::mutex> lock(_pendingUploadsLock);
+            _wakeUpCondition.wait(lock, [this] { return _mustStop || !_pendingUploads.empty() || !_droppedUploads.empty(); });
+
+            givenUpUploads = std::move(_droppedUploads);
+            _droppedUploads.clear();
+
+            // when stopping, only the most recent profile is uploaded
+            isStopping = _mustStop;
+            while (isStopping && (_pendingUploads.size() > 1))
+            {
+                givenUpUploads.push_back(std::move(_pendingUploads.front()));
+                _pendingUploads.pop_front();
+            }
+
+            if (!_pendingUploads.empty())
+            {
+                upload = std::move(_pendingUploads.front());
+                _pendingUploads.pop_front();
+            }
+        }
+
+        for (auto const& givenUpUpload : givenUpUploads)
+        {
+            OnFailure(givenUpUpload);
+        }
+
+        if (upload.Task == nullptr)
+        {
+            if (isStopping)
+            {
+                return;
+            }
+            continue;
+        }
+
+        bool success = isStopping ? UploadWhileStopping(upload.Task) : Upload(upload.Task);
+        if (!success)
+        {
+            OnFailure(upload);
+        }
+    }
+}
+
+void ProfileUploadQueue::OnFailure(PendingUpload const& upload)
+{
+    if (upload.OnFailure != nullptr)
+    {
+        upload.OnFailure();
+    }
+}
+
+bool ProfileUploadQueue::UploadWhileStopping(UploadTask const& task)
+{
+    std::chrono::steady_clock::time_point deadline;
+    {
+        std::lock_guard<std::mutex> lock(_pendingUploadsLock);
+        deadline = _shutdownDeadline;
+    }
+
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+    if (remaining.count() <= 0)
+    {
+        Log::Info("The profile is not uploaded because the shutdown timeout has expired.");
+        return false;
+    }
+
+    // a single attempt: the process is exiting
+    try
+    {
+        return task(remaining);
+    }
+    catch (std::exception const& ex)
+    {
+        Log::Error("An exception occured while uploading a profile: ", ex.what());
+    }
+
+    return false;
+}
+
+bool ProfileUploadQueue::Upload(UploadTask const& task)
+{
+    auto backoff = _initialBackoff;
+    for (std::int32_t attempt = 0;; attempt++)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        bool success = false;
+        try
+        {
+            success = task(std::nullopt);
+        }
+        catch (std::exception const& ex)
+        {
+            Log::Error("An exception occured while uploading a profile: ", ex.what());
+        }
+
+        if (_metricsSender != nullptr)
+        {
+            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+            _metricsSender->Gauge(UploadDurationMetricName, static_cast<double>(duration.count()));
+        }
+
+        if (success)
+        {
+            return true;
+        }
+
+        if (attempt >= _maxRetries)
+        {
+            Log::Warn("The profile could not be uploaded after ", attempt + 1, " attempts.");
+            return false;
+        }
+
+        // no retry when stopping: the profile is given up (i.e. spooled)
+        std::unique_lock<std::mutex> lock(_pendingUploadsLock);
+        if (_wakeUpCondition.wait_for(lock, backoff, [this] { return _mustStop; }))
+        {
+            Log::Info("The profile upload is not retried because the profiler is stopping.");
+            return false;
+        }
+
+        backoff *= 2;
+    }
+}
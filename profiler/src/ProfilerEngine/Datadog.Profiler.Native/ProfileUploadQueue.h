@@ -0,0 +1,91 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include "IService.h"
+
+class IMetricsSender;
+
+// Uploads the serialized profiles from a dedicated thread so that a slow or unreachable agent
+// does not block the samples aggregator (and the providers feeding it) for the whole HTTP timeout.
+// A failed upload is retried with an exponential backoff. When too many profiles are waiting,
+// the oldest one is given up (i.e. spooled by its failure handler) to bound the memory.
+// When stopping, only the most recent profile is uploaded, once and within the shutdown timeout:
+// the other pending profiles are given up so that the exit of the process is not delayed.
+class ProfileUploadQueue : public IService
+{
+public:
+    // returns true if the profile has been successfully uploaded.
+    // When stopping, the remaining time of the shutdown timeout is given: the upload must not take
+    // longer and must not upload other profiles (i.e. spooled ones)
+    using UploadTask = std::function<bool(std::optional<std::chrono::milliseconds> shutdownTimeout)>;
+    // called from the upload thread when the profile could not be uploaded (even after retries)
+    using FailureHandler = std::function<void()>;
+
+    static const std::size_t DefaultMaxPendingUploads;
+    static const std::int32_t DefaultMaxRetries;
+    static const std::chrono::milliseconds DefaultInitialBackoff;
+    static const std::chrono::milliseconds DefaultShutdownTimeout;
+
+    ProfileUploadQueue(IMetricsSender* metricsSender,
+                       std::size_t maxPendingUploads = DefaultMaxPendingUploads,
+                       std::int32_t maxRetries = DefaultMaxRetries,
+                       std::chrono::milliseconds initialBackoff = DefaultInitialBackoff,
+                       std::chrono::milliseconds shutdownTimeout = DefaultShutdownTimeout);
+
+    ProfileUploadQueue(const ProfileUploadQueue&) = delete;
+    ProfileUploadQueue& operator=(const ProfileUploadQueue&) = delete;
+
+    // Inherited via IService
+    const char* GetName() override;
+    bool Start() override;
+    bool Stop() override;
+
+    void Enqueue(UploadTask task, FailureHandler onFailure = nullptr);
+    std::size_t GetPendingUploadsCount();
+    std::uint64_t GetDroppedUploadsCount();
+
+private:
+    struct PendingUpload
+    {
+        UploadTask Task;
+        FailureHandler OnFailure;
+    };
+
+    void Work();
+    bool Upload(UploadTask const& task);
+    bool UploadWhileStopping(UploadTask const& task);
+    static void OnFailure(PendingUpload const& upload);
+
+private:
+    const char* _serviceName = "ProfileUploadQueue";
+    static const std::string QueueDepthMetricName;
+    static const std::string UploadDurationMetricName;
+    static const std::string DroppedUploadsMetricName;
+
+    IMetricsSender* _metricsSender;
+    const std::size_t _maxPendingUploads;
+    const std::int32_t _maxRetries;
+    const std::chrono::milliseconds _initialBackoff;
+    const std::chrono::milliseconds _shutdownTimeout;
+
+    std::thread _worker;
+    std::mutex _pendingUploadsLock;
+    std::condition_variable _wakeUpCondition;
+    // the following fields are protected by _pendingUploadsLock
+    bool _mustStop;
+    std::chrono::steady_clock::time_point _shutdownDeadline;
+    std::deque<PendingUpload> _pendingUploads;
+    // dropped when the queue was full: their failure handler is called from the upload thread
+    std::deque<PendingUpload> _droppedUploads;
+    std::uint64_t _droppedUploadsCount;
+};
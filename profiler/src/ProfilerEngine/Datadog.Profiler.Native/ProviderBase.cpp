@@ -5,18 +5,33 @@
 #include "Sample.h"
 
 
-void ProviderBase::Store(Sample&& sample)
+ProviderBase::ProviderBase(std::size_t shardsCount) :
+    _shardsCount{(shardsCount == 0) ? 1 : shardsCount},
+    _shards{std::make_unique<Shard[]>(_shardsCount)}
 {
-    std::lock_guard<std::mutex> lock(_samplesLock);
+}
+
 
-    _samples.push_back(std::move(sample));
+void ProviderBase::Store(Sample&& sample, std::size_t shardIndex)
+{
+    auto& shard = _shards[shardIndex % _shardsCount];
+    std::lock_guard<std::mutex> lock(shard.Lock);
+
+    shard.Samples.push_back(std::move(sample));
 }
 
 
 std::list<Sample> ProviderBase::GetSamples()
 {
-    std::lock_guard<std::mutex> lock(_samplesLock);
+    std::list<Sample> samplesToReturn;
+    for (std::size_t i = 0; i < _shardsCount; i++)
+    {
+        auto& shard = _shards[i];
+        std::lock_guard<std::mutex> lock(shard.Lock);
+
+        // splicing moves the nodes without copying the samples: the shard is empty now
+        samplesToReturn.splice(samplesToReturn.end(), shard.Samples);
+    }
 
-    auto samplesToReturn = std::move(_samples);  // _samples is empty now
     return samplesToReturn;
 }
@@ -2,6 +2,7 @@
 // This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
 
 #pragma once
+#include <memory>
 #include <mutex>
 #include <list>
 
@@ -9,15 +10,26 @@
 #include "Sample.h"
 
 
+// The samples are stored into shards so that several threads can store samples at the same
+// time without contending on the same lock: each transformer thread uses its own shard.
+// The shards are merged when the samples are retrieved.
 class ProviderBase : public ISamplesProvider
 {
 public:
+    ProviderBase(std::size_t shardsCount = 1);
+
     std::list<Sample> GetSamples() override;
 
 protected:
-    void Store(Sample&& sample);
+    void Store(Sample&& sample, std::size_t shardIndex = 0);
 
-protected:
-    std::mutex _samplesLock;
-    std::list<Sample> _samples;
+private:
+    struct Shard
+    {
+        std::mutex Lock;
+        std::list<Sample> Samples;
+    };
+
+    std::size_t _shardsCount;
+    std::unique_ptr<Shard[]> _shards;
 };
@@ -0,0 +1,17 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "RawSample.h"
+
+class RawAllocationSample : public RawSample
+{
+public:
+    std::string AllocationClass;    // type name of the sampled object
+    std::uint64_t AllocationAmount; // bytes allocated since the previous sample
+    std::uint64_t AllocationSize;   // size in bytes of the sampled object (0 if not provided by the runtime)
+};
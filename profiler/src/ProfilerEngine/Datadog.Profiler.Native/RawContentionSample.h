@@ -0,0 +1,15 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#pragma once
+
+#include <cstdint>
+
+#include "RawSample.h"
+
+class RawContentionSample : public RawSample
+{
+public:
+    std::uint64_t ContentionDuration;   // in nanoseconds
+    std::uint64_t LockOwnerThreadId;    // 0 if unknown
+};
@@ -8,5 +8,5 @@
 class RawCpuSample : public RawSample
 {
 public:
-    std::uint64_t Duration;  // in milliseconds
+    std::uint64_t Duration;  // in nanoseconds
 };
@@ -0,0 +1,17 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "RawSample.h"
+
+class RawExceptionSample : public RawSample
+{
+public:
+    std::string ExceptionType;      // type name of the thrown exception
+    std::string ExceptionMessage;   // empty if not available
+    std::uint64_t Count;            // number of exceptions of this type represented by the sample
+};
@@ -0,0 +1,21 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#pragma once
+
+#include <cstdint>
+
+#include "cor.h"
+#include "corprof.h"
+
+#include "RawSample.h"
+
+class RawGarbageCollectionSample : public RawSample
+{
+public:
+    std::int32_t Generation;        // highest collected generation (LOH/POH are reported as gen 2)
+    COR_PRF_GC_REASON Reason;
+    std::uint64_t Duration;         // in nanoseconds, between the start and the end of the collection
+    std::uint64_t PauseDuration;    // in nanoseconds, while the runtime was suspended (0 for background collections)
+    std::int64_t EndTimestampNs;    // unix time of the end of the collection, in nanoseconds
+};
@@ -14,7 +14,6 @@ class RawSample
 {
 public:
     RawSample();
-    virtual ~RawSample() = default;
 
 public:
     std::uint64_t Timestamp;        // _unixTimeUtc;
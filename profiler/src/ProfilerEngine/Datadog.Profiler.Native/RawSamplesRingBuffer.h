@@ -0,0 +1,162 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+// Bounded single-producer/single-consumer queue of raw samples.
+//
+// All memory is allocated once in the constructor:
+//  - a fixed number of slots, each one holding the scalar fields of a TRawSample
+//  - one slab of instruction pointers where each slot owns MaxFramesCount entries
+// so pushing a sample neither allocates nor takes a lock.
+//
+// When the consumer is too slow and the buffer is full, new samples are dropped and counted.
+// Stacks deeper than MaxFramesCount are truncated (the deepest frames are lost) and counted.
+//
+// TryPush() must only be called by one thread at a time (the producer) and TryPop() must only be
+// called by one thread at a time (the consumer).
+//
+template <class TRawSample>
+class RawSamplesRingBuffer
+{
+public:
+    RawSamplesRingBuffer(std::size_t capacity, std::size_t maxFramesCount) :
+        _capacity{RoundUpToPowerOfTwo(capacity)},
+        _mask{_capacity - 1},
+        _maxFramesCount{maxFramesCount},
+        _slots{std::make_unique<Slot[]>(_capacity)},
+        _stackSlab{std::make_unique<std::uintptr_t[]>(_capacity * maxFramesCount)}
+    {
+    }
+
+    RawSamplesRingBuffer(const RawSamplesRingBuffer&) = delete;
+    RawSamplesRingBuffer& operator=(const RawSamplesRingBuffer&) = delete;
+
+public:
+    // Producer side: returns false if the sample was dropped because the buffer is full.
+    // In that case, the given sample is left untouched so the caller can release what it owns.
+    bool TryPush(TRawSample&& rawSample)
+    {
+        return TryPush(std::forward<TRawSample>(rawSample), rawSample.Stack.data(), rawSample.Stack.size());
+    }
+
+    // Same as above but the instruction pointers are copied from the given frames instead of the Stack of the sample
+    bool TryPush(TRawSample&& rawSample, std::uintptr_t const* pFrames, std::size_t stackSize)
+    {
+        auto writeIndex = _writeIndex.load(std::memory_order_relaxed);
+        if (writeIndex - _readIndex.load(std::memory_order_acquire) == _capacity)
+        {
+            _droppedCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        auto position = writeIndex & _mask;
+        auto& slot = _slots[position];
+
+        // copy the instruction pointers into the slab instead of keeping the vector
+        auto framesCount = std::min(stackSize, _maxFramesCount);
+        if (framesCount < stackSize)
+        {
+            _truncatedCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        std::copy_n(pFrames, framesCount, GetStackAt(position));
+        slot.FramesCount = framesCount;
+
+        // the stack is temporarily taken out of the sample so that only the other fields are copied
+        std::vector<std::uintptr_t> stack;
+        stack.swap(rawSample.Stack);
+        slot.Sample = std::move(rawSample);
+        stack.swap(rawSample.Stack);
+
+        _writeIndex.store(writeIndex + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: returns false if the buffer is empty.
+    // The Stack vector of the given sample is reused to avoid allocations when popping in a loop
+    bool TryPop(TRawSample& rawSample)
+    {
+        auto readIndex = _readIndex.load(std::memory_order_relaxed);
+        if (readIndex == _writeIndex.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        auto position = readIndex & _mask;
+        auto const& slot = _slots[position];
+
+        std::vector<std::uintptr_t> stack;
+        stack.swap(rawSample.Stack);
+        rawSample = slot.Sample;
+
+        auto* pFrames = GetStackAt(position);
+        stack.assign(pFrames, pFrames + slot.FramesCount);
+        stack.swap(rawSample.Stack);
+
+        _readIndex.store(readIndex + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::size_t Size() const
+    {
+        return static_cast<std::size_t>(_writeIndex.load(std::memory_order_acquire) - _readIndex.load(std::memory_order_acquire));
+    }
+
+    std::size_t GetCapacity() const
+    {
+        return _capacity;
+    }
+
+    std::uint64_t GetDroppedCount() const
+    {
+        return _droppedCount.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t GetTruncatedCount() const
+    {
+        return _truncatedCount.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Slot
+    {
+        TRawSample Sample;
+        std::size_t FramesCount = 0;
+    };
+
+    static std::size_t RoundUpToPowerOfTwo(std::size_t value)
+    {
+        std::size_t result = 1;
+        while (result < value)
+        {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    inline std::uintptr_t* GetStackAt(std::size_t position) const
+    {
+        return _stackSlab.get() + position * _maxFramesCount;
+    }
+
+private:
+    const std::size_t _capacity;
+    const std::size_t _mask;
+    const std::size_t _maxFramesCount;
+
+    std::unique_ptr<Slot[]> _slots;
+    std::unique_ptr<std::uintptr_t[]> _stackSlab;
+
+    // producer and consumer indexes are kept on different cache lines to avoid false sharing
+    alignas(64) std::atomic<std::uint64_t> _writeIndex = 0;
+    alignas(64) std::atomic<std::uint64_t> _readIndex = 0;
+
+    std::atomic<std::uint64_t> _droppedCount = 0;
+    std::atomic<std::uint64_t> _truncatedCount = 0;
+};
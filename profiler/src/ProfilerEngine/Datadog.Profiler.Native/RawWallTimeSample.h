@@ -14,4 +14,5 @@ class RawWallTimeSample : public RawSample
 {
 public:
     std::uint64_t  Duration;  // in nanoseconds
+    bool DuringGarbageCollection = false;  // the stack is replaced by the "Garbage Collector" frame
 };
@@ -3,6 +3,8 @@
 
 #include "Sample.h"
 
+#include <functional>
+
 // define well known label string constants
 const std::string Sample::ThreadIdLabel = "thread id";
 const std::string Sample::ThreadNameLabel = "thread name";
@@ -10,6 +12,15 @@ const std::string Sample::AppDomainNameLabel = "appdomain name";
 const std::string Sample::ProcessIdLabel = "appdomain process id";
 const std::string Sample::LocalRootSpanIdLabel = "local root span id";
 const std::string Sample::SpanIdLabel = "span id";
+const std::string Sample::AllocationClassLabel = "allocation class";
+const std::string Sample::LockOwnerThreadIdLabel = "lock owner thread id";
+const std::string Sample::ContentionDurationBucketLabel = "lock duration bucket";
+const std::string Sample::ExceptionTypeLabel = "exception type";
+const std::string Sample::ExceptionMessageLabel = "exception message";
+const std::string Sample::GarbageCollectionGenerationLabel = "gc generation";
+const std::string Sample::GarbageCollectionReasonLabel = "gc reason";
+const std::string Sample::GarbageCollectionPauseDurationLabel = "gc pause duration";
+const std::string Sample::EndTimestampLabel = "end_timestamp_ns";
 
 
 Sample::Sample(uint64_t timestamp, std::string_view runtimeId) :
@@ -24,6 +35,7 @@ Sample::Sample(std::string_view runtimeId)
     _timestamp = 0;
     _values = {0};
     _labels = {};
+    _numericLabels = {};
     _callstack = {};
     _runtimeId = runtimeId;
 }
@@ -39,6 +51,7 @@ Sample& Sample::operator=(Sample&& other) noexcept
     _callstack = std::move(other._callstack);
     _values = std::move(other._values);
     _labels = std::move(other._labels);
+    _numericLabels = std::move(other._numericLabels);
     _runtimeId = other._runtimeId;
 
     return *this;
@@ -79,12 +92,62 @@ void Sample::AddValue(std::int64_t value, SampleValue index)
     _values[pos] = value;
 }
 
-void Sample::AddFrame(const std::string& moduleName, const std::string& frame)
+void Sample::AddFrame(FrameId frame)
+{
+    _callstack.push_back(frame);
+}
+
+void Sample::AddFrame(std::string_view moduleName, std::string_view frame)
+{
+    auto* pStringTable = StringTable::GetInstance();
+    _callstack.push_back({pStringTable->Intern(moduleName), pStringTable->Intern(frame)});
+}
+
+void Sample::SumValues(const Values& values)
+{
+    for (size_t i = 0; i < array_size; i++)
+    {
+        _values[i] += values[i];
+    }
+}
+
+bool Sample::HasSameCallstackAndLabels(const Sample& other) const
 {
-    _callstack.push_back({ moduleName, frame });
+    return (_runtimeId == other._runtimeId) &&
+           (_callstack == other._callstack) &&
+           (_labels == other._labels) &&
+           (_numericLabels == other._numericLabels);
 }
 
-const std::vector<std::pair<std::string, std::string>>& Sample::GetCallstack() const
+std::size_t Sample::GetCallstackAndLabelsHash() const
+{
+    // boost::hash_combine like
+    auto combine = [](std::size_t& seed, std::size_t value) {
+        seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    };
+
+    std::size_t hash = std::hash<std::string_view>{}(_runtimeId);
+    for (auto const& frame : _callstack)
+    {
+        combine(hash, std::hash<std::uint64_t>{}(frame.GetKey()));
+    }
+
+    for (auto const& [name, value] : _labels)
+    {
+        combine(hash, std::hash<std::string>{}(name));
+        combine(hash, std::hash<std::string>{}(value));
+    }
+
+    for (auto const& label : _numericLabels)
+    {
+        combine(hash, std::hash<std::string>{}(label.Name));
+        combine(hash, std::hash<std::int64_t>{}(label.Value));
+    }
+
+    return hash;
+}
+
+const std::vector<FrameId>& Sample::GetCallstack() const
 {
     return _callstack;
 }
@@ -94,6 +157,11 @@ void Sample::AddLabel(const Label& label)
     _labels.push_back(label);
 }
 
+void Sample::AddNumericLabel(const NumericLabel& label)
+{
+    _numericLabels.push_back(label);
+}
+
 std::string_view Sample::GetRuntimeId() const
 {
     return _runtimeId;
@@ -104,6 +172,11 @@ const Labels& Sample::GetLabels() const
     return _labels;
 }
 
+const NumericLabels& Sample::GetNumericLabels() const
+{
+    return _numericLabels;
+}
+
 void Sample::SetPid(const std::string& pid)
 {
     AddLabel(Label{ProcessIdLabel, pid});
@@ -10,6 +10,8 @@
 #include <tuple>
 #include <vector>
 
+#include "FrameId.h"
+
 struct SampleValueType
 {
     const std::string& Name;
@@ -23,6 +25,12 @@ SampleValueType const SampleTypeDefinitions[] =
 {
     {"wall", "nanoseconds"},// WallTimeDuration
     {"cpu", "nanoseconds"}, // CPUTimeDuration
+    {"alloc-samples", "count"}, // AllocationCount
+    {"alloc-size", "bytes"},    // AllocationSize
+    {"lock-count", "count"},        // ContentionCount
+    {"lock-time", "nanoseconds"},   // ContentionDuration
+    {"exception", "count"},         // ExceptionCount
+    {"timeline", "nanoseconds"},    // GarbageCollectionDuration
 
     // the new ones should be added here at the same time
     // new identifiers are added to SampleValue
@@ -39,15 +47,19 @@ enum class SampleValue : size_t
     // CPU time profiler
     CpuTimeDuration = 1,
 
-    //// Allocation tick profiler
-    //AllocationCount = 2,
+    // Allocations profiler
+    AllocationCount = 2,
+    AllocationSize = 3,
+
+    // Lock contention profiler
+    ContentionCount = 4,
+    ContentionDuration = 5,
 
-    //// Thread contention profiler
-    //ContentionCount = 3,
-    //ContentionDuration = 4,
+    // Exception profiler
+    ExceptionCount = 6,
 
-    //// Exception profiler
-    //ExceptionCount = 5
+    // Garbage collections timeline
+    GarbageCollectionDuration = 7,
 };
 //
 static constexpr size_t array_size = sizeof(SampleTypeDefinitions) / sizeof(SampleTypeDefinitions[0]);
@@ -57,6 +69,20 @@ typedef std::array<int64_t, array_size> Values;
 typedef std::pair<std::string, std::string> Label;  // TODO: use stringview to avoid copy
 typedef std::list<Label> Labels;
 
+// value that the backend can aggregate or sort (i.e. durations, timestamps)
+struct NumericLabel
+{
+    std::string Name;
+    std::int64_t Value;
+    std::string Unit; // optional
+
+    bool operator==(const NumericLabel& other) const
+    {
+        return (Value == other.Value) && (Name == other.Name) && (Unit == other.Unit);
+    }
+};
+typedef std::list<NumericLabel> NumericLabels;
+
 
 /// <summary>
 /// Unfinished class. The purpose, for now, is just to work on the export component.
@@ -74,8 +100,9 @@ public:
 public:
     uint64_t GetTimeStamp() const;
     const Values& GetValues() const;
-    const std::vector<std::pair<std::string, std::string>>& GetCallstack() const;
+    const std::vector<FrameId>& GetCallstack() const;
     const Labels& GetLabels() const;
+    const NumericLabels& GetNumericLabels() const;
     std::string_view GetRuntimeId() const;
 
 // Since this class is not finished, this method is only for test purposes
@@ -85,8 +112,14 @@ public:
 // but it seems better for encapsulation to do the transformation between collected raw data
 // and a Sample in each Provider (this is the each behind CollectorBase template class)
     void AddValue(std::int64_t value, SampleValue index);
-    void AddFrame(const std::string& moduleName, const std::string& frame); // TODO: use stringview to avoid copy
+    void AddFrame(FrameId frame);
+    // used when aggregating samples with the same callstack and labels
+    void SumValues(const Values& values);
+    bool HasSameCallstackAndLabels(const Sample& other) const;
+    std::size_t GetCallstackAndLabelsHash() const;
+    void AddFrame(std::string_view moduleName, std::string_view frame); // interns both strings
     void AddLabel(const Label& label);
+    void AddNumericLabel(const NumericLabel& label);
 
 // helpers for well known mandatory labels
     void SetPid(const std::string& pid);
@@ -102,11 +135,21 @@ public:
     static const std::string AppDomainNameLabel;
     static const std::string LocalRootSpanIdLabel;
     static const std::string SpanIdLabel;
+    static const std::string AllocationClassLabel;
+    static const std::string LockOwnerThreadIdLabel;
+    static const std::string ContentionDurationBucketLabel;
+    static const std::string ExceptionTypeLabel;
+    static const std::string ExceptionMessageLabel;
+    static const std::string GarbageCollectionGenerationLabel;
+    static const std::string GarbageCollectionReasonLabel;
+    static const std::string GarbageCollectionPauseDurationLabel;
+    static const std::string EndTimestampLabel;
 
 private:
     uint64_t _timestamp;
-    std::vector<std::pair<std::string, std::string>> _callstack; // TODO: use stringview to avoid copy
+    std::vector<FrameId> _callstack;
     Values _values;
     Labels _labels;
+    NumericLabels _numericLabels;
     std::string_view _runtimeId;
 };
\ No newline at end of file
@@ -28,7 +28,9 @@ SamplesAggregator::SamplesAggregator(IConfiguration* configuration,
     _nextExportTime{std::chrono::steady_clock::now() + _uploadInterval},
     _exporter{exporter},
     _mustStop{false},
-    _metricsSender{metricsSender}
+    _metricsSender{metricsSender},
+    _collectedSamplesCount{0},
+    _aggregatedSamplesCount{0}
 {
 }
 
@@ -75,30 +77,97 @@ std::list<Sample> SamplesAggregator::CollectSamples()
 
 void SamplesAggregator::Work()
 {
-    while (!_mustStop)
+    while (true)
     {
-        // TODO catch structured exception
-        //      or make the library able to catch then using try/catch
-        try
+        std::this_thread::sleep_for(ProcessingInterval);
+
+        if (_mustStop)
         {
-            std::this_thread::sleep_for(ProcessingInterval);
+            break;
+        }
+
+        ProcessSamples();
+    }
+
+    // the samples collected since the previous export are exported (without waiting for the
+    // upload interval) before the exporter and its upload queue are stopped
+    ProcessSamples();
+}
+
+void SamplesAggregator::ProcessSamples()
+{
+    // TODO catch structured exception
+    //      or make the library able to catch then using try/catch
+    try
+    {
+        auto samples = CollectSamples();
+
+        Aggregate(samples);
+
+        Export();
+    }
+    catch (std::exception const& ex)
+    {
+        SendHeartBeatMetric(false);
+        Log::Error("An exception occured: ", ex.what());
+    }
+}
+
+void SamplesAggregator::Aggregate(std::list<Sample>& samples)
+{
+    for (auto& sample : samples)
+    {
+        _collectedSamplesCount++;
 
-            auto samples = CollectSamples();
+        auto& bucket = _aggregatedSamples[sample.GetCallstackAndLabelsHash()];
 
-            for (auto const& sample : samples)
+        auto aggregatedSample = bucket.begin();
+        for (; aggregatedSample != bucket.end(); ++aggregatedSample)
+        {
+            if (aggregatedSample->HasSameCallstackAndLabels(sample))
             {
-                _exporter->Add(sample);
+                break;
             }
+        }
 
-            Export();
+        if (aggregatedSample != bucket.end())
+        {
+            aggregatedSample->SumValues(sample.GetValues());
+        }
+        else
+        {
+            bucket.push_back(std::move(sample));
 
+            // the exporter encodes the samples in a more compact way
+            if (++_aggregatedSamplesCount >= MaxAggregatedSamplesCount)
+            {
+                FlushAggregatedSamples();
+            }
         }
-        catch (std::exception const& ex)
+    }
+}
+
+void SamplesAggregator::FlushAggregatedSamples()
+{
+    std::uint64_t aggregatedSamplesCount = 0;
+    auto collectedSamplesCount = _collectedSamplesCount;
+    _collectedSamplesCount = 0;
+    _aggregatedSamplesCount = 0;
+
+    // the aggregated samples are discarded even if the exporter fails
+    auto aggregatedSamples = std::move(_aggregatedSamples);
+    _aggregatedSamples.clear();
+
+    for (auto const& [hash, bucket] : aggregatedSamples)
+    {
+        for (auto const& sample : bucket)
         {
-            SendHeartBeatMetric(false);
-            Log::Error("An exception occured: ", ex.what());
+            _exporter->Add(sample);
+            aggregatedSamplesCount++;
         }
     }
+
+    Log::Debug(collectedSamplesCount, " samples aggregated into ", aggregatedSamplesCount, " samples.");
 }
 
 void SamplesAggregator::Export()
@@ -110,6 +179,8 @@ void SamplesAggregator::Export()
     {
         _nextExportTime = now + _uploadInterval;
 
+        FlushAggregatedSamples();
+
         auto success = _exporter->Export();
 
         SendHeartBeatMetric(success);
@@ -2,12 +2,15 @@
 // This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
 
 #pragma once
+#include <atomic>
 #include <chrono>
 #include <forward_list>
 #include <list>
 #include <memory>
 #include <string>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "IService.h"
 
@@ -21,6 +24,11 @@ class ISamplesProvider;
 
 class SamplesAggregator : public IService
 {
+public:
+    // beyond this number of distinct samples, the aggregated samples are given to the exporter
+    // before the next export: the samples collected afterwards are aggregated separately
+    static const std::size_t MaxAggregatedSamplesCount = 10000;
+
 public:
     SamplesAggregator(IConfiguration* configuration, IExporter* exporter, IMetricsSender* metricsSender);
 
@@ -33,8 +41,11 @@ public:
 
 private:
     void Work();
+    void ProcessSamples();
     std::list<Sample> CollectSamples();
+    void Aggregate(std::list<Sample>& samples);
     void Export();
+    void FlushAggregatedSamples();
     void SendHeartBeatMetric(bool success);
 
 private:
@@ -47,6 +58,13 @@ private:
     std::forward_list<ISamplesProvider*> _samplesProviders;
     IExporter* _exporter;
     std::thread _worker;
-    bool _mustStop;
+    std::atomic<bool> _mustStop;
     IMetricsSender* _metricsSender;
+
+    // samples with the same callstack and labels are merged (their values are summed)
+    // until the next export so that the exporter receives one sample per unique stack
+    //                 V-- hash of callstack + labels (collisions are kept in the vector)
+    std::unordered_map<std::size_t, std::vector<Sample>> _aggregatedSamples;
+    std::size_t _aggregatedSamplesCount;
+    std::uint64_t _collectedSamplesCount;
 };
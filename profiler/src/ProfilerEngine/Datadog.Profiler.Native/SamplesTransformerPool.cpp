@@ -0,0 +1,203 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include "SamplesTransformerPool.h"
+
+#include "Log.h"
+#include "OpSysTools.h"
+
+#include "shared/src/native-src/string.h"
+
+SamplesTransformerPool::SamplesTransformerPool(std::size_t workersCount) :
+    _workersCount{(workersCount == 0) ? 1 : workersCount},
+    _workers{std::make_unique<Worker[]>(_workersCount)},
+    _nextWorkerIndex{0},
+    _isStarted{false},
+    _mustStop{false},
+    _pendingTasksCount{0}
+{
+}
+
+SamplesTransformerPool::~SamplesTransformerPool()
+{
+    Stop();
+}
+
+const char* SamplesTransformerPool::GetName()
+{
+    return _serviceName;
+}
+
+bool SamplesTransformerPool::Start()
+{
+    Log::Info("Starting ", _workersCount, " samples transformer threads");
+    {
+        std::lock_guard<std::mutex> lock(_wakeUpLock);
+        _mustStop = false;
+    }
+
+    for (std::size_t i = 0; i < _workersCount; i++)
+    {
+        auto& worker = _workers[i];
+        worker.Thread = std::thread(&SamplesTransformerPool::Work, this, i);
+
+        shared::WSTRINGSTREAM builder;
+        builder << WStr("DD.Profiler.SamplesTransformer.Thread.") << i;
+        OpSysTools::SetNativeThreadName(&worker.Thread, builder.str().c_str());
+    }
+    _isStarted = true;
+
+    return true;
+}
+
+bool SamplesTransformerPool::Stop()
+{
+    if (!_isStarted)
+    {
+        return true;
+    }
+
+    Log::Info("Stopping the samples transformer threads");
+    {
+        std::lock_guard<std::mutex> lock(_wakeUpLock);
+        _mustStop = true;
+    }
+    _wakeUpCondition.notify_all();
+
+    for (std::size_t i = 0; i < _workersCount; i++)
+    {
+        auto& worker = _workers[i];
+        if (worker.Thread.joinable())
+        {
+            worker.Thread.join();
+        }
+    }
+    _isStarted = false;
+
+    return true;
+}
+
+std::size_t SamplesTransformerPool::GetWorkersCount() const
+{
+    return _workersCount;
+}
+
+void SamplesTransformerPool::Run(std::vector<Task> const& tasks)
+{
+    if (tasks.empty())
+    {
+        return;
+    }
+
+    if (!_isStarted)
+    {
+        for (auto const& task : tasks)
+        {
+            task(0);
+        }
+        return;
+    }
+
+    Batch batch;
+    batch.RemainingTasksCount = tasks.size();
+
+    // spread the tasks across the workers, starting from a different one for each batch
+    // so that the batches of different collectors do not all end up in the first queues
+    auto workerIndex = _nextWorkerIndex.fetch_add(1, std::memory_order_relaxed);
+    for (auto const& task : tasks)
+    {
+        auto& worker = _workers[workerIndex++ % _workersCount];
+        std::lock_guard<std::mutex> lock(worker.Lock);
+        worker.Items.push_back({&task, &batch});
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_wakeUpLock);
+        _pendingTasksCount += static_cast<std::int64_t>(tasks.size());
+    }
+    _wakeUpCondition.notify_all();
+
+    std::unique_lock<std::mutex> lock(batch.Lock);
+    batch.Done.wait(lock, [&batch] { return batch.RemainingTasksCount == 0; });
+}
+
+void SamplesTransformerPool::Work(std::size_t workerIndex)
+{
+    while (true)
+    {
+        WorkItem item;
+        if (TryPop(workerIndex, item) || TrySteal(workerIndex, item))
+        {
+            Execute(workerIndex, item);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_wakeUpLock);
+        _wakeUpCondition.wait(lock, [this] { return _mustStop || (_pendingTasksCount > 0); });
+
+        // the pending tasks are executed before leaving because Run() is waiting for them
+        if (_mustStop && (_pendingTasksCount <= 0))
+        {
+            return;
+        }
+    }
+}
+
+bool SamplesTransformerPool::TryPop(std::size_t workerIndex, WorkItem& item)
+{
+    auto& worker = _workers[workerIndex];
+    std::lock_guard<std::mutex> lock(worker.Lock);
+    if (worker.Items.empty())
+    {
+        return false;
+    }
+
+    // the most recent task is taken from the back; the thieves take the oldest from the front
+    item = worker.Items.back();
+    worker.Items.pop_back();
+    return true;
+}
+
+bool SamplesTransformerPool::TrySteal(std::size_t workerIndex, WorkItem& item)
+{
+    for (std::size_t i = 1; i < _workersCount; i++)
+    {
+        auto& victim = _workers[(workerIndex + i) % _workersCount];
+        std::lock_guard<std::mutex> lock(victim.Lock);
+        if (!victim.Items.empty())
+        {
+            item = victim.Items.front();
+            victim.Items.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void SamplesTransformerPool::Execute(std::size_t workerIndex, WorkItem const& item)
+{
+    {
+        std::lock_guard<std::mutex> lock(_wakeUpLock);
+        _pendingTasksCount--;
+    }
+
+    try
+    {
+        (*item.pTask)(workerIndex);
+    }
+    catch (std::exception const& ex)
+    {
+        Log::Error("An exception occured while transforming samples: ", ex.what());
+    }
+
+    // the count is updated and the notification sent under the lock: Run() cannot see the
+    // batch done (and destroy it) before the worker has released the lock. The batch must
+    // not be touched afterwards
+    auto* pBatch = item.pBatch;
+    std::lock_guard<std::mutex> lock(pBatch->Lock);
+    if (--pBatch->RemainingTasksCount == 0)
+    {
+        pBatch->Done.notify_one();
+    }
+}
@@ -0,0 +1,87 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "IService.h"
+
+// Worker threads shared by the collectors to transform their raw samples (i.e. symbolize
+// the frames) in parallel instead of relying on a single thread per collector.
+// Each worker has its own queue of tasks: the tasks of a batch are spread across the queues
+// and an idle worker steals tasks from the queues of the busy ones.
+// The index of the worker running a task is given to the task so that the results can be
+// stored in a per worker shard without contention.
+class SamplesTransformerPool : public IService
+{
+public:
+    using Task = std::function<void(std::size_t workerIndex)>;
+
+    SamplesTransformerPool(std::size_t workersCount);
+    ~SamplesTransformerPool() override;
+
+    SamplesTransformerPool(const SamplesTransformerPool&) = delete;
+    SamplesTransformerPool& operator=(const SamplesTransformerPool&) = delete;
+
+    // Inherited via IService
+    const char* GetName() override;
+    bool Start() override;
+    bool Stop() override;
+
+    std::size_t GetWorkersCount() const;
+
+    // Runs the given tasks on the workers and returns when all of them are done.
+    // If the pool is not started, the tasks are run by the calling thread as worker 0.
+    void Run(std::vector<Task> const& tasks);
+
+private:
+    struct Batch
+    {
+        std::mutex Lock;
+        std::condition_variable Done;
+        // protected by Lock: the batch can be destroyed by Run() as soon as it sees 0
+        std::size_t RemainingTasksCount;
+    };
+
+    // tasks and batches are owned by the caller of Run() which waits for their completion
+    struct WorkItem
+    {
+        Task const* pTask;
+        Batch* pBatch;
+    };
+
+    struct Worker
+    {
+        std::thread Thread;
+        std::mutex Lock;
+        std::deque<WorkItem> Items;
+    };
+
+    void Work(std::size_t workerIndex);
+    bool TryPop(std::size_t workerIndex, WorkItem& item);
+    bool TrySteal(std::size_t workerIndex, WorkItem& item);
+    void Execute(std::size_t workerIndex, WorkItem const& item);
+
+private:
+    const char* _serviceName = "SamplesTransformerPool";
+
+    const std::size_t _workersCount;
+    std::unique_ptr<Worker[]> _workers;
+    std::atomic<std::size_t> _nextWorkerIndex;
+    bool _isStarted;
+
+    std::mutex _wakeUpLock;
+    std::condition_variable _wakeUpCondition;
+    // the following fields are protected by _wakeUpLock
+    bool _mustStop;
+    // can be temporarily negative when a task is popped before the count is updated by Run()
+    std::int64_t _pendingTasksCount;
+};
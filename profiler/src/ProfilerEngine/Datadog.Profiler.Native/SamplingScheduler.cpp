@@ -0,0 +1,87 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include "SamplingScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+// weight of the last measurement in the moving average of the sample cost
+constexpr double SampleCostSmoothingFactor = 0.125;
+
+SamplingScheduler::SamplingScheduler(double overheadBudget, std::int32_t maxThreadsPerIteration) :
+    _overheadBudget{overheadBudget},
+    _maxThreadsPerIteration{(std::max)(maxThreadsPerIteration, 1)},
+    _sampleCostNs{0},
+    _samplingPeriod{MinSamplingPeriod},
+    _threadsPerIteration{1}
+{
+}
+
+void SamplingScheduler::OnIterationCompleted(std::int32_t sampledThreadsCount, std::chrono::nanoseconds collectionTime)
+{
+    if (sampledThreadsCount <= 0)
+    {
+        return;
+    }
+
+    double cost = static_cast<double>(collectionTime.count()) / sampledThreadsCount;
+    if (_sampleCostNs == 0)
+    {
+        _sampleCostNs = cost;
+    }
+    else
+    {
+        _sampleCostNs += (cost - _sampleCostNs) * SampleCostSmoothingFactor;
+    }
+}
+
+void SamplingScheduler::Update(std::int32_t threadsCount)
+{
+    if (threadsCount <= 0)
+    {
+        // nothing to sample: just check regularly for new threads
+        _threadsPerIteration = 0;
+        _samplingPeriod = TargetThreadSamplingPeriod;
+        return;
+    }
+
+    // samples per nanosecond
+    double rate = static_cast<double>(threadsCount) / TargetThreadSamplingPeriod.count();
+    if ((_sampleCostNs > 0) && (_overheadBudget > 0))
+    {
+        rate = (std::min)(rate, _overheadBudget / _sampleCostNs);
+    }
+
+    std::int32_t threadsPerIteration = (std::min)(threadsCount, _maxThreadsPerIteration);
+    double period = threadsPerIteration / rate;
+
+    if (period > MaxSamplingPeriod.count())
+    {
+        // too expensive: sample fewer threads per iteration instead of waking up even less often
+        threadsPerIteration = (std::max)(static_cast<std::int32_t>(rate * MaxSamplingPeriod.count()), 1);
+        period = static_cast<double>(MaxSamplingPeriod.count());
+    }
+    else if (period < MinSamplingPeriod.count())
+    {
+        period = static_cast<double>(MinSamplingPeriod.count());
+    }
+
+    _threadsPerIteration = threadsPerIteration;
+    _samplingPeriod = std::chrono::nanoseconds(std::llround(period));
+}
+
+std::chrono::nanoseconds SamplingScheduler::GetSamplingPeriod() const
+{
+    return _samplingPeriod;
+}
+
+std::int32_t SamplingScheduler::GetThreadsPerIteration() const
+{
+    return _threadsPerIteration;
+}
+
+std::chrono::nanoseconds SamplingScheduler::GetSampleCost() const
+{
+    return std::chrono::nanoseconds(std::llround(_sampleCostNs));
+}
@@ -0,0 +1,48 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+/// <summary>
+/// Decides how often the StackSamplerLoop wakes up and how many threads it samples each time,
+/// so that the time spent collecting samples stays under a budget expressed as a fraction of one core.
+///
+/// * The cost of one thread sample is the stack walk duration measured by the StackSamplerLoopManager
+///   for its collection time statistics, averaged over the threads of each iteration (moving average).
+/// * Ideally, each thread is sampled every TargetThreadSamplingPeriod: with a few threads,
+///   they are all sampled at each (less frequent) wake up.
+/// * When this is too expensive for the budget, the sampling rate is reduced: with thousands of threads,
+///   each one is sampled less often but the overhead stays the same.
+/// </summary>
+class SamplingScheduler
+{
+public:
+    static constexpr std::chrono::nanoseconds MinSamplingPeriod = std::chrono::milliseconds(9);
+    static constexpr std::chrono::nanoseconds MaxSamplingPeriod = std::chrono::milliseconds(500);
+    static constexpr std::chrono::nanoseconds TargetThreadSamplingPeriod = std::chrono::milliseconds(20);
+
+public:
+    // overheadBudget is a fraction of one core (i.e. 0.01 for 1%)
+    SamplingScheduler(double overheadBudget, std::int32_t maxThreadsPerIteration);
+
+    // time spent walking the stacks of the sampledThreadsCount threads sampled by an iteration
+    void OnIterationCompleted(std::int32_t sampledThreadsCount, std::chrono::nanoseconds collectionTime);
+
+    // compute the period and the number of threads per iteration for the current number of threads
+    void Update(std::int32_t threadsCount);
+
+    std::chrono::nanoseconds GetSamplingPeriod() const;
+    std::int32_t GetThreadsPerIteration() const;
+    std::chrono::nanoseconds GetSampleCost() const;
+
+private:
+    const double _overheadBudget;
+    const std::int32_t _maxThreadsPerIteration;
+
+    double _sampleCostNs;
+    std::chrono::nanoseconds _samplingPeriod;
+    std::int32_t _threadsPerIteration;
+};
@@ -0,0 +1,161 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+
+// Read-mostly concurrent map used to cache the symbols resolved by the profiler.
+//
+// Entries are spread among ShardsCount shards, each one protected by its own reader/writer lock:
+//  - lookups only take a shared lock on one shard so they don't block each other
+//  - insertions/removals only block the lookups hitting the same shard
+//
+// Hit/miss counters are kept per shard (on the same cache line as the lock) to avoid
+// contention on a global counter.
+//
+template <class TKey, class TValue, std::size_t ShardsCount = 16>
+class ShardedCache
+{
+    static_assert((ShardsCount > 0) && ((ShardsCount & (ShardsCount - 1)) == 0), "ShardsCount must be a power of 2");
+
+public:
+    ShardedCache() = default;
+    ShardedCache(const ShardedCache&) = delete;
+    ShardedCache& operator=(const ShardedCache&) = delete;
+
+public:
+    bool TryGet(const TKey& key, TValue& value) const
+    {
+        auto& shard = GetShard(key);
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.Lock);
+
+            auto entry = shard.Entries.find(key);
+            if (entry != shard.Entries.end())
+            {
+                value = entry->second;
+                shard.HitCount.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        shard.MissCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    void Set(const TKey& key, const TValue& value)
+    {
+        auto& shard = GetShard(key);
+        std::unique_lock<std::shared_mutex> lock(shard.Lock);
+
+        shard.Entries[key] = value;
+    }
+
+    bool Remove(const TKey& key)
+    {
+        auto& shard = GetShard(key);
+        std::unique_lock<std::shared_mutex> lock(shard.Lock);
+
+        return shard.Entries.erase(key) != 0;
+    }
+
+    // Remove all entries for which predicate(key, value) returns true; returns the number of removed entries
+    template <class TPredicate>
+    std::size_t RemoveIf(TPredicate predicate)
+    {
+        std::size_t removedCount = 0;
+        for (auto& shard : _shards)
+        {
+            std::unique_lock<std::shared_mutex> lock(shard.Lock);
+
+            for (auto entry = shard.Entries.begin(); entry != shard.Entries.end();)
+            {
+                if (predicate(entry->first, entry->second))
+                {
+                    entry = shard.Entries.erase(entry);
+                    removedCount++;
+                }
+                else
+                {
+                    ++entry;
+                }
+            }
+        }
+
+        return removedCount;
+    }
+
+    std::size_t Size() const
+    {
+        std::size_t size = 0;
+        for (auto& shard : _shards)
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.Lock);
+            size += shard.Entries.size();
+        }
+
+        return size;
+    }
+
+    std::uint64_t GetHitCount() const
+    {
+        std::uint64_t count = 0;
+        for (auto& shard : _shards)
+        {
+            count += shard.HitCount.load(std::memory_order_relaxed);
+        }
+
+        return count;
+    }
+
+    std::uint64_t GetMissCount() const
+    {
+        std::uint64_t count = 0;
+        for (auto& shard : _shards)
+        {
+            count += shard.MissCount.load(std::memory_order_relaxed);
+        }
+
+        return count;
+    }
+
+private:
+    struct alignas(64) Shard
+    {
+        mutable std::shared_mutex Lock;
+        std::unordered_map<TKey, TValue> Entries;
+        mutable std::atomic<std::uint64_t> HitCount = 0;
+        mutable std::atomic<std::uint64_t> MissCount = 0;
+    };
+
+    // FunctionID/ClassID are aligned addresses and std::hash is the identity for integers with most
+    // standard libraries: mix the bits so that the entries are evenly spread among the shards
+    static inline std::size_t GetShardIndex(const TKey& key)
+    {
+        std::uint64_t hash = static_cast<std::uint64_t>(std::hash<TKey>{}(key));
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        return static_cast<std::size_t>(hash & (ShardsCount - 1));
+    }
+
+    inline Shard& GetShard(const TKey& key)
+    {
+        return _shards[GetShardIndex(key)];
+    }
+
+    inline const Shard& GetShard(const TKey& key) const
+    {
+        return _shards[GetShardIndex(key)];
+    }
+
+private:
+    std::array<Shard, ShardsCount> _shards;
+};
@@ -29,10 +29,19 @@ bool StackFramesCollectorBase::TryAddFrame(StackFrameCodeKind codeKind,
                                            FunctionID clrFunctionId,
                                            UINT_PTR nativeInstructionPointer,
                                            std::uint64_t moduleHandle)
+{
+    return TryAddFrame(_pReusableStackSnapshotResult, codeKind, clrFunctionId, nativeInstructionPointer, moduleHandle);
+}
+
+bool StackFramesCollectorBase::TryAddFrame(StackSnapshotResultReusableBuffer* pStackSnapshotResult,
+                                           StackFrameCodeKind codeKind,
+                                           FunctionID clrFunctionId,
+                                           UINT_PTR nativeInstructionPointer,
+                                           std::uint64_t moduleHandle)
 {
     StackSnapshotResultFrameInfo* pCurrentFrameInfo;
     bool hasCapacityForSubsequentFrames;
-    bool hasCapacityForThisFrame = _pReusableStackSnapshotResult->TryAddNextFrame(&pCurrentFrameInfo, &hasCapacityForSubsequentFrames);
+    bool hasCapacityForThisFrame = pStackSnapshotResult->TryAddNextFrame(&pCurrentFrameInfo, &hasCapacityForSubsequentFrames);
 
     if (!hasCapacityForThisFrame)
     {
@@ -42,7 +51,7 @@ bool StackFramesCollectorBase::TryAddFrame(StackFrameCodeKind codeKind,
         // since last iteration we had hasCapacityForSubsequentFrames == true.
 
         // We will also increase the size of the preallocated buffer for the next time:
-        _pReusableStackSnapshotResult->GrowCapacityAtNextReset();
+        pStackSnapshotResult->GrowCapacityAtNextReset();
 
         // Use the info we collected so far and abort further stack walking for this time:
         return false;
@@ -57,7 +66,7 @@ bool StackFramesCollectorBase::TryAddFrame(StackFrameCodeKind codeKind,
         pCurrentFrameInfo->Set(StackFrameCodeKind::MultipleMixed, 0, 0, 0);
 
         // We will also increase the size of the preallocated buffer for the next time:
-        _pReusableStackSnapshotResult->GrowCapacityAtNextReset();
+        pStackSnapshotResult->GrowCapacityAtNextReset();
 
         // Use the info we collected so far and abort further stack walking for this time:
         return false;
@@ -219,4 +228,39 @@ void StackFramesCollectorBase::OnDeadlock()
     // The DoStackSnapshot method calls SuspendThread/ResumeThread.
     // In case of a deadlock, if the sampling thread has not gracefully finished, it will be killed.
     // The result will be: 1 call to ResumeThread missing.
-}
\ No newline at end of file
+}
+
+bool StackFramesCollectorBase::EnableCpuTimers(std::chrono::nanoseconds cpuInterval)
+{
+    return false;
+}
+
+void StackFramesCollectorBase::StartCpuTimer(ManagedThreadInfo* pThreadInfo)
+{
+}
+
+void StackFramesCollectorBase::StopCpuTimer(ManagedThreadInfo* pThreadInfo)
+{
+}
+
+void StackFramesCollectorBase::CollectCpuTimerSamples(std::vector<RawCpuSample>& samples)
+{
+}
+
+std::uint32_t StackFramesCollectorBase::GetStackSamplesBatchCapacity()
+{
+    return 0;
+}
+
+void StackFramesCollectorBase::CollectStackSamples(ManagedThreadInfo* const* ppThreadInfos,
+                                                   std::uint32_t count,
+                                                   StackSnapshotResultBuffer** ppStackSnapshotResults,
+                                                   uint32_t* pHRs)
+{
+    // only called when GetStackSamplesBatchCapacity() is not 0
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+        ppStackSnapshotResults[i] = nullptr;
+        pHRs[i] = E_NOTIMPL;
+    }
+}
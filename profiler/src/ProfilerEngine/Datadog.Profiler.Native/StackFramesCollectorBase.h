@@ -6,8 +6,10 @@
 #include <chrono>
 #include <condition_variable>
 #include <mutex>
+#include <vector>
 
 #include "ManagedThreadInfo.h"
+#include "RawCpuSample.h"
 #include "StackSnapshotResultReusableBuffer.h"
 
 class StackFramesCollectorBase
@@ -20,6 +22,13 @@ protected:
                      UINT_PTR nativeInstructionPointer,
                      std::uint64_t moduleHandle);
 
+    // Same as above but for collectors that walk several stacks at the same time, each one into its own buffer
+    static bool TryAddFrame(StackSnapshotResultReusableBuffer* pStackSnapshotResult,
+                            StackFrameCodeKind codeKind,
+                            FunctionID clrFunctionId,
+                            UINT_PTR nativeInstructionPointer,
+                            std::uint64_t moduleHandle);
+
     bool TryApplyTraceContextDataFromCurrentCollectionThreadToSnapshot(void);
 
     StackSnapshotResultBuffer* GetStackSnapshotResult(void);
@@ -41,6 +50,25 @@ public:
 
     virtual void OnDeadlock();
 
+    // CPU-timer-driven sampling: instead of computing the CPU consumption of the threads picked by the sampler thread,
+    // each thread is sampled by itself each time it has consumed cpuInterval of CPU.
+    // Not supported by default: EnableCpuTimers returns false and the other methods are no-ops.
+    virtual bool EnableCpuTimers(std::chrono::nanoseconds cpuInterval);
+    virtual void StartCpuTimer(ManagedThreadInfo* pThreadInfo);
+    virtual void StopCpuTimer(ManagedThreadInfo* pThreadInfo);
+
+    // Append the CPU samples collected since the last call (AppDomainId is not set)
+    virtual void CollectCpuTimerSamples(std::vector<RawCpuSample>& samples);
+
+    // Batched collection: the stacks of up to GetStackSamplesBatchCapacity() threads are walked in parallel.
+    // The result buffers belong to the collector and stay valid until the next collection.
+    // Not supported by default: the capacity is 0 and the threads are sampled one by one with CollectStackSample.
+    virtual std::uint32_t GetStackSamplesBatchCapacity();
+    virtual void CollectStackSamples(ManagedThreadInfo* const* ppThreadInfos,
+                                     std::uint32_t count,
+                                     StackSnapshotResultBuffer** ppStackSnapshotResults,
+                                     uint32_t* pHRs);
+
     void RequestAbortCurrentCollection(void);
     void PrepareForNextCollection(void);
     bool SuspendTargetThread(ManagedThreadInfo* pThreadInfo, bool* pIsTargetThreadSuspended);
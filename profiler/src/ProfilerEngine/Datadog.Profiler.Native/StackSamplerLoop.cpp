@@ -1,6 +1,7 @@
 // Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
 // This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
 
+#include <algorithm>
 #include <chrono>
 #include <inttypes.h>
 #include <iomanip>
@@ -11,6 +12,7 @@
 #include <stdio.h>
 
 #include "Configuration.h"
+#include "GarbageCollectionProvider.h"
 #include "HResultConverter.h"
 #include "Log.h"
 #include "ManagedThreadInfo.h"
@@ -27,15 +29,15 @@
 #include "ICollector.h"
 #include "RawWallTimeSample.h"
 #include "RawCpuSample.h"
-#include "SystemTime.h"
 
 #include "shared/src/native-src/string.h"
 
 // Configuration constants:
 using namespace std::chrono_literals;
 constexpr std::chrono::nanoseconds SamplingPeriod = 9ms;
-constexpr uint64_t SamplingPeriodMs = SamplingPeriod.count() / 1000000;
 constexpr std::int32_t SampledThreadsPerIteration = 5;
+constexpr std::int32_t MaxCandidatesPerSampledThread = 4;
+constexpr std::chrono::nanoseconds ParkedThreadMaxSamplingPeriod = 1s;
 constexpr const WCHAR* StackSamplerLoop_ThreadName = WStr("DD.Profiler.StackSamplerLoop.Thread");
 
 #ifdef NDEBUG
@@ -56,7 +58,8 @@ StackSamplerLoop::StackSamplerLoop(
     IManagedThreadList* pManagedThreadList,
     ISymbolsResolver* pSymbolResolver,
     ICollector<RawWallTimeSample>* pWallTimeCollector,
-    ICollector<RawCpuSample>* pCpuTimeCollector
+    ICollector<RawCpuSample>* pCpuTimeCollector,
+    GarbageCollectionProvider const* pGarbageCollectionProvider
     ) :
     _pCorProfilerInfo{pCorProfilerInfo},
     _pConfiguration{pConfiguration},
@@ -68,12 +71,38 @@ StackSamplerLoop::StackSamplerLoop(
     _pSymbolsResolver{pSymbolResolver},
     _pWallTimeCollector{pWallTimeCollector},
     _pCpuTimeCollector{pCpuTimeCollector},
+    _pGarbageCollectionProvider{pGarbageCollectionProvider},
     _pLoopThread{nullptr},
     _loopThreadOsId{0},
-    _targetThread(nullptr)
+    _targetThread(nullptr),
+    _isCpuTimerSamplingEnabled{pManager->IsCpuTimerSamplingEnabled()},
+    _stackSamplesBatchCapacity{pStackFramesCollector->GetStackSamplesBatchCapacity()},
+    _sampledThreadsPerIteration{SampledThreadsPerIteration}
 {
     _pCorProfilerInfo->AddRef();
 
+    if (_stackSamplesBatchCapacity > 0)
+    {
+        // collecting a batch takes about the time of one stack walk: sample more threads when there are more cores to run them
+        auto coresCount = static_cast<std::int32_t>(std::thread::hardware_concurrency());
+        _sampledThreadsPerIteration = (std::min)((std::max)(coresCount, SampledThreadsPerIteration), static_cast<std::int32_t>(_stackSamplesBatchCapacity));
+
+        // no allocation during the collections
+        _batchThreads.reserve(_sampledThreadsPerIteration);
+        _batchPrevSampleTimestamps.reserve(_sampledThreadsPerIteration);
+        _batchStackSnapshotResults.reserve(_sampledThreadsPerIteration);
+        _batchHRs.reserve(_sampledThreadsPerIteration);
+
+        Log::Info("Up to ", _sampledThreadsPerIteration, " threads are sampled in parallel per iteration.");
+    }
+
+    auto overheadBudget = _pConfiguration->GetSamplingOverheadBudget();
+    if (overheadBudget > 0)
+    {
+        _pSamplingScheduler = std::make_unique<SamplingScheduler>(overheadBudget / 100, _sampledThreadsPerIteration);
+        Log::Info("Stack sampling is scheduled to use at most ", overheadBudget, "% of one core.");
+    }
+
     _pLoopThread = new std::thread(&StackSamplerLoop::MainLoop, this);
     OpSysTools::SetNativeThreadName(_pLoopThread, StackSamplerLoop_ThreadName);
 }
@@ -154,10 +183,94 @@ void StackSamplerLoop::MainLoop()
 
 void StackSamplerLoop::WaitOnePeriod(void)
 {
-    std::this_thread::sleep_for(SamplingPeriod);
+    std::this_thread::sleep_for(GetSamplingPeriod());
 }
 
 void StackSamplerLoop::MainLoopIteration(void)
+{
+    std::int32_t sampledThreadsCount = (_stackSamplesBatchCapacity > 0)
+                                           ? CollectStackSamplesBatch()
+                                           : CollectThreadsStackSamples();
+
+    if (_isCpuTimerSamplingEnabled)
+    {
+        CollectCpuTimerSamples();
+    }
+
+    if (_pSamplingScheduler != nullptr)
+    {
+        // adjust the next iterations to the measured cost of the stack walks and to the current number of threads
+        _pSamplingScheduler->OnIterationCompleted(sampledThreadsCount, _pManager->GetAndResetCollectionTime());
+        _pSamplingScheduler->Update(_pManagedThreadList->Count());
+    }
+}
+
+std::int32_t StackSamplerLoop::GetThreadsPerIteration(void) const
+{
+    return (_pSamplingScheduler != nullptr) ? _pSamplingScheduler->GetThreadsPerIteration() : _sampledThreadsPerIteration;
+}
+
+std::chrono::nanoseconds StackSamplerLoop::GetSamplingPeriod(void) const
+{
+    return (_pSamplingScheduler != nullptr) ? _pSamplingScheduler->GetSamplingPeriod() : SamplingPeriod;
+}
+
+std::int32_t StackSamplerLoop::GetCandidatesCount(std::int32_t managedThreadsCount, std::int32_t thisIterationCount) const
+{
+    // with the adaptive scheduling, parked threads are skipped: look further in the list to find active ones
+    if (_pSamplingScheduler == nullptr)
+    {
+        return thisIterationCount;
+    }
+
+    return (std::min)(managedThreadsCount, thisIterationCount * MaxCandidatesPerSampledThread);
+}
+
+ManagedThreadInfo* StackSamplerLoop::PickNextThread(std::int32_t& candidatesCount, std::int64_t currentTimestampNs)
+{
+    while (candidatesCount > 0)
+    {
+        candidatesCount--;
+
+        ManagedThreadInfo* pThreadInfo = _pManagedThreadList->LoopNext();
+        if (pThreadInfo == nullptr)
+        {
+            return nullptr;
+        }
+
+        if ((_pSamplingScheduler == nullptr) || !IsThreadParked(pThreadInfo, currentTimestampNs))
+        {
+            return pThreadInfo;
+        }
+
+        pThreadInfo->Release();
+    }
+
+    return nullptr;
+}
+
+bool StackSamplerLoop::IsThreadParked(ManagedThreadInfo* pThreadInfo, std::int64_t currentTimestampNs)
+{
+    // A thread that did not consume CPU since it was last looked at is waiting: its callstack is probably the same
+    // as the last time it was sampled. It is skipped unless it was not sampled for a while: the wall time of its
+    // next sample will cover the whole period since the previous one.
+    std::uint64_t cpuTime;
+    if (!pThreadInfo->GetCpuTime(cpuTime))
+    {
+        return false;
+    }
+
+    auto previousCpuTime = pThreadInfo->SetLastObservedCpuTimeNanoseconds(cpuTime);
+    if (cpuTime != previousCpuTime)
+    {
+        return false;
+    }
+
+    auto lastSampleTimestampNs = static_cast<std::int64_t>(pThreadInfo->GetLastSampleHighPrecisionTimestampNanoseconds());
+    return (lastSampleTimestampNs != 0) && (currentTimestampNs - lastSampleTimestampNs < ParkedThreadMaxSamplingPeriod.count());
+}
+
+std::int32_t StackSamplerLoop::CollectThreadsStackSamples(void)
 {
     // The true count of managed thread can change concurrently.
     // If it stays above SampleThreadsPerIteration, it is irrelevant for the code here.
@@ -166,14 +279,18 @@ void StackSamplerLoop::MainLoopIteration(void)
     // If it falls to zero, we are still OK:
     // it is very rare and we will simply loop up to SampleThreadsPerIteration doing nothing.
     int managedThreadsCount = _pManagedThreadList->Count();
-    int thisIterationCount = (std::min)(managedThreadsCount, SampledThreadsPerIteration);
+    int thisIterationCount = (std::min)(managedThreadsCount, GetThreadsPerIteration());
+    std::int32_t candidatesCount = GetCandidatesCount(managedThreadsCount, thisIterationCount);
+    std::int64_t currentTimestampNs = OpSysTools::GetHighPrecisionNanoseconds();
+    std::int32_t sampledThreadsCount = 0;
 
     for (int i = 0; i < thisIterationCount && false == _shutdownRequested; i++)
     {
-        _targetThread = _pManagedThreadList->LoopNext();
+        _targetThread = PickNextThread(candidatesCount, currentTimestampNs);
         if (_targetThread != nullptr)
         {
             CollectOneThreadStackSample(_targetThread);
+            sampledThreadsCount++;
 
             // LoopNext() calls AddRef() on the threadInfo before returning it.
             // This is because it needs to happen under the managedThreads's internal lock
@@ -188,6 +305,135 @@ void StackSamplerLoop::MainLoopIteration(void)
             std::this_thread::yield();
         }
     }
+
+    return sampledThreadsCount;
+}
+
+std::int32_t StackSamplerLoop::CollectStackSamplesBatch(void)
+{
+    // Same logic as CollectThreadsStackSamples + CollectOneThreadStackSample except that
+    // the stacks of all the threads picked for this iteration are walked at the same time
+    int managedThreadsCount = _pManagedThreadList->Count();
+    int thisIterationCount = (std::min)(managedThreadsCount, GetThreadsPerIteration());
+    std::int32_t candidatesCount = GetCandidatesCount(managedThreadsCount, thisIterationCount);
+
+    // /!\ time function allocates so it must be called before the threads are interrupted
+    time_t currentUnixTimestamp = GetCurrentTimestamp();
+    std::int64_t thisSampleTimestampNanosecs = OpSysTools::GetHighPrecisionNanoseconds();
+
+    _batchThreads.clear();
+    _batchPrevSampleTimestamps.clear();
+    for (int i = 0; i < thisIterationCount && false == _shutdownRequested; i++)
+    {
+        // LoopNext() calls AddRef() on the threadInfo before returning it
+        ManagedThreadInfo* pThreadInfo = PickNextThread(candidatesCount, thisSampleTimestampNanosecs);
+        if (pThreadInfo == nullptr)
+        {
+            continue;
+        }
+
+        // The same thread can be returned twice if the list shrinks concurrently: it must be walked (and its lock acquired) only once.
+        // As in CollectOneThreadStackSample, skip the threads without handle or that the manager does not allow to sample.
+        if ((std::find(_batchThreads.begin(), _batchThreads.end(), pThreadInfo) != _batchThreads.end()) ||
+            (pThreadInfo->GetOsThreadHandle() == static_cast<HANDLE>(0)) ||
+            !_pManager->AllowStackWalkInBatch(pThreadInfo))
+        {
+            pThreadInfo->Release();
+            continue;
+        }
+
+        std::int64_t prevSampleTimestampNanosecs = pThreadInfo->SetLastSampleHighPrecisionTimestampNanoseconds(thisSampleTimestampNanosecs);
+        pThreadInfo->SetLastKnownSampleUnixTimestamp(currentUnixTimestamp, thisSampleTimestampNanosecs);
+
+        _batchThreads.push_back(pThreadInfo);
+        _batchPrevSampleTimestamps.push_back(prevSampleTimestampNanosecs);
+    }
+
+    auto count = static_cast<std::uint32_t>(_batchThreads.size());
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    _batchStackSnapshotResults.resize(count);
+    _batchHRs.resize(count);
+
+    {
+        // Release the threads (stack walk lock and reference taken by AllowStackWalkInBatch) whatever happens
+        auto scopeFinalizer = CreateScopeFinalizer(
+            [this, count] {
+                _pManager->NotifyBatchIterationFinished(_batchThreads.data(), count);
+            });
+
+        _pManager->NotifyThreadState(false);
+
+        {
+            auto endCollectionScope = CreateScopeFinalizer([this] { _pManager->NotifyCollectionEnd(); });
+
+            _pManager->NotifyCollectionStart();
+            _pStackFramesCollector->CollectStackSamples(_batchThreads.data(), count, _batchStackSnapshotResults.data(), _batchHRs.data());
+        }
+
+        for (std::uint32_t i = 0; i < count; i++)
+        {
+            ManagedThreadInfo* pThreadInfo = _batchThreads[i];
+            StackSnapshotResultBuffer* pStackSnapshotResult = _batchStackSnapshotResults[i];
+
+            bool isStackSnapshotSuccessful = (pStackSnapshotResult->GetFramesCount() > 0);
+            pThreadInfo->IncSnapshotsPerformedCount(isStackSnapshotSuccessful);
+
+            if (isStackSnapshotSuccessful)
+            {
+                std::int64_t wallTime = ComputeWallTime(thisSampleTimestampNanosecs, _batchPrevSampleTimestamps[i]);
+                UpdateSnapshotInfos(pStackSnapshotResult, wallTime, currentUnixTimestamp);
+                DetermineAppDomain(pThreadInfo->GetClrThreadId(), pStackSnapshotResult);
+            }
+        }
+    }
+
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+        ManagedThreadInfo* pThreadInfo = _batchThreads[i];
+        StackSnapshotResultBuffer* pStackSnapshotResult = _batchStackSnapshotResults[i];
+
+        UpdateStatistics(_batchHRs[i], pStackSnapshotResult->GetFramesCount());
+        DetermineSampledStackFrameCodeKinds(pStackSnapshotResult);
+        PersistStackSnapshotResults(pStackSnapshotResult, pThreadInfo);
+
+        pThreadInfo->Release();
+    }
+    _batchThreads.clear();
+
+    LogEncounteredStackSnapshotResultStatistics(thisSampleTimestampNanosecs);
+
+    return static_cast<std::int32_t>(count);
+}
+
+void StackSamplerLoop::CollectCpuTimerSamples()
+{
+    // the CPU samples have been collected by the threads themselves when their CPU timer fired
+    _cpuTimerSamples.clear();
+    _pStackFramesCollector->CollectCpuTimerSamples(_cpuTimerSamples);
+
+    for (auto& rawCpuSample : _cpuTimerSamples)
+    {
+        // The thread may have died since the sample was collected: its ClrThreadId must not be used anymore.
+        // Holding the stack walk lock prevents the thread from being destroyed while its AppDomain is retrieved.
+        // see DetermineAppDomain for the (rare) case where the AppDomain has changed since the sample was collected
+        ManagedThreadInfo* pThreadInfo = rawCpuSample.ThreadInfo;
+        {
+            SemaphoreScope guardedLock(pThreadInfo->GetStackWalkLock());
+
+            AppDomainID appDomainId;
+            if (!pThreadInfo->IsDestroyed() &&
+                SUCCEEDED(_pCorProfilerInfo->GetThreadAppDomain(pThreadInfo->GetClrThreadId(), &appDomainId)))
+            {
+                rawCpuSample.AppDomainId = appDomainId;
+            }
+        }
+
+        _pCpuTimeCollector->Add(std::move(rawCpuSample));
+    }
 }
 
 void StackSamplerLoop::CollectOneThreadStackSample(ManagedThreadInfo* pThreadInfo)
@@ -374,7 +620,7 @@ std::int64_t StackSamplerLoop::ComputeWallTime(std::int64_t currentTimestampNs,
     {
         // prevTimestampNs = 0 means that it is the first time the wall time is computed for a given thread
         // --> at least one sampling period has elapsed
-        return static_cast<std::int64_t>(SamplingPeriod.count());
+        return static_cast<std::int64_t>(GetSamplingPeriod().count());
     }
 
     if (prevTimestampNs > 0)
@@ -386,7 +632,7 @@ std::int64_t StackSamplerLoop::ComputeWallTime(std::int64_t currentTimestampNs,
     {
         // this should never happen
         // count at least one sampling period
-        return static_cast<std::int64_t>(SamplingPeriod.count());
+        return static_cast<std::int64_t>(GetSamplingPeriod().count());
     }
 }
 
@@ -583,27 +829,6 @@ void StackSamplerLoop::LogEncounteredStackSnapshotResultStatistics(std::int64_t
     }
 }
 
-uint64_t GetThreadCpuTime(ManagedThreadInfo* pThreadInfo)
-{
-    uint64_t duration = 0;
-
-#ifdef _WINDOWS
-    FILETIME creationTime, exitTime = {}; // not used here
-    FILETIME kernelTime = {};
-    FILETIME userTime = {};
-
-    if (::GetThreadTimes(pThreadInfo->GetOsThreadHandle(), &creationTime, &exitTime, &kernelTime, &userTime))
-    {
-        uint64_t milliseconds = GetTotalMilliseconds(userTime) + GetTotalMilliseconds(kernelTime);
-        return milliseconds;
-    }
-#else
-    // TODO: find the corresponding Linux implementation
-#endif
-
-    return duration;
-}
-
 void StackSamplerLoop::PersistStackSnapshotResults(StackSnapshotResultBuffer const* pSnapshotResult, ManagedThreadInfo* pThreadInfo)
 {
     if (pSnapshotResult == nullptr || pSnapshotResult->GetFramesCount() == 0)
@@ -613,51 +838,65 @@ void StackSamplerLoop::PersistStackSnapshotResults(StackSnapshotResultBuffer con
 
     if (_pConfiguration->IsFFLibddprofEnabled())
     {
+        // the instruction pointers are extracted once from the snapshot and copied by each collector
+        // into its own queue: the raw samples do not own a stack
+        _instructionPointers.clear();
+        pSnapshotResult->CopyInstructionPointers(_instructionPointers);
+
         // add the WallTime sample to the lipddprof pipeline
         RawWallTimeSample rawSample;
         rawSample.Timestamp = pSnapshotResult->GetUnixTimeUtc();
         rawSample.LocalRootSpanId = pSnapshotResult->GetLocalRootSpanId();
         rawSample.SpanId = pSnapshotResult->GetSpanId();
         rawSample.AppDomainId = pSnapshotResult->GetAppDomainId();
-        pSnapshotResult->CopyInstructionPointers(rawSample.Stack);
+
+        // the application code is not running while the runtime is suspended for a GC:
+        // the wall time goes to the garbage collector instead of the frames on the stack
+        std::size_t wallTimeFramesCount = _instructionPointers.size();
+        if ((_pGarbageCollectionProvider != nullptr) && _pGarbageCollectionProvider->IsGarbageCollectionInProgress())
+        {
+            rawSample.DuringGarbageCollection = true;
+            wallTimeFramesCount = 0;
+        }
         rawSample.ThreadInfo = pThreadInfo;
         pThreadInfo->AddRef();
         rawSample.Duration = pSnapshotResult->GetRepresentedDurationNanoseconds();
-        _pWallTimeCollector->Add(std::move(rawSample));
+        _pWallTimeCollector->Add(std::move(rawSample), _instructionPointers.data(), wallTimeFramesCount);
 
-        if (_pConfiguration->IsCpuProfilingEnabled())
+        // with CPU timers, the CPU samples are collected by CollectCpuTimerSamples
+        if (_pConfiguration->IsCpuProfilingEnabled() && !_isCpuTimerSamplingEnabled)
         {
             // add the CPU sample to the lipddprof pipeline if needed
             // (i.e. CPU time was consumed by the thread)
-            auto lastCpuConsumption = pThreadInfo->GetCpuConsumptionMilliseconds();
-            auto currentCpuConsumption = GetThreadCpuTime(pThreadInfo);
-            uint64_t incrementCpuConsumption = 0;
-            if (lastCpuConsumption == 0)
-            {
-                // count the duration of the first occurence as the sampling rate
-                incrementCpuConsumption = SamplingPeriodMs;
-            }
-            else if (currentCpuConsumption > lastCpuConsumption)
+            std::uint64_t currentCpuConsumption = 0;
+            std::uint64_t incrementCpuConsumption = 0;
+            if (pThreadInfo->GetCpuTime(currentCpuConsumption))
             {
-                incrementCpuConsumption = lastCpuConsumption - currentCpuConsumption;
+                // keep track of the new CPU consumption
+                auto lastCpuConsumption = pThreadInfo->SetCpuConsumptionNanoseconds(currentCpuConsumption);
+                if (lastCpuConsumption == 0)
+                {
+                    // count the duration of the first occurence as the sampling rate
+                    incrementCpuConsumption = GetSamplingPeriod().count();
+                }
+                else if (currentCpuConsumption > lastCpuConsumption)
+                {
+                    incrementCpuConsumption = currentCpuConsumption - lastCpuConsumption;
+                }
             }
 
             if (incrementCpuConsumption > 0)
             {
-                // keep track of the new CPU consumption
-                pThreadInfo->SetCpuConsumptionMilliseconds(currentCpuConsumption);
-
                 // emit a CPU sample
                 RawCpuSample rawCpuSample;
                 rawCpuSample.Timestamp = pSnapshotResult->GetUnixTimeUtc();
                 rawCpuSample.LocalRootSpanId = pSnapshotResult->GetLocalRootSpanId();
                 rawCpuSample.SpanId = pSnapshotResult->GetSpanId();
                 rawCpuSample.AppDomainId = pSnapshotResult->GetAppDomainId();
-                pSnapshotResult->CopyInstructionPointers(rawCpuSample.Stack);
                 rawCpuSample.ThreadInfo = pThreadInfo;
                 pThreadInfo->AddRef();
                 rawCpuSample.Duration = incrementCpuConsumption;
-                _pCpuTimeCollector->Add(std::move(rawCpuSample));
+                _pCpuTimeCollector->Add(std::move(rawCpuSample), _instructionPointers.data(), _instructionPointers.size());
             }
         }
     }
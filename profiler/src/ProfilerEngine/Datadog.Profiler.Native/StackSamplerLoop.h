@@ -10,6 +10,7 @@
 
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 // from dotnet coreclr includes
 #include "cor.h"
@@ -20,6 +21,7 @@
 #include "ICollector.h"
 #include "RawCpuSample.h"
 #include "RawWallTimeSample.h"
+#include "SamplingScheduler.h"
 
 #include "shared/src/native-src/string.h"
 
@@ -32,6 +34,7 @@ class IStackSnapshotsBufferManager;
 class IManagedThreadList;
 class ISymbolsResolver;
 class IConfiguration;
+class GarbageCollectionProvider;
 
 class StackSamplerLoop
 {
@@ -48,7 +51,8 @@ public:
         IManagedThreadList* pManagedThreadList,
         ISymbolsResolver* pSymbolResolver,
         ICollector<RawWallTimeSample>* pWallTimeCollector,
-        ICollector<RawCpuSample>* pCpuTimeCollector
+        ICollector<RawCpuSample>* pCpuTimeCollector,
+        GarbageCollectionProvider const* pGarbageCollectionProvider
         );
     ~StackSamplerLoop();
     StackSamplerLoop(StackSamplerLoop const&) = delete;
@@ -68,11 +72,28 @@ private:
     ISymbolsResolver* _pSymbolsResolver;
     ICollector<RawWallTimeSample>* _pWallTimeCollector;
     ICollector<RawCpuSample>* _pCpuTimeCollector;
+    GarbageCollectionProvider const* _pGarbageCollectionProvider;  // null if GC profiling is disabled
 
     std::thread* _pLoopThread;
     DWORD _loopThreadOsId;
     volatile bool _shutdownRequested = false;
     ManagedThreadInfo* _targetThread;
+    const bool _isCpuTimerSamplingEnabled;
+    std::vector<RawCpuSample> _cpuTimerSamples;
+
+    // instruction pointers of the last persisted snapshot, shared by the wall time and CPU samples
+    std::vector<std::uintptr_t> _instructionPointers;
+
+    // when the collector supports it, the threads sampled in an iteration are collected in parallel
+    const std::uint32_t _stackSamplesBatchCapacity;
+    std::int32_t _sampledThreadsPerIteration;
+    std::vector<ManagedThreadInfo*> _batchThreads;
+    std::vector<std::int64_t> _batchPrevSampleTimestamps;
+    std::vector<StackSnapshotResultBuffer*> _batchStackSnapshotResults;
+    std::vector<uint32_t> _batchHRs;
+
+    // null if the sampling period and the number of threads sampled per iteration are fixed
+    std::unique_ptr<SamplingScheduler> _pSamplingScheduler;
 
 private:
     std::unordered_map<HRESULT, std::uint64_t> _encounteredStackSnapshotHRs;
@@ -84,7 +105,15 @@ private:
     void MainLoop(void);
     void WaitOnePeriod(void);
     void MainLoopIteration(void);
+    std::int32_t CollectThreadsStackSamples(void);
     void CollectOneThreadStackSample(ManagedThreadInfo* pThreadInfo);
+    std::int32_t CollectStackSamplesBatch(void);
+    std::int32_t GetThreadsPerIteration(void) const;
+    std::int32_t GetCandidatesCount(std::int32_t managedThreadsCount, std::int32_t thisIterationCount) const;
+    std::chrono::nanoseconds GetSamplingPeriod(void) const;
+    ManagedThreadInfo* PickNextThread(std::int32_t& candidatesCount, std::int64_t currentTimestampNs);
+    bool IsThreadParked(ManagedThreadInfo* pThreadInfo, std::int64_t currentTimestampNs);
+    void CollectCpuTimerSamples(void);
     void LogEncounteredStackSnapshotResultStatistics(std::int64_t thisSampleTimestampNanosecs, bool useStdOutInsteadOfLog = false);
     void DetermineSampledStackFrameCodeKinds(StackSnapshotResultBuffer* _pStackSnapshotResult);
     void DetermineAppDomain(ThreadID threadId, StackSnapshotResultBuffer* const pStackSnapshotResult);
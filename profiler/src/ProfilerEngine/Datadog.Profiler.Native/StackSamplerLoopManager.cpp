@@ -3,6 +3,8 @@
 
 #include "StackSamplerLoopManager.h"
 #include "IClrLifetime.h"
+#include "IConfiguration.h"
+#include "Log.h"
 #include "OpSysTools.h"
 #include "OsSpecificApi.h"
 #include "SymbolsResolver.h"
@@ -11,7 +13,6 @@
 using namespace std::chrono_literals;
 
 constexpr std::chrono::milliseconds DeadlockDetectionInterval = 1s;
-constexpr std::chrono::milliseconds StackSamplerLoopManager_MaxExpectedStackSampleCollectionDurationMs = 500ms;
 constexpr std::chrono::nanoseconds CollectionDurationThresholdNs = std::chrono::nanoseconds(StackSamplerLoopManager_MaxExpectedStackSampleCollectionDurationMs);
 
 #ifdef NDEBUG
@@ -23,6 +24,7 @@ constexpr std::chrono::nanoseconds StatsAggregationPeriodNs = StatsAggregationPe
 
 const WCHAR* WatcherThreadName = WStr("DD.Profiler.StackSamplerLoopManager.WatcherThread");
 const std::chrono::nanoseconds StackSamplerLoopManager::StatisticAggregationPeriodNs = 10s;
+const std::chrono::nanoseconds StackSamplerLoopManager::CpuTimerInterval = 10ms;
 
 StackSamplerLoopManager::StackSamplerLoopManager(
     ICorProfilerInfo4* pCorProfilerInfo,
@@ -34,16 +36,19 @@ StackSamplerLoopManager::StackSamplerLoopManager(
     IManagedThreadList* pManagedThreadList,
     ISymbolsResolver* pSymbolsResolver,
     ICollector<RawWallTimeSample>* pWallTimeCollector,
-    ICollector<RawCpuSample>* pCpuTimeCollector
+    ICollector<RawCpuSample>* pCpuTimeCollector,
+    GarbageCollectionProvider const* pGarbageCollectionProvider
     ) :
     _pCorProfilerInfo{pCorProfilerInfo},
     _pConfiguration{pConfiguration},
     _pStackFramesCollector{nullptr},
     _pStackSamplerLoop{nullptr},
+    _isCpuTimerSamplingEnabled{false},
     _pWatcherThread{nullptr},
     _isWatcherShutdownRequested{false},
     _pTargetThread{nullptr},
     _collectionStartNs{0},
+    _collectionTimeSinceResetNs{0},
     _isTargetThreadSuspended{false},
     _isForceTerminated{false},
     _currentPeriod{0},
@@ -59,11 +64,26 @@ StackSamplerLoopManager::StackSamplerLoopManager(
     _pSymbolsResolver{pSymbolsResolver},
     _pWallTimeCollector{pWallTimeCollector},
     _pCpuTimeCollector{pCpuTimeCollector},
+    _pGarbageCollectionProvider{pGarbageCollectionProvider},
     _deadlockInterventionInProgress{0}
 {
     _pCorProfilerInfo->AddRef();
     _pStackFramesCollector = OsSpecificApi::CreateNewStackFramesCollectorInstance(_pCorProfilerInfo);
 
+    // The timers must be enabled before the first thread is assigned to an OS thread
+    if (_pConfiguration->IsFFLibddprofEnabled() && _pConfiguration->IsCpuProfilingEnabled() && _pConfiguration->IsCpuTimerSamplingEnabled())
+    {
+        _isCpuTimerSamplingEnabled = _pStackFramesCollector->EnableCpuTimers(CpuTimerInterval);
+        if (_isCpuTimerSamplingEnabled)
+        {
+            Log::Info("CPU samples are collected every ", CpuTimerInterval.count() / 1000000, " ms of CPU consumed by each thread.");
+        }
+        else
+        {
+            Log::Info("CPU timers are not supported: CPU consumption is computed when threads are sampled.");
+        }
+    }
+
     _currentStatistics = std::make_unique<Statistics>();
     _statisticCollectionStartNs = OpSysTools::GetHighPrecisionNanoseconds();
 }
@@ -132,7 +152,8 @@ void StackSamplerLoopManager::RunStackSampling()
             _pManagedThreadList,
             _pSymbolsResolver,
             _pWallTimeCollector,
-            _pCpuTimeCollector
+            _pCpuTimeCollector,
+            _pGarbageCollectionProvider
             );
         _pStackSamplerLoop = stackSamplerLoop;
     }
@@ -276,6 +297,13 @@ void StackSamplerLoopManager::WatcherLoopIteration()
         return;
     }
 
+    if (_pTargetThread == nullptr)
+    {
+        // Batched collection: no thread is suspended so there is no thread to resume.
+        // The collector stops waiting for the stalled stack walks by itself.
+        return;
+    }
+
 #ifdef _WINDOWS
     auto samplerThreadhandle = static_cast<HANDLE>(_pStackSamplerLoop->_pLoopThread->native_handle());
 
@@ -442,6 +470,29 @@ bool StackSamplerLoopManager::AllowStackWalk(ManagedThreadInfo* pThreadInfo)
 {
     std::lock_guard<std::mutex> guardedLock(_watcherActivityLock);
 
+    if (!TryAcquireStackWalk(pThreadInfo))
+    {
+        return false;
+    }
+
+    _pTargetThread = pThreadInfo;
+    _isTargetThreadSuspended = false;
+    _isForceTerminated = false;
+
+    return true;
+}
+
+bool StackSamplerLoopManager::AllowStackWalkInBatch(ManagedThreadInfo* pThreadInfo)
+{
+    std::lock_guard<std::mutex> guardedLock(_watcherActivityLock);
+
+    return TryAcquireStackWalk(pThreadInfo);
+}
+
+bool StackSamplerLoopManager::TryAcquireStackWalk(ManagedThreadInfo* pThreadInfo)
+{
+    // This method must only be called while _watcherActivityLock is held!
+
     bool isThreadSafeStatusChanged;
     bool isThreadSafeForStackSampleCollection = GetUpdateIsThreadSafeForStackSampleCollection(pThreadInfo, &isThreadSafeStatusChanged);
 
@@ -486,9 +537,6 @@ bool StackSamplerLoopManager::AllowStackWalk(ManagedThreadInfo* pThreadInfo)
     }
 
     pThreadInfo->AddRef();
-    _pTargetThread = pThreadInfo;
-    _isTargetThreadSuspended = false;
-    _isForceTerminated = false;
 
     return true;
 }
@@ -520,6 +568,7 @@ void StackSamplerLoopManager::NotifyCollectionEnd()
 
     std::int64_t collectionEndTimeNs = OpSysTools::GetHighPrecisionNanoseconds();
     _currentStatistics->AddCollectionTime(collectionEndTimeNs - _collectionStartNs);
+    _collectionTimeSinceResetNs += collectionEndTimeNs - _collectionStartNs;
 
     _collectionStartNs = 0;
     _kernelTime = {0};
@@ -537,6 +586,27 @@ void StackSamplerLoopManager::NotifyIterationFinished()
     _collectionStartNs = 0;
     _isTargetThreadSuspended = false;
 
+    UpdateIterationStatistics();
+}
+
+void StackSamplerLoopManager::NotifyBatchIterationFinished(ManagedThreadInfo* const* ppThreadInfos, std::uint32_t count)
+{
+    std::lock_guard<std::mutex> guardedLock(_watcherActivityLock);
+
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+        ppThreadInfos[i]->GetStackWalkLock().Release();
+        ppThreadInfos[i]->Release();
+    }
+    _collectionStartNs = 0;
+
+    UpdateIterationStatistics();
+}
+
+void StackSamplerLoopManager::UpdateIterationStatistics()
+{
+    // This method must only be called while _watcherActivityLock is held!
+
     std::int64_t threadCollectionEndTimeNs = OpSysTools::GetHighPrecisionNanoseconds();
     _currentStatistics->AddSuspensionTime(threadCollectionEndTimeNs - _threadSuspensionStart);
 
@@ -549,6 +619,36 @@ void StackSamplerLoopManager::NotifyIterationFinished()
     }
 }
 
+void StackSamplerLoopManager::OnThreadAssignedToOsThread(ManagedThreadInfo* pThreadInfo)
+{
+    if (_isCpuTimerSamplingEnabled)
+    {
+        _pStackFramesCollector->StartCpuTimer(pThreadInfo);
+    }
+}
+
+void StackSamplerLoopManager::OnThreadDestroyed(ManagedThreadInfo* pThreadInfo)
+{
+    if (_isCpuTimerSamplingEnabled)
+    {
+        _pStackFramesCollector->StopCpuTimer(pThreadInfo);
+    }
+}
+
+std::chrono::nanoseconds StackSamplerLoopManager::GetAndResetCollectionTime()
+{
+    std::lock_guard<std::mutex> guardedLock(_watcherActivityLock);
+
+    std::chrono::nanoseconds collectionTime(_collectionTimeSinceResetNs);
+    _collectionTimeSinceResetNs = 0;
+    return collectionTime;
+}
+
+bool StackSamplerLoopManager::IsCpuTimerSamplingEnabled() const
+{
+    return _isCpuTimerSamplingEnabled;
+}
+
 inline bool StackSamplerLoopManager::GetUpdateIsThreadSafeForStackSampleCollection(
     ManagedThreadInfo* pThreadInfo,
     bool* pIsStatusChanged)
@@ -29,11 +29,16 @@ class IStackSnapshotsBufferManager;
 class IManagedThreadList;
 class ISymbolsResolver;
 class IConfiguration;
+class GarbageCollectionProvider;
 
 
 constexpr std::uint64_t DeadlocksPerThreadThreshold = 5;
 constexpr std::uint64_t TotalDeadlocksThreshold = 12;
 
+// A stack sample collection that lasts longer is considered as deadlocked by the watcher.
+// The batched collectors, that the watcher does not track, bound their own wait by the same duration.
+constexpr std::chrono::milliseconds StackSamplerLoopManager_MaxExpectedStackSampleCollectionDurationMs = std::chrono::milliseconds(500);
+
 // Be very careful with this flag. See comments for the StackSamplerLoopManager class and throughout the implementation.
 constexpr bool LogDuringStackSampling_Unsafe = false;
 
@@ -88,7 +93,8 @@ public:
         IManagedThreadList* pManagedThreadList,
         ISymbolsResolver* pSymbolsResolver,
         ICollector<RawWallTimeSample>* pWallTimeCollector,
-        ICollector<RawCpuSample>* pCpuTimeCollector
+        ICollector<RawCpuSample>* pCpuTimeCollector,
+        GarbageCollectionProvider const* pGarbageCollectionProvider
         );
 
     ~StackSamplerLoopManager() override;
@@ -103,11 +109,28 @@ public:
     void NotifyCollectionEnd() override;
     void NotifyIterationFinished() override;
 
+    // When the stacks of several threads are collected in parallel, no thread is tracked as the target thread
+    // because the deadlock intervention is only needed for collectors that suspend the threads (i.e. not batched):
+    // the watcher never intervenes during a batch and the batched collector bounds its own wait instead
+    // (see StackSamplerLoopManager_MaxExpectedStackSampleCollectionDurationMs)
+    bool AllowStackWalkInBatch(ManagedThreadInfo* pThreadInfo) override;
+    void NotifyBatchIterationFinished(ManagedThreadInfo* const* ppThreadInfos, std::uint32_t count) override;
+    void OnThreadAssignedToOsThread(ManagedThreadInfo* pThreadInfo) override;
+    void OnThreadDestroyed(ManagedThreadInfo* pThreadInfo) override;
+
+    // sum of the stack walks durations (as in the collection time statistics) since the previous call
+    std::chrono::nanoseconds GetAndResetCollectionTime() override;
+
+    // true if the CPU samples are collected by per-thread CPU timers instead of the sampler thread
+    bool IsCpuTimerSamplingEnabled() const;
+
 private:
     StackSamplerLoopManager() = delete;
 
     inline bool GetUpdateIsThreadSafeForStackSampleCollection(ManagedThreadInfo* pThreadInfo, bool* pIsStatusChanged);
     inline bool ShouldCollectThread(std::uint64_t threadAggPeriodDeadlockCount, std::uint64_t globalAggPeriodDeadlockCount) const;
+    bool TryAcquireStackWalk(ManagedThreadInfo* pThreadInfo);
+    void UpdateIterationStatistics();
 
     void RunStackSampling(void);
     void GracefulShutdownStackSampling(void);
@@ -131,6 +154,7 @@ private:
 
 private:
     static const std::chrono::nanoseconds StatisticAggregationPeriodNs;
+    static const std::chrono::nanoseconds CpuTimerInterval;
 
     class Statistics
     {
@@ -211,9 +235,11 @@ private:
     ISymbolsResolver* _pSymbolsResolver = nullptr;
     ICollector<RawWallTimeSample>* _pWallTimeCollector = nullptr;
     ICollector<RawCpuSample>* _pCpuTimeCollector = nullptr;
+    GarbageCollectionProvider const* _pGarbageCollectionProvider = nullptr;
 
     StackFramesCollectorBase* _pStackFramesCollector;
     StackSamplerLoop* _pStackSamplerLoop;
+    bool _isCpuTimerSamplingEnabled;
     std::uint8_t _deadlockInterventionInProgress;
 
     std::thread* _pWatcherThread;
@@ -223,6 +249,7 @@ private:
 
     ManagedThreadInfo* _pTargetThread;
     std::int64_t _collectionStartNs;
+    std::int64_t _collectionTimeSinceResetNs;
     FILETIME _kernelTime, _userTime;
 
     bool _isTargetThreadSuspended;
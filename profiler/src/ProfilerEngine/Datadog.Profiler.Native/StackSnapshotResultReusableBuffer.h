@@ -14,8 +14,8 @@
 /// <summary>
 /// Allocating when a thread is suspended can lead to deadlocks.
 /// This container holds a buffer that is used while walking stacks to temporarily hold results.
-/// If we wanted to walk stacks of more than one thread concurrently, there would need to be more then once instance of this class.
-/// However, since StackFrameCollector implementations currently all walk one stack at a time, they use one instance of this class each.
+/// Collectors that walk one stack at a time use one instance of this class each.
+/// Collectors that walk the stacks of several threads concurrently (see LinuxStackFramesCollector) use one instance per thread walked in parallel.
 /// </summary>
 class StackSnapshotResultBuffer
 {
@@ -0,0 +1,95 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include "StringTable.h"
+#include "Log.h"
+
+StringId const StringTable::EmptyStringId = 0;
+
+StringTable::StringTable() :
+    _count{0}
+{
+    for (auto& chunk : _chunks)
+    {
+        chunk.store(nullptr);
+    }
+
+    // the empty string is always the first one
+    Intern("");
+}
+
+StringTable::~StringTable()
+{
+    for (auto& chunk : _chunks)
+    {
+        delete[] chunk.load();
+    }
+}
+
+StringTable* StringTable::GetInstance()
+{
+    // never deleted: interned strings could still be used by other threads during shutdown
+    static StringTable* pInstance = new StringTable();
+    return pInstance;
+}
+
+StringId StringTable::Intern(std::string_view value)
+{
+    std::lock_guard<std::mutex> lock(_internLock);
+
+    auto element = _ids.find(value);
+    if (element != _ids.end())
+    {
+        return element->second;
+    }
+
+    auto count = _count.load(std::memory_order_relaxed);
+    auto* pChunk = GetOrCreateChunk(count / ChunkSize);
+    if (pChunk == nullptr)
+    {
+        // should never happen but better map to the empty string than crashing
+        Log::Warn("Too many interned strings (", count, "): '", value, "' is not interned.");
+        return EmptyStringId;
+    }
+
+    auto const& text = _strings.emplace_back(value);
+    auto id = static_cast<StringId>(count);
+    pChunk[count % ChunkSize] = text;
+    _ids[text] = id;
+    _count.store(count + 1, std::memory_order_release);
+
+    return id;
+}
+
+std::string_view StringTable::Get(StringId id) const
+{
+    if (id >= _count.load(std::memory_order_acquire))
+    {
+        return {};
+    }
+
+    auto const* pChunk = _chunks[id / ChunkSize].load(std::memory_order_acquire);
+    return pChunk[id % ChunkSize];
+}
+
+std::size_t StringTable::Size() const
+{
+    return _count.load();
+}
+
+std::string_view* StringTable::GetOrCreateChunk(std::size_t chunkIndex)
+{
+    if (chunkIndex >= MaxChunksCount)
+    {
+        return nullptr;
+    }
+
+    auto* pChunk = _chunks[chunkIndex].load(std::memory_order_relaxed);
+    if (pChunk == nullptr)
+    {
+        pChunk = new std::string_view[ChunkSize];
+        _chunks[chunkIndex].store(pChunk, std::memory_order_release);
+    }
+
+    return pChunk;
+}
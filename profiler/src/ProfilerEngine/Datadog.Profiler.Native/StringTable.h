@@ -0,0 +1,55 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+typedef std::uint32_t StringId;
+
+// Process-wide table of interned strings (module names, frames, ...).
+// An interned string is never freed so:
+//  - the same text is stored only once and identified by a small integer
+//  - the string_view returned by Get() is valid for the lifetime of the process
+// Interning takes a lock but getting the text of an id does not.
+class StringTable
+{
+public:
+    // id of the empty string
+    static StringId const EmptyStringId;
+
+public:
+    StringTable();
+    ~StringTable();
+
+    StringTable(const StringTable&) = delete;
+    StringTable& operator=(const StringTable&) = delete;
+
+    static StringTable* GetInstance();
+
+public:
+    StringId Intern(std::string_view value);
+    std::string_view Get(StringId id) const;
+    std::size_t Size() const;
+
+private:
+    // ids are used as an index in chunks of string_views that are never reallocated
+    static const std::size_t ChunkSize = 4096;
+    static const std::size_t MaxChunksCount = 4096;
+
+    std::string_view* GetOrCreateChunk(std::size_t chunkIndex);
+
+private:
+    std::mutex _internLock;
+    std::deque<std::string> _strings; // no reallocation when growing
+    std::unordered_map<std::string_view, StringId> _ids;
+
+    std::array<std::atomic<std::string_view*>, MaxChunksCount> _chunks;
+    std::atomic<std::size_t> _count;
+};
@@ -0,0 +1,27 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include "SynchronousStackCollector.h"
+
+bool SynchronousStackCollector::Collect(ICorProfilerInfo4* pCorProfilerInfo, std::vector<std::uintptr_t>& stack)
+{
+    stack.reserve(64);
+
+    // 0 means the current thread
+    HRESULT hr = pCorProfilerInfo->DoStackSnapshot(0, OnStackFrame, COR_PRF_SNAPSHOT_DEFAULT, &stack, nullptr, 0);
+
+    return SUCCEEDED(hr) && !stack.empty();
+}
+
+HRESULT STDMETHODCALLTYPE SynchronousStackCollector::OnStackFrame(FunctionID functionId, UINT_PTR ip, COR_PRF_FRAME_INFO frameInfo, ULONG32 contextSize, BYTE context[], void* clientData)
+{
+    auto* pStack = static_cast<std::vector<std::uintptr_t>*>(clientData);
+    if (pStack->size() >= MaxFramesCount)
+    {
+        // stop the walk
+        return S_FALSE;
+    }
+
+    pStack->push_back(static_cast<std::uintptr_t>(ip));
+    return S_OK;
+}
@@ -0,0 +1,26 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "cor.h"
+#include "corprof.h"
+
+// Walks the managed stack of the current thread from a CLR callback (i.e. allocation or exception):
+// unlike the StackSamplerLoop, there is no need to suspend the thread.
+class SynchronousStackCollector
+{
+public:
+    // deeper stacks are truncated by the raw samples queue anyway
+    static const std::size_t MaxFramesCount = 512;
+
+public:
+    // returns false if the stack could not be walked or is empty
+    static bool Collect(ICorProfilerInfo4* pCorProfilerInfo, std::vector<std::uintptr_t>& stack);
+
+private:
+    static HRESULT STDMETHODCALLTYPE OnStackFrame(FunctionID functionId, UINT_PTR ip, COR_PRF_FRAME_INFO frameInfo, ULONG32 contextSize, BYTE context[], void* clientData);
+};
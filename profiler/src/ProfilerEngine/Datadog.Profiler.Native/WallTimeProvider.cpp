@@ -1,6 +1,7 @@
 // Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
 // This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
 
+#include "GarbageCollectionProvider.h"
 #include "IAppDomainStore.h"
 #include "IConfiguration.h"
 #include "IFrameStore.h"
@@ -13,10 +14,11 @@ WallTimeProvider::WallTimeProvider(
     IConfiguration* pConfiguration,
     IFrameStore* pFrameStore,
     IAppDomainStore* pAppDomainStore,
-    IRuntimeIdStore* pRuntimeIdStore
+    IRuntimeIdStore* pRuntimeIdStore,
+    SamplesTransformerPool* pTransformerPool
     )
     :
-    CollectorBase<RawWallTimeSample>(pConfiguration, pFrameStore, pAppDomainStore, pRuntimeIdStore)
+    CollectorBase<RawWallTimeSample>(pConfiguration, pFrameStore, pAppDomainStore, pRuntimeIdStore, pTransformerPool)
 {
 }
 
@@ -27,6 +29,11 @@ const char* WallTimeProvider::GetName()
 
 void WallTimeProvider::OnTransformRawSample(const RawWallTimeSample& rawSample, Sample& sample)
 {
+    if (rawSample.DuringGarbageCollection)
+    {
+        GarbageCollectionProvider::AddGarbageCollectorFrame(sample);
+    }
+
     sample.AddValue(rawSample.Duration, SampleValue::WallTimeDuration);
 }
 
@@ -24,7 +24,8 @@ public:
         IConfiguration* pConfiguration,
         IFrameStore* pFrameStore,
         IAppDomainStore* pAssemblyStore,
-        IRuntimeIdStore* pRuntimeIdStore
+        IRuntimeIdStore* pRuntimeIdStore,
+        SamplesTransformerPool* pTransformerPool = nullptr
         );
 
 // interfaces implementation
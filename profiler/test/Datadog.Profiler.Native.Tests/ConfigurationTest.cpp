@@ -145,6 +145,79 @@ TEST(ConfigurationTest, CheckProfileDirectoryWhenVariableIsSet)
     ASSERT_EQ(expectedValue, configuration.GetProfilesOutputDirectory());
 }
 
+TEST(ConfigurationTest, CheckNoDefaultSpoolDirectoryWhenVariableIsNotSet)
+{
+    unsetenv(EnvironmentVariables::SpoolDirectory);
+    auto configuration = Configuration{};
+    auto expectedValue = shared::WSTRING();
+    ASSERT_EQ(expectedValue, configuration.GetSpoolDirectory());
+}
+
+TEST(ConfigurationTest, CheckSpoolDirectoryWhenVariableIsSet)
+{
+    auto expectedValue = fs::path(WStr("MyFolder/WhereIWantIt/ToBe"));
+    EnvironmentHelper::EnvironmentVariable ar(EnvironmentVariables::SpoolDirectory, shared::ToWSTRING(expectedValue.string()));
+    auto configuration = Configuration{};
+    ASSERT_EQ(expectedValue, configuration.GetSpoolDirectory());
+}
+
+TEST(ConfigurationTest, CheckDefaultSpoolMaxSizePerServiceWhenVariableIsNotSet)
+{
+    unsetenv(EnvironmentVariables::SpoolMaxSizePerService);
+    auto configuration = Configuration{};
+    ASSERT_EQ(50 * 1024 * 1024, configuration.GetSpoolMaxSizePerService());
+}
+
+TEST(ConfigurationTest, CheckSpoolMaxSizePerServiceWhenVariableIsSet)
+{
+    EnvironmentHelper::EnvironmentVariable ar(EnvironmentVariables::SpoolMaxSizePerService, WStr("8"));
+    auto configuration = Configuration{};
+    ASSERT_EQ(8 * 1024 * 1024, configuration.GetSpoolMaxSizePerService());
+}
+
+TEST(ConfigurationTest, CheckDefaultTransformerThreadsCountWhenVariableIsNotSet)
+{
+    unsetenv(EnvironmentVariables::TransformerThreadsCount);
+    auto configuration = Configuration{};
+    ASSERT_GE(configuration.GetTransformerThreadsCount(), 1);
+    ASSERT_LE(configuration.GetTransformerThreadsCount(), 4);
+}
+
+TEST(ConfigurationTest, CheckTransformerThreadsCountWhenVariableIsSet)
+{
+    EnvironmentHelper::EnvironmentVariable ar(EnvironmentVariables::TransformerThreadsCount, WStr("6"));
+    auto configuration = Configuration{};
+    ASSERT_EQ(6, configuration.GetTransformerThreadsCount());
+}
+
+TEST(ConfigurationTest, CheckDefaultTransformerThreadsCountWhenVariableIsZero)
+{
+    EnvironmentHelper::EnvironmentVariable ar(EnvironmentVariables::TransformerThreadsCount, WStr("0"));
+    auto configuration = Configuration{};
+    ASSERT_GE(configuration.GetTransformerThreadsCount(), 1);
+}
+
+TEST(ConfigurationTest, CheckDefaultRawSamplesCapacityWhenVariableIsNotSet)
+{
+    unsetenv(EnvironmentVariables::RawSamplesCapacity);
+    auto configuration = Configuration{};
+    ASSERT_EQ(256, configuration.GetRawSamplesCapacity());
+}
+
+TEST(ConfigurationTest, CheckRawSamplesCapacityWhenVariableIsSet)
+{
+    EnvironmentHelper::EnvironmentVariable ar(EnvironmentVariables::RawSamplesCapacity, WStr("1024"));
+    auto configuration = Configuration{};
+    ASSERT_EQ(1024, configuration.GetRawSamplesCapacity());
+}
+
+TEST(ConfigurationTest, CheckDefaultRawSamplesCapacityWhenVariableIsZero)
+{
+    EnvironmentHelper::EnvironmentVariable ar(EnvironmentVariables::RawSamplesCapacity, WStr("0"));
+    auto configuration = Configuration{};
+    ASSERT_EQ(256, configuration.GetRawSamplesCapacity());
+}
+
 TEST(ConfigurationTest, CheckDefaultUploadIntervalInDevMode)
 {
     unsetenv(EnvironmentVariables::UploadInterval);
@@ -374,3 +447,80 @@ TEST(ConfigurationTest, CheckThatFFIsLibddprofIsEnabledWhenVariableIsNotSet)
     auto configuration = Configuration{};
     ASSERT_TRUE(configuration.IsFFLibddprofEnabled());
 }
+
+TEST(ConfigurationTest, CheckSamplingOverheadBudgetIsZeroWhenVariableIsNotSet)
+{
+    unsetenv(EnvironmentVariables::SamplingOverheadBudget);
+    auto configuration = Configuration{};
+    ASSERT_EQ(0.0, configuration.GetSamplingOverheadBudget());
+}
+
+TEST(ConfigurationTest, CheckSamplingOverheadBudgetWhenVariableIsSet)
+{
+    EnvironmentHelper::EnvironmentVariable ar(EnvironmentVariables::SamplingOverheadBudget, WStr("0.5"));
+    auto configuration = Configuration{};
+    ASSERT_EQ(0.5, configuration.GetSamplingOverheadBudget());
+}
+
+TEST(ConfigurationTest, CheckSamplingOverheadBudgetIsZeroWhenVariableIsInvalid)
+{
+    EnvironmentHelper::EnvironmentVariable ar(EnvironmentVariables::SamplingOverheadBudget, WStr("1%"));
+    auto configuration = Configuration{};
+    ASSERT_EQ(0.0, configuration.GetSamplingOverheadBudget());
+}
+
+TEST(ConfigurationTest, CheckIfAllocationProfilingIsNotEnabledWhenVariableIsNotSet)
+{
+    unsetenv(EnvironmentVariables::AllocationProfilingEnabled);
+    auto configuration = Configuration{};
+    ASSERT_FALSE(configuration.IsAllocationProfilingEnabled());
+}
+
+TEST(ConfigurationTest, CheckIfAllocationProfilingIsEnabledWhenEnvVariableIsSetToTrue)
+{
+    EnvironmentHelper::EnvironmentVariable ar(EnvironmentVariables::AllocationProfilingEnabled, WStr("1"));
+    auto configuration = Configuration{};
+    ASSERT_TRUE(configuration.IsAllocationProfilingEnabled());
+}
+
+TEST(ConfigurationTest, CheckIfContentionProfilingIsNotEnabledWhenVariableIsNotSet)
+{
+    unsetenv(EnvironmentVariables::ContentionProfilingEnabled);
+    auto configuration = Configuration{};
+    ASSERT_FALSE(configuration.IsContentionProfilingEnabled());
+}
+
+TEST(ConfigurationTest, CheckIfContentionProfilingIsEnabledWhenEnvVariableIsSetToTrue)
+{
+    EnvironmentHelper::EnvironmentVariable ar(EnvironmentVariables::ContentionProfilingEnabled, WStr("1"));
+    auto configuration = Configuration{};
+    ASSERT_TRUE(configuration.IsContentionProfilingEnabled());
+}
+
+TEST(ConfigurationTest, CheckIfExceptionProfilingIsNotEnabledWhenVariableIsNotSet)
+{
+    unsetenv(EnvironmentVariables::ExceptionProfilingEnabled);
+    auto configuration = Configuration{};
+    ASSERT_FALSE(configuration.IsExceptionProfilingEnabled());
+}
+
+TEST(ConfigurationTest, CheckIfExceptionProfilingIsEnabledWhenEnvVariableIsSetToTrue)
+{
+    EnvironmentHelper::EnvironmentVariable ar(EnvironmentVariables::ExceptionProfilingEnabled, WStr("1"));
+    auto configuration = Configuration{};
+    ASSERT_TRUE(configuration.IsExceptionProfilingEnabled());
+}
+
+TEST(ConfigurationTest, CheckIfGarbageCollectionProfilingIsNotEnabledWhenVariableIsNotSet)
+{
+    unsetenv(EnvironmentVariables::GarbageCollectionProfilingEnabled);
+    auto configuration = Configuration{};
+    ASSERT_FALSE(configuration.IsGarbageCollectionProfilingEnabled());
+}
+
+TEST(ConfigurationTest, CheckIfGarbageCollectionProfilingIsEnabledWhenEnvVariableIsSetToTrue)
+{
+    EnvironmentHelper::EnvironmentVariable ar(EnvironmentVariables::GarbageCollectionProfilingEnabled, WStr("1"));
+    auto configuration = Configuration{};
+    ASSERT_TRUE(configuration.IsGarbageCollectionProfilingEnabled());
+}
@@ -0,0 +1,150 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include "gtest/gtest.h"
+
+#include "ExceptionSampler.h"
+
+const std::int64_t OneSecondNs = 1000000000;
+
+TEST(ExceptionSamplerTest, CheckBurstIsSampled)
+{
+    ExceptionSampler sampler(1, 3);
+
+    // the bucket starts full
+    ASSERT_EQ(1, sampler.Sample(1, 0));
+    ASSERT_EQ(1, sampler.Sample(1, 0));
+    ASSERT_EQ(1, sampler.Sample(1, 0));
+    ASSERT_EQ(0, sampler.Sample(1, 0));
+}
+
+TEST(ExceptionSamplerTest, CheckSkippedExceptionsAreCounted)
+{
+    ExceptionSampler sampler(1, 1);
+
+    ASSERT_EQ(1, sampler.Sample(1, 0));
+    for (int i = 0; i < 9; i++)
+    {
+        ASSERT_EQ(0, sampler.Sample(1, OneSecondNs / 10));
+    }
+
+    // a token is available after 1 second: the sample represents the skipped exceptions too
+    ASSERT_EQ(10, sampler.Sample(1, OneSecondNs));
+    ASSERT_EQ(0, sampler.Sample(1, OneSecondNs));
+}
+
+TEST(ExceptionSamplerTest, CheckTypesAreRateLimitedIndependently)
+{
+    ExceptionSampler sampler(1, 1);
+
+    ASSERT_EQ(1, sampler.Sample(1, 0));
+    ASSERT_EQ(0, sampler.Sample(1, 0));
+
+    // a storm of exceptions of one type does not prevent the other types from being sampled
+    ASSERT_EQ(1, sampler.Sample(2, 0));
+    ASSERT_EQ(0, sampler.Sample(2, 0));
+}
+
+TEST(ExceptionSamplerTest, CheckSkippedExceptionsAreFlushed)
+{
+    ExceptionSampler sampler(1, 1);
+
+    ASSERT_EQ(1, sampler.Sample(1, 0));
+    sampler.SetTypeName(1, "System.InvalidOperationException");
+    ASSERT_EQ(0, sampler.Sample(1, 0));
+    ASSERT_EQ(0, sampler.Sample(1, 0));
+    ASSERT_EQ(1, sampler.Sample(2, 0));
+
+    // the exceptions thrown after the last sample of their type are returned once
+    auto skippedExceptions = sampler.Flush();
+    ASSERT_EQ(1, skippedExceptions.size());
+    ASSERT_EQ("System.InvalidOperationException", skippedExceptions[0].TypeName);
+    ASSERT_EQ(2, skippedExceptions[0].Count);
+
+    ASSERT_TRUE(sampler.Flush().empty());
+}
+
+TEST(ExceptionSamplerTest, CheckRateIsSharedByThrownTypes)
+{
+    ExceptionSampler sampler(1, 1);
+    ASSERT_EQ(1, sampler.GetSamplesPerSecond());
+
+    for (ClassID classId = 1; classId <= 4; classId++)
+    {
+        ASSERT_EQ(1, sampler.Sample(classId, 0));
+        ASSERT_EQ(0, sampler.Sample(classId, 0));
+    }
+
+    sampler.Flush();
+    ASSERT_EQ(0.25, sampler.GetSamplesPerSecond());
+
+    // a token is now available after 4 seconds instead of 1
+    ASSERT_EQ(0, sampler.Sample(1, 2 * OneSecondNs));
+    ASSERT_EQ(2, sampler.Sample(1, 4 * OneSecondNs));
+
+    // the other types were not thrown during the last period: they are forgotten
+    sampler.Flush();
+    ASSERT_EQ(1, sampler.GetSamplesPerSecond());
+    ASSERT_EQ(1, sampler.Sample(2, 4 * OneSecondNs));
+}
+
+TEST(ExceptionSamplerTest, CheckRateHasMinimum)
+{
+    ExceptionSampler sampler(1, 1);
+
+    for (ClassID classId = 1; classId <= 100; classId++)
+    {
+        sampler.Sample(classId, 0);
+    }
+
+    sampler.Flush();
+    ASSERT_EQ(ExceptionSampler::MinSamplesPerSecond, sampler.GetSamplesPerSecond());
+}
+
+TEST(ExceptionSamplerTest, CheckTypesBeyondLimitShareSameState)
+{
+    ExceptionSampler sampler(1, 1);
+
+    // all types are eventually sampled but, beyond the limit, they share the same bucket
+    std::uint64_t sampledCount = 0;
+    ClassID classId = 1;
+    for (; classId <= 100 * ExceptionSampler::MaxTypesPerShard; classId++)
+    {
+        sampledCount += sampler.Sample(classId, 0);
+    }
+
+    // the overflowing types are reported without their name but their counts are exact
+    std::uint64_t skippedCount = 0;
+    for (auto const& skippedExceptions : sampler.Flush())
+    {
+        ASSERT_EQ("", skippedExceptions.TypeName);
+        skippedCount += skippedExceptions.Count;
+    }
+
+    ASSERT_EQ(classId - 1, sampledCount + skippedCount);
+}
+
+TEST(ExceptionSamplerTest, CheckGivenBackExceptionsAreCarriedByNextSample)
+{
+    ExceptionSampler sampler(1, 1);
+
+    ASSERT_EQ(1, sampler.Sample(1, 0));
+    ASSERT_EQ(0, sampler.Sample(1, 0));
+    ASSERT_EQ(2, sampler.Sample(1, OneSecondNs));
+
+    // the sample could not be reported: the token is refunded and the count is not lost
+    sampler.GiveBack(1, 2);
+    ASSERT_EQ(3, sampler.Sample(1, OneSecondNs));
+}
+
+TEST(ExceptionSamplerTest, CheckGivenBackExceptionsAreFlushed)
+{
+    ExceptionSampler sampler(1, 1);
+
+    ASSERT_EQ(1, sampler.Sample(1, 0));
+    sampler.GiveBack(1, 1);
+
+    auto skippedExceptions = sampler.Flush();
+    ASSERT_EQ(1, skippedExceptions.size());
+    ASSERT_EQ(1, skippedExceptions[0].Count);
+}
@@ -6,6 +6,8 @@
 
 FrameStoreHelper::FrameStoreHelper(bool isManaged, std::string prefix, size_t count)
 {
+    auto* pStringTable = StringTable::GetInstance();
+
     // build automatically a mapping
     //    number --> { isManaged, "module #number", "prefix #number" }
     // with number going from 1 to count
@@ -17,7 +19,7 @@ FrameStoreHelper::FrameStoreHelper(bool isManaged, std::string prefix, size_t co
         std::stringstream moduleBuilder;
         moduleBuilder << "module #" << i;
 
-        _mapping[i] = { isManaged, moduleBuilder.str(), frameBuilder.str() };
+        _mapping[i] = { isManaged, {pStringTable->Intern(moduleBuilder.str()), pStringTable->Intern(frameBuilder.str())} };
     }
 }
 
@@ -29,7 +31,7 @@ FrameStoreHelper::FrameStoreHelper(bool isManaged, std::string prefix, size_t co
 //}
 
 
-std::tuple<bool, std::string, std::string> FrameStoreHelper::GetFrame(uintptr_t instructionPointer)
+std::tuple<bool, FrameId> FrameStoreHelper::GetFrame(uintptr_t instructionPointer)
 {
     auto item = _mapping.find(instructionPointer);
     if (item != _mapping.end())
@@ -37,5 +39,15 @@ std::tuple<bool, std::string, std::string> FrameStoreHelper::GetFrame(uintptr_t
         return item->second;
     }
 
-    return { true, "module???", "frame???" };
+    auto* pStringTable = StringTable::GetInstance();
+    return { true, {pStringTable->Intern("module???"), pStringTable->Intern("frame???")} };
+}
+
+bool FrameStoreHelper::GetTypeName(ClassID classId, std::string& name)
+{
+    return false;
+}
+
+void FrameStoreHelper::OnModuleUnloaded(ModuleID moduleId)
+{
 }
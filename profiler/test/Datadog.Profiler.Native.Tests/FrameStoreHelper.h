@@ -12,8 +12,10 @@ public:
 
 public:
     // Inherited via IFrameStore
-    std::tuple<bool, std::string, std::string> GetFrame(uintptr_t instructionPointer) override;
+    std::tuple<bool, FrameId> GetFrame(uintptr_t instructionPointer) override;
+    bool GetTypeName(ClassID classId, std::string& name) override;
+    void OnModuleUnloaded(ModuleID moduleId) override;
 
 private:
-    std::unordered_map<uintptr_t, std::tuple<bool, std::string, std::string>> _mapping;
+    std::unordered_map<uintptr_t, std::tuple<bool, FrameId>> _mapping;
 };
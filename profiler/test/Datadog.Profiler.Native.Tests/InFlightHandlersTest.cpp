@@ -0,0 +1,156 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "InFlightHandlers.h"
+
+using namespace std::chrono_literals;
+
+
+struct PublishedData
+{
+    static constexpr std::uint64_t Alive = 0x0123456789ABCDEF;
+    static constexpr std::uint64_t Freed = 0xDEADDEADDEADDEAD;
+
+    ~PublishedData()
+    {
+        Magic = Freed;
+    }
+
+    std::uint64_t Magic = Alive;
+};
+
+TEST(InFlightHandlersTest, CheckWaitForAllReturnsWhenNoHandlerIsRunning)
+{
+    InFlightHandlers handlers;
+    std::atomic<PublishedData*> published{nullptr};
+
+    ASSERT_TRUE(handlers.WaitForAll(1s));
+
+    // a handler entering after the data has been unpublished does not see it
+    handlers.Enter();
+    ASSERT_EQ(nullptr, published.load());
+    ASSERT_EQ(1, handlers.GetCount());
+    handlers.Leave();
+
+    ASSERT_EQ(0, handlers.GetCount());
+    ASSERT_TRUE(handlers.WaitForAll(1s));
+}
+
+TEST(InFlightHandlersTest, CheckWaitForAllWaitsForRunningHandler)
+{
+    InFlightHandlers handlers;
+    auto pData = new PublishedData();
+    std::atomic<PublishedData*> published{pData};
+
+    std::atomic<bool> hasEntered{false};
+    std::atomic<bool> canLeave{false};
+    std::uint64_t magic = 0;
+
+    std::thread handler([&] {
+        handlers.Enter();
+        auto pLoaded = published.load();
+        hasEntered = true;
+
+        while (!canLeave)
+        {
+            std::this_thread::yield();
+        }
+
+        // the data is still alive even though it has been unpublished in the meantime
+        magic = pLoaded->Magic;
+        handlers.Leave();
+    });
+
+    while (!hasEntered)
+    {
+        std::this_thread::yield();
+    }
+
+    published.store(nullptr);
+
+    std::atomic<bool> hasWaited{false};
+    std::thread owner([&] {
+        hasWaited = handlers.WaitForAll(10s);
+    });
+
+    std::this_thread::sleep_for(50ms);
+    ASSERT_FALSE(hasWaited);
+
+    canLeave = true;
+    owner.join();
+    handler.join();
+
+    ASSERT_TRUE(hasWaited);
+    ASSERT_EQ(PublishedData::Alive, magic);
+    delete pData;
+}
+
+TEST(InFlightHandlersTest, CheckWaitForAllGivesUpOnStuckHandler)
+{
+    InFlightHandlers handlers;
+
+    // a handler that never leaves (i.e. blocked in its signal handler)
+    handlers.Enter();
+
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_FALSE(handlers.WaitForAll(50ms));
+    ASSERT_GE(std::chrono::steady_clock::now() - start, 50ms);
+
+    handlers.Leave();
+    ASSERT_TRUE(handlers.WaitForAll(50ms));
+}
+
+TEST(InFlightHandlersTest, CheckDataIsNeverUsedAfterBeingFreed)
+{
+    InFlightHandlers handlers;
+    std::atomic<PublishedData*> published{new PublishedData()};
+    std::atomic<bool> isStopped{false};
+    std::atomic<std::uint64_t> freedDataSeenCount{0};
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++)
+    {
+        threads.emplace_back([&] {
+            while (!isStopped)
+            {
+                handlers.Enter();
+                auto pData = published.load();
+                if ((pData != nullptr) && (pData->Magic != PublishedData::Alive))
+                {
+                    freedDataSeenCount++;
+                }
+                handlers.Leave();
+
+                // let the owner see no handler running from time to time
+                std::this_thread::sleep_for(10us);
+            }
+        });
+    }
+
+    // replace the published data the same way DisableCpuTimers frees the CPU timer slots
+    for (int i = 0; i < 200; i++)
+    {
+        auto pData = published.exchange(nullptr);
+        ASSERT_TRUE(handlers.WaitForAll(10s));
+        delete pData;
+
+        published.store(new PublishedData());
+    }
+
+    isStopped = true;
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    ASSERT_EQ(0, freedDataSeenCount);
+    ASSERT_EQ(0, handlers.GetCount());
+    delete published.load();
+}
@@ -6,6 +6,8 @@
 
 #include "LibddprofExporter.h"
 #include "OpSysTools.h"
+#include "ProfileSpool.h"
+#include "ProfileUploadQueue.h"
 
 #include "ProfilerMockedInterface.h"
 
@@ -430,4 +432,120 @@ TEST(LibddprofExporterTest, MakeSureNoCrashForReallyLongCallstack)
                                 42);
 
     EXPECT_NO_THROW(exporter.Add(sample1));
-}
\ No newline at end of file
+}
+
+// simulates an unreachable agent without relying on the network
+class FailingUploadExporter : public LibddprofExporter
+{
+public:
+    using LibddprofExporter::LibddprofExporter;
+
+    mutable int UploadsCount = 0;
+
+protected:
+    bool Upload(SerializedProfile const& profile, std::uint64_t timeoutMs) const override
+    {
+        UploadsCount++;
+        return false;
+    }
+};
+
+TEST(LibddprofExporterTest, CheckProfileIsSpooledWhenAgentIsUnreachable)
+{
+    auto [configuration, mockConfiguration] = CreateConfiguration();
+
+    fs::path pprofTempDir;
+    EXPECT_CALL(mockConfiguration, GetProfilesOutputDirectory()).Times(1).WillOnce(ReturnRef(pprofTempDir));
+
+    std::string agentUrl = "http://localhost:8126";
+    EXPECT_CALL(mockConfiguration, GetAgentUrl()).Times(1).WillOnce(ReturnRef(agentUrl));
+    std::string version = "1.0.2";
+    EXPECT_CALL(mockConfiguration, GetVersion()).Times(1).WillOnce(ReturnRef(version));
+    std::string env = "myenv";
+    EXPECT_CALL(mockConfiguration, GetEnvironment()).Times(1).WillOnce(ReturnRef(env));
+    std::string host = "localhost";
+    EXPECT_CALL(mockConfiguration, GetHostname()).Times(1).WillOnce(ReturnRef(host));
+    EXPECT_CALL(mockConfiguration, IsAgentless()).Times(1).WillOnce(Return(false));
+
+    std::vector<std::pair<std::string, std::string>> tags;
+    EXPECT_CALL(mockConfiguration, GetUserTags()).Times(1).WillOnce(ReturnRef(tags));
+
+    auto applicationStore = MockApplicationStore();
+
+    std::string runtimeId = "MyRid";
+    std::string application = "MyApp";
+    EXPECT_CALL(applicationStore, GetName(std::string_view(runtimeId))).WillRepeatedly(ReturnRef(application));
+
+    fs::path spoolTempDir = fs::temp_directory_path() / tmpnam(nullptr);
+    ProfileSpool spool(spoolTempDir, 1024 * 1024);
+
+    FailingUploadExporter exporter(&mockConfiguration, &applicationStore, nullptr, &spool);
+
+    exporter.Add(CreateSample(runtimeId, CreateCallstack(10), {{"label1", "value1"}}, 42));
+    ASSERT_FALSE(exporter.Export());
+
+    ASSERT_EQ(1, exporter.UploadsCount);
+
+    ASSERT_EQ(1, spool.GetCount());
+    ASSERT_LT(0, spool.GetSize(application));
+
+    fs::remove_all(spoolTempDir);
+}
+
+TEST(LibddprofExporterTest, CheckProfileGivenUpByTheUploadQueueIsSpooledWithItsPprof)
+{
+    auto [configuration, mockConfiguration] = CreateConfiguration();
+
+    fs::path pprofTempDir;
+    EXPECT_CALL(mockConfiguration, GetProfilesOutputDirectory()).Times(1).WillOnce(ReturnRef(pprofTempDir));
+
+    std::string agentUrl = "http://localhost:8126";
+    EXPECT_CALL(mockConfiguration, GetAgentUrl()).Times(1).WillOnce(ReturnRef(agentUrl));
+    std::string version = "1.0.2";
+    EXPECT_CALL(mockConfiguration, GetVersion()).Times(1).WillOnce(ReturnRef(version));
+    std::string env = "myenv";
+    EXPECT_CALL(mockConfiguration, GetEnvironment()).Times(1).WillOnce(ReturnRef(env));
+    std::string host = "localhost";
+    EXPECT_CALL(mockConfiguration, GetHostname()).Times(1).WillOnce(ReturnRef(host));
+    EXPECT_CALL(mockConfiguration, IsAgentless()).Times(1).WillOnce(Return(false));
+
+    std::vector<std::pair<std::string, std::string>> tags;
+    EXPECT_CALL(mockConfiguration, GetUserTags()).Times(1).WillOnce(ReturnRef(tags));
+
+    auto applicationStore = MockApplicationStore();
+
+    std::string runtimeId = "MyRid";
+    std::string application = "MyApp";
+    EXPECT_CALL(applicationStore, GetName(std::string_view(runtimeId))).WillRepeatedly(ReturnRef(application));
+
+    fs::path spoolTempDir = fs::temp_directory_path() / tmpnam(nullptr);
+    ProfileSpool spool(spoolTempDir, 1024 * 1024);
+
+    // a single pending profile: the first one is given up when the second one is enqueued
+    ProfileUploadQueue uploadQueue(nullptr, 1, 0);
+    FailingUploadExporter exporter(&mockConfiguration, &applicationStore, &uploadQueue, &spool);
+
+    exporter.Add(CreateSample(runtimeId, CreateCallstack(10), {{"label1", "value1"}}, 42));
+    exporter.Export();
+    exporter.Add(CreateSample(runtimeId, CreateCallstack(10), {{"label1", "value1"}}, 42));
+    exporter.Export();
+    ASSERT_EQ(1, uploadQueue.GetDroppedUploadsCount());
+
+    // the given up profile is spooled by the upload thread without being uploaded
+    uploadQueue.Start();
+    uploadQueue.Stop();
+
+    ASSERT_EQ(1, exporter.UploadsCount);
+    ASSERT_EQ(2, spool.GetCount());
+
+    // magic | start | end | runtime ID size | runtime ID | application name size | application name | pprof
+    auto headerSize = sizeof(std::uint32_t) + 2 * sizeof(std::int64_t) + sizeof(std::uint32_t) + runtimeId.size() + sizeof(std::uint32_t) + application.size();
+    std::vector<std::uint8_t> record;
+    while (spool.ReadOldest(record))
+    {
+        ASSERT_LT(headerSize, record.size());
+        spool.RemoveOldest();
+    }
+
+    fs::remove_all(spoolTempDir);
+}
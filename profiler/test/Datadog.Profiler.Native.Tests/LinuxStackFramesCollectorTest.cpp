@@ -0,0 +1,260 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#ifndef _WINDOWS
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <signal.h>
+#include <thread>
+#include <vector>
+
+#include "CorProfilerInfoHelper.h"
+#include "LinuxStackFramesCollector.h"
+#include "ManagedThreadInfo.h"
+#include "OpSysTools.h"
+#include "RawCpuSample.h"
+#include "StackSnapshotResultReusableBuffer.h"
+
+using namespace std::chrono_literals;
+
+
+// The stack walk signal handler is installed only once per process: all tests share the same collector
+LinuxStackFramesCollector& GetCollector()
+{
+    static CorProfilerInfoHelper profilerInfo;
+    static LinuxStackFramesCollector collector(&profilerInfo);
+    return collector;
+}
+
+// Thread sleeping until it is stopped.
+// When its stack walk signals are blocked, it never handles a stack walk request.
+class SampledThread
+{
+public:
+    SampledThread(ThreadID clrThreadId, bool areSignalsBlocked) :
+        _threadInfo(clrThreadId),
+        _isStarted{false},
+        _isStopped{false},
+        _areSignalsBlocked{areSignalsBlocked}
+    {
+        _thread = std::thread([this]() {
+            bool areSignalsBlocked = _areSignalsBlocked;
+            if (areSignalsBlocked)
+            {
+                SetSignalsBlocked(true);
+            }
+
+            _threadInfo.SetOsInfo(OpSysTools::GetThreadId(), static_cast<HANDLE>(0));
+            _isStarted = true;
+
+            while (!_isStopped)
+            {
+                if (_areSignalsBlocked != areSignalsBlocked)
+                {
+                    // late signals are handled now
+                    SetSignalsBlocked(_areSignalsBlocked);
+                    areSignalsBlocked = _areSignalsBlocked;
+                }
+
+                std::this_thread::sleep_for(1ms);
+            }
+        });
+
+        while (!_isStarted)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    ~SampledThread()
+    {
+        _isStopped = true;
+        _thread.join();
+    }
+
+    ManagedThreadInfo* GetThreadInfo()
+    {
+        return &_threadInfo;
+    }
+
+    void UnblockSignals()
+    {
+        _areSignalsBlocked = false;
+    }
+
+private:
+    static void SetSignalsBlocked(bool areBlocked)
+    {
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGUSR1);
+        sigaddset(&signals, SIGUSR2);
+        pthread_sigmask(areBlocked ? SIG_BLOCK : SIG_UNBLOCK, &signals, nullptr);
+    }
+
+private:
+    ManagedThreadInfo _threadInfo;
+    std::thread _thread;
+    std::atomic<bool> _isStarted;
+    std::atomic<bool> _isStopped;
+    std::atomic<bool> _areSignalsBlocked;
+};
+
+void CollectBatch(std::vector<std::unique_ptr<SampledThread>>& threads,
+                  std::vector<StackSnapshotResultBuffer*>& results,
+                  std::vector<uint32_t>& hrs)
+{
+    std::vector<ManagedThreadInfo*> threadInfos;
+    for (auto& thread : threads)
+    {
+        threadInfos.push_back(thread->GetThreadInfo());
+    }
+
+    results.assign(threads.size(), nullptr);
+    hrs.assign(threads.size(), S_OK);
+    GetCollector().CollectStackSamples(threadInfos.data(), static_cast<std::uint32_t>(threads.size()), results.data(), hrs.data());
+}
+
+TEST(LinuxStackFramesCollectorTest, CheckStacksOfSeveralThreadsAreCollectedInOneBatch)
+{
+    const std::uint32_t threadsCount = 8;
+    ASSERT_GE(GetCollector().GetStackSamplesBatchCapacity(), threadsCount);
+
+    std::vector<std::unique_ptr<SampledThread>> threads;
+    for (std::uint32_t i = 0; i < threadsCount; i++)
+    {
+        threads.push_back(std::make_unique<SampledThread>(i + 1, false));
+    }
+
+    std::vector<StackSnapshotResultBuffer*> results;
+    std::vector<uint32_t> hrs;
+    CollectBatch(threads, results, hrs);
+
+    for (std::uint32_t i = 0; i < threadsCount; i++)
+    {
+        ASSERT_EQ(S_OK, hrs[i]);
+        ASSERT_NE(nullptr, results[i]);
+        ASSERT_GT(results[i]->GetFramesCount(), 0);
+    }
+}
+
+TEST(LinuxStackFramesCollectorTest, CheckThreadNotHandlingTheSignalDoesNotBlockTheBatch)
+{
+    std::vector<std::unique_ptr<SampledThread>> threads;
+    threads.push_back(std::make_unique<SampledThread>(1, false));
+    threads.push_back(std::make_unique<SampledThread>(2, true));
+    threads.push_back(std::make_unique<SampledThread>(3, false));
+
+    std::vector<StackSnapshotResultBuffer*> results;
+    std::vector<uint32_t> hrs;
+
+    auto start = std::chrono::steady_clock::now();
+    CollectBatch(threads, results, hrs);
+    auto duration = std::chrono::steady_clock::now() - start;
+
+    // the collector gives up waiting for the blocked thread
+    ASSERT_LT(duration, 1s);
+
+    ASSERT_EQ(S_OK, hrs[0]);
+    ASSERT_GT(results[0]->GetFramesCount(), 0);
+    ASSERT_EQ(E_FAIL, hrs[1]);
+    ASSERT_EQ(0, results[1]->GetFramesCount());
+    ASSERT_EQ(S_OK, hrs[2]);
+    ASSERT_GT(results[2]->GetFramesCount(), 0);
+
+    // the late signal finds no slot to write into and the thread is sampled by the next batch
+    threads[1]->UnblockSignals();
+    std::this_thread::sleep_for(50ms);
+
+    CollectBatch(threads, results, hrs);
+    for (std::uint32_t i = 0; i < threads.size(); i++)
+    {
+        ASSERT_EQ(S_OK, hrs[i]);
+        ASSERT_GT(results[i]->GetFramesCount(), 0);
+    }
+}
+
+TEST(LinuxStackFramesCollectorTest, CheckConsecutiveBatchesReuseTheSlots)
+{
+    std::vector<std::unique_ptr<SampledThread>> threads;
+    for (std::uint32_t i = 0; i < 4; i++)
+    {
+        threads.push_back(std::make_unique<SampledThread>(i + 1, false));
+    }
+
+    std::vector<StackSnapshotResultBuffer*> results;
+    std::vector<uint32_t> hrs;
+
+    // the pending stack walks count of a batch is not disturbed by the previous ones
+    for (int batch = 0; batch < 100; batch++)
+    {
+        CollectBatch(threads, results, hrs);
+        for (std::uint32_t i = 0; i < threads.size(); i++)
+        {
+            ASSERT_EQ(S_OK, hrs[i]);
+            ASSERT_GT(results[i]->GetFramesCount(), 0);
+        }
+    }
+}
+
+
+TEST(LinuxStackFramesCollectorTest, CheckCpuTimerSamplesOfSpinningThread)
+{
+    ASSERT_TRUE(GetCollector().EnableCpuTimers(10ms));
+
+    // the reference of the test keeps the stack allocated thread info from being deleted by the collector
+    ManagedThreadInfo threadInfo(1);
+    threadInfo.AddRef();
+
+    std::atomic<bool> isStarted{false};
+    std::atomic<bool> isStopped{false};
+
+    std::thread spinningThread([&]() {
+        threadInfo.SetOsInfo(OpSysTools::GetThreadId(), static_cast<HANDLE>(0));
+        isStarted = true;
+
+        std::atomic<std::uint64_t> counter = 0;
+        while (!isStopped)
+        {
+            counter++;
+        }
+    });
+
+    while (!isStarted)
+    {
+        std::this_thread::yield();
+    }
+
+    GetCollector().StartCpuTimer(&threadInfo);
+    std::this_thread::sleep_for(200ms);
+    GetCollector().StopCpuTimer(&threadInfo);
+
+    isStopped = true;
+    spinningThread.join();
+
+    // the samples of a stopped timer are still collected
+    std::vector<RawCpuSample> samples;
+    GetCollector().CollectCpuTimerSamples(samples);
+
+    ASSERT_FALSE(samples.empty());
+    for (auto& sample : samples)
+    {
+        ASSERT_EQ(&threadInfo, sample.ThreadInfo);
+        ASSERT_GT(sample.Duration, 0);
+        ASSERT_FALSE(sample.Stack.empty());
+        sample.ThreadInfo->Release();
+    }
+
+    // the slot released its reference on the thread once its last samples were collected
+    ASSERT_EQ(1, threadInfo.GetRefCount());
+
+    samples.clear();
+    GetCollector().CollectCpuTimerSamples(samples);
+    ASSERT_TRUE(samples.empty());
+}
+
+#endif
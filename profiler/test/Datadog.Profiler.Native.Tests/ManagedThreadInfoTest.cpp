@@ -0,0 +1,85 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "ManagedThreadInfo.h"
+#include "OpSysTools.h"
+
+using namespace std::chrono_literals;
+
+
+HANDLE GetCurrentThreadHandle()
+{
+#ifdef _WINDOWS
+    return ::GetCurrentThread(); // pseudo handle: only valid in the current thread
+#else
+    return static_cast<HANDLE>(0); // not used on Linux
+#endif
+}
+
+TEST(ManagedThreadInfoTest, CheckCpuTimeIsNotAvailableBeforeOsThreadIsAssigned)
+{
+    ManagedThreadInfo threadInfo(1);
+
+    std::uint64_t cpuTime = 0;
+    ASSERT_FALSE(threadInfo.GetCpuTime(cpuTime));
+}
+
+TEST(ManagedThreadInfoTest, CheckCpuTimeOfSpinningThread)
+{
+    std::uint64_t startCpuTime = 0;
+    std::uint64_t endCpuTime = 0;
+    bool isCpuTimeAvailable = false;
+
+    std::thread spinningThread([&]() {
+        ManagedThreadInfo threadInfo(1);
+        threadInfo.SetOsInfo(OpSysTools::GetThreadId(), GetCurrentThreadHandle());
+
+        isCpuTimeAvailable = threadInfo.GetCpuTime(startCpuTime);
+
+        // burn CPU for a while
+        std::atomic<std::uint64_t> counter = 0;
+        auto start = std::chrono::steady_clock::now();
+        while (std::chrono::steady_clock::now() - start < 200ms)
+        {
+            counter++;
+        }
+
+        isCpuTimeAvailable = isCpuTimeAvailable && threadInfo.GetCpuTime(endCpuTime);
+    });
+    spinningThread.join();
+
+    ASSERT_TRUE(isCpuTimeAvailable);
+    ASSERT_GT(endCpuTime, startCpuTime);
+
+    // the thread could have been scheduled out (i.e. on a busy CI machine) but it should have
+    // consumed a significant part of the 200 ms and nothing more
+    auto consumed = endCpuTime - startCpuTime;
+    ASSERT_GE(consumed, std::chrono::nanoseconds(20ms).count());
+    ASSERT_LE(consumed, std::chrono::nanoseconds(400ms).count());
+}
+
+TEST(ManagedThreadInfoTest, CheckCpuTimeOfSleepingThread)
+{
+    std::uint64_t startCpuTime = 0;
+    std::uint64_t endCpuTime = 0;
+    bool isCpuTimeAvailable = false;
+
+    std::thread sleepingThread([&]() {
+        ManagedThreadInfo threadInfo(1);
+        threadInfo.SetOsInfo(OpSysTools::GetThreadId(), GetCurrentThreadHandle());
+
+        isCpuTimeAvailable = threadInfo.GetCpuTime(startCpuTime);
+        std::this_thread::sleep_for(200ms);
+        isCpuTimeAvailable = isCpuTimeAvailable && threadInfo.GetCpuTime(endCpuTime);
+    });
+    sleepingThread.join();
+
+    ASSERT_TRUE(isCpuTimeAvailable);
+    ASSERT_LE(endCpuTime - startCpuTime, std::chrono::nanoseconds(20ms).count());
+}
@@ -0,0 +1,104 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+#ifndef _WINDOWS
+#include <dlfcn.h>
+#endif
+
+#include "NativeSymbolResolver.h"
+
+
+namespace NativeSymbolResolverTestFunctions {
+// not inlined and not static to make sure a symbol exists for this function
+#ifdef _WINDOWS
+__declspec(noinline)
+#else
+__attribute__((noinline))
+#endif
+int Function(int value)
+{
+    return value * 2 + 1;
+}
+} // namespace NativeSymbolResolverTestFunctions
+
+
+TEST(NativeSymbolResolverTest, CheckFunctionIsResolved)
+{
+    NativeSymbolResolver resolver;
+
+    // look for an address inside the function, not only its first byte
+    auto instructionPointer = reinterpret_cast<std::uintptr_t>(&NativeSymbolResolverTestFunctions::Function) + 1;
+
+    std::string modulePath;
+    std::string functionName;
+    ASSERT_TRUE(resolver.Resolve(instructionPointer, modulePath, functionName));
+    ASSERT_FALSE(modulePath.empty());
+
+#ifndef _WINDOWS
+    // the name is demangled
+    ASSERT_EQ("NativeSymbolResolverTestFunctions::Function(int)", functionName);
+#endif
+
+    // the same result is returned from the index snapshot
+    std::string otherModulePath;
+    std::string otherFunctionName;
+    ASSERT_TRUE(resolver.Resolve(instructionPointer, otherModulePath, otherFunctionName));
+    ASSERT_EQ(modulePath, otherModulePath);
+    ASSERT_EQ(functionName, otherFunctionName);
+}
+
+TEST(NativeSymbolResolverTest, CheckAddressOutsideModulesIsNotResolved)
+{
+    NativeSymbolResolver resolver;
+
+    auto buffer = std::make_unique<char[]>(64);
+    std::string modulePath;
+    std::string functionName;
+    ASSERT_FALSE(resolver.Resolve(reinterpret_cast<std::uintptr_t>(buffer.get()), modulePath, functionName));
+    ASSERT_TRUE(functionName.empty());
+}
+
+#ifndef _WINDOWS
+TEST(NativeSymbolResolverTest, CheckUnloadedImagesRangesAreReported)
+{
+    NativeSymbolResolver resolver;
+
+    // the library must not be already loaded: otherwise, dlclose would not unload it
+    void* loadedHandle = dlopen("libz.so.1", RTLD_NOW | RTLD_NOLOAD);
+    if (loadedHandle != nullptr)
+    {
+        dlclose(loadedHandle);
+        GTEST_SKIP() << "libz.so.1 is already loaded";
+    }
+
+    void* handle = dlopen("libz.so.1", RTLD_NOW | RTLD_LOCAL);
+    if (handle == nullptr)
+    {
+        GTEST_SKIP() << "libz.so.1 is not available";
+    }
+
+    auto instructionPointer = reinterpret_cast<std::uintptr_t>(dlsym(handle, "zlibVersion"));
+    ASSERT_NE(0, instructionPointer);
+
+    std::string modulePath;
+    std::string functionName;
+    ASSERT_TRUE(resolver.Resolve(instructionPointer, modulePath, functionName));
+    ASSERT_TRUE(resolver.GetUnloadedRanges().empty());
+
+    dlclose(handle);
+
+    auto unloadedRanges = resolver.GetUnloadedRanges();
+    ASSERT_TRUE(std::any_of(unloadedRanges.begin(), unloadedRanges.end(), [instructionPointer](auto const& range) {
+        return (instructionPointer >= range.first) && (instructionPointer < range.second);
+    }));
+
+    // already reported
+    ASSERT_TRUE(resolver.GetUnloadedRanges().empty());
+}
+#endif
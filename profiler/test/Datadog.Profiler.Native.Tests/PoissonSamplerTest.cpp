@@ -0,0 +1,37 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include "gtest/gtest.h"
+
+#include "PoissonSampler.h"
+
+TEST(PoissonSamplerTest, CheckUpscaling)
+{
+    // a small event is rarely sampled: it represents a lot of events
+    auto [smallCount, smallMagnitude] = PoissonSampler::Upscale(100, 512 * 1024);
+    ASSERT_EQ(5243, smallCount);
+    ASSERT_EQ(524338, smallMagnitude);
+
+    // an event much larger than the mean distance is always sampled
+    auto [largeCount, largeMagnitude] = PoissonSampler::Upscale(100 * 512 * 1024, 512 * 1024);
+    ASSERT_EQ(1, largeCount);
+    ASSERT_EQ(100 * 512 * 1024, largeMagnitude);
+}
+
+TEST(PoissonSamplerTest, CheckSamplingDistanceAverage)
+{
+    const std::uint64_t meanDistance = 1000;
+    const int iterations = 100000;
+
+    double sum = 0;
+    for (int i = 0; i < iterations; i++)
+    {
+        auto distance = PoissonSampler::GetNextSamplingDistance(meanDistance);
+        ASSERT_LT(0, distance);
+        sum += distance;
+    }
+
+    // the average distance must be close to the expected mean
+    auto average = sum / iterations;
+    ASSERT_NEAR(meanDistance, average, meanDistance * 0.05);
+}
@@ -0,0 +1,300 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include "gtest/gtest.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "PprofBuilder.h"
+#include "ProfilerMockedInterface.h"
+#include "Sample.h"
+
+// Minimal protobuf reader: only the fields used by the tests are decoded
+class ProtobufReader
+{
+public:
+    ProtobufReader(std::uint8_t const* data, std::size_t size) :
+        _current{data},
+        _end{data + size}
+    {
+    }
+
+    bool IsEnd() const
+    {
+        return _current >= _end;
+    }
+
+    std::uint64_t ReadVarint()
+    {
+        std::uint64_t value = 0;
+        int shift = 0;
+        while (_current < _end)
+        {
+            auto byte = *_current++;
+            value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                break;
+            }
+            shift += 7;
+        }
+        return value;
+    }
+
+    // return the field number and set the payload (bytes or varint)
+    std::uint32_t ReadField(ProtobufReader& bytes, std::uint64_t& varint)
+    {
+        auto tag = ReadVarint();
+        if ((tag & 7) == 2)
+        {
+            auto size = ReadVarint();
+            bytes = ProtobufReader(_current, size);
+            _current += size;
+        }
+        else
+        {
+            varint = ReadVarint();
+        }
+        return static_cast<std::uint32_t>(tag >> 3);
+    }
+
+    std::string ToString() const
+    {
+        return std::string(reinterpret_cast<char const*>(_current), _end - _current);
+    }
+
+private:
+    std::uint8_t const* _current;
+    std::uint8_t const* _end;
+};
+
+struct DecodedLabel
+{
+    std::int64_t Key = 0;
+    std::int64_t Str = 0;
+    std::int64_t Num = 0;
+    std::int64_t NumUnit = 0;
+};
+
+struct DecodedSample
+{
+    std::vector<std::uint64_t> LocationIds;
+    std::vector<std::int64_t> Values;
+    std::vector<DecodedLabel> Labels;
+};
+
+struct DecodedProfile
+{
+    std::vector<std::string> Strings;
+    std::vector<DecodedSample> Samples;
+    std::map<std::uint64_t, std::int64_t> FunctionNames;
+    std::size_t LocationsCount = 0;
+    std::size_t MappingsCount = 0;
+    std::size_t SampleTypesCount = 0;
+    std::uint64_t TimeNanos = 0;
+    std::uint64_t DurationNanos = 0;
+};
+
+DecodedProfile Decode(std::vector<std::uint8_t> const& buffer)
+{
+    DecodedProfile profile;
+    ProtobufReader reader(buffer.data(), buffer.size());
+    while (!reader.IsEnd())
+    {
+        ProtobufReader bytes(nullptr, 0);
+        std::uint64_t varint = 0;
+        switch (reader.ReadField(bytes, varint))
+        {
+            case 1:
+                profile.SampleTypesCount++;
+                break;
+
+            case 2:
+            {
+                DecodedSample sample;
+                while (!bytes.IsEnd())
+                {
+                    ProtobufReader field(nullptr, 0);
+                    auto number = bytes.ReadField(field, varint);
+                    if (number == 1)
+                    {
+                        while (!field.IsEnd())
+                        {
+                            sample.LocationIds.push_back(field.ReadVarint());
+                        }
+                    }
+                    else if (number == 2)
+                    {
+                        while (!field.IsEnd())
+                        {
+                            sample.Values.push_back(static_cast<std::int64_t>(field.ReadVarint()));
+                        }
+                    }
+                    else if (number == 3)
+                    {
+                        DecodedLabel label;
+                        while (!field.IsEnd())
+                        {
+                            ProtobufReader unused(nullptr, 0);
+                            std::uint64_t value = 0;
+                            switch (field.ReadField(unused, value))
+                            {
+                                case 1: label.Key = static_cast<std::int64_t>(value); break;
+                                case 2: label.Str = static_cast<std::int64_t>(value); break;
+                                case 3: label.Num = static_cast<std::int64_t>(value); break;
+                                case 4: label.NumUnit = static_cast<std::int64_t>(value); break;
+                                default: break;
+                            }
+                        }
+                        sample.Labels.push_back(label);
+                    }
+                }
+                profile.Samples.push_back(sample);
+                break;
+            }
+
+            case 3:
+                profile.MappingsCount++;
+                break;
+
+            case 4:
+                profile.LocationsCount++;
+                break;
+
+            case 5:
+            {
+                ProtobufReader unused(nullptr, 0);
+                std::uint64_t id = 0;
+                std::uint64_t name = 0;
+                bytes.ReadField(unused, id);
+                bytes.ReadField(unused, name);
+                profile.FunctionNames[id] = name;
+                break;
+            }
+
+            case 6:
+                profile.Strings.push_back(bytes.ToString());
+                break;
+
+            case 9:
+                profile.TimeNanos = varint;
+                break;
+
+            case 10:
+                profile.DurationNanos = varint;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return profile;
+}
+
+TEST(PprofBuilderTest, CheckSamplesAndTablesAreEncoded)
+{
+    PprofBuilder builder("RealTime", "Nanoseconds");
+
+    builder.Add(CreateSample("rid",
+                             std::initializer_list<std::pair<std::string, std::string>>({{"module", "frame1"}, {"module", "frame2"}}),
+                             {{"label1", "value1"}},
+                             21));
+    builder.Add(CreateSample("rid",
+                             std::initializer_list<std::pair<std::string, std::string>>({{"module", "frame1"}, {"other module", "frame3"}}),
+                             {{"label1", "value2"}},
+                             42));
+    ASSERT_EQ(2, builder.GetSamplesCount());
+
+    std::vector<std::uint8_t> buffer;
+    builder.Serialize(buffer, 1000, 3000);
+
+    auto profile = Decode(buffer);
+    ASSERT_EQ(array_size, profile.SampleTypesCount);
+    ASSERT_EQ(1000, profile.TimeNanos);
+    ASSERT_EQ(2000, profile.DurationNanos);
+
+    // the first string must be the empty string
+    ASSERT_FALSE(profile.Strings.empty());
+    ASSERT_EQ("", profile.Strings[0]);
+
+    // frames and modules are shared between samples
+    ASSERT_EQ(2, profile.Samples.size());
+    ASSERT_EQ(3, profile.LocationsCount);
+    ASSERT_EQ(3, profile.FunctionNames.size());
+    ASSERT_EQ(2, profile.MappingsCount);
+
+    auto const& first = profile.Samples[0];
+    auto const& second = profile.Samples[1];
+    ASSERT_EQ(2, first.LocationIds.size());
+    ASSERT_EQ(first.LocationIds[0], second.LocationIds[0]);
+    ASSERT_NE(first.LocationIds[1], second.LocationIds[1]);
+    ASSERT_EQ("frame1", profile.Strings[profile.FunctionNames[first.LocationIds[0]]]);
+    ASSERT_EQ("frame3", profile.Strings[profile.FunctionNames[second.LocationIds[1]]]);
+
+    ASSERT_EQ(array_size, first.Values.size());
+    ASSERT_EQ(21, first.Values[0]);
+    ASSERT_EQ(42, second.Values[0]);
+
+    ASSERT_EQ(1, first.Labels.size());
+    ASSERT_EQ("label1", profile.Strings[first.Labels[0].Key]);
+    ASSERT_EQ("value1", profile.Strings[first.Labels[0].Str]);
+    ASSERT_EQ(first.Labels[0].Key, second.Labels[0].Key);
+    ASSERT_EQ("value2", profile.Strings[second.Labels[0].Str]);
+}
+
+TEST(PprofBuilderTest, CheckBuilderIsResetAfterSerialization)
+{
+    PprofBuilder builder("RealTime", "Nanoseconds");
+
+    builder.Add(CreateSample("rid", CreateCallstack(10), {{"label1", "value1"}}, 21));
+
+    std::vector<std::uint8_t> buffer;
+    builder.Serialize(buffer, 0, 0);
+    ASSERT_EQ(0, builder.GetSamplesCount());
+
+    // the next profile must not reference the tables of the previous one
+    builder.Add(CreateSample("rid", CreateCallstack(2), {{"label2", "value2"}}, 42));
+    builder.Serialize(buffer, 0, 0);
+
+    auto profile = Decode(buffer);
+    ASSERT_EQ(1, profile.Samples.size());
+    ASSERT_EQ(2, profile.LocationsCount);
+    ASSERT_EQ(1, profile.MappingsCount);
+    ASSERT_EQ(profile.Strings.end(), std::find(profile.Strings.begin(), profile.Strings.end(), "label1"));
+    ASSERT_EQ("label2", profile.Strings[profile.Samples[0].Labels[0].Key]);
+}
+
+TEST(PprofBuilderTest, CheckNumericLabelsAreEncoded)
+{
+    PprofBuilder builder("RealTime", "Nanoseconds");
+
+    auto sample = CreateSample("rid", CreateCallstack(1), {{"label1", "value1"}}, 21);
+    sample.AddNumericLabel(NumericLabel{"duration", 1500, "nanoseconds"});
+    sample.AddNumericLabel(NumericLabel{"timestamp", -42, ""});
+    builder.Add(sample);
+
+    std::vector<std::uint8_t> buffer;
+    builder.Serialize(buffer, 0, 0);
+
+    auto profile = Decode(buffer);
+    ASSERT_EQ(1, profile.Samples.size());
+    auto const& labels = profile.Samples[0].Labels;
+    ASSERT_EQ(3, labels.size());
+
+    ASSERT_EQ("label1", profile.Strings[labels[0].Key]);
+    ASSERT_EQ("value1", profile.Strings[labels[0].Str]);
+
+    // a numeric label has no string value
+    ASSERT_EQ("duration", profile.Strings[labels[1].Key]);
+    ASSERT_EQ(0, labels[1].Str);
+    ASSERT_EQ(1500, labels[1].Num);
+    ASSERT_EQ("nanoseconds", profile.Strings[labels[1].NumUnit]);
+
+    // negative values are encoded as two's complement and the unit is optional
+    ASSERT_EQ("timestamp", profile.Strings[labels[2].Key]);
+    ASSERT_EQ(-42, labels[2].Num);
+    ASSERT_EQ(0, labels[2].NumUnit);
+}
@@ -0,0 +1,254 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include "gtest/gtest.h"
+
+#include <fstream>
+#include <vector>
+
+#include "OpSysTools.h"
+#include "ProfileSpool.h"
+
+#include "shared/src/native-src/dd_filesystem.hpp"
+
+std::vector<std::uint8_t> CreateContent(std::size_t size, std::uint8_t value)
+{
+    return std::vector<std::uint8_t>(size, value);
+}
+
+// the files of a process are spooled in its own subdirectory
+fs::path GetProcessDirectory(fs::path const& spoolDir, int processId = OpSysTools::GetProcId())
+{
+    return spoolDir / std::to_string(processId);
+}
+
+std::size_t CountFiles(fs::path const& directory)
+{
+    std::size_t count = 0;
+    for (auto const& file : fs::directory_iterator(directory))
+    {
+        count++;
+    }
+    return count;
+}
+
+TEST(ProfileSpoolTest, CheckProfilesAreReadOldestFirst)
+{
+    fs::path spoolDir = fs::temp_directory_path() / tmpnam(nullptr);
+    ProfileSpool spool(spoolDir, 1024);
+
+    ASSERT_TRUE(spool.Write("service", CreateContent(10, 1)));
+    ASSERT_TRUE(spool.Write("other service", CreateContent(20, 2)));
+    ASSERT_TRUE(spool.Write("service", CreateContent(30, 3)));
+    ASSERT_EQ(3, spool.GetCount());
+    ASSERT_EQ(3, CountFiles(GetProcessDirectory(spoolDir)));
+
+    std::vector<std::uint8_t> content;
+    for (std::uint8_t expected = 1; expected <= 3; expected++)
+    {
+        ASSERT_TRUE(spool.ReadOldest(content));
+        ASSERT_EQ(CreateContent(expected * 10, expected), content);
+        spool.RemoveOldest();
+    }
+
+    ASSERT_FALSE(spool.ReadOldest(content));
+    ASSERT_EQ(0, spool.GetCount());
+    ASSERT_EQ(0, CountFiles(GetProcessDirectory(spoolDir)));
+
+    fs::remove_all(spoolDir);
+}
+
+TEST(ProfileSpoolTest, CheckOldestProfilesOfTheSameServiceAreRemovedWhenFull)
+{
+    fs::path spoolDir = fs::temp_directory_path() / tmpnam(nullptr);
+    ProfileSpool spool(spoolDir, 100);
+
+    ASSERT_TRUE(spool.Write("service", CreateContent(40, 1)));
+    ASSERT_TRUE(spool.Write("other service", CreateContent(90, 2)));
+    ASSERT_TRUE(spool.Write("service", CreateContent(40, 3)));
+    ASSERT_EQ(80, spool.GetSize("service"));
+
+    // the first profile of "service" is removed; not the one of "other service"
+    ASSERT_TRUE(spool.Write("service", CreateContent(40, 4)));
+    ASSERT_EQ(80, spool.GetSize("service"));
+    ASSERT_EQ(90, spool.GetSize("other service"));
+    ASSERT_EQ(3, spool.GetCount());
+
+    std::vector<std::uint8_t> content;
+    ASSERT_TRUE(spool.ReadOldest(content));
+    ASSERT_EQ(CreateContent(90, 2), content);
+
+    fs::remove_all(spoolDir);
+}
+
+TEST(ProfileSpoolTest, CheckLimitIsEnforcedForTooLongServiceName)
+{
+    fs::path spoolDir = fs::temp_directory_path() / tmpnam(nullptr);
+    ProfileSpool spool(spoolDir, 100);
+
+    // the service name is truncated in the spooled files
+    std::string service(5000, 's');
+    ASSERT_TRUE(spool.Write(service, CreateContent(60, 1)));
+    ASSERT_TRUE(spool.Write(service, CreateContent(60, 2)));
+    ASSERT_EQ(1, spool.GetCount());
+    ASSERT_EQ(60, spool.GetSize(service));
+
+    std::vector<std::uint8_t> content;
+    ASSERT_TRUE(spool.ReadOldest(content));
+    ASSERT_EQ(CreateContent(60, 2), content);
+
+    fs::remove_all(spoolDir);
+}
+
+TEST(ProfileSpoolTest, CheckTooLargeProfileIsNotSpooled)
+{
+    fs::path spoolDir = fs::temp_directory_path() / tmpnam(nullptr);
+    ProfileSpool spool(spoolDir, 100);
+
+    ASSERT_TRUE(spool.Write("service", CreateContent(50, 1)));
+    ASSERT_FALSE(spool.Write("service", CreateContent(101, 2)));
+
+    // the spooled profile has been kept
+    ASSERT_EQ(1, spool.GetCount());
+    ASSERT_EQ(50, spool.GetSize("service"));
+
+    fs::remove_all(spoolDir);
+}
+
+TEST(ProfileSpoolTest, CheckMissingFileIsSkipped)
+{
+    fs::path spoolDir = fs::temp_directory_path() / tmpnam(nullptr);
+    ProfileSpool spool(spoolDir, 1024);
+
+    ASSERT_TRUE(spool.Write("service", CreateContent(10, 1)));
+    ASSERT_TRUE(spool.Write("service", CreateContent(20, 2)));
+
+    // the directory is not enumerated in a specific order: the oldest file (lowest sequence number) is looked for
+    fs::path oldest;
+    for (auto const& file : fs::directory_iterator(GetProcessDirectory(spoolDir)))
+    {
+        if (oldest.empty() || (file.path() < oldest))
+        {
+            oldest = file.path();
+        }
+    }
+    fs::remove(oldest);
+
+    std::vector<std::uint8_t> content;
+    ASSERT_TRUE(spool.ReadOldest(content));
+    ASSERT_EQ(1, spool.GetCount());
+    ASSERT_EQ(CountFiles(GetProcessDirectory(spoolDir)), spool.GetCount());
+
+    fs::remove_all(spoolDir);
+}
+
+TEST(ProfileSpoolTest, CheckProfilesOfPreviousInstanceAreReplayed)
+{
+    fs::path spoolDir = fs::temp_directory_path() / tmpnam(nullptr);
+    {
+        ProfileSpool spool(spoolDir, 1024);
+        ASSERT_TRUE(spool.Write("service", CreateContent(10, 1)));
+        ASSERT_TRUE(spool.Write("other service", CreateContent(20, 2)));
+    }
+
+    // a profile that was being written when the previous process exited is discarded
+    std::ofstream{GetProcessDirectory(spoolDir) / "1_00000000000000000042.spool.tmp"} << "partial";
+
+    ProfileSpool spool(spoolDir, 1024);
+    ASSERT_EQ(2, spool.GetCount());
+    ASSERT_EQ(2, CountFiles(GetProcessDirectory(spoolDir)));
+    ASSERT_EQ(10, spool.GetSize("service"));
+    ASSERT_EQ(20, spool.GetSize("other service"));
+
+    // the new profiles do not replace the previous ones
+    ASSERT_TRUE(spool.Write("service", CreateContent(30, 3)));
+    ASSERT_EQ(3, CountFiles(GetProcessDirectory(spoolDir)));
+
+    std::vector<std::uint8_t> content;
+    for (std::uint8_t expected = 1; expected <= 3; expected++)
+    {
+        ASSERT_TRUE(spool.ReadOldest(content));
+        ASSERT_EQ(CreateContent(expected * 10, expected), content);
+        spool.RemoveOldest();
+    }
+    ASSERT_EQ(0, CountFiles(GetProcessDirectory(spoolDir)));
+
+    fs::remove_all(spoolDir);
+}
+
+TEST(ProfileSpoolTest, CheckProfilesOfPreviousInstanceAreCountedInTheLimit)
+{
+    fs::path spoolDir = fs::temp_directory_path() / tmpnam(nullptr);
+    {
+        ProfileSpool spool(spoolDir, 1024);
+        ASSERT_TRUE(spool.Write("service", CreateContent(40, 1)));
+        ASSERT_TRUE(spool.Write("service", CreateContent(40, 2)));
+        ASSERT_TRUE(spool.Write("service", CreateContent(40, 3)));
+    }
+
+    // the oldest profile is removed to fit in the new limit...
+    ProfileSpool spool(spoolDir, 100);
+    ASSERT_EQ(2, spool.GetCount());
+    ASSERT_EQ(80, spool.GetSize("service"));
+
+    // ...and the next one to make room for a new profile
+    ASSERT_TRUE(spool.Write("service", CreateContent(40, 4)));
+    ASSERT_EQ(2, CountFiles(GetProcessDirectory(spoolDir)));
+
+    std::vector<std::uint8_t> content;
+    ASSERT_TRUE(spool.ReadOldest(content));
+    ASSERT_EQ(CreateContent(40, 3), content);
+
+    fs::remove_all(spoolDir);
+}
+
+TEST(ProfileSpoolTest, CheckProfilesOfExitedProcessAreAdopted)
+{
+    fs::path spoolDir = fs::temp_directory_path() / tmpnam(nullptr);
+    {
+        ProfileSpool spool(spoolDir, 1024);
+        ASSERT_TRUE(spool.Write("service", CreateContent(10, 1)));
+    }
+
+    // no process can have this id: the files look like the ones of an exited process
+    auto exitedProcessDir = GetProcessDirectory(spoolDir, 99999999);
+    fs::rename(GetProcessDirectory(spoolDir), exitedProcessDir);
+    std::ofstream{exitedProcessDir / "99999999_00000000000000000042.spool.tmp"} << "partial";
+
+    ProfileSpool spool(spoolDir, 1024);
+    ASSERT_EQ(1, spool.GetCount());
+    ASSERT_EQ(10, spool.GetSize("service"));
+    ASSERT_EQ(1, CountFiles(GetProcessDirectory(spoolDir)));
+    ASSERT_FALSE(fs::exists(exitedProcessDir));
+
+    std::vector<std::uint8_t> content;
+    ASSERT_TRUE(spool.ReadOldest(content));
+    ASSERT_EQ(CreateContent(10, 1), content);
+
+    fs::remove_all(spoolDir);
+}
+
+TEST(ProfileSpoolTest, CheckProfilesOfRunningProcessAreNotTouched)
+{
+    fs::path spoolDir = fs::temp_directory_path() / tmpnam(nullptr);
+    {
+        ProfileSpool spool(spoolDir, 1024);
+        ASSERT_TRUE(spool.Write("service", CreateContent(10, 1)));
+    }
+
+    // a process that is always running
+#ifdef _WINDOWS
+    auto runningProcessDir = GetProcessDirectory(spoolDir, 4);
+#else
+    auto runningProcessDir = GetProcessDirectory(spoolDir, 1);
+#endif
+    fs::rename(GetProcessDirectory(spoolDir), runningProcessDir);
+    std::ofstream{runningProcessDir / "1_00000000000000000042.spool.tmp"} << "being written";
+
+    // neither replayed (nor removed to fit in the limit) nor deleted while being written
+    ProfileSpool spool(spoolDir, 1);
+    ASSERT_EQ(0, spool.GetCount());
+    ASSERT_EQ(2, CountFiles(runningProcessDir));
+
+    fs::remove_all(spoolDir);
+}
@@ -0,0 +1,258 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "ProfileUploadQueue.h"
+
+using namespace std::chrono_literals;
+
+TEST(ProfileUploadQueueTest, CheckUploadIsDoneOnAnotherThread)
+{
+    ProfileUploadQueue queue(nullptr);
+    queue.Start();
+
+    std::promise<std::thread::id> uploadThread;
+    queue.Enqueue([&uploadThread](auto) {
+        uploadThread.set_value(std::this_thread::get_id());
+        return true;
+    });
+
+    auto future = uploadThread.get_future();
+    ASSERT_EQ(std::future_status::ready, future.wait_for(5s));
+    ASSERT_NE(std::this_thread::get_id(), future.get());
+
+    queue.Stop();
+}
+
+TEST(ProfileUploadQueueTest, CheckFailedUploadIsRetried)
+{
+    ProfileUploadQueue queue(nullptr, 10, 3, 1ms);
+    queue.Start();
+
+    std::atomic<int> attempts = 0;
+    std::promise<void> uploaded;
+    queue.Enqueue([&attempts, &uploaded](auto) {
+        // the agent fails twice before accepting the profile
+        if (++attempts < 3)
+        {
+            return false;
+        }
+        uploaded.set_value();
+        return true;
+    });
+
+    ASSERT_EQ(std::future_status::ready, uploaded.get_future().wait_for(5s));
+    queue.Stop();
+
+    ASSERT_EQ(3, attempts);
+}
+
+TEST(ProfileUploadQueueTest, CheckUploadIsAbandonedAfterMaxRetries)
+{
+    ProfileUploadQueue queue(nullptr, 10, 2, 1ms);
+    queue.Start();
+
+    std::atomic<int> attempts = 0;
+    queue.Enqueue([&attempts](auto) {
+        attempts++;
+        return false;
+    });
+
+    std::promise<void> nextUploaded;
+    queue.Enqueue([&nextUploaded](auto) {
+        nextUploaded.set_value();
+        return true;
+    });
+
+    ASSERT_EQ(std::future_status::ready, nextUploaded.get_future().wait_for(5s));
+    queue.Stop();
+
+    // first attempt + 2 retries
+    ASSERT_EQ(3, attempts);
+}
+
+TEST(ProfileUploadQueueTest, CheckOldestProfilesAreDroppedWhenQueueIsFull)
+{
+    ProfileUploadQueue queue(nullptr, 2, 0, 1ms);
+    queue.Start();
+
+    // block the upload thread as a slow agent would do
+    std::promise<void> uploadStarted;
+    std::promise<void> agentResponse;
+    auto response = agentResponse.get_future().share();
+    queue.Enqueue([&uploadStarted, response](auto) {
+        uploadStarted.set_value();
+        response.wait();
+        return true;
+    });
+    ASSERT_EQ(std::future_status::ready, uploadStarted.get_future().wait_for(5s));
+
+    std::mutex uploadedLock;
+    std::vector<int> uploaded;
+    std::vector<int> failed;
+    for (int i = 0; i < 5; i++)
+    {
+        queue.Enqueue(
+            [i, &uploadedLock, &uploaded](auto) {
+                std::lock_guard<std::mutex> lock(uploadedLock);
+                uploaded.push_back(i);
+                return true;
+            },
+            [i, &uploadedLock, &failed]() {
+                std::lock_guard<std::mutex> lock(uploadedLock);
+                failed.push_back(i);
+            });
+    }
+
+    ASSERT_EQ(2, queue.GetPendingUploadsCount());
+    ASSERT_EQ(3, queue.GetDroppedUploadsCount());
+
+    // the pending profiles are uploaded once the agent responds
+    agentResponse.set_value();
+    while (queue.GetPendingUploadsCount() != 0)
+    {
+        std::this_thread::sleep_for(1ms);
+    }
+    queue.Stop();
+
+    // the dropped profiles are given to their failure handler (i.e. to be spooled) instead of being lost
+    ASSERT_EQ(std::vector<int>({0, 1, 2}), failed);
+    ASSERT_EQ(std::vector<int>({3, 4}), uploaded);
+}
+
+TEST(ProfileUploadQueueTest, CheckStopDoesNotWaitForBackoff)
+{
+    ProfileUploadQueue queue(nullptr, 10, 5, 1h);
+    queue.Start();
+
+    std::promise<void> firstAttempt;
+    std::atomic<int> attempts = 0;
+    queue.Enqueue([&attempts, &firstAttempt](auto) {
+        if (attempts++ == 0)
+        {
+            firstAttempt.set_value();
+        }
+        return false;
+    });
+    ASSERT_EQ(std::future_status::ready, firstAttempt.get_future().wait_for(5s));
+
+    auto start = std::chrono::steady_clock::now();
+    queue.Stop();
+
+    ASSERT_LT(std::chrono::steady_clock::now() - start, 5s);
+    ASSERT_EQ(1, attempts);
+}
+
+TEST(ProfileUploadQueueTest, CheckFailureHandlerIsCalledAfterMaxRetries)
+{
+    ProfileUploadQueue queue(nullptr, 10, 1, 1ms);
+    queue.Start();
+
+    std::atomic<int> attempts = 0;
+    std::promise<int> failed;
+    queue.Enqueue(
+        [&attempts](auto) {
+            attempts++;
+            return false;
+        },
+        [&attempts, &failed]() { failed.set_value(attempts); });
+
+    auto future = failed.get_future();
+    ASSERT_EQ(std::future_status::ready, future.wait_for(5s));
+    ASSERT_EQ(2, future.get());
+
+    queue.Stop();
+}
+
+TEST(ProfileUploadQueueTest, CheckOnlyTheLastProfileIsUploadedWhenStopping)
+{
+    ProfileUploadQueue queue(nullptr, 10, 3, 1ms, 200ms);
+    queue.Start();
+
+    // block the upload thread as a slow agent would do
+    std::promise<void> uploadStarted;
+    std::promise<void> agentResponse;
+    auto response = agentResponse.get_future().share();
+    queue.Enqueue([&uploadStarted, response](auto) {
+        uploadStarted.set_value();
+        response.wait();
+        return true;
+    });
+    ASSERT_EQ(std::future_status::ready, uploadStarted.get_future().wait_for(5s));
+
+    std::mutex lock;
+    std::vector<int> failed;
+    std::vector<std::optional<std::chrono::milliseconds>> shutdownTimeouts;
+    for (int i = 0; i < 3; i++)
+    {
+        queue.Enqueue(
+            [&lock, &shutdownTimeouts](auto shutdownTimeout) {
+                std::lock_guard<std::mutex> guard(lock);
+                shutdownTimeouts.push_back(shutdownTimeout);
+                return false;
+            },
+            [i, &lock, &failed]() {
+                std::lock_guard<std::mutex> guard(lock);
+                failed.push_back(i);
+            });
+    }
+
+    std::thread agent([&agentResponse] {
+        std::this_thread::sleep_for(50ms);
+        agentResponse.set_value();
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    queue.Stop();
+    agent.join();
+
+    ASSERT_LT(std::chrono::steady_clock::now() - start, 5s);
+
+    // a single attempt for the last profile, bounded by the shutdown timeout
+    ASSERT_EQ(1, shutdownTimeouts.size());
+    ASSERT_TRUE(shutdownTimeouts[0].has_value());
+    ASSERT_LE(*shutdownTimeouts[0], 200ms);
+
+    // the others are given up (i.e. spooled) without being uploaded
+    ASSERT_EQ(std::vector<int>({0, 1, 2}), failed);
+}
+
+TEST(ProfileUploadQueueTest, CheckProfileIsGivenUpWhenShutdownTimeoutHasExpired)
+{
+    ProfileUploadQueue queue(nullptr, 10, 3, 1ms, 10ms);
+    queue.Start();
+
+    std::promise<void> uploadStarted;
+    std::promise<void> agentResponse;
+    auto response = agentResponse.get_future().share();
+    queue.Enqueue([&uploadStarted, response](auto) {
+        uploadStarted.set_value();
+        response.wait();
+        return true;
+    });
+    ASSERT_EQ(std::future_status::ready, uploadStarted.get_future().wait_for(5s));
+
+    std::atomic<int> attempts = 0;
+    std::atomic<int> failures = 0;
+    queue.Enqueue([&attempts](auto) { attempts++; return true; }, [&failures]() { failures++; });
+
+    // the upload in progress outlives the shutdown timeout
+    std::thread agent([&agentResponse] {
+        std::this_thread::sleep_for(100ms);
+        agentResponse.set_value();
+    });
+    queue.Stop();
+    agent.join();
+
+    ASSERT_EQ(0, attempts);
+    ASSERT_EQ(1, failures);
+}
@@ -21,6 +21,10 @@ public:
     MOCK_METHOD(bool, IsDebugLogEnabled, (), (const override));
     MOCK_METHOD(fs::path const&, GetLogDirectory, (), (const override));
     MOCK_METHOD(fs::path const&, GetProfilesOutputDirectory, (), (const override));
+    MOCK_METHOD(fs::path const&, GetSpoolDirectory, (), (const override));
+    MOCK_METHOD(std::uint64_t, GetSpoolMaxSizePerService, (), (const override));
+    MOCK_METHOD(std::size_t, GetTransformerThreadsCount, (), (const override));
+    MOCK_METHOD(std::size_t, GetRawSamplesCapacity, (), (const override));
     MOCK_METHOD(bool, IsNativeFramesEnabled, (), (const override));
     MOCK_METHOD(bool, IsOperationalMetricsEnabled, (), (const override));
     MOCK_METHOD(std::chrono::seconds, GetUploadInterval, (), (const override));
@@ -37,6 +41,12 @@ public:
     MOCK_METHOD(bool, IsFFLibddprofEnabled, (), (const override));
     MOCK_METHOD(bool, IsAgentless, (), (const override));
     MOCK_METHOD(bool, IsCpuProfilingEnabled, (), (const override));
+    MOCK_METHOD(bool, IsCpuTimerSamplingEnabled, (), (const override));
+    MOCK_METHOD(double, GetSamplingOverheadBudget, (), (const override));
+    MOCK_METHOD(bool, IsAllocationProfilingEnabled, (), (const override));
+    MOCK_METHOD(bool, IsContentionProfilingEnabled, (), (const override));
+    MOCK_METHOD(bool, IsExceptionProfilingEnabled, (), (const override));
+    MOCK_METHOD(bool, IsGarbageCollectionProfilingEnabled, (), (const override));
 };
 
 class MockExporter : public IExporter
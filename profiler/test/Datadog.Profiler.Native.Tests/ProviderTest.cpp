@@ -3,6 +3,7 @@
 
 #include "gtest/gtest.h"
 
+#include <algorithm>
 #include <vector>
 #include <unordered_map>
 #include <chrono>
@@ -15,8 +16,19 @@
 #include "FrameStoreHelper.h"
 #include "WallTimeProvider.h"
 #include "CpuTimeProvider.h"
+#include "AllocationsProvider.h"
+#include "CorProfilerInfoHelper.h"
+#include "ManagedThreadList.h"
+#include "ContentionProvider.h"
+#include "ExceptionsProvider.h"
+#include "GarbageCollectionProvider.h"
+#include "PoissonSampler.h"
 #include "RawCpuSample.h"
 #include "RawWallTimeSample.h"
+#include "RawAllocationSample.h"
+#include "RawContentionSample.h"
+#include "RawExceptionSample.h"
+#include "RawGarbageCollectionSample.h"
 
 using namespace std::chrono_literals;
 
@@ -60,7 +72,7 @@ RawCpuSample GetRawCpuSample(
 {
     RawCpuSample raw;
     raw.Timestamp = timeStamp;
-    raw.Duration = duration;  // in milliseconds
+    raw.Duration = duration;  // in nanoseconds
     raw.AppDomainId = appDomainId;
     raw.LocalRootSpanId = traceId;
     raw.SpanId = spanId;
@@ -106,6 +118,89 @@ TEST(WallTimeProviderTest, CheckNoMissingSample)
     provider.Stop();
 }
 
+TEST(WallTimeProviderTest, CheckNoMissingSampleWithTransformerPool)
+{
+// the raw samples are transformed by the workers of the pool: check that the shards are merged
+    auto frameStore = new FrameStoreHelper(true, "Frame", 5);
+    auto appDomainStore = new AppDomainStoreHelper(2);
+    auto [configuration, mockConfiguration] = CreateConfiguration();
+    MockRuntimeIdStore runtimeIdStore;
+
+    // the raw samples are added faster than they are transformed: none must be dropped
+    const std::uint64_t samplesCount = 500;
+    EXPECT_CALL(mockConfiguration, GetRawSamplesCapacity()).WillRepeatedly(::testing::Return(samplesCount));
+
+    std::string expectedRuntimeId = "MyRid";
+    EXPECT_CALL(runtimeIdStore, GetId(::testing::_)).WillRepeatedly(::testing::ReturnRef(expectedRuntimeId));
+
+    SamplesTransformerPool transformerPool(4);
+    transformerPool.Start();
+
+    WallTimeProvider provider(configuration.get(), frameStore, appDomainStore, &runtimeIdStore, &transformerPool);
+    provider.Start();
+
+    for (std::uint64_t i = 1; i <= samplesCount; i++)
+    {
+        provider.Add(GetWallTimeRawSample(i, 10, 1, 0, 0, 5));
+    }
+
+    // wait for the provider to collect raw samples
+    std::this_thread::sleep_for(200ms);
+
+    auto samples = provider.GetSamples();
+    ASSERT_EQ(samplesCount, samples.size());
+
+    // each sample has been transformed exactly once
+    std::vector<std::uint64_t> timestamps;
+    for (auto const& sample : samples)
+    {
+        ASSERT_EQ(5, sample.GetCallstack().size());
+        timestamps.push_back(sample.GetTimeStamp());
+    }
+    std::sort(timestamps.begin(), timestamps.end());
+    for (std::uint64_t i = 1; i <= samplesCount; i++)
+    {
+        ASSERT_EQ(i, timestamps[i - 1]);
+    }
+
+    ASSERT_EQ(0, provider.GetSamples().size());
+
+    provider.Stop();
+    transformerPool.Stop();
+}
+
+TEST(WallTimeProviderTest, CheckQueueStatistics)
+{
+// check the queue is emptied by the transformer and that its statistics are updated
+    auto frameStore = new FrameStoreHelper(true, "Frame", 1);
+    auto appDomainStore = new AppDomainStoreHelper(2);
+    auto [configuration, mockConfiguration] = CreateConfiguration();
+    MockRuntimeIdStore runtimeIdStore;
+
+    std::string expectedRuntimeId = "MyRid";
+    EXPECT_CALL(runtimeIdStore, GetId(::testing::_)).WillRepeatedly(::testing::ReturnRef(expectedRuntimeId));
+
+    WallTimeProvider provider(configuration.get(), frameStore, appDomainStore, &runtimeIdStore);
+    provider.Start();
+
+    // nothing has been transformed yet
+    ASSERT_EQ(0, provider.GetQueueDepth());
+    ASSERT_EQ(0, provider.GetLastTransformLatency().count());
+
+    provider.Add(RawWallTimeSample());
+    provider.Add(RawWallTimeSample());
+
+    // wait for the provider to collect raw samples
+    std::this_thread::sleep_for(200ms);
+
+    ASSERT_EQ(0, provider.GetQueueDepth());
+    ASSERT_LE(1, provider.GetMaxQueueDepth());
+    ASSERT_LT(0, provider.GetLastTransformLatency().count());
+    ASSERT_EQ(2, provider.GetSamples().size());
+
+    provider.Stop();
+}
+
 TEST(WallTimeProviderTest, CheckAppDomainInfoAndRuntimeId)
 {
 // add samples and check their appdomain, and pid labels
@@ -236,14 +331,42 @@ TEST(WallTimeProviderTest, CheckFrames)
         auto frames = sample.GetCallstack();
         for (auto frame : frames)
         {
-            ASSERT_EQ(expectedModules[currentFrame], frame.first);
-            ASSERT_EQ(expectedFrames[currentFrame], frame.second);
+            ASSERT_EQ(expectedModules[currentFrame], frame.GetModuleName());
+            ASSERT_EQ(expectedFrames[currentFrame], frame.GetFrame());
 
             currentFrame++;
         }
     }
 }
 
+TEST(WallTimeProviderTest, CheckGarbageCollectionFrame)
+{
+    auto frameStore = new FrameStoreHelper(true, "Frame", 4);
+    auto appDomainStore = new AppDomainStoreHelper(1);
+    auto [configuration, mockConfiguration] = CreateConfiguration();
+    RuntimeIdStoreHelper runtimeIdStore;
+
+    WallTimeProvider provider(configuration.get(), frameStore, appDomainStore, &runtimeIdStore);
+    provider.Start();
+
+    // the stack of a sample taken during a GC is not collected
+    auto rawSample = GetWallTimeRawSample(1000, 10, static_cast<AppDomainID>(1), 0, 0, 0);
+    rawSample.DuringGarbageCollection = true;
+    provider.Add(std::move(rawSample));
+
+    // wait for the provider to collect raw samples
+    std::this_thread::sleep_for(200ms);
+
+    auto samples = provider.GetSamples();
+    provider.Stop();
+
+    ASSERT_EQ(1, samples.size());
+    auto const& frames = samples.front().GetCallstack();
+    ASSERT_EQ(1, frames.size());
+    ASSERT_EQ("CLR", frames[0].GetModuleName());
+    ASSERT_EQ("|lm:CLR |ns:CLR |ct:CLR |fn:Garbage Collector", frames[0].GetFrame());
+}
+
 TEST(WallTimeProviderTest, CheckValuesAndTimestamp)
 {
     // add samples and check their frames
@@ -304,10 +427,10 @@ TEST(CpuTimeProviderTest, CheckValuesAndTimestamp)
     provider.Start();
 
     //                           V-----V-- check these values are correct
-    provider.Add(GetRawCpuSample(1000, 10, static_cast<AppDomainID>(1), 0, 0, 1));
-    provider.Add(GetRawCpuSample(2000, 20, static_cast<AppDomainID>(1), 0, 0, 1));
-    provider.Add(GetRawCpuSample(3000, 30, static_cast<AppDomainID>(1), 0, 0, 1));
-    provider.Add(GetRawCpuSample(4000, 40, static_cast<AppDomainID>(1), 0, 0, 1));
+    provider.Add(GetRawCpuSample(1000, 10000000, static_cast<AppDomainID>(1), 0, 0, 1));
+    provider.Add(GetRawCpuSample(2000, 20000000, static_cast<AppDomainID>(1), 0, 0, 1));
+    provider.Add(GetRawCpuSample(3000, 30000000, static_cast<AppDomainID>(1), 0, 0, 1));
+    provider.Add(GetRawCpuSample(4000, 40000000, static_cast<AppDomainID>(1), 0, 0, 1));
 
     // wait for the provider to collect raw samples
     std::this_thread::sleep_for(200ms);
@@ -337,3 +460,364 @@ TEST(CpuTimeProviderTest, CheckValuesAndTimestamp)
         currentSample++;
     }
 }
+
+TEST(AllocationsProviderTest, CheckValuesAndAllocationClass)
+{
+    auto frameStore = new FrameStoreHelper(true, "Frame", 1);
+    auto appDomainStore = new AppDomainStoreHelper(1);
+    auto [configuration, mockConfiguration] = CreateConfiguration();
+    RuntimeIdStoreHelper runtimeIdStore;
+
+    AllocationsProvider provider(nullptr, nullptr, configuration.get(), frameStore, appDomainStore, &runtimeIdStore);
+    provider.Start();
+
+    RawAllocationSample raw;
+    raw.Timestamp = 1000;
+    raw.AppDomainId = static_cast<AppDomainID>(1);
+    raw.Stack.push_back(1);
+    raw.AllocationClass = "System.String";
+    raw.AllocationAmount = AllocationsProvider::AllocationTickInterval;
+    raw.AllocationSize = 64;
+    provider.Add(std::move(raw));
+
+    // wait for the provider to collect raw samples
+    std::this_thread::sleep_for(200ms);
+
+    auto samples = provider.GetSamples();
+    provider.Stop();
+
+    ASSERT_EQ(1, samples.size());
+    auto const& sample = samples.front();
+
+    // the bytes allocated since the previous tick are attributed to objects of the sampled size
+    std::int64_t expectedSize = AllocationsProvider::AllocationTickInterval;
+    auto values = sample.GetValues();
+    for (size_t current = 0; current < values.size(); current++)
+    {
+        if (current == (size_t)SampleValue::AllocationCount)
+        {
+            ASSERT_EQ(expectedSize / 64, values[current]);
+        }
+        else if (current == (size_t)SampleValue::AllocationSize)
+        {
+            ASSERT_EQ(expectedSize, values[current]);
+        }
+        else // all other values must be 0
+        {
+            ASSERT_EQ(0, values[current]);
+        }
+    }
+
+    auto const& labels = sample.GetLabels();
+    auto label = std::find_if(labels.begin(), labels.end(), [](Label const& l) { return l.first == Sample::AllocationClassLabel; });
+    ASSERT_NE(labels.end(), label);
+    ASSERT_EQ("System.String", label->second);
+}
+
+// GCAllocationTick payload as serialized by the runtime (fields are not aligned)
+std::vector<BYTE> GetAllocationTickPayload(DWORD version, std::uint64_t allocationAmount, std::uint64_t objectSize)
+{
+    std::vector<BYTE> payload;
+    auto append = [&payload](auto value) {
+        auto bytes = reinterpret_cast<const BYTE*>(&value);
+        payload.insert(payload.end(), bytes, bytes + sizeof(value));
+    };
+
+    append(static_cast<std::uint32_t>(allocationAmount)); // AllocationAmount
+    append(static_cast<std::uint32_t>(0));                // AllocationKind
+    append(static_cast<std::uint16_t>(0));                // ClrInstanceID
+    append(allocationAmount);                             // AllocationAmount64
+    append(static_cast<std::uintptr_t>(0x1234));          // TypeID
+    for (auto c : std::string("Foo"))                     // TypeName
+    {
+        append(static_cast<std::uint16_t>(c));
+    }
+    append(static_cast<std::uint16_t>(0));
+    append(static_cast<std::uint32_t>(0));                // HeapIndex
+    if (version >= 3)
+    {
+        append(static_cast<std::uintptr_t>(0x5678));      // Address
+    }
+    if (version >= 4)
+    {
+        append(objectSize);                               // ObjectSize
+    }
+
+    return payload;
+}
+
+TEST(AllocationsProviderTest, CheckAllocationTickPayload)
+{
+    auto frameStore = new FrameStoreHelper(true, "Frame", 1);
+    auto appDomainStore = new AppDomainStoreHelper(1);
+    auto [configuration, mockConfiguration] = CreateConfiguration();
+    RuntimeIdStoreHelper runtimeIdStore;
+    CorProfilerInfoHelper profilerInfo;
+    ManagedThreadList threadList(&profilerInfo);
+
+    AllocationsProvider provider(&profilerInfo, &threadList, configuration.get(), frameStore, appDomainStore, &runtimeIdStore);
+    provider.Start();
+
+    UINT_PTR stack[] = {1, 2};
+
+    // V4 provides the size of the sampled object and V3 does not
+    auto v4 = GetAllocationTickPayload(4, 100000, 48);
+    provider.OnEventPipeEvent(AllocationsProvider::AllocationTickEventId, 4, static_cast<ULONG>(v4.size()), v4.data(), 1, 2, stack);
+    auto v3 = GetAllocationTickPayload(3, 120000, 0);
+    provider.OnEventPipeEvent(AllocationsProvider::AllocationTickEventId, 3, static_cast<ULONG>(v3.size()), v3.data(), 1, 2, stack);
+
+    // other events and truncated payloads are ignored
+    provider.OnEventPipeEvent(AllocationsProvider::AllocationTickEventId + 1, 4, static_cast<ULONG>(v4.size()), v4.data(), 1, 2, stack);
+    provider.OnEventPipeEvent(AllocationsProvider::AllocationTickEventId, 4, 12, v4.data(), 1, 2, stack);
+
+    // wait for the provider to collect raw samples
+    std::this_thread::sleep_for(200ms);
+
+    auto samples = provider.GetSamples();
+    provider.Stop();
+
+    ASSERT_EQ(2, samples.size());
+
+    auto values = samples.front().GetValues();
+    ASSERT_EQ(100000 / 48, values[(size_t)SampleValue::AllocationCount]);
+    ASSERT_EQ(100000, values[(size_t)SampleValue::AllocationSize]);
+    ASSERT_EQ(2, samples.front().GetCallstack().size());
+
+    values = samples.back().GetValues();
+    ASSERT_EQ(1, values[(size_t)SampleValue::AllocationCount]);
+    ASSERT_EQ(120000, values[(size_t)SampleValue::AllocationSize]);
+}
+
+TEST(ContentionProviderTest, CheckValuesAndLabels)
+{
+    auto frameStore = new FrameStoreHelper(true, "Frame", 1);
+    auto appDomainStore = new AppDomainStoreHelper(1);
+    auto [configuration, mockConfiguration] = CreateConfiguration();
+    RuntimeIdStoreHelper runtimeIdStore;
+
+    ContentionProvider provider(nullptr, nullptr, configuration.get(), frameStore, appDomainStore, &runtimeIdStore);
+    provider.Start();
+
+    RawContentionSample raw;
+    raw.Timestamp = 1000;
+    raw.AppDomainId = static_cast<AppDomainID>(1);
+    raw.Stack.push_back(1);
+    raw.ContentionDuration = 20000000; // 20 ms
+    raw.LockOwnerThreadId = 42;
+    provider.Add(std::move(raw));
+
+    // wait for the provider to collect raw samples
+    std::this_thread::sleep_for(200ms);
+
+    auto samples = provider.GetSamples();
+    provider.Stop();
+
+    ASSERT_EQ(1, samples.size());
+    auto const& sample = samples.front();
+
+    auto [expectedCount, expectedDuration] = PoissonSampler::Upscale(20000000, ContentionProvider::SamplingInterval);
+    auto values = sample.GetValues();
+    for (size_t current = 0; current < values.size(); current++)
+    {
+        if (current == (size_t)SampleValue::ContentionCount)
+        {
+            ASSERT_EQ(expectedCount, values[current]);
+        }
+        else if (current == (size_t)SampleValue::ContentionDuration)
+        {
+            ASSERT_EQ(expectedDuration, values[current]);
+        }
+        else // all other values must be 0
+        {
+            ASSERT_EQ(0, values[current]);
+        }
+    }
+
+    auto const& labels = sample.GetLabels();
+    auto bucket = std::find_if(labels.begin(), labels.end(), [](Label const& l) { return l.first == Sample::ContentionDurationBucketLabel; });
+    ASSERT_NE(labels.end(), bucket);
+    ASSERT_EQ("10 - 100 ms", bucket->second);
+
+    auto owner = std::find_if(labels.begin(), labels.end(), [](Label const& l) { return l.first == Sample::LockOwnerThreadIdLabel; });
+    ASSERT_NE(labels.end(), owner);
+    ASSERT_EQ("42", owner->second);
+}
+
+TEST(ContentionProviderTest, CheckDurationBuckets)
+{
+    ASSERT_STREQ("< 1 ms", ContentionProvider::GetDurationBucket(999999));
+    ASSERT_STREQ("1 - 10 ms", ContentionProvider::GetDurationBucket(1000000));
+    ASSERT_STREQ("10 - 100 ms", ContentionProvider::GetDurationBucket(99999999));
+    ASSERT_STREQ("100 ms - 1 s", ContentionProvider::GetDurationBucket(100000000));
+    ASSERT_STREQ(">= 1 s", ContentionProvider::GetDurationBucket(5000000000));
+}
+
+TEST(ExceptionsProviderTest, CheckValuesAndLabels)
+{
+    auto frameStore = new FrameStoreHelper(true, "Frame", 1);
+    auto appDomainStore = new AppDomainStoreHelper(1);
+    auto [configuration, mockConfiguration] = CreateConfiguration();
+    RuntimeIdStoreHelper runtimeIdStore;
+
+    ExceptionsProvider provider(nullptr, nullptr, configuration.get(), frameStore, appDomainStore, &runtimeIdStore);
+    provider.Start();
+
+    RawExceptionSample raw;
+    raw.Timestamp = 1000;
+    raw.AppDomainId = static_cast<AppDomainID>(1);
+    raw.Stack.push_back(1);
+    raw.ExceptionType = "System.InvalidOperationException";
+    raw.ExceptionMessage = "Operation is not valid";
+    raw.Count = 7;
+    provider.Add(std::move(raw));
+
+    // wait for the provider to collect raw samples
+    std::this_thread::sleep_for(200ms);
+
+    auto samples = provider.GetSamples();
+    provider.Stop();
+
+    ASSERT_EQ(1, samples.size());
+    auto const& sample = samples.front();
+
+    auto values = sample.GetValues();
+    for (size_t current = 0; current < values.size(); current++)
+    {
+        if (current == (size_t)SampleValue::ExceptionCount)
+        {
+            ASSERT_EQ(7, values[current]);
+        }
+        else // all other values must be 0
+        {
+            ASSERT_EQ(0, values[current]);
+        }
+    }
+
+    auto const& labels = sample.GetLabels();
+    auto type = std::find_if(labels.begin(), labels.end(), [](Label const& l) { return l.first == Sample::ExceptionTypeLabel; });
+    ASSERT_NE(labels.end(), type);
+    ASSERT_EQ("System.InvalidOperationException", type->second);
+
+    auto message = std::find_if(labels.begin(), labels.end(), [](Label const& l) { return l.first == Sample::ExceptionMessageLabel; });
+    ASSERT_NE(labels.end(), message);
+    ASSERT_EQ("Operation is not valid", message->second);
+}
+
+TEST(GarbageCollectionProviderTest, CheckValuesAndLabels)
+{
+    auto frameStore = new FrameStoreHelper(true, "Frame", 1);
+    auto appDomainStore = new AppDomainStoreHelper(1);
+    auto [configuration, mockConfiguration] = CreateConfiguration();
+    RuntimeIdStoreHelper runtimeIdStore;
+
+    GarbageCollectionProvider provider(nullptr, configuration.get(), frameStore, appDomainStore, &runtimeIdStore);
+    provider.Start();
+
+    RawGarbageCollectionSample raw;
+    raw.Timestamp = 1000;
+    raw.AppDomainId = static_cast<AppDomainID>(1);
+    raw.Generation = 2;
+    raw.Reason = COR_PRF_GC_INDUCED;
+    raw.Duration = 3000000;
+    raw.PauseDuration = 2000000;
+    raw.EndTimestampNs = 1000000000123;
+    provider.Add(std::move(raw));
+
+    // wait for the provider to collect raw samples
+    std::this_thread::sleep_for(200ms);
+
+    auto samples = provider.GetSamples();
+    provider.Stop();
+
+    ASSERT_EQ(1, samples.size());
+    auto const& sample = samples.front();
+
+    auto values = sample.GetValues();
+    for (size_t current = 0; current < values.size(); current++)
+    {
+        if (current == (size_t)SampleValue::GarbageCollectionDuration)
+        {
+            ASSERT_EQ(3000000, values[current]);
+        }
+        else // all other values must be 0
+        {
+            ASSERT_EQ(0, values[current]);
+        }
+    }
+
+    // the synthetic frame is the only one
+    auto const& frames = sample.GetCallstack();
+    ASSERT_EQ(1, frames.size());
+    ASSERT_EQ("|lm:CLR |ns:CLR |ct:CLR |fn:Garbage Collector", frames[0].GetFrame());
+
+    auto const& labels = sample.GetLabels();
+    auto getLabel = [&labels](std::string const& name) {
+        auto label = std::find_if(labels.begin(), labels.end(), [&name](Label const& l) { return l.first == name; });
+        return (label == labels.end()) ? std::string() : label->second;
+    };
+    ASSERT_EQ("gen 2", getLabel(Sample::GarbageCollectionGenerationLabel));
+    ASSERT_EQ("Induced", getLabel(Sample::GarbageCollectionReasonLabel));
+
+    // durations and timestamps are numeric labels
+    auto const& numericLabels = sample.GetNumericLabels();
+    ASSERT_EQ(2, numericLabels.size());
+    ASSERT_EQ(Sample::GarbageCollectionPauseDurationLabel, numericLabels.front().Name);
+    ASSERT_EQ(2000000, numericLabels.front().Value);
+    ASSERT_EQ("nanoseconds", numericLabels.front().Unit);
+    ASSERT_EQ(Sample::EndTimestampLabel, numericLabels.back().Name);
+    ASSERT_EQ(1000000000123, numericLabels.back().Value);
+    ASSERT_EQ("", getLabel(Sample::GarbageCollectionPauseDurationLabel));
+}
+
+TEST(GarbageCollectionProviderTest, CheckBackgroundCollectionIsNotGivenTheForegroundPause)
+{
+    auto frameStore = new FrameStoreHelper(true, "Frame", 1);
+    auto appDomainStore = new AppDomainStoreHelper(1);
+    auto [configuration, mockConfiguration] = CreateConfiguration();
+    RuntimeIdStoreHelper runtimeIdStore;
+    CorProfilerInfoHelper profilerInfo;
+
+    GarbageCollectionProvider provider(&profilerInfo, configuration.get(), frameStore, appDomainStore, &runtimeIdStore);
+    provider.Start();
+
+    BOOL gen2[] = {TRUE, TRUE, TRUE};
+    BOOL gen0[] = {TRUE, FALSE, FALSE};
+
+    // a background gen 2 starts during its own short suspension...
+    provider.OnRuntimeSuspendStarted(COR_PRF_SUSPEND_FOR_GC);
+    provider.OnGarbageCollectionStarted(3, gen2, COR_PRF_GC_OTHER);
+    provider.OnRuntimeResumeFinished();
+
+    // ...and finishes during the suspension of a foreground gen 0
+    provider.OnRuntimeSuspendStarted(COR_PRF_SUSPEND_FOR_GC);
+    provider.OnGarbageCollectionStarted(3, gen0, COR_PRF_GC_OTHER);
+    std::this_thread::sleep_for(10ms);
+    provider.OnGarbageCollectionFinished(); // gen 0
+    provider.OnGarbageCollectionFinished(); // gen 2
+    provider.OnRuntimeResumeFinished();
+
+    // wait for the provider to collect raw samples
+    std::this_thread::sleep_for(200ms);
+
+    auto samples = provider.GetSamples();
+    provider.Stop();
+
+    ASSERT_EQ(2, samples.size());
+    for (auto const& sample : samples)
+    {
+        auto const& labels = sample.GetLabels();
+        auto generation = std::find_if(labels.begin(), labels.end(), [](Label const& l) { return l.first == Sample::GarbageCollectionGenerationLabel; });
+        ASSERT_NE(labels.end(), generation);
+
+        auto pause = sample.GetNumericLabels().front();
+        ASSERT_EQ(Sample::GarbageCollectionPauseDurationLabel, pause.Name);
+        if (generation->second == "gen 2")
+        {
+            ASSERT_EQ(0, pause.Value);
+        }
+        else
+        {
+            ASSERT_GE(pause.Value, 10000000);
+        }
+    }
+}
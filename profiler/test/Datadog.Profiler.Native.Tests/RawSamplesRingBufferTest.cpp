@@ -0,0 +1,157 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include "gtest/gtest.h"
+
+#include <thread>
+#include <vector>
+
+#include "RawSamplesRingBuffer.h"
+#include "RawWallTimeSample.h"
+
+
+RawWallTimeSample CreateRawSample(std::uint64_t timestamp, size_t frameCount)
+{
+    RawWallTimeSample raw;
+    raw.Timestamp = timestamp;
+    raw.Duration = timestamp * 10;
+    raw.AppDomainId = 1;
+    raw.LocalRootSpanId = timestamp + 1;
+    raw.SpanId = timestamp + 2;
+
+    for (size_t i = 0; i < frameCount; i++)
+    {
+        raw.Stack.push_back(timestamp * 1000 + i);
+    }
+
+    return raw;
+}
+
+TEST(RawSamplesRingBufferTest, CheckPushedSamplesArePoppedInOrder)
+{
+    RawSamplesRingBuffer<RawWallTimeSample> buffer(4, 16);
+
+    for (std::uint64_t i = 1; i <= 3; i++)
+    {
+        ASSERT_TRUE(buffer.TryPush(CreateRawSample(i, i)));
+    }
+    ASSERT_EQ(3, buffer.Size());
+
+    RawWallTimeSample raw;
+    for (std::uint64_t i = 1; i <= 3; i++)
+    {
+        ASSERT_TRUE(buffer.TryPop(raw));
+        ASSERT_EQ(i, raw.Timestamp);
+        ASSERT_EQ(i * 10, raw.Duration);
+        ASSERT_EQ(i + 1, raw.LocalRootSpanId);
+        ASSERT_EQ(i + 2, raw.SpanId);
+        ASSERT_EQ(i, raw.Stack.size());
+        for (size_t frame = 0; frame < raw.Stack.size(); frame++)
+        {
+            ASSERT_EQ(i * 1000 + frame, raw.Stack[frame]);
+        }
+    }
+
+    ASSERT_FALSE(buffer.TryPop(raw));
+    ASSERT_EQ(0, buffer.Size());
+    ASSERT_EQ(0, buffer.GetDroppedCount());
+}
+
+TEST(RawSamplesRingBufferTest, CheckSamplesAreDroppedWhenFull)
+{
+    RawSamplesRingBuffer<RawWallTimeSample> buffer(2, 16);
+    ASSERT_EQ(2, buffer.GetCapacity());
+
+    ASSERT_TRUE(buffer.TryPush(CreateRawSample(1, 2)));
+    ASSERT_TRUE(buffer.TryPush(CreateRawSample(2, 2)));
+
+    auto dropped = CreateRawSample(3, 2);
+    ASSERT_FALSE(buffer.TryPush(std::move(dropped)));
+    ASSERT_EQ(1, buffer.GetDroppedCount());
+
+    // a rejected sample is left untouched
+    ASSERT_EQ(3, dropped.Timestamp);
+    ASSERT_EQ(2, dropped.Stack.size());
+
+    // room is available again once a sample is consumed
+    RawWallTimeSample raw;
+    ASSERT_TRUE(buffer.TryPop(raw));
+    ASSERT_EQ(1, raw.Timestamp);
+    ASSERT_TRUE(buffer.TryPush(CreateRawSample(4, 2)));
+    ASSERT_EQ(1, buffer.GetDroppedCount());
+}
+
+TEST(RawSamplesRingBufferTest, CheckDeepStacksAreTruncated)
+{
+    RawSamplesRingBuffer<RawWallTimeSample> buffer(2, 8);
+
+    ASSERT_TRUE(buffer.TryPush(CreateRawSample(1, 20)));
+
+    RawWallTimeSample raw;
+    ASSERT_TRUE(buffer.TryPop(raw));
+    ASSERT_EQ(8, raw.Stack.size());
+    ASSERT_EQ(1000, raw.Stack[0]);
+    ASSERT_EQ(1007, raw.Stack[7]);
+    ASSERT_EQ(1, buffer.GetTruncatedCount());
+}
+
+TEST(RawSamplesRingBufferTest, CheckSharedFramesAreCopiedForEachSample)
+{
+    RawSamplesRingBuffer<RawWallTimeSample> buffer(4, 16);
+
+    // the same instruction pointers are used by several samples (i.e. wall time and CPU)
+    std::vector<std::uintptr_t> frames = {42, 43, 44};
+    ASSERT_TRUE(buffer.TryPush(CreateRawSample(1, 0), frames.data(), frames.size()));
+    ASSERT_TRUE(buffer.TryPush(CreateRawSample(2, 0), frames.data(), frames.size()));
+    frames.clear();
+
+    RawWallTimeSample raw;
+    for (std::uint64_t i = 1; i <= 2; i++)
+    {
+        ASSERT_TRUE(buffer.TryPop(raw));
+        ASSERT_EQ(i, raw.Timestamp);
+        ASSERT_EQ(std::vector<std::uintptr_t>({42, 43, 44}), raw.Stack);
+    }
+}
+
+TEST(RawSamplesRingBufferTest, CheckCapacityIsRoundedUpToPowerOfTwo)
+{
+    RawSamplesRingBuffer<RawWallTimeSample> buffer(5, 8);
+
+    ASSERT_EQ(8, buffer.GetCapacity());
+}
+
+TEST(RawSamplesRingBufferTest, CheckConcurrentProducerAndConsumer)
+{
+    const std::uint64_t samplesCount = 100000;
+    RawSamplesRingBuffer<RawWallTimeSample> buffer(64, 4);
+
+    std::thread producer([&buffer, samplesCount]() {
+        for (std::uint64_t i = 1; i <= samplesCount; i++)
+        {
+            auto raw = CreateRawSample(i, 1);
+            while (!buffer.TryPush(std::move(raw)))
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::uint64_t expected = 1;
+    RawWallTimeSample raw;
+    while (expected <= samplesCount)
+    {
+        if (buffer.TryPop(raw))
+        {
+            ASSERT_EQ(expected, raw.Timestamp);
+            ASSERT_EQ(expected * 1000, raw.Stack[0]);
+            expected++;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    producer.join();
+}
@@ -11,11 +11,14 @@
 #include "Sample.h"
 #include "SamplesAggregator.h"
 
+#include <algorithm>
 #include <chrono>
 #include <tuple>
+#include <vector>
 
 using ::testing::_;
 using ::testing::ByMove;
+using ::testing::Invoke;
 using ::testing::Return;
 using ::testing::Throw;
 
@@ -57,6 +60,31 @@ TEST(SamplesAggregatorTest, MustCollectOneSampleFromOneProvider)
     ASSERT_TRUE(metricsSender.WasCounterCalled());
 }
 
+TEST(SamplesAggregatorTest, MustExportLastSamplesWhenStopping)
+{
+    auto [configuration, mockConfiguration] = CreateConfiguration();
+    EXPECT_CALL(mockConfiguration, GetUploadInterval()).Times(1).WillOnce(Return(60s));
+
+    auto [samplesProvider, mockSamplesProvider] = CreateSamplesProvider();
+
+    std::string runtimeId = "MyRid";
+    EXPECT_CALL(mockSamplesProvider, GetSamples()).Times(1).WillOnce(Return(ByMove(CreateSamples(runtimeId, 1))));
+
+    // the upload interval is not reached: the samples are exported because the aggregator stops
+    auto [exporter, mockExporter] = CreateExporter();
+    EXPECT_CALL(mockExporter, Add(_)).Times(1);
+    EXPECT_CALL(mockExporter, Export()).Times(1).WillOnce(Return(true));
+
+    auto metricsSender = MockMetricsSender();
+
+    auto aggregator = SamplesAggregator(&mockConfiguration, &mockExporter, &metricsSender);
+    aggregator.Register(&mockSamplesProvider);
+
+    aggregator.Start();
+    std::this_thread::sleep_for(100ms);
+    aggregator.Stop();
+}
+
 TEST(SamplesAggregatorTest, MustCollectSamplesFromTwoProviders)
 {
     auto [configuration, mockConfiguration] = CreateConfiguration();
@@ -70,8 +98,9 @@ TEST(SamplesAggregatorTest, MustCollectSamplesFromTwoProviders)
     auto [samplesProvider2, mockSamplesProvider2] = CreateSamplesProvider();
     EXPECT_CALL(mockSamplesProvider2, GetSamples()).Times(1).WillOnce(Return(ByMove(CreateSamples(runtimeId2, 2))));
 
+    // the 2 samples of the second provider are identical so they are aggregated
     auto [exporter, mockExporter] = CreateExporter();
-    EXPECT_CALL(mockExporter, Add(_)).Times(3);
+    EXPECT_CALL(mockExporter, Add(_)).Times(2);
     EXPECT_CALL(mockExporter, Export()).Times(1).WillOnce(Return(true));
 
     auto metricsSender = MockMetricsSender();
@@ -100,8 +129,9 @@ TEST(SamplesAggregatorTest, MustNotFailWhenSendingProfileThrows)
     auto [samplesProvider2, mockSamplesProvider2] = CreateSamplesProvider();
     EXPECT_CALL(mockSamplesProvider2, GetSamples()).Times(1).WillOnce(Return(ByMove(CreateSamples(runtimeId2, 2))));
 
+    // the 2 samples of the second provider are identical so they are aggregated
     auto [exporter, mockExporter] = CreateExporter();
-    EXPECT_CALL(mockExporter, Add(_)).Times(3);
+    EXPECT_CALL(mockExporter, Add(_)).Times(2);
     EXPECT_CALL(mockExporter, Export()).Times(1).WillRepeatedly(Throw(std::exception()));
 
     auto metricsSender = MockMetricsSender();
@@ -172,3 +202,71 @@ TEST(SamplesAggregatorTest, MustNotFailWhenCollectingSampleThrows)
 
     ASSERT_TRUE(metricsSender.WasCounterCalled());
 }
+
+TEST(SamplesAggregatorTest, MustAggregateSamplesWithSameCallstackAndLabels)
+{
+    auto [configuration, mockConfiguration] = CreateConfiguration();
+    EXPECT_CALL(mockConfiguration, GetUploadInterval()).Times(1).WillOnce(Return(1s));
+
+    std::string runtimeId = "MyRid";
+    std::list<Sample> samples;
+    samples.push_back(CreateSample(runtimeId, CreateCallstack(3), {{"label", "value"}}, 10));
+    samples.push_back(CreateSample(runtimeId, CreateCallstack(3), {{"label", "value"}}, 5));
+    samples.push_back(CreateSample(runtimeId, CreateCallstack(3), {{"label", "other value"}}, 1));
+    samples.push_back(CreateSample(runtimeId, CreateCallstack(2), {{"label", "value"}}, 2));
+
+    auto [samplesProvider, mockSamplesProvider] = CreateSamplesProvider();
+    EXPECT_CALL(mockSamplesProvider, GetSamples()).Times(1).WillOnce(Return(ByMove(std::move(samples))));
+
+    std::vector<std::int64_t> exportedValues;
+    auto [exporter, mockExporter] = CreateExporter();
+    EXPECT_CALL(mockExporter, Add(_)).Times(3).WillRepeatedly(Invoke([&exportedValues](Sample const& sample) {
+        exportedValues.push_back(sample.GetValues()[0]);
+    }));
+    EXPECT_CALL(mockExporter, Export()).Times(1).WillOnce(Return(true));
+
+    auto metricsSender = MockMetricsSender();
+
+    auto aggregator = SamplesAggregator(&mockConfiguration, &mockExporter, &metricsSender);
+    aggregator.Register(&mockSamplesProvider);
+
+    aggregator.Start();
+    std::this_thread::sleep_for(100ms);
+    aggregator.Stop();
+
+    // the values of the first 2 samples are summed
+    std::sort(exportedValues.begin(), exportedValues.end());
+    ASSERT_EQ(std::vector<std::int64_t>({1, 2, 15}), exportedValues);
+}
+
+TEST(SamplesAggregatorTest, MustGiveAggregatedSamplesToExporterWhenTooMany)
+{
+    auto [configuration, mockConfiguration] = CreateConfiguration();
+    EXPECT_CALL(mockConfiguration, GetUploadInterval()).Times(1).WillOnce(Return(1s));
+
+    std::string runtimeId = "MyRid";
+    std::list<Sample> samples;
+    for (std::size_t i = 0; i < SamplesAggregator::MaxAggregatedSamplesCount; i++)
+    {
+        samples.push_back(CreateSample(runtimeId, CreateCallstack(3), {{"label", std::to_string(i)}}, 1));
+    }
+
+    // same callstack and labels as the first sample, but received after the limit was reached
+    samples.push_back(CreateSample(runtimeId, CreateCallstack(3), {{"label", "0"}}, 1));
+
+    auto [samplesProvider, mockSamplesProvider] = CreateSamplesProvider();
+    EXPECT_CALL(mockSamplesProvider, GetSamples()).Times(1).WillOnce(Return(ByMove(std::move(samples))));
+
+    auto [exporter, mockExporter] = CreateExporter();
+    EXPECT_CALL(mockExporter, Add(_)).Times(SamplesAggregator::MaxAggregatedSamplesCount + 1);
+    EXPECT_CALL(mockExporter, Export()).Times(1).WillOnce(Return(true));
+
+    auto metricsSender = MockMetricsSender();
+
+    auto aggregator = SamplesAggregator(&mockConfiguration, &mockExporter, &metricsSender);
+    aggregator.Register(&mockSamplesProvider);
+
+    aggregator.Start();
+    std::this_thread::sleep_for(100ms);
+    aggregator.Stop();
+}
@@ -0,0 +1,138 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "SamplesTransformerPool.h"
+
+using namespace std::chrono_literals;
+
+TEST(SamplesTransformerPoolTest, CheckAllTasksAreDoneWhenRunReturns)
+{
+    SamplesTransformerPool pool(4);
+    pool.Start();
+
+    std::vector<std::atomic<int>> executions(100);
+    std::vector<SamplesTransformerPool::Task> tasks;
+    for (std::size_t i = 0; i < executions.size(); i++)
+    {
+        tasks.emplace_back([i, &executions](std::size_t) { executions[i]++; });
+    }
+
+    pool.Run(tasks);
+
+    for (auto const& count : executions)
+    {
+        ASSERT_EQ(1, count);
+    }
+
+    pool.Stop();
+}
+
+TEST(SamplesTransformerPoolTest, CheckManySmallBatchesAreDone)
+{
+    SamplesTransformerPool pool(4);
+    pool.Start();
+
+    // each batch lives on the stack of Run(): a worker still touching a finished batch would
+    // use a destroyed one when the next batch takes its place
+    std::atomic<int> executions = 0;
+    for (int i = 0; i < 20000; i++)
+    {
+        std::vector<SamplesTransformerPool::Task> tasks;
+        for (int j = 0; j < (i % 3) + 1; j++)
+        {
+            tasks.emplace_back([&executions](std::size_t) { executions++; });
+        }
+
+        pool.Run(tasks);
+        ASSERT_EQ(((i / 3) * 6) + ((i % 3) + 1) * ((i % 3) + 2) / 2, executions);
+    }
+
+    pool.Stop();
+}
+
+TEST(SamplesTransformerPoolTest, CheckTasksAreRunOnTheWorkers)
+{
+    SamplesTransformerPool pool(2);
+    pool.Start();
+
+    std::mutex lock;
+    std::set<std::thread::id> threads;
+    std::set<std::size_t> workerIndexes;
+    std::vector<SamplesTransformerPool::Task> tasks;
+    for (int i = 0; i < 10; i++)
+    {
+        tasks.emplace_back([&lock, &threads, &workerIndexes](std::size_t workerIndex) {
+            std::lock_guard<std::mutex> guard(lock);
+            threads.insert(std::this_thread::get_id());
+            workerIndexes.insert(workerIndex);
+        });
+    }
+
+    pool.Run(tasks);
+
+    ASSERT_EQ(0, threads.count(std::this_thread::get_id()));
+    for (auto workerIndex : workerIndexes)
+    {
+        ASSERT_LT(workerIndex, pool.GetWorkersCount());
+    }
+
+    pool.Stop();
+}
+
+TEST(SamplesTransformerPoolTest, CheckIdleWorkerStealsTasks)
+{
+    SamplesTransformerPool pool(2);
+    pool.Start();
+
+    // the first task blocks its worker until the other tasks have been run: as they are spread
+    // across the 2 workers, the ones queued behind the blocked task must be stolen by the other worker
+    std::atomic<int> otherTasksCount = 0;
+    std::vector<SamplesTransformerPool::Task> tasks;
+    const int tasksCount = 9;
+    tasks.emplace_back([&otherTasksCount](std::size_t) {
+        auto deadline = std::chrono::steady_clock::now() + 5s;
+        while ((otherTasksCount < tasksCount - 1) && (std::chrono::steady_clock::now() < deadline))
+        {
+            std::this_thread::sleep_for(1ms);
+        }
+    });
+    for (int i = 1; i < tasksCount; i++)
+    {
+        tasks.emplace_back([&otherTasksCount](std::size_t) { otherTasksCount++; });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    pool.Run(tasks);
+
+    ASSERT_EQ(tasksCount - 1, otherTasksCount);
+    ASSERT_LT(std::chrono::steady_clock::now() - start, 5s);
+
+    pool.Stop();
+}
+
+TEST(SamplesTransformerPoolTest, CheckTasksAreRunByCallerWhenNotStarted)
+{
+    SamplesTransformerPool pool(4);
+
+    std::thread::id taskThread;
+    std::size_t taskWorkerIndex = 42;
+    std::vector<SamplesTransformerPool::Task> tasks;
+    tasks.emplace_back([&taskThread, &taskWorkerIndex](std::size_t workerIndex) {
+        taskThread = std::this_thread::get_id();
+        taskWorkerIndex = workerIndex;
+    });
+
+    pool.Run(tasks);
+
+    ASSERT_EQ(std::this_thread::get_id(), taskThread);
+    ASSERT_EQ(0, taskWorkerIndex);
+}
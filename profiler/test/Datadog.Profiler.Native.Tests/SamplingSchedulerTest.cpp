@@ -0,0 +1,71 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include "gtest/gtest.h"
+
+#include "SamplingScheduler.h"
+
+using namespace std::chrono_literals;
+
+TEST(SamplingSchedulerTest, CheckFewThreadsAreAllSampledAtEachIteration)
+{
+    SamplingScheduler scheduler(0.01, 64);
+
+    // 1 µs per sample is far below the budget
+    scheduler.OnIterationCompleted(10, 10us);
+    scheduler.Update(10);
+
+    ASSERT_EQ(10, scheduler.GetThreadsPerIteration());
+    ASSERT_EQ(SamplingScheduler::TargetThreadSamplingPeriod, scheduler.GetSamplingPeriod());
+}
+
+TEST(SamplingSchedulerTest, CheckPeriodIsStretchedToStayUnderBudget)
+{
+    SamplingScheduler scheduler(0.01, 64);
+
+    // 100 µs per sample with 1% of a core --> 100 samples per second at most
+    scheduler.OnIterationCompleted(64, 6400us);
+    scheduler.Update(2000);
+
+    ASSERT_EQ(100us, scheduler.GetSampleCost());
+    ASSERT_EQ(50, scheduler.GetThreadsPerIteration());
+    ASSERT_EQ(SamplingScheduler::MaxSamplingPeriod, scheduler.GetSamplingPeriod());
+
+    // the overhead is the budget
+    auto overhead = static_cast<double>(scheduler.GetThreadsPerIteration() * scheduler.GetSampleCost().count()) / scheduler.GetSamplingPeriod().count();
+    ASSERT_NEAR(0.01, overhead, 0.0001);
+}
+
+TEST(SamplingSchedulerTest, CheckPeriodIsNeverShorterThanTheMinimum)
+{
+    SamplingScheduler scheduler(0.01, 5);
+    scheduler.OnIterationCompleted(5, 5us);
+    scheduler.Update(1000);
+
+    ASSERT_EQ(5, scheduler.GetThreadsPerIteration());
+    ASSERT_EQ(SamplingScheduler::MinSamplingPeriod, scheduler.GetSamplingPeriod());
+}
+
+TEST(SamplingSchedulerTest, CheckSampleCostIsSmoothed)
+{
+    SamplingScheduler scheduler(0.01, 64);
+    scheduler.OnIterationCompleted(1, 100us);
+    ASSERT_EQ(100us, scheduler.GetSampleCost());
+
+    // a single slow iteration does not change the cost that much
+    scheduler.OnIterationCompleted(1, 900us);
+    ASSERT_EQ(200us, scheduler.GetSampleCost());
+
+    // iterations without sample are ignored
+    scheduler.OnIterationCompleted(0, 1000us);
+    ASSERT_EQ(200us, scheduler.GetSampleCost());
+}
+
+TEST(SamplingSchedulerTest, CheckNothingIsSampledWithoutThread)
+{
+    SamplingScheduler scheduler(0.01, 64);
+    scheduler.Update(0);
+
+    ASSERT_EQ(0, scheduler.GetThreadsPerIteration());
+    ASSERT_EQ(SamplingScheduler::TargetThreadSamplingPeriod, scheduler.GetSamplingPeriod());
+}
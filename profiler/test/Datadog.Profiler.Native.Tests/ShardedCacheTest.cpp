@@ -0,0 +1,94 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include "gtest/gtest.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ShardedCache.h"
+
+
+TEST(ShardedCacheTest, CheckHitsAndMissesAreCounted)
+{
+    ShardedCache<uintptr_t, std::string> cache;
+
+    std::string value;
+    ASSERT_FALSE(cache.TryGet(0x1000, value));
+    ASSERT_EQ(1, cache.GetMissCount());
+    ASSERT_EQ(0, cache.GetHitCount());
+
+    cache.Set(0x1000, "first");
+    ASSERT_TRUE(cache.TryGet(0x1000, value));
+    ASSERT_EQ("first", value);
+    ASSERT_EQ(1, cache.GetHitCount());
+
+    // the value is replaced
+    cache.Set(0x1000, "second");
+    ASSERT_TRUE(cache.TryGet(0x1000, value));
+    ASSERT_EQ("second", value);
+    ASSERT_EQ(2, cache.GetHitCount());
+    ASSERT_EQ(1, cache.GetMissCount());
+    ASSERT_EQ(1, cache.Size());
+}
+
+TEST(ShardedCacheTest, CheckEntriesAreRemoved)
+{
+    ShardedCache<uintptr_t, uintptr_t> cache;
+
+    // addresses are aligned: make sure that they all end up in the cache whatever their shard
+    for (uintptr_t i = 1; i <= 100; i++)
+    {
+        cache.Set(i * 64, i % 2);
+    }
+    ASSERT_EQ(100, cache.Size());
+
+    ASSERT_TRUE(cache.Remove(64));
+    ASSERT_FALSE(cache.Remove(64));
+    ASSERT_EQ(99, cache.Size());
+
+    // remove all "odd" entries (i.e. the ones with 1 as value)
+    auto removedCount = cache.RemoveIf([](uintptr_t, uintptr_t value) { return value == 1; });
+    ASSERT_EQ(49, removedCount);
+    ASSERT_EQ(50, cache.Size());
+
+    uintptr_t value;
+    ASSERT_FALSE(cache.TryGet(3 * 64, value));
+    ASSERT_TRUE(cache.TryGet(4 * 64, value));
+    ASSERT_EQ(0, value);
+}
+
+TEST(ShardedCacheTest, CheckConcurrentReadersAndWriters)
+{
+    const uintptr_t keysCount = 10000;
+    const size_t threadsCount = 4;
+    ShardedCache<uintptr_t, uintptr_t> cache;
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadsCount; t++)
+    {
+        threads.emplace_back([&cache, keysCount]() {
+            for (uintptr_t key = 0; key < keysCount; key++)
+            {
+                uintptr_t value;
+                if (!cache.TryGet(key, value))
+                {
+                    cache.Set(key, key * 2);
+                }
+                else
+                {
+                    ASSERT_EQ(key * 2, value);
+                }
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    ASSERT_EQ(keysCount, cache.Size());
+    ASSERT_EQ(keysCount * threadsCount, cache.GetHitCount() + cache.GetMissCount());
+}
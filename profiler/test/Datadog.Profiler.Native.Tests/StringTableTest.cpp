@@ -0,0 +1,94 @@
+// Unless explicitly stated otherwise all files in this repository are licensed under the Apache 2 License.
+// This product includes software developed at Datadog (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+#include "gtest/gtest.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Sample.h"
+#include "StringTable.h"
+
+
+TEST(StringTableTest, CheckSameStringGetsSameId)
+{
+    StringTable table;
+
+    auto id1 = table.Intern("module");
+    auto id2 = table.Intern(std::string("mod") + "ule");
+    auto id3 = table.Intern("frame");
+
+    ASSERT_EQ(id1, id2);
+    ASSERT_NE(id1, id3);
+    ASSERT_EQ("module", table.Get(id1));
+    ASSERT_EQ("frame", table.Get(id3));
+}
+
+TEST(StringTableTest, CheckEmptyAndUnknownIds)
+{
+    StringTable table;
+
+    ASSERT_EQ(StringTable::EmptyStringId, table.Intern(""));
+    ASSERT_EQ("", table.Get(StringTable::EmptyStringId));
+    ASSERT_EQ("", table.Get(12345));
+}
+
+TEST(StringTableTest, CheckViewsAreStableWhenGrowing)
+{
+    StringTable table;
+
+    auto id = table.Intern("first");
+    auto view = table.Get(id);
+
+    // force the allocation of several chunks
+    for (int i = 0; i < 10000; i++)
+    {
+        table.Intern("string #" + std::to_string(i));
+    }
+
+    ASSERT_EQ(10002, table.Size());
+    ASSERT_EQ(view.data(), table.Get(id).data());
+    ASSERT_EQ("first", view);
+    ASSERT_EQ("string #9999", table.Get(table.Intern("string #9999")));
+}
+
+TEST(StringTableTest, CheckConcurrentInterning)
+{
+    StringTable table;
+
+    auto intern = [&table]() {
+        for (int i = 0; i < 1000; i++)
+        {
+            auto text = "shared #" + std::to_string(i);
+            ASSERT_EQ(text, table.Get(table.Intern(text)));
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++)
+    {
+        threads.emplace_back(intern);
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    // the empty string + 1000 shared strings
+    ASSERT_EQ(1001, table.Size());
+}
+
+TEST(StringTableTest, CheckSampleFramesAreInterned)
+{
+    Sample sample{"MyRid"};
+    sample.AddFrame("module", "frame #1");
+    sample.AddFrame("module", "frame #2");
+
+    auto const& callstack = sample.GetCallstack();
+    ASSERT_EQ(2, callstack.size());
+    ASSERT_EQ(callstack[0].ModuleName, callstack[1].ModuleName);
+    ASSERT_NE(callstack[0].Frame, callstack[1].Frame);
+    ASSERT_EQ("module", callstack[0].GetModuleName());
+    ASSERT_EQ("frame #2", callstack[1].GetFrame());
+}
@@ -0,0 +1,91 @@
+#include "assembly_name_matcher.h"
+
+#include <algorithm>
+
+namespace trace
+{
+
+AssemblyNameMatcher::AssemblyNameMatcher() : prefixes_trie_(1)
+{
+}
+
+AssemblyNameMatcher::AssemblyNameMatcher(const std::vector<shared::WSTRING>& exact_names,
+                                         const std::vector<shared::WSTRING>& prefixes) :
+    exact_names_(exact_names.begin(), exact_names.end()), prefixes_trie_(1)
+{
+    for (const auto& prefix : prefixes)
+    {
+        AddPrefix(prefix);
+    }
+}
+
+void AssemblyNameMatcher::AddPrefix(const shared::WSTRING& prefix)
+{
+    std::uint32_t node = 0;
+    for (const auto c : prefix)
+    {
+        auto& children = prefixes_trie_[node].children;
+        auto child = std::lower_bound(children.begin(), children.end(), c,
+                                      [](const std::pair<WCHAR, std::uint32_t>& item, WCHAR value) {
+                                          return item.first < value;
+                                      });
+
+        if (child != children.end() && child->first == c)
+        {
+            node = child->second;
+            continue;
+        }
+
+        // the reference to the children is invalidated when a node is added
+        const auto new_node = static_cast<std::uint32_t>(prefixes_trie_.size());
+        children.insert(child, std::make_pair(c, new_node));
+        prefixes_trie_.emplace_back();
+        node = new_node;
+    }
+
+    prefixes_trie_[node].is_prefix_end = true;
+}
+
+bool AssemblyNameMatcher::MatchesPrefix(const shared::WSTRING& name) const
+{
+    std::uint32_t node = 0;
+    for (const auto c : name)
+    {
+        if (prefixes_trie_[node].is_prefix_end)
+        {
+            return true;
+        }
+
+        const auto& children = prefixes_trie_[node].children;
+        auto child = std::lower_bound(children.begin(), children.end(), c,
+                                      [](const std::pair<WCHAR, std::uint32_t>& item, WCHAR value) {
+                                          return item.first < value;
+                                      });
+
+        if (child == children.end() || child->first != c)
+        {
+            return false;
+        }
+
+        node = child->second;
+    }
+
+    return prefixes_trie_[node].is_prefix_end;
+}
+
+AssemblyNameMatch AssemblyNameMatcher::Match(const shared::WSTRING& name) const
+{
+    if (exact_names_.find(name) != exact_names_.end())
+    {
+        return AssemblyNameMatch::ExactName;
+    }
+
+    if (MatchesPrefix(name))
+    {
+        return AssemblyNameMatch::Prefix;
+    }
+
+    return AssemblyNameMatch::None;
+}
+
+} // namespace trace
@@ -0,0 +1,52 @@
+#ifndef DD_CLR_PROFILER_ASSEMBLY_NAME_MATCHER_H_
+#define DD_CLR_PROFILER_ASSEMBLY_NAME_MATCHER_H_
+
+#include <cstdint>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "../../../shared/src/native-src/string.h"
+
+namespace trace
+{
+
+enum class AssemblyNameMatch
+{
+    None,
+    ExactName,
+    Prefix
+};
+
+/// <summary>
+/// Matches assembly names against a list of exact names (hash set) and a list of prefixes (trie).
+/// The matcher is built once and never modified: a name is classified in O(name length)
+/// without taking any lock.
+/// </summary>
+class AssemblyNameMatcher
+{
+private:
+    struct TrieNode
+    {
+        // sorted by character; the fanout is small so a vector is more compact than a map
+        std::vector<std::pair<WCHAR, std::uint32_t>> children;
+        bool is_prefix_end = false;
+    };
+
+    std::unordered_set<shared::WSTRING> exact_names_;
+    std::vector<TrieNode> prefixes_trie_;
+
+    void AddPrefix(const shared::WSTRING& prefix);
+    bool MatchesPrefix(const shared::WSTRING& name) const;
+
+public:
+    AssemblyNameMatcher();
+    AssemblyNameMatcher(const std::vector<shared::WSTRING>& exact_names, const std::vector<shared::WSTRING>& prefixes);
+
+    // an exact name takes precedence over a prefix
+    AssemblyNameMatch Match(const shared::WSTRING& name) const;
+};
+
+} // namespace trace
+
+#endif // DD_CLR_PROFILER_ASSEMBLY_NAME_MATCHER_H_
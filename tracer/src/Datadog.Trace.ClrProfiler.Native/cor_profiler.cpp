@@ -158,6 +158,12 @@ HRESULT STDMETHODCALLTYPE CorProfiler::Initialize(IUnknown* cor_profiler_info_un
 
     trace_annotations_enabled = IsTraceAnnotationEnabled();
 
+    skip_assemblies_matcher_ = AssemblyNameMatcher(
+        {std::begin(skip_assemblies), std::end(skip_assemblies)},
+        {std::begin(skip_assembly_prefixes), std::end(skip_assembly_prefixes)});
+    skip_traceattribute_assemblies_matcher_ = AssemblyNameMatcher(
+        {}, {std::begin(skip_traceattribute_assembly_prefixes), std::end(skip_traceattribute_assembly_prefixes)});
+
     // get ICorProfilerInfo10 for >= .NET Core 3.0
     ICorProfilerInfo10* info10 = nullptr;
     hr = cor_profiler_info_unknown->QueryInterface(__uuidof(ICorProfilerInfo10), (void**) &info10);
@@ -175,6 +181,7 @@ HRESULT STDMETHODCALLTYPE CorProfiler::Initialize(IUnknown* cor_profiler_info_un
 
     rejit_handler = info10 != nullptr ? std::make_shared<RejitHandler>(info10, work_offloader)
                                       : std::make_shared<RejitHandler>(this->info_, work_offloader);
+    rejit_handler->SetModuleRegistry(&module_registry_);
     tracer_integration_preprocessor = std::make_unique<TracerRejitPreprocessor>(rejit_handler, work_offloader);
 
     DWORD event_mask = COR_PRF_MONITOR_JIT_COMPILATION | COR_PRF_DISABLE_TRANSPARENCY_CHECKS_UNDER_FULL_TRUST |
@@ -459,6 +466,14 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ModuleLoadFinished(ModuleID module_id, HR
         return S_OK;
     }
 
+    // The module is classified from its name before taking the lock:
+    // other modules being loaded at the same time don't wait for it
+    const auto& module_info = GetModuleInfo(this->info_, module_id);
+    const auto skip_assembly_match =
+        module_info.IsValid() ? skip_assemblies_matcher_.Match(module_info.assembly.name) : AssemblyNameMatch::None;
+    const auto skip_traceattribute_search =
+        module_info.IsValid() && skip_traceattribute_assemblies_matcher_.Match(module_info.assembly.name) != AssemblyNameMatch::None;
+
     // keep this lock until we are done using the module,
     // to prevent it from unloading while in use
     std::lock_guard<std::mutex> guard(module_ids_lock_);
@@ -469,7 +484,7 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ModuleLoadFinished(ModuleID module_id, HR
         return S_OK;
     }
 
-    auto hr = TryRejitModule(module_id);
+    auto hr = TryRejitModule(module_id, module_info, skip_assembly_match, skip_traceattribute_search);
 
     // Push integration definitions from past modules that were unable to be added
     auto rejit_size = rejit_module_method_pairs.size();
@@ -500,7 +515,9 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ModuleLoadFinished(ModuleID module_id, HR
         // We call the function to analyze the module and request the ReJIT of integrations defined in this module.
         if (tracer_integration_preprocessor != nullptr && !integration_definitions_.empty())
         {
-            const auto numReJITs = tracer_integration_preprocessor->RequestRejitForLoadedModules(rejitModuleIds, integration_definitions_);
+            tracer_integration_preprocessor->UpdateDefinitionsIndex(integration_definitions_, integration_definitions_index_);
+            const auto numReJITs = tracer_integration_preprocessor->RequestRejitForLoadedModules(
+                rejitModuleIds, integration_definitions_, integration_definitions_index_);
             Logger::Debug("Total number of ReJIT Requested: ", numReJITs);
         }
     }
@@ -508,9 +525,9 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ModuleLoadFinished(ModuleID module_id, HR
     return hr;
 }
 
-HRESULT CorProfiler::TryRejitModule(ModuleID module_id)
+HRESULT CorProfiler::TryRejitModule(ModuleID module_id, const ModuleInfo& module_info,
+                                    AssemblyNameMatch skip_assembly_match, bool skip_traceattribute_search)
 {
-    const auto& module_info = GetModuleInfo(this->info_, module_id);
     if (!module_info.IsValid())
     {
         return S_OK;
@@ -609,22 +626,16 @@ HRESULT CorProfiler::TryRejitModule(ModuleID module_id)
         return S_OK;
     }
 
-    for (auto&& skip_assembly : skip_assemblies)
+    if (skip_assembly_match == AssemblyNameMatch::ExactName)
     {
-        if (module_info.assembly.name == skip_assembly)
-        {
-            Logger::Debug("ModuleLoadFinished skipping known module: ", module_id, " ", module_info.assembly.name);
-            return S_OK;
-        }
+        Logger::Debug("ModuleLoadFinished skipping known module: ", module_id, " ", module_info.assembly.name);
+        return S_OK;
     }
 
-    for (auto&& skip_assembly_pattern : skip_assembly_prefixes)
+    if (skip_assembly_match == AssemblyNameMatch::Prefix)
     {
-        if (module_info.assembly.name.rfind(skip_assembly_pattern, 0) == 0)
-        {
-            Logger::Debug("ModuleLoadFinished skipping module by pattern: ", module_id, " ", module_info.assembly.name);
-            return S_OK;
-        }
+        Logger::Debug("ModuleLoadFinished skipping module by pattern: ", module_id, " ", module_info.assembly.name);
+        return S_OK;
     }
 
     if (module_info.assembly.name == managed_profiler_name)
@@ -687,21 +698,14 @@ HRESULT CorProfiler::TryRejitModule(ModuleID module_id)
     }
     else
     {
-        module_ids_.push_back(module_id);
+        const auto module = module_registry_.Add(module_info);
 
         bool searchForTraceAttribute = trace_annotations_enabled;
-        if (searchForTraceAttribute)
+        if (searchForTraceAttribute && skip_traceattribute_search)
         {
-            for (auto&& skip_assembly_pattern : skip_traceattribute_assembly_prefixes)
-            {
-                if (module_info.assembly.name.rfind(skip_assembly_pattern, 0) == 0)
-                {
-                    Logger::Debug("ModuleLoadFinished skipping [Trace] search for module by pattern: ", module_id, " ",
-                                  module_info.assembly.name);
-                    searchForTraceAttribute = false;
-                    break;
-                }
-            }
+            Logger::Debug("ModuleLoadFinished skipping [Trace] search for module by pattern: ", module_id, " ",
+                          module_info.assembly.name);
+            searchForTraceAttribute = false;
         }
 
         // Scan module for [Trace] methods
@@ -711,20 +715,20 @@ HRESULT CorProfiler::TryRejitModule(ModuleID module_id)
             mdTypeRef typeRef = mdTypeRefNil;
             bool foundType = false;
 
-            ComPtr<IUnknown> metadata_interfaces;
-            auto hr = this->info_->GetModuleMetaData(module_id, ofRead | ofWrite, IID_IMetaDataImport2,
-                                                     metadata_interfaces.GetAddressOf());
-
-            if (FAILED(hr))
+            // the metadata is cached in the registry for the ReJIT and the JIT callbacks
+            const auto module_metadata = module->GetOrCreateMetadata(this->info_, &corAssemblyProperty,
+                                                                     enable_by_ref_instrumentation,
+                                                                     enable_calltarget_state_by_ref);
+            if (module_metadata == nullptr)
             {
                 Logger::Warn("ModuleLoadFinished failed to get metadata interface for ", module_id, " ",
                                 module_info.assembly.name);
                 return S_OK;
             }
 
-            const auto& metadata_import = metadata_interfaces.As<IMetaDataImport2>(IID_IMetaDataImport);
+            const auto& metadata_import = module_metadata->metadata_import;
 
-            hr = metadata_import->FindTypeDefByName(traceAttribute_typename_cstring, mdTypeDefNil, &typeDef);
+            auto hr = metadata_import->FindTypeDefByName(traceAttribute_typename_cstring, mdTypeDefNil, &typeDef);
             if (SUCCEEDED(hr))
             {
                 foundType = true;
@@ -917,7 +921,9 @@ HRESULT CorProfiler::TryRejitModule(ModuleID module_id)
         // We call the function to analyze the module and request the ReJIT of integrations defined in this module.
         if (tracer_integration_preprocessor != nullptr && !integration_definitions_.empty())
         {
-            const auto numReJITs = tracer_integration_preprocessor->RequestRejitForLoadedModules(std::vector<ModuleID>{module_id}, integration_definitions_);
+            tracer_integration_preprocessor->UpdateDefinitionsIndex(integration_definitions_, integration_definitions_index_);
+            const auto numReJITs = tracer_integration_preprocessor->RequestRejitForLoadedModules(
+                std::vector<ModuleID>{module_id}, integration_definitions_, integration_definitions_index_);
             Logger::Debug("Total number of ReJIT Requested: ", numReJITs);
         }
     }
@@ -949,6 +955,9 @@ HRESULT STDMETHODCALLTYPE CorProfiler::ModuleUnloadStarted(ModuleID module_id)
         rejit_handler->RemoveModule(module_id);
     }
 
+    // the ModuleID can be reused by a module loaded later
+    module_registry_.Remove(module_id);
+
     const auto& moduleInfo = GetModuleInfo(this->info_, module_id);
     if (!moduleInfo.IsValid())
     {
@@ -993,7 +1002,7 @@ HRESULT STDMETHODCALLTYPE CorProfiler::Shutdown()
         rejit_handler = nullptr;
     }
     Logger::Info("Exiting...");
-    Logger::Debug("   ModuleIds: ", module_ids_.size());
+    Logger::Debug("   ModuleIds: ", module_registry_.Size());
     Logger::Debug("   IntegrationDefinitions: ", integration_definitions_.size());
     Logger::Debug("   DefinitionsIds: ", definitions_ids_.size());
     Logger::Debug("   ManagedProfilerLoadedAppDomains: ", managed_profiler_loaded_app_domains.size());
@@ -1036,16 +1045,6 @@ HRESULT STDMETHODCALLTYPE CorProfiler::JITCompilationStarted(FunctionID function
         return S_OK;
     }
 
-    // keep this lock until we are done using the module,
-    // to prevent it from unloading while in use
-    std::lock_guard<std::mutex> guard(module_ids_lock_);
-
-    // double check if is_attached_ has changed to avoid possible race condition with shutdown function
-    if (!is_attached_)
-    {
-        return S_OK;
-    }
-
     ModuleID module_id;
     mdToken function_token = mdTokenNil;
 
@@ -1056,14 +1055,27 @@ HRESULT STDMETHODCALLTYPE CorProfiler::JITCompilationStarted(FunctionID function
         return S_OK;
     }
 
-    // we have to check if the Id is in the module_ids_ vector.
+    // we have to check if the Id is in the module registry.
     // In case is True we create a local ModuleMetadata to inject the loader.
-    if (!shared::Contains(module_ids_, module_id))
+    // Most of the methods are either in skipped modules or in AppDomains where the loader is already
+    // injected: this is checked without locking so the parallel JIT threads do not serialize.
+    const auto module = module_registry_.Find(module_id);
+    if (module == nullptr || module->loader_injected.load())
     {
         return S_OK;
     }
 
-    const auto& module_info = GetModuleInfo(this->info_, module_id);
+    // keep this lock until we are done using the module,
+    // to prevent it from unloading while in use
+    std::lock_guard<std::mutex> guard(module_ids_lock_);
+
+    // double check if is_attached_ has changed to avoid possible race condition with shutdown function
+    if (!is_attached_)
+    {
+        return S_OK;
+    }
+
+    const auto& module_info = module->info;
 
     bool has_loader_injected_in_appdomain =
         first_jit_compilation_app_domains.find(module_info.assembly.app_domain_id) !=
@@ -1072,25 +1084,17 @@ HRESULT STDMETHODCALLTYPE CorProfiler::JITCompilationStarted(FunctionID function
     if (has_loader_injected_in_appdomain)
     {
         // Loader was already injected in a calltarget scenario, we don't need to do anything else here
+        module->loader_injected.store(true);
         return S_OK;
     }
 
-    ComPtr<IUnknown> metadataInterfaces;
-    hr = this->info_->GetModuleMetaData(module_id, ofRead | ofWrite, IID_IMetaDataImport2,
-                                        metadataInterfaces.GetAddressOf());
-
-    const auto& metadataImport = metadataInterfaces.As<IMetaDataImport2>(IID_IMetaDataImport);
-    const auto& metadataEmit = metadataInterfaces.As<IMetaDataEmit2>(IID_IMetaDataEmit);
-    const auto& assemblyImport = metadataInterfaces.As<IMetaDataAssemblyImport>(IID_IMetaDataAssemblyImport);
-    const auto& assemblyEmit = metadataInterfaces.As<IMetaDataAssemblyEmit>(IID_IMetaDataAssemblyEmit);
-
-    Logger::Debug("Temporaly allocating the ModuleMetadata for injection. ModuleId=", module_id,
-                  " ModuleName=", module_info.assembly.name);
-
-    std::unique_ptr<ModuleMetadata> module_metadata = std::make_unique<ModuleMetadata>(
-        metadataImport, metadataEmit, assemblyImport, assemblyEmit, module_info.assembly.name,
-        module_info.assembly.app_domain_id, &corAssemblyProperty, enable_by_ref_instrumentation,
-        enable_calltarget_state_by_ref);
+    const auto module_metadata = module->GetOrCreateMetadata(this->info_, &corAssemblyProperty,
+                                                             enable_by_ref_instrumentation,
+                                                             enable_calltarget_state_by_ref);
+    if (module_metadata == nullptr)
+    {
+        return S_OK;
+    }
 
     // get function info
     const auto& caller = GetFunctionInfo(module_metadata->metadata_import, function_token);
@@ -1344,12 +1348,13 @@ void CorProfiler::InternalAddInstrumentation(WCHAR* id, CallTargetDefinition* it
 
         definitions_ids_.emplace(definitionsId);
 
-        Logger::Info("Total number of modules to analyze: ", module_ids_.size());
+        const auto& module_ids = module_registry_.GetModuleIds();
+        Logger::Info("Total number of modules to analyze: ", module_ids.size());
         if (rejit_handler != nullptr)
         {
             std::promise<ULONG> promise;
             std::future<ULONG> future = promise.get_future();
-            tracer_integration_preprocessor->EnqueueRequestRejitForLoadedModules(module_ids_, integrationDefinitions, &promise);
+            tracer_integration_preprocessor->EnqueueRequestRejitForLoadedModules(module_ids, integrationDefinitions, &promise);
 
             // wait and get the value from the future<int>
             const auto& numReJITs = future.get();
@@ -1442,12 +1447,13 @@ void CorProfiler::InitializeTraceMethods(WCHAR* id, WCHAR* integration_assembly_
             std::vector<IntegrationDefinition> integrationDefinitions = GetIntegrationsFromTraceMethodsConfiguration(*trace_annotation_integration_type.get(), configuration_string);
             std::scoped_lock<std::mutex> moduleLock(module_ids_lock_);
 
-            Logger::Debug("InitializeTraceMethods: Total number of modules to analyze: ", module_ids_.size());
+            const auto& module_ids = module_registry_.GetModuleIds();
+            Logger::Debug("InitializeTraceMethods: Total number of modules to analyze: ", module_ids.size());
             if (rejit_handler != nullptr)
             {
                 std::promise<ULONG> promise;
                 std::future<ULONG> future = promise.get_future();
-                tracer_integration_preprocessor->EnqueueRequestRejitForLoadedModules(module_ids_, integrationDefinitions,
+                tracer_integration_preprocessor->EnqueueRequestRejitForLoadedModules(module_ids, integrationDefinitions,
                                                                                     &promise);
 
                 // wait and get the value from the future<int>
@@ -1501,24 +1507,19 @@ HRESULT STDMETHODCALLTYPE CorProfiler::GetAssemblyReferences(const WCHAR* wszAss
     // Skip known framework assemblies that we will not instrument and,
     // as a result, will not need an assembly reference to the
     // managed profiler
-    for (auto&& skip_assembly_pattern : skip_assembly_prefixes)
+    const auto skip_assembly_match = skip_assemblies_matcher_.Match(assembly_name);
+    if (skip_assembly_match == AssemblyNameMatch::Prefix)
     {
-        if (assembly_name.rfind(skip_assembly_pattern, 0) == 0)
-        {
-            Logger::Debug("GetAssemblyReferences skipping module by pattern: Name=", assembly_name,
-                          " Path=", wszAssemblyPath);
-            return S_OK;
-        }
+        Logger::Debug("GetAssemblyReferences skipping module by pattern: Name=", assembly_name,
+                      " Path=", wszAssemblyPath);
+        return S_OK;
     }
 
-    for (auto&& skip_assembly : skip_assemblies)
+    if (skip_assembly_match == AssemblyNameMatch::ExactName)
     {
-        if (assembly_name == skip_assembly)
-        {
-            Logger::Debug("GetAssemblyReferences skipping known assembly: Name=", assembly_name,
-                          " Path=", wszAssemblyPath);
-            return S_OK;
-        }
+        Logger::Debug("GetAssemblyReferences skipping known assembly: Name=", assembly_name,
+                      " Path=", wszAssemblyPath);
+        return S_OK;
     }
 
     // Construct an ASSEMBLYMETADATA structure for the managed profiler that can
@@ -2995,7 +2996,8 @@ HRESULT STDMETHODCALLTYPE CorProfiler::JITCachedFunctionSearchStarted(FunctionID
     }
 
     // Verify that we have the metadata for this module
-    if (!shared::Contains(module_ids_, module_id))
+    const auto module = module_registry_.Find(module_id);
+    if (module == nullptr)
     {
         // we haven't stored a ModuleMetadata for this module,
         // so there's nothing to do here, we accept the NGEN image.
@@ -3003,11 +3005,10 @@ HRESULT STDMETHODCALLTYPE CorProfiler::JITCachedFunctionSearchStarted(FunctionID
         return S_OK;
     }
 
-    const auto& module_info = GetModuleInfo(this->info_, module_id);
-    const auto& appDomainId = module_info.assembly.app_domain_id;
-
     const bool has_loader_injected_in_appdomain =
-        first_jit_compilation_app_domains.find(appDomainId) != first_jit_compilation_app_domains.end();
+        module->loader_injected.load() ||
+        first_jit_compilation_app_domains.find(module->info.assembly.app_domain_id) !=
+            first_jit_compilation_app_domains.end();
 
     if (!has_loader_injected_in_appdomain)
     {
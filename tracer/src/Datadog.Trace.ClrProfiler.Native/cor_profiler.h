@@ -16,6 +16,8 @@
 #include "rejit_preprocessor.h"
 #include "debugger_rejit_preprocessor.h"
 #include "rejit_handler.h"
+#include "assembly_name_matcher.h"
+#include "module_registry.h"
 #include <unordered_set>
 #include "clr_helpers.h"
 #include "debugger_probes_instrumentation_requester.h"
@@ -37,6 +39,8 @@ private:
     std::atomic_bool is_attached_ = {false};
     RuntimeInformation runtime_information_;
     std::vector<IntegrationDefinition> integration_definitions_;
+    // integration_definitions_ is only appended to: its index is updated before each ReJIT request
+    RejitDefinitionsIndex integration_definitions_index_;
     std::deque<std::pair<ModuleID, std::vector<MethodReference>>> rejit_module_method_pairs;
 
     std::unordered_set<shared::WSTRING> definitions_ids_;
@@ -74,8 +78,14 @@ private:
     //
     // Module helper variables
     //
+    // serializes the module load/unload callbacks with the ReJIT requests and protects the AppDomain sets;
+    // the JIT callbacks only take it when the module could need the loader
     std::mutex module_ids_lock_;
-    std::vector<ModuleID> module_ids_;
+    ModuleRegistry module_registry_;
+
+    // built once in Initialize from the skip lists, used without holding module_ids_lock_
+    AssemblyNameMatcher skip_assemblies_matcher_;
+    AssemblyNameMatcher skip_traceattribute_assemblies_matcher_;
 
     //
     // Helper methods
@@ -87,7 +97,8 @@ private:
     std::string GetILCodes(const std::string& title, ILRewriter* rewriter, const FunctionInfo& caller,
                            const ComPtr<IMetaDataImport2>& metadata_import);
     HRESULT RewriteForDistributedTracing(const ModuleMetadata& module_metadata, ModuleID module_id);
-    HRESULT TryRejitModule(ModuleID module_id);
+    HRESULT TryRejitModule(ModuleID module_id, const ModuleInfo& module_info, AssemblyNameMatch skip_assembly_match,
+                           bool skip_traceattribute_search);
     bool TypeNameMatchesTraceAttribute(WCHAR type_name[], DWORD type_name_len);
     //
     // Startup methods
@@ -62,12 +62,12 @@ void DebuggerProbesInstrumentationRequester::InstrumentProbes(WCHAR* id, Debugge
 
         std::scoped_lock<std::mutex> moduleLock(corProfiler->module_ids_lock_);
 
-        Logger::Info("Total number of modules to analyze: ", corProfiler->module_ids_.size());
+        const auto& module_ids = corProfiler->module_registry_.GetModuleIds();
+        Logger::Info("Total number of modules to analyze: ", module_ids.size());
 
         std::promise<ULONG> promise;
         std::future<ULONG> future = promise.get_future();
-        debugger_rejit_preprocessor->EnqueueRequestRejitForLoadedModules(corProfiler->module_ids_,
-                                                                          methodProbeDefinitions, &promise);
+        debugger_rejit_preprocessor->EnqueueRequestRejitForLoadedModules(module_ids, methodProbeDefinitions, &promise);
 
         // wait and get the value from the future<int>
         const auto& numReJITs = future.get();
@@ -94,7 +94,8 @@ HRESULT TracerMethodRewriter::Rewrite(RejitHandlerModule* moduleHandler, RejitHa
     ModuleID module_id = moduleHandler->GetModuleId();
     ModuleMetadata& module_metadata = *moduleHandler->GetModuleMetadata();
     FunctionInfo* caller = methodHandler->GetFunctionInfo();
-    TracerTokens* tracerTokens = module_metadata.GetTracerTokens();
+    TracerTokens* tracerTokens = module_metadata.GetTracerTokens(corProfiler->enable_by_ref_instrumentation,
+                                                                 corProfiler->enable_calltarget_state_by_ref);
     mdToken function_token = caller->id;
     TypeSignature retFuncArg = caller->method_signature.GetReturnValue();
     IntegrationDefinition* integration_definition = tracerMethodHandler->GetIntegrationDefinition();
@@ -19,9 +19,10 @@ namespace trace
 class ModuleMetadata
 {
 private:
-    std::mutex wrapper_mutex;
+    mutable std::mutex wrapper_mutex;
     std::unique_ptr<std::unordered_map<shared::WSTRING, mdTypeRef>> integration_types = nullptr;
-    std::unique_ptr<TracerTokens> tracerTokens = nullptr;
+    // one set of tokens per combination of the by ref options (see GetTracerTokens)
+    std::unique_ptr<TracerTokens> tracerTokens[4];
     std::unique_ptr<std::vector<IntegrationDefinition>> integrations = nullptr;
 
 public:
@@ -76,6 +77,7 @@ public:
 
     bool TryGetIntegrationTypeRef(const shared::WSTRING& keyIn, mdTypeRef& valueOut) const
     {
+        std::scoped_lock<std::mutex> lock(wrapper_mutex);
         if (integration_types == nullptr)
         {
             return false;
@@ -105,11 +107,21 @@ public:
 
     TracerTokens* GetTracerTokens()
     {
-        if (tracerTokens == nullptr)
+        return GetTracerTokens(enable_by_ref_instrumentation, enable_calltarget_state_by_ref);
+    }
+
+    TracerTokens* GetTracerTokens(const bool enableByRefInstrumentation, const bool enableCallTargetStateByRef)
+    {
+        // the metadata of a module is shared by the JIT callbacks and the ReJIT thread.
+        // The by ref options are enabled by the managed side after the first modules are loaded:
+        // the tokens depend on them, so one set is kept per combination in the single metadata of the module
+        std::scoped_lock<std::mutex> lock(wrapper_mutex);
+        auto& tokens = tracerTokens[(enableByRefInstrumentation ? 1 : 0) | (enableCallTargetStateByRef ? 2 : 0)];
+        if (tokens == nullptr)
         {
-            tracerTokens = std::make_unique<TracerTokens>(this, enable_by_ref_instrumentation, enable_calltarget_state_by_ref);
+            tokens = std::make_unique<TracerTokens>(this, enableByRefInstrumentation, enableCallTargetStateByRef);
         }
-        return tracerTokens.get();
+        return tokens.get();
     }
 };
 
@@ -0,0 +1,263 @@
+#include "module_registry.h"
+
+#include <cstdint>
+
+#include "logger.h"
+#include "module_metadata.h"
+
+namespace trace
+{
+
+std::shared_ptr<ModuleMetadata> RegisteredModule::GetOrCreateMetadata(ICorProfilerInfo4* profiler_info,
+                                                                       const AssemblyProperty* cor_assembly_property,
+                                                                       bool enable_by_ref_instrumentation,
+                                                                       bool enable_calltarget_state_by_ref)
+{
+    std::lock_guard<std::mutex> guard(metadata_lock_);
+
+    if (removed.load())
+    {
+        return nullptr;
+    }
+
+    if (metadata_ != nullptr)
+    {
+        // the by ref options may have been enabled since the metadata was created:
+        // the tokens depending on them are kept per option in the same metadata
+        return metadata_;
+    }
+
+    ComPtr<IUnknown> metadata_interfaces;
+    auto hr = profiler_info->GetModuleMetaData(id, ofRead | ofWrite, IID_IMetaDataImport2, metadata_interfaces.GetAddressOf());
+    if (FAILED(hr))
+    {
+        Logger::Warn("Failed to get metadata interface for ", id, " ", info.assembly.name);
+        return nullptr;
+    }
+
+    const auto& metadata_import = metadata_interfaces.As<IMetaDataImport2>(IID_IMetaDataImport);
+    const auto& metadata_emit = metadata_interfaces.As<IMetaDataEmit2>(IID_IMetaDataEmit);
+    const auto& assembly_import = metadata_interfaces.As<IMetaDataAssemblyImport>(IID_IMetaDataAssemblyImport);
+    const auto& assembly_emit = metadata_interfaces.As<IMetaDataAssemblyEmit>(IID_IMetaDataAssemblyEmit);
+
+    Logger::Debug("Caching the ModuleMetadata of ", id, " ", info.assembly.name);
+
+    metadata_ = std::make_shared<ModuleMetadata>(metadata_import, metadata_emit, assembly_import, assembly_emit,
+                                                 info.assembly.name, info.assembly.app_domain_id,
+                                                 cor_assembly_property, enable_by_ref_instrumentation,
+                                                 enable_calltarget_state_by_ref);
+    return metadata_;
+}
+
+void RegisteredModule::ReleaseMetadata()
+{
+    std::lock_guard<std::mutex> guard(metadata_lock_);
+    metadata_ = nullptr;
+}
+
+ModuleRegistry::Table::Table(size_t capacity) :
+    mask(capacity - 1), slots(new std::atomic<RegisteredModule*>[capacity])
+{
+    for (size_t i = 0; i < capacity; i++)
+    {
+        slots[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+ModuleRegistry::ModuleRegistry()
+{
+    for (auto& shard : shards_)
+    {
+        shard.tables.push_back(std::make_unique<Table>(InitialShardCapacity));
+        shard.table.store(shard.tables.back().get(), std::memory_order_release);
+    }
+}
+
+size_t ModuleRegistry::Hash(ModuleID module_id)
+{
+    // ModuleIDs are addresses: the low bits are always the same because of the alignment,
+    // a multiplicative (Fibonacci) hash spreads them over the high bits
+    return static_cast<size_t>((static_cast<std::uint64_t>(module_id) * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+void ModuleRegistry::Insert(Table* table, size_t hash, RegisteredModule* module)
+{
+    auto index = (hash / ShardsCount) & table->mask;
+    while (table->slots[index].load(std::memory_order_relaxed) != nullptr)
+    {
+        index = (index + 1) & table->mask;
+    }
+
+    table->slots[index].store(module, std::memory_order_release);
+}
+
+void ModuleRegistry::Grow(Shard& shard)
+{
+    const auto table = shard.table.load(std::memory_order_relaxed);
+    const auto capacity = table->mask + 1;
+
+    // the table is full of removed modules when collectible assemblies are loaded and unloaded:
+    // it is only rehashed, without them, instead of doubling its capacity
+    const auto live_modules = shard.count.load(std::memory_order_relaxed);
+    auto new_table = std::make_unique<Table>((live_modules + 1) * 4 > capacity ? capacity * 2 : capacity);
+
+    // the removed modules are not copied
+    size_t used_slots = 0;
+    for (size_t i = 0; i < capacity; i++)
+    {
+        const auto module = table->slots[i].load(std::memory_order_relaxed);
+        if (module != nullptr && !module->removed.load(std::memory_order_relaxed))
+        {
+            Insert(new_table.get(), Hash(module->id), module);
+            used_slots++;
+        }
+    }
+
+    // the previous table is kept for the readers still probing it
+    shard.table.store(new_table.get(), std::memory_order_release);
+    shard.tables.push_back(std::move(new_table));
+    shard.used_slots = used_slots;
+}
+
+RegisteredModule* ModuleRegistry::Add(const ModuleInfo& module_info)
+{
+    const auto module_id = module_info.id;
+    const auto hash = Hash(module_id);
+    auto& shard = shards_[hash % ShardsCount];
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    auto table = shard.table.load(std::memory_order_relaxed);
+    std::atomic<RegisteredModule*>* removed_slot = nullptr;
+    for (auto index = (hash / ShardsCount) & table->mask;; index = (index + 1) & table->mask)
+    {
+        auto& slot = table->slots[index];
+        const auto module = slot.load(std::memory_order_relaxed);
+        if (module == nullptr)
+        {
+            break;
+        }
+
+        if (module->id != module_id)
+        {
+            if (removed_slot == nullptr && module->removed.load(std::memory_order_relaxed))
+            {
+                removed_slot = &slot;
+            }
+
+            continue;
+        }
+
+        if (!module->removed.load(std::memory_order_relaxed))
+        {
+            return module;
+        }
+
+        // the ModuleID of an unloaded module is reused: the entry is replaced in place
+        removed_slot = &slot;
+        break;
+    }
+
+    shard.modules.push_back(std::make_unique<RegisteredModule>(module_info));
+    const auto module = shard.modules.back().get();
+
+    // the slot of a removed module on the probe sequence is reused: the readers probing past it
+    // are not affected since it never becomes empty
+    if (removed_slot != nullptr)
+    {
+        removed_slot->store(module, std::memory_order_release);
+        shard.count.fetch_add(1, std::memory_order_relaxed);
+        return module;
+    }
+
+    // keep the load factor under 1/2 so the probe sequences stay short
+    if ((shard.used_slots + 1) * 2 > table->mask + 1)
+    {
+        Grow(shard);
+        table = shard.table.load(std::memory_order_relaxed);
+    }
+
+    Insert(table, hash, module);
+    shard.used_slots++;
+    shard.count.fetch_add(1, std::memory_order_relaxed);
+    return module;
+}
+
+void ModuleRegistry::Remove(ModuleID module_id)
+{
+    const auto hash = Hash(module_id);
+    auto& shard = shards_[hash % ShardsCount];
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    const auto module = Find(module_id);
+    if (module != nullptr)
+    {
+        module->removed.store(true, std::memory_order_release);
+        module->ReleaseMetadata();
+        shard.count.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+RegisteredModule* ModuleRegistry::Find(ModuleID module_id) const
+{
+    const auto hash = Hash(module_id);
+    const auto table = shards_[hash % ShardsCount].table.load(std::memory_order_acquire);
+
+    for (auto index = (hash / ShardsCount) & table->mask;; index = (index + 1) & table->mask)
+    {
+        const auto module = table->slots[index].load(std::memory_order_acquire);
+        if (module == nullptr)
+        {
+            return nullptr;
+        }
+
+        if (module->id == module_id)
+        {
+            return module->removed.load(std::memory_order_acquire) ? nullptr : module;
+        }
+    }
+}
+
+std::vector<ModuleID> ModuleRegistry::GetModuleIds() const
+{
+    std::vector<ModuleID> module_ids;
+    module_ids.reserve(Size());
+
+    for (const auto& shard : shards_)
+    {
+        const auto table = shard.table.load(std::memory_order_acquire);
+        for (size_t i = 0; i <= table->mask; i++)
+        {
+            const auto module = table->slots[i].load(std::memory_order_acquire);
+            if (module != nullptr && !module->removed.load(std::memory_order_acquire))
+            {
+                module_ids.push_back(module->id);
+            }
+        }
+    }
+
+    return module_ids;
+}
+
+size_t ModuleRegistry::Capacity() const
+{
+    size_t capacity = 0;
+    for (const auto& shard : shards_)
+    {
+        capacity += shard.table.load(std::memory_order_acquire)->mask + 1;
+    }
+
+    return capacity;
+}
+
+size_t ModuleRegistry::Size() const
+{
+    size_t size = 0;
+    for (const auto& shard : shards_)
+    {
+        size += shard.count.load(std::memory_order_relaxed);
+    }
+
+    return size;
+}
+
+} // namespace trace
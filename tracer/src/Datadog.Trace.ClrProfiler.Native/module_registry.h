@@ -0,0 +1,118 @@
+#ifndef DD_CLR_PROFILER_MODULE_REGISTRY_H_
+#define DD_CLR_PROFILER_MODULE_REGISTRY_H_
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "cor.h"
+#include "corprof.h"
+#include "clr_helpers.h"
+
+namespace trace
+{
+
+class ModuleMetadata;
+
+/// <summary>
+/// State of a module that can be instrumented, shared by the module and JIT callbacks
+/// </summary>
+struct RegisteredModule
+{
+    explicit RegisteredModule(const ModuleInfo& module_info) : id(module_info.id), info(module_info)
+    {
+    }
+
+    const ModuleID id;
+    const ModuleInfo info;
+
+    // set once the loader is known to be injected in the AppDomain of the module:
+    // the JIT callbacks can then skip the module without taking any lock
+    std::atomic<bool> loader_injected{false};
+
+    // set when the module is unloaded; the entry itself lives as long as the registry
+    std::atomic<bool> removed{false};
+
+    // Returns the metadata of the module, created on first use: the metadata interfaces are queried
+    // once per module load instead of once per rewrite. It is released when the module is unloaded.
+    // The by ref options only set the default tokens of the metadata created by the first call.
+    // Returns nullptr if the module is unloaded or if its metadata cannot be retrieved.
+    std::shared_ptr<ModuleMetadata> GetOrCreateMetadata(ICorProfilerInfo4* profiler_info,
+                                                        const AssemblyProperty* cor_assembly_property,
+                                                        bool enable_by_ref_instrumentation,
+                                                        bool enable_calltarget_state_by_ref);
+    void ReleaseMetadata();
+
+private:
+    std::mutex metadata_lock_;
+    std::shared_ptr<ModuleMetadata> metadata_;
+};
+
+/// <summary>
+/// Concurrent registry of the loaded modules, keyed by ModuleID.
+/// The modules are spread over shards, each one being an open addressing table.
+/// Lookups never take a lock; adding or removing a module only locks its shard.
+/// The replaced tables and removed entries are kept until the registry is destroyed because a
+/// lock-free reader may still be using them. The slots of the removed modules are reused and a table
+/// full of them is rehashed without doubling its capacity, so the tables stay proportional to the
+/// number of loaded modules. An unloaded module still retains its entry (its metadata is released):
+/// loading and unloading collectible assemblies in a loop grows the registry by a few hundred bytes
+/// per unload.
+/// </summary>
+class ModuleRegistry
+{
+private:
+    static constexpr size_t ShardsCount = 16;
+    static constexpr size_t InitialShardCapacity = 32;
+
+    struct Table
+    {
+        explicit Table(size_t capacity);
+
+        const size_t mask;
+        std::unique_ptr<std::atomic<RegisteredModule*>[]> slots;
+    };
+
+    struct Shard
+    {
+        std::atomic<Table*> table{nullptr};
+        std::atomic<size_t> count{0};
+
+        // the following fields are only used by the writers, under the shard lock
+        std::mutex lock;
+        size_t used_slots = 0;
+        std::vector<std::unique_ptr<Table>> tables;
+        std::vector<std::unique_ptr<RegisteredModule>> modules;
+    };
+
+    std::array<Shard, ShardsCount> shards_;
+
+    static size_t Hash(ModuleID module_id);
+    static void Insert(Table* table, size_t hash, RegisteredModule* module);
+    void Grow(Shard& shard);
+
+public:
+    ModuleRegistry();
+
+    ModuleRegistry(const ModuleRegistry&) = delete;
+    ModuleRegistry& operator=(const ModuleRegistry&) = delete;
+
+    // returns the registered module (the existing one if the module was already registered)
+    RegisteredModule* Add(const ModuleInfo& module_info);
+    void Remove(ModuleID module_id);
+
+    // lock-free: returns nullptr if the module is not registered
+    RegisteredModule* Find(ModuleID module_id) const;
+
+    std::vector<ModuleID> GetModuleIds() const;
+    size_t Size() const;
+
+    // number of slots of the current tables
+    size_t Capacity() const;
+};
+
+} // namespace trace
+
+#endif // DD_CLR_PROFILER_MODULE_REGISTRY_H_
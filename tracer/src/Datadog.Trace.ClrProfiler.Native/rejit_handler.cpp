@@ -176,9 +176,9 @@ ModuleMetadata* RejitHandlerModule::GetModuleMetadata()
     return m_metadata.get();
 }
 
-void RejitHandlerModule::SetModuleMetadata(ModuleMetadata* metadata)
+void RejitHandlerModule::SetModuleMetadata(std::shared_ptr<ModuleMetadata> metadata)
 {
-    m_metadata = std::unique_ptr<ModuleMetadata>(metadata);
+    m_metadata = std::move(metadata);
 }
 
 bool RejitHandlerModule::CreateMethodIfNotExists(const mdMethodDef methodDef,
@@ -333,20 +333,99 @@ RejitHandlerModule* RejitHandler::GetOrAddModule(ModuleID moduleId)
 
 bool RejitHandler::HasModuleAndMethod(ModuleID moduleId, mdMethodDef methodDef)
 {
-    if (IsShutdownRequested())
+    // Called by the JIT for every inlining decision: no lock is taken here, neither the shutdown one
+    if (m_shutdown.load())
     {
         return false;
     }
 
-    std::lock_guard<std::mutex> guard(m_modules_lock);
-    auto find_res = m_modules.find(moduleId);
-    if (find_res != m_modules.end())
+    // the reader is counted before loading the map: a map replaced after that is not freed until it leaves
+    m_rejitTargetsReaders.fetch_add(1);
+
+    bool found = false;
+    const auto rejitTargets = m_rejitTargets.load();
+    if (rejitTargets != nullptr)
     {
-        auto moduleHandler = find_res->second.get();
-        return moduleHandler->ContainsMethod(methodDef);
+        const auto moduleTargets = rejitTargets->find(moduleId);
+        found = moduleTargets != rejitTargets->end() && moduleTargets->second->count(methodDef) != 0;
     }
 
-    return false;
+    m_rejitTargetsReaders.fetch_sub(1);
+    return found;
+}
+
+void RejitHandler::AddRejitTargets(const std::vector<ModuleID>& modulesVector,
+                                   const std::vector<mdMethodDef>& modulesMethodDef)
+{
+    std::lock_guard<std::mutex> guard(m_rejitTargets_lock);
+
+    const auto currentTargets = m_publishedRejitTargets.get();
+
+    // the methods sets of the modules having new targets
+    std::unordered_map<ModuleID, std::unique_ptr<std::unordered_set<mdMethodDef>>> updatedModules;
+    for (size_t i = 0; i < modulesVector.size() && i < modulesMethodDef.size(); i++)
+    {
+        const auto moduleId = modulesVector[i];
+        std::shared_ptr<const std::unordered_set<mdMethodDef>> currentMethods;
+        if (currentTargets != nullptr)
+        {
+            const auto moduleTargets = currentTargets->find(moduleId);
+            if (moduleTargets != currentTargets->end())
+            {
+                currentMethods = moduleTargets->second;
+            }
+        }
+
+        auto& updatedMethods = updatedModules[moduleId];
+        if (updatedMethods == nullptr)
+        {
+            if (currentMethods != nullptr && currentMethods->count(modulesMethodDef[i]) != 0)
+            {
+                updatedModules.erase(moduleId);
+                continue;
+            }
+
+            updatedMethods = currentMethods != nullptr
+                                 ? std::make_unique<std::unordered_set<mdMethodDef>>(*currentMethods)
+                                 : std::make_unique<std::unordered_set<mdMethodDef>>();
+        }
+
+        updatedMethods->insert(modulesMethodDef[i]);
+    }
+
+    // Nothing new: the current map is kept
+    if (updatedModules.empty() && currentTargets != nullptr)
+    {
+        return;
+    }
+
+    auto rejitTargets = currentTargets != nullptr ? std::make_unique<RejitTargetsMap>(*currentTargets)
+                                                  : std::make_unique<RejitTargetsMap>();
+    for (auto& updatedModule : updatedModules)
+    {
+        (*rejitTargets)[updatedModule.first] = std::move(updatedModule.second);
+    }
+
+    PublishRejitTargets(std::move(rejitTargets));
+}
+
+void RejitHandler::PublishRejitTargets(std::unique_ptr<RejitTargetsMap> rejitTargets)
+{
+    // m_rejitTargets_lock must be held by the caller
+    if (m_publishedRejitTargets != nullptr)
+    {
+        m_retiredRejitTargets.push_back(std::move(m_publishedRejitTargets));
+    }
+
+    m_publishedRejitTargets = std::move(rejitTargets);
+    m_rejitTargets.store(m_publishedRejitTargets.get());
+
+    // A reader that is not counted yet will load the map published above:
+    // without any reader in flight, none of the retired maps can still be read
+    if (m_rejitTargetsReaders.load() == 0)
+    {
+        m_retiredRejitTargets.clear();
+    }
 }
 
 void RejitHandler::RemoveModule(ModuleID moduleId)
@@ -356,6 +435,20 @@ void RejitHandler::RemoveModule(ModuleID moduleId)
         return;
     }
 
+    // Removes the ReJIT targets of the module (only if it has some, to avoid copying the map for nothing)
+    {
+        std::lock_guard<std::mutex> targetsGuard(m_rejitTargets_lock);
+
+        const auto currentTargets = m_publishedRejitTargets.get();
+        if (currentTargets != nullptr && currentTargets->find(moduleId) != currentTargets->end())
+        {
+            auto rejitTargets = std::make_unique<RejitTargetsMap>(*currentTargets);
+            rejitTargets->erase(moduleId);
+
+            PublishRejitTargets(std::move(rejitTargets));
+        }
+    }
+
     // Removes the RejitHandlerModule instance
     std::lock_guard<std::mutex> modulesGuard(m_modules_lock);
     m_modules.erase(moduleId);
@@ -553,6 +646,22 @@ AssemblyProperty* RejitHandler::GetCorAssemblyProperty()
     return m_pCorAssemblyProperty;
 }
 
+void RejitHandler::SetModuleRegistry(ModuleRegistry* pModuleRegistry)
+{
+    m_moduleRegistry = pModuleRegistry;
+}
+
+ModuleRegistry* RejitHandler::GetModuleRegistry()
+{
+    return m_moduleRegistry;
+}
+
+std::shared_ptr<ModuleMetadata> RejitHandler::GetModuleMetadata(RegisteredModule* module)
+{
+    return module->GetOrCreateMetadata(m_profilerInfo, m_pCorAssemblyProperty, enable_by_ref_instrumentation,
+                                       enable_calltarget_state_by_ref);
+}
+
 void RejitHandler::SetEnableByRefInstrumentation(bool enableByRefInstrumentation)
 {
     enable_by_ref_instrumentation = enableByRefInstrumentation;
@@ -6,12 +6,14 @@
 #include <shared_mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <future>
 
 #include "cor.h"
 #include "corprof.h"
 #include "module_metadata.h"
+#include "module_registry.h"
 #include "rejit_work_offloader.h"
 #include "method_rewriter.h"
 
@@ -74,6 +76,11 @@ public:
     MethodRewriter* GetMethodRewriter() override;
 };
 
+/// <summary>
+/// ReJIT targets, by module: the methods of a module are shared by the successive versions of the map
+/// </summary>
+typedef std::unordered_map<ModuleID, std::shared_ptr<const std::unordered_set<mdMethodDef>>> RejitTargetsMap;
+
 using RejitHandlerModuleMethodCreatorFunc = std::function<std::unique_ptr<RejitHandlerModuleMethod>(const mdMethodDef, RejitHandlerModule*)>;
 
 /// <summary>
@@ -83,7 +90,7 @@ class RejitHandlerModule
 {
 private:
     ModuleID m_moduleId;
-    std::unique_ptr<ModuleMetadata> m_metadata;
+    std::shared_ptr<ModuleMetadata> m_metadata;
     std::mutex m_methods_lock;
     std::unordered_map<mdMethodDef, std::unique_ptr<RejitHandlerModuleMethod>> m_methods;
     
@@ -98,7 +105,7 @@ public:
     RejitHandler* GetHandler();
 
     ModuleMetadata* GetModuleMetadata();
-    void SetModuleMetadata(ModuleMetadata* metadata);
+    void SetModuleMetadata(std::shared_ptr<ModuleMetadata> metadata);
 
     bool CreateMethodIfNotExists(const mdMethodDef methodDef, RejitHandlerModuleMethodCreatorFunc creator);
     bool ContainsMethod(mdMethodDef methodDef);
@@ -120,6 +127,7 @@ private:
     std::mutex m_modules_lock;
     std::unordered_map<ModuleID, std::unique_ptr<RejitHandlerModule>> m_modules;
     AssemblyProperty* m_pCorAssemblyProperty = nullptr;
+    ModuleRegistry* m_moduleRegistry = nullptr;
 
     ICorProfilerInfo7* m_profilerInfo;
     ICorProfilerInfo10* m_profilerInfo10;
@@ -132,6 +140,20 @@ private:
     std::mutex m_ngenInlinersModules_lock;
     std::vector<ModuleID> m_ngenInlinersModules;
 
+    // ReJIT targets by module, probed by JITInlining for every inlining decision.
+    // The published map is never modified: it is copied, updated and atomically replaced (copy-on-write)
+    // when targets are added or a module is unloaded, so readers don't take any lock. Only the modules whose
+    // targets change get a new methods set, the others are shared with the previous map.
+    // A replaced map is retired and freed by a later publication once no reader is in flight: the readers
+    // are counted around their lookup so that a map is never freed while a JIT thread could be reading it.
+    std::atomic<const RejitTargetsMap*> m_rejitTargets = {nullptr};
+    std::atomic<int> m_rejitTargetsReaders = {0};
+    std::mutex m_rejitTargets_lock;
+    std::unique_ptr<const RejitTargetsMap> m_publishedRejitTargets;
+    std::vector<std::unique_ptr<const RejitTargetsMap>> m_retiredRejitTargets;
+
+    void PublishRejitTargets(std::unique_ptr<RejitTargetsMap> rejitTargets);
+
 public:
     RejitHandler(ICorProfilerInfo7* pInfo, std::shared_ptr<RejitWorkOffloader> work_offloader);
     RejitHandler(ICorProfilerInfo10* pInfo, std::shared_ptr<RejitWorkOffloader> work_offloader);
@@ -144,6 +166,7 @@ public:
 
     void RemoveModule(ModuleID moduleId);
     bool HasModuleAndMethod(ModuleID moduleId, mdMethodDef methodDef);
+    void AddRejitTargets(const std::vector<ModuleID>& modulesVector, const std::vector<mdMethodDef>& modulesMethodDef);
 
     void AddNGenInlinerModule(ModuleID moduleId);
 
@@ -161,6 +184,10 @@ public:
 
     void SetCorAssemblyProfiler(AssemblyProperty* pCorAssemblyProfiler);
     AssemblyProperty* GetCorAssemblyProperty();
+
+    void SetModuleRegistry(ModuleRegistry* pModuleRegistry);
+    ModuleRegistry* GetModuleRegistry();
+    std::shared_ptr<ModuleMetadata> GetModuleMetadata(RegisteredModule* module);
 };
 
 } // namespace trace
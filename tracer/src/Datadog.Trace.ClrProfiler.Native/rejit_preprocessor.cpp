@@ -4,9 +4,41 @@
 #include "logger.h"
 #include "debugger_members.h"
 
+#include <algorithm>
+
 namespace trace
 {
 
+// RejitDefinitionsIndex
+
+void RejitDefinitionsIndex::GetCandidateDefinitions(const shared::WSTRING& assembly_name,
+                                                    std::vector<size_t>& positions) const
+{
+    positions.clear();
+
+    const auto assemblyDefinitions = definitions_by_assembly.find(assembly_name);
+    if (assemblyDefinitions != definitions_by_assembly.end())
+    {
+        positions.insert(positions.end(), assemblyDefinitions->second.begin(), assemblyDefinitions->second.end());
+    }
+
+    // the trace methods definitions look for their target type in every module
+    if (assembly_name != tracemethodintegration_assemblyname)
+    {
+        const auto traceMethodsDefinitions = definitions_by_assembly.find(tracemethodintegration_assemblyname);
+        if (traceMethodsDefinitions != definitions_by_assembly.end())
+        {
+            positions.insert(positions.end(), traceMethodsDefinitions->second.begin(),
+                             traceMethodsDefinitions->second.end());
+        }
+    }
+
+    positions.insert(positions.end(), derived_definitions.begin(), derived_definitions.end());
+
+    // the definitions are processed in their registration order, as when all of them were enumerated
+    std::sort(positions.begin(), positions.end());
+}
+
 // RejitPreprocessor
 template <class RejitRequestDefinition>
 RejitPreprocessor<RejitRequestDefinition>::RejitPreprocessor(std::shared_ptr<RejitHandler> rejit_handler,
@@ -17,13 +49,12 @@ RejitPreprocessor<RejitRequestDefinition>::RejitPreprocessor(std::shared_ptr<Rej
 
 template <class RejitRequestDefinition>
 void RejitPreprocessor<RejitRequestDefinition>::ProcessTypeDefForRejit(const RejitRequestDefinition& definition,
-                                          ComPtr<IMetaDataImport2>& metadataImport,
-                                          ComPtr<IMetaDataEmit2>& metadataEmit,
-                                          ComPtr<IMetaDataAssemblyImport>& assemblyImport,
-                                          ComPtr<IMetaDataAssemblyEmit>& assemblyEmit, const ModuleInfo& moduleInfo,
+                                          const std::shared_ptr<ModuleMetadata>& moduleMetadata,
+                                          const ModuleInfo& moduleInfo,
                                           const mdTypeDef typeDef, std::vector<ModuleID>& vtModules,
                                           std::vector<mdMethodDef>& vtMethodDefs)
 {
+    ComPtr<IMetaDataImport2> metadataImport = moduleMetadata->metadata_import;
     auto target_method = GetTargetMethod(definition);
     const bool wildcard_enabled = target_method.method_name == tracemethodintegration_wildcardmethodname;
 
@@ -45,11 +76,6 @@ void RejitPreprocessor<RejitRequestDefinition>::ProcessTypeDefForRejit(const Rej
         },
         [&metadataImport](HCORENUM ptr) -> void { metadataImport->CloseEnum(ptr); });
 
-    auto corProfilerInfo = m_rejit_handler->GetCorProfilerInfo();
-    auto pCorAssemblyProperty = m_rejit_handler->GetCorAssemblyProperty();
-    auto enable_by_ref_instrumentation = m_rejit_handler->GetEnableByRefInstrumentation();
-    auto enable_calltarget_state_by_ref = m_rejit_handler->GetEnableCallTargetStateByRef();
-
     auto enumIterator = enumMethods.begin();
     for (; enumIterator != enumMethods.end(); enumIterator = ++enumIterator)
     {
@@ -133,13 +159,7 @@ void RejitPreprocessor<RejitRequestDefinition>::ProcessTypeDefForRejit(const Rej
         }
         if (moduleHandler->GetModuleMetadata() == nullptr)
         {
-            Logger::Debug("Creating ModuleMetadata...");
-
-            const auto moduleMetadata =
-                new ModuleMetadata(metadataImport, metadataEmit, assemblyImport, assemblyEmit, moduleInfo.assembly.name,
-                                   moduleInfo.assembly.app_domain_id, pCorAssemblyProperty,
-                                   enable_by_ref_instrumentation, enable_calltarget_state_by_ref);
-
+            // the ModuleMetadata cached in the module registry is shared with the ReJIT handler
             Logger::Info("ReJIT handler stored metadata for ", moduleInfo.id, " ", moduleInfo.assembly.name,
                          " AppDomain ", moduleInfo.assembly.app_domain_id, " ", moduleInfo.assembly.app_domain_name);
 
@@ -164,18 +184,51 @@ void RejitPreprocessor<RejitRequestDefinition>::ProcessTypeDefForRejit(const Rej
     }
 }
 
+template <class RejitRequestDefinition>
+void RejitPreprocessor<RejitRequestDefinition>::UpdateDefinitionsIndex(
+    const std::vector<RejitRequestDefinition>& definitions, RejitDefinitionsIndex& index)
+{
+    for (auto position = index.indexed_count; position < definitions.size(); position++)
+    {
+        const auto& definition = definitions[position];
+        if (GetIsDerived(definition))
+        {
+            index.derived_definitions.push_back(position);
+        }
+        else
+        {
+            index.definitions_by_assembly[GetTargetMethod(definition).type.assembly.name].push_back(position);
+        }
+    }
+
+    index.indexed_count = definitions.size();
+}
+
 template <class RejitRequestDefinition>
 ULONG RejitPreprocessor<RejitRequestDefinition>::RequestRejitForLoadedModules(
                                                         const std::vector<ModuleID>& modules,
                                                         const std::vector<RejitRequestDefinition>& definitions,
                                                         bool enqueueInSameThread)
+{
+    RejitDefinitionsIndex index;
+    UpdateDefinitionsIndex(definitions, index);
+
+    return RequestRejitForLoadedModules(modules, definitions, index, enqueueInSameThread);
+}
+
+template <class RejitRequestDefinition>
+ULONG RejitPreprocessor<RejitRequestDefinition>::RequestRejitForLoadedModules(
+                                                        const std::vector<ModuleID>& modules,
+                                                        const std::vector<RejitRequestDefinition>& definitions,
+                                                        const RejitDefinitionsIndex& index,
+                                                        bool enqueueInSameThread)
 {
     if (m_rejit_handler->IsShutdownRequested())
     {
         return 0;
     }
 
-    auto corProfilerInfo = m_rejit_handler->GetCorProfilerInfo();
+    auto moduleRegistry = m_rejit_handler->GetModuleRegistry();
 
     std::vector<ModuleID> vtModules;
     std::vector<mdMethodDef> vtMethodDefs;
@@ -185,22 +238,45 @@ ULONG RejitPreprocessor<RejitRequestDefinition>::RequestRejitForLoadedModules(
     vtModules.reserve(15);
     vtMethodDefs.reserve(15);
 
+    std::vector<size_t> candidateDefinitions;
+    std::unordered_map<shared::WSTRING, mdTypeDef> moduleTypeDefs;
+
     for (const auto& module : modules)
     {
         auto _ = trace::Stats::Instance()->CallTargetRequestRejitMeasure();
-        const ModuleInfo& moduleInfo = GetModuleInfo(corProfilerInfo, module);
+
+        // the module info and metadata are cached in the module registry;
+        // the modules unloaded since the request was enqueued are not found anymore
+        const auto registeredModule = moduleRegistry != nullptr ? moduleRegistry->Find(module) : nullptr;
+        if (registeredModule == nullptr)
+        {
+            Logger::Debug("Skipping the unloaded Module: ", module);
+            continue;
+        }
+
+        const ModuleInfo& moduleInfo = registeredModule->info;
+
+        // only the definitions targeting the assembly of the module (or any assembly) are looked at
+        index.GetCandidateDefinitions(moduleInfo.assembly.name, candidateDefinitions);
+        if (candidateDefinitions.empty())
+        {
+            continue;
+        }
+
         Logger::Debug("Requesting Rejit for Module: ", moduleInfo.assembly.name);
 
-        ComPtr<IUnknown> metadataInterfaces;
+        std::shared_ptr<ModuleMetadata> moduleMetadata = nullptr;
         ComPtr<IMetaDataImport2> metadataImport;
-        ComPtr<IMetaDataEmit2> metadataEmit;
         ComPtr<IMetaDataAssemblyImport> assemblyImport;
-        ComPtr<IMetaDataAssemblyEmit> assemblyEmit;
         std::unique_ptr<AssemblyMetadata> assemblyMetadata = nullptr;
 
-        for (const RejitRequestDefinition& definition : definitions)
+        // several definitions target the same type: it is looked up once per module
+        moduleTypeDefs.clear();
+
+        for (const auto position : candidateDefinitions)
         {
-            const auto target_method = GetTargetMethod(definition);
+            const RejitRequestDefinition& definition = definitions[position];
+            const auto& target_method = GetTargetMethod(definition);
             const auto is_derived = GetIsDerived(definition);
 
             if (is_derived)
@@ -209,19 +285,16 @@ ULONG RejitPreprocessor<RejitRequestDefinition>::RequestRejitForLoadedModules(
                 if (assemblyMetadata == nullptr)
                 {
                     Logger::Debug("  Loading Assembly Metadata...");
-                    auto hr = corProfilerInfo->GetModuleMetaData(moduleInfo.id, ofRead | ofWrite, IID_IMetaDataImport2,
-                                                                metadataInterfaces.GetAddressOf());
-                    if (FAILED(hr))
+                    moduleMetadata = m_rejit_handler->GetModuleMetadata(registeredModule);
+                    if (moduleMetadata == nullptr)
                     {
                         Logger::Warn("CallTarget_RequestRejitForModule failed to get metadata interface for ",
                                      moduleInfo.id, " ", moduleInfo.assembly.name);
                         break;
                     }
 
-                    metadataImport = metadataInterfaces.As<IMetaDataImport2>(IID_IMetaDataImport);
-                    metadataEmit = metadataInterfaces.As<IMetaDataEmit2>(IID_IMetaDataEmit);
-                    assemblyImport = metadataInterfaces.As<IMetaDataAssemblyImport>(IID_IMetaDataAssemblyImport);
-                    assemblyEmit = metadataInterfaces.As<IMetaDataAssemblyEmit>(IID_IMetaDataAssemblyEmit);
+                    metadataImport = moduleMetadata->metadata_import;
+                    assemblyImport = moduleMetadata->assembly_import;
                     assemblyMetadata = std::make_unique<AssemblyMetadata>(GetAssemblyImportMetadata(assemblyImport));
                     Logger::Debug("  Assembly Metadata loaded for: ", assemblyMetadata->name, "(",
                                   assemblyMetadata->version.str(), ").");
@@ -330,36 +403,27 @@ ULONG RejitPreprocessor<RejitRequestDefinition>::RequestRejitForLoadedModules(
                         //
                         // Looking for the method to rewrite
                         //
-                        ProcessTypeDefForRejit(definition, metadataImport, metadataEmit, assemblyImport, assemblyEmit,
-                                               moduleInfo, typeDef, vtModules, vtMethodDefs);
+                        ProcessTypeDefForRejit(definition, moduleMetadata, moduleInfo, typeDef, vtModules,
+                                               vtMethodDefs);
                     }
                 }
             }
             else
             {
-                // If the integration is not for the current assembly we skip.
-                if (target_method.type.assembly.name != tracemethodintegration_assemblyname &&
-                    target_method.type.assembly.name != moduleInfo.assembly.name)
-                {
-                    continue;
-                }
-
+                // The index only returns the integrations for the current assembly (or the trace methods ones).
                 if (assemblyMetadata == nullptr)
                 {
                     Logger::Debug("  Loading Assembly Metadata...");
-                    auto hr = corProfilerInfo->GetModuleMetaData(moduleInfo.id, ofRead | ofWrite, IID_IMetaDataImport2,
-                                                                metadataInterfaces.GetAddressOf());
-                    if (FAILED(hr))
+                    moduleMetadata = m_rejit_handler->GetModuleMetadata(registeredModule);
+                    if (moduleMetadata == nullptr)
                     {
                         Logger::Warn("CallTarget_RequestRejitForModule failed to get metadata interface for ",
                                      moduleInfo.id, " ", moduleInfo.assembly.name);
                         break;
                     }
 
-                    metadataImport = metadataInterfaces.As<IMetaDataImport2>(IID_IMetaDataImport);
-                    metadataEmit = metadataInterfaces.As<IMetaDataEmit2>(IID_IMetaDataEmit);
-                    assemblyImport = metadataInterfaces.As<IMetaDataAssemblyImport>(IID_IMetaDataAssemblyImport);
-                    assemblyEmit = metadataInterfaces.As<IMetaDataAssemblyEmit>(IID_IMetaDataAssemblyEmit);
+                    metadataImport = moduleMetadata->metadata_import;
+                    assemblyImport = moduleMetadata->assembly_import;
                     assemblyMetadata = std::make_unique<AssemblyMetadata>(GetAssemblyImportMetadata(assemblyImport));
                     Logger::Debug("  Assembly Metadata loaded for: ", assemblyMetadata->name, "(",
                                   assemblyMetadata->version.str(), ").");
@@ -378,10 +442,19 @@ ULONG RejitPreprocessor<RejitRequestDefinition>::RequestRejitForLoadedModules(
                 }
 
                 // We are in the right module, so we try to load the mdTypeDef from the integration target type name.
-                mdTypeDef typeDef = mdTypeDefNil;
-                auto foundType = FindTypeDefByName(target_method.type.name, moduleInfo.assembly.name,
-                                                   metadataImport, typeDef);
-                if (!foundType)
+                auto moduleTypeDef = moduleTypeDefs.find(target_method.type.name);
+                if (moduleTypeDef == moduleTypeDefs.end())
+                {
+                    mdTypeDef typeDef = mdTypeDefNil;
+                    if (!FindTypeDefByName(target_method.type.name, moduleInfo.assembly.name, metadataImport, typeDef))
+                    {
+                        typeDef = mdTypeDefNil;
+                    }
+                    moduleTypeDef = moduleTypeDefs.emplace(target_method.type.name, typeDef).first;
+                }
+
+                const auto typeDef = moduleTypeDef->second;
+                if (typeDef == mdTypeDefNil)
                 {
                     continue;
                 }
@@ -389,8 +462,7 @@ ULONG RejitPreprocessor<RejitRequestDefinition>::RequestRejitForLoadedModules(
                 //
                 // Looking for the method to rewrite
                 //
-                ProcessTypeDefForRejit(definition, metadataImport, metadataEmit, assemblyImport, assemblyEmit,
-                                       moduleInfo, typeDef, vtModules, vtMethodDefs);
+                ProcessTypeDefForRejit(definition, moduleMetadata, moduleInfo, typeDef, vtModules, vtMethodDefs);
             }
         }
     }
@@ -400,6 +472,9 @@ ULONG RejitPreprocessor<RejitRequestDefinition>::RequestRejitForLoadedModules(
     // Request the ReJIT for all integrations found in the module.
     if (rejitCount > 0)
     {
+        // Publish the targets so that JITInlining prevents them from being inlined.
+        m_rejit_handler->AddRejitTargets(vtModules, vtMethodDefs);
+
         if (enqueueInSameThread)
         {
             m_rejit_handler->RequestRejit(vtModules, vtMethodDefs);
@@ -3,6 +3,8 @@
 
 #include "integration.h"
 #include <future>
+#include <unordered_map>
+#include <vector>
 #include "cor.h"
 #include "corprof.h"
 #include "module_metadata.h"
@@ -15,6 +17,23 @@ class RejitHandlerModuleMethod;
 class RejitHandlerModule;
 struct FunctionInfo;
 
+/// <summary>
+/// Positions of ReJIT request definitions grouped by the assembly name of their target, so that a module only
+/// goes through the definitions that can match it instead of all of them.
+/// The indexed vector of definitions can only be appended to: the new definitions are indexed incrementally.
+/// </summary>
+struct RejitDefinitionsIndex
+{
+    // target assembly name -> positions of the definitions (ascending)
+    std::unordered_map<shared::WSTRING, std::vector<size_t>> definitions_by_assembly;
+    // the derived definitions target the types inheriting from a type of another assembly: they can match any module
+    std::vector<size_t> derived_definitions;
+    size_t indexed_count = 0;
+
+    // positions (ascending) of the definitions that can match a module of the given assembly
+    void GetCandidateDefinitions(const shared::WSTRING& assembly_name, std::vector<size_t>& positions) const;
+};
+
 /// <summary>
 /// Responsible to determine what are the methods that should be rejitted and prepares the metadata needed in the rewriting process.
 /// </summary>
@@ -22,9 +41,8 @@ template <class RejitRequestDefinition>
 class RejitPreprocessor
 {
 private:
-    void ProcessTypeDefForRejit(const RejitRequestDefinition& definition, ComPtr<IMetaDataImport2>& metadataImport,
-                           ComPtr<IMetaDataEmit2>& metadataEmit, ComPtr<IMetaDataAssemblyImport>& assemblyImport,
-                           ComPtr<IMetaDataAssemblyEmit>& assemblyEmit, const ModuleInfo& moduleInfo,
+    void ProcessTypeDefForRejit(const RejitRequestDefinition& definition,
+                           const std::shared_ptr<ModuleMetadata>& moduleMetadata, const ModuleInfo& moduleInfo,
                            const mdTypeDef typeDef, std::vector<ModuleID>& vtModules,
                            std::vector<mdMethodDef>& vtMethodDefs);
 
@@ -43,10 +61,18 @@ protected:
 public:
     RejitPreprocessor(std::shared_ptr<RejitHandler> rejit_handler, std::shared_ptr<RejitWorkOffloader> work_offloader);
 
+    // indexes the definitions appended since the previous update of the index
+    void UpdateDefinitionsIndex(const std::vector<RejitRequestDefinition>& requests, RejitDefinitionsIndex& index);
+
     ULONG RequestRejitForLoadedModules(const std::vector<ModuleID>& modules,
                                        const std::vector<RejitRequestDefinition>& requests,
                                        bool enqueueInSameThread = false);
 
+    // same as above, with the index of the requests maintained by the caller
+    ULONG RequestRejitForLoadedModules(const std::vector<ModuleID>& modules,
+                                       const std::vector<RejitRequestDefinition>& requests,
+                                       const RejitDefinitionsIndex& index, bool enqueueInSameThread = false);
+
     void EnqueueRequestRejitForLoadedModules(const std::vector<ModuleID>& modulesVector,
                                              const std::vector<RejitRequestDefinition>& requests,
                                              std::promise<ULONG>* promise);
@@ -0,0 +1,72 @@
+#include "pch.h"
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/assembly_name_matcher.h"
+#include "../../src/Datadog.Trace.ClrProfiler.Native/clr_helpers.h"
+#include "../../src/Datadog.Trace.ClrProfiler.Native/dd_profiler_constants.h"
+
+#include <vector>
+
+using namespace trace;
+
+TEST(AssemblyNameMatcherTest, MatchesExactNames) {
+  AssemblyNameMatcher matcher({WStr("mscorlib"), WStr("netstandard")}, {});
+
+  EXPECT_EQ(matcher.Match(WStr("mscorlib")), AssemblyNameMatch::ExactName);
+  EXPECT_EQ(matcher.Match(WStr("netstandard")), AssemblyNameMatch::ExactName);
+  EXPECT_EQ(matcher.Match(WStr("mscorlib.resources")), AssemblyNameMatch::None);
+  EXPECT_EQ(matcher.Match(WStr("mscorli")), AssemblyNameMatch::None);
+  EXPECT_EQ(matcher.Match(WStr("")), AssemblyNameMatch::None);
+}
+
+TEST(AssemblyNameMatcherTest, MatchesPrefixes) {
+  AssemblyNameMatcher matcher({}, {WStr("System.IO"), WStr("System.Xml"), WStr("Microsoft.Extensions.Http")});
+
+  EXPECT_EQ(matcher.Match(WStr("System.IO")), AssemblyNameMatch::Prefix);
+  EXPECT_EQ(matcher.Match(WStr("System.IO.Pipelines")), AssemblyNameMatch::Prefix);
+  EXPECT_EQ(matcher.Match(WStr("System.Xml.Linq")), AssemblyNameMatch::Prefix);
+  EXPECT_EQ(matcher.Match(WStr("Microsoft.Extensions.Http.Polly")), AssemblyNameMatch::Prefix);
+  EXPECT_EQ(matcher.Match(WStr("System.I")), AssemblyNameMatch::None);
+  EXPECT_EQ(matcher.Match(WStr("System.Net.Http")), AssemblyNameMatch::None);
+  EXPECT_EQ(matcher.Match(WStr("Microsoft.Extensions.Logging")), AssemblyNameMatch::None);
+  EXPECT_EQ(matcher.Match(WStr("")), AssemblyNameMatch::None);
+}
+
+TEST(AssemblyNameMatcherTest, ExactNameTakesPrecedenceOverPrefix) {
+  AssemblyNameMatcher matcher({WStr("System.Configuration")}, {WStr("System.")});
+
+  EXPECT_EQ(matcher.Match(WStr("System.Configuration")), AssemblyNameMatch::ExactName);
+  EXPECT_EQ(matcher.Match(WStr("System.Configuration.ConfigurationManager")), AssemblyNameMatch::Prefix);
+}
+
+TEST(AssemblyNameMatcherTest, EmptyMatcherMatchesNothing) {
+  AssemblyNameMatcher matcher;
+
+  EXPECT_EQ(matcher.Match(WStr("mscorlib")), AssemblyNameMatch::None);
+  EXPECT_EQ(matcher.Match(WStr("")), AssemblyNameMatch::None);
+}
+
+TEST(AssemblyNameMatcherTest, MatchesLikeTheSkipLists) {
+  AssemblyNameMatcher matcher({std::begin(skip_assemblies), std::end(skip_assemblies)},
+                              {std::begin(skip_assembly_prefixes), std::end(skip_assembly_prefixes)});
+
+  std::vector<shared::WSTRING> names = {WStr("mscorlib"),
+                                        WStr("System.Private.CoreLib"),
+                                        WStr("System.Runtime.Extensions"),
+                                        WStr("System.Net.Http"),
+                                        WStr("Microsoft.AspNetCore.Mvc.Core"),
+                                        WStr("Microsoft.Extensions.Hosting.Abstractions"),
+                                        WStr("Datadog.Trace"),
+                                        WStr("Samples.ExampleLibrary")};
+
+  for (const auto& name : names) {
+    bool expected = false;
+    for (const auto& skip_assembly : skip_assemblies) {
+      expected = expected || name == skip_assembly;
+    }
+    for (const auto& skip_assembly_prefix : skip_assembly_prefixes) {
+      expected = expected || name.rfind(skip_assembly_prefix, 0) == 0;
+    }
+
+    EXPECT_EQ(matcher.Match(name) != AssemblyNameMatch::None, expected);
+  }
+}
@@ -0,0 +1,178 @@
+#include "pch.h"
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/module_registry.h"
+
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace trace;
+
+static ModuleInfo CreateModuleInfo(ModuleID moduleId, AppDomainID appDomainId) {
+  return ModuleInfo(moduleId, WStr("Samples.ExampleLibrary.dll"),
+                    AssemblyInfo(moduleId, WStr("Samples.ExampleLibrary"), moduleId, appDomainId, WStr("DefaultDomain")),
+                    0);
+}
+
+TEST(ModuleRegistryTest, FindsAddedModules) {
+  ModuleRegistry registry;
+  EXPECT_EQ(registry.Find(0x1000), nullptr);
+
+  const auto module = registry.Add(CreateModuleInfo(0x1000, 1));
+  ASSERT_NE(module, nullptr);
+  EXPECT_EQ(module->id, 0x1000);
+  EXPECT_EQ(module->info.assembly.app_domain_id, 1);
+  EXPECT_EQ(registry.Find(0x1000), module);
+  EXPECT_EQ(registry.Find(0x2000), nullptr);
+
+  // adding the same module again returns the registered one
+  EXPECT_EQ(registry.Add(CreateModuleInfo(0x1000, 1)), module);
+  EXPECT_EQ(registry.Size(), 1);
+}
+
+TEST(ModuleRegistryTest, RemovedModuleIdCanBeReused) {
+  ModuleRegistry registry;
+  const auto module = registry.Add(CreateModuleInfo(0x1000, 1));
+  module->loader_injected = true;
+
+  registry.Remove(0x1000);
+  EXPECT_EQ(registry.Find(0x1000), nullptr);
+  EXPECT_EQ(registry.Size(), 0);
+  EXPECT_TRUE(registry.GetModuleIds().empty());
+
+  // the state of the unloaded module is not inherited
+  const auto reused = registry.Add(CreateModuleInfo(0x1000, 2));
+  EXPECT_NE(reused, module);
+  EXPECT_EQ(reused->info.assembly.app_domain_id, 2);
+  EXPECT_FALSE(reused->loader_injected);
+  EXPECT_EQ(registry.Find(0x1000), reused);
+}
+
+TEST(ModuleRegistryTest, NoMetadataForUnloadedModule) {
+  ModuleRegistry registry;
+  const auto module = registry.Add(CreateModuleInfo(0x1000, 1));
+  registry.Remove(0x1000);
+
+  // the metadata interfaces of an unloaded module must not be queried
+  EXPECT_EQ(module->GetOrCreateMetadata(nullptr, nullptr, false, false), nullptr);
+}
+
+TEST(ModuleRegistryTest, KeepsAllModulesWhenGrowing) {
+  ModuleRegistry registry;
+
+  std::vector<ModuleID> expected;
+  for (ModuleID module_id = 0x10000; module_id < 0x10000 + 5000 * 0x40; module_id += 0x40) {
+    registry.Add(CreateModuleInfo(module_id, 1));
+    expected.push_back(module_id);
+  }
+
+  // remove 1 module out of 3
+  for (size_t i = 0; i < expected.size(); i += 3) {
+    registry.Remove(expected[i]);
+  }
+
+  std::vector<ModuleID> remaining;
+  for (size_t i = 0; i < expected.size(); i++) {
+    if (i % 3 == 0) {
+      EXPECT_EQ(registry.Find(expected[i]), nullptr);
+    } else {
+      ASSERT_NE(registry.Find(expected[i]), nullptr);
+      EXPECT_EQ(registry.Find(expected[i])->id, expected[i]);
+      remaining.push_back(expected[i]);
+    }
+  }
+
+  auto module_ids = registry.GetModuleIds();
+  std::sort(module_ids.begin(), module_ids.end());
+  EXPECT_EQ(module_ids, remaining);
+  EXPECT_EQ(registry.Size(), remaining.size());
+}
+
+TEST(ModuleRegistryTest, TablesDoNotGrowWithUnloadedModules) {
+  ModuleRegistry registry;
+  const auto initial_capacity = registry.Capacity();
+
+  // collectible assemblies loaded and unloaded in a loop, with a few modules alive at a time
+  std::vector<ModuleID> alive;
+  for (ModuleID module_id = 0x10000; module_id < 0x10000 + 100000 * 0x40; module_id += 0x40) {
+    registry.Add(CreateModuleInfo(module_id, 1));
+    alive.push_back(module_id);
+    if (alive.size() == 10) {
+      registry.Remove(alive.front());
+      alive.erase(alive.begin());
+    }
+  }
+
+  EXPECT_EQ(registry.Capacity(), initial_capacity);
+  EXPECT_EQ(registry.Size(), alive.size());
+  for (const auto module_id : alive) {
+    ASSERT_NE(registry.Find(module_id), nullptr);
+    EXPECT_EQ(registry.Find(module_id)->id, module_id);
+  }
+}
+
+TEST(ModuleRegistryTest, FindsModulesWhileOthersAreAdded) {
+  ModuleRegistry registry;
+  const ModuleID first_module_id = 0x10000;
+  const int modules_count = 20000;
+
+  std::thread writer([&registry]() {
+    for (int i = 0; i < modules_count; i++) {
+      registry.Add(CreateModuleInfo(first_module_id + i * 0x40, 1));
+    }
+  });
+
+  // a module found once must always be found afterwards
+  for (int i = 0; i < modules_count; i++) {
+    const ModuleID module_id = first_module_id + i * 0x40;
+    while (registry.Find(module_id) == nullptr) {
+      std::this_thread::yield();
+    }
+    ASSERT_NE(registry.Find(first_module_id), nullptr);
+    ASSERT_EQ(registry.Find(module_id)->id, module_id);
+  }
+
+  writer.join();
+  EXPECT_EQ(registry.Size(), modules_count);
+}
+
+// Simulates the JIT callbacks at startup: several threads look up the module of each compiled method
+// while the registry gives the same answers as a search in the list of the registered modules.
+TEST(ModuleRegistryTest, ParallelLookupsMatchRegisteredModules) {
+  const int modules_count = 400;
+  const int lookups_per_thread = 20000;
+  const int threads_count = 8;
+
+  // only 1 module out of 4 can be instrumented, the others are skipped
+  std::vector<ModuleID> module_ids;
+  ModuleRegistry registry;
+  for (int i = 0; i < modules_count; i += 4) {
+    const ModuleID module_id = 0x10000000 + i * 0x1000;
+    module_ids.push_back(module_id);
+    registry.Add(CreateModuleInfo(module_id, 1));
+  }
+
+  std::vector<size_t> mismatches(threads_count);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < threads_count; t++) {
+    threads.emplace_back([&registry, &module_ids, &mismatches, t]() {
+      std::mt19937 random(t);
+      std::uniform_int_distribution<int> modules_distribution(0, modules_count - 1);
+      for (int i = 0; i < lookups_per_thread; i++) {
+        const ModuleID module_id = 0x10000000 + modules_distribution(random) * 0x1000;
+        const bool expected = std::find(module_ids.begin(), module_ids.end(), module_id) != module_ids.end();
+        if ((registry.Find(module_id) != nullptr) != expected) {
+          mismatches[t]++;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (const auto count : mismatches) {
+    EXPECT_EQ(count, 0u);
+  }
+}
@@ -0,0 +1,115 @@
+#include "pch.h"
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/rejit_handler.h"
+
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace trace;
+
+static std::unique_ptr<RejitHandlerModuleMethod> CreateNoMethod(const mdMethodDef, RejitHandlerModule*) {
+  return nullptr;
+}
+
+TEST(RejitHandlerTest, HasModuleAndMethodOnlyForRejitTargets) {
+  RejitHandler handler((ICorProfilerInfo7*) nullptr, nullptr);
+  EXPECT_FALSE(handler.HasModuleAndMethod(1, 0x06000001));
+
+  std::vector<ModuleID> modules = {1, 1, 2};
+  std::vector<mdMethodDef> methodDefs = {0x06000001, 0x06000002, 0x06000001};
+  handler.AddRejitTargets(modules, methodDefs);
+
+  EXPECT_TRUE(handler.HasModuleAndMethod(1, 0x06000001));
+  EXPECT_TRUE(handler.HasModuleAndMethod(1, 0x06000002));
+  EXPECT_TRUE(handler.HasModuleAndMethod(2, 0x06000001));
+  EXPECT_FALSE(handler.HasModuleAndMethod(2, 0x06000002));
+  EXPECT_FALSE(handler.HasModuleAndMethod(3, 0x06000001));
+
+  // targets added later are visible too
+  modules = {3};
+  methodDefs = {0x06000003};
+  handler.AddRejitTargets(modules, methodDefs);
+
+  EXPECT_TRUE(handler.HasModuleAndMethod(1, 0x06000001));
+  EXPECT_TRUE(handler.HasModuleAndMethod(3, 0x06000003));
+}
+
+TEST(RejitHandlerTest, RemoveModuleRemovesItsRejitTargets) {
+  RejitHandler handler((ICorProfilerInfo7*) nullptr, nullptr);
+
+  std::vector<ModuleID> modules = {1, 2};
+  std::vector<mdMethodDef> methodDefs = {0x06000001, 0x06000001};
+  handler.AddRejitTargets(modules, methodDefs);
+
+  handler.RemoveModule(1);
+
+  EXPECT_FALSE(handler.HasModuleAndMethod(1, 0x06000001));
+  EXPECT_TRUE(handler.HasModuleAndMethod(2, 0x06000001));
+}
+
+TEST(RejitHandlerTest, FindsRejitTargetsWhileOthersAreAddedAndRemoved) {
+  RejitHandler handler((ICorProfilerInfo7*) nullptr, nullptr);
+  const int cycles = 20000;
+
+  std::vector<ModuleID> modules = {1};
+  std::vector<mdMethodDef> methodDefs = {0x06000001};
+  handler.AddRejitTargets(modules, methodDefs);
+
+  // the replaced maps are freed while the reader probes them
+  std::thread writer([&handler]() {
+    for (int i = 0; i < cycles; i++) {
+      const ModuleID moduleId = 2 + (i % 16);
+      std::vector<ModuleID> modules = {moduleId, moduleId};
+      std::vector<mdMethodDef> methodDefs = {0x06000001, static_cast<mdMethodDef>(0x06000002 + i)};
+      handler.AddRejitTargets(modules, methodDefs);
+      handler.RemoveModule(moduleId);
+    }
+  });
+
+  for (int i = 0; i < cycles; i++) {
+    ASSERT_TRUE(handler.HasModuleAndMethod(1, 0x06000001));
+    ASSERT_FALSE(handler.HasModuleAndMethod(1, 0x06000002));
+  }
+
+  writer.join();
+  EXPECT_TRUE(handler.HasModuleAndMethod(1, 0x06000001));
+  for (ModuleID moduleId = 2; moduleId < 18; moduleId++) {
+    EXPECT_FALSE(handler.HasModuleAndMethod(moduleId, 0x06000001));
+  }
+}
+
+// The published targets set used by JITInlining gives the same answers as the modules and methods maps.
+// The decisions look like a startup: a few hundred modules, a lot of distinct callees and very few ReJIT targets.
+TEST(RejitHandlerTest, PublishedTargetsMatchModulesAndMethods) {
+  const int modulesCount = 200;
+  const int methodsPerModule = 20000;
+  const int decisionsCount = 100000;
+
+  RejitHandler handler((ICorProfilerInfo7*) nullptr, nullptr);
+
+  // 15 targets in 1 module out of 10
+  std::vector<ModuleID> targetModules;
+  std::vector<mdMethodDef> targetMethodDefs;
+  for (ModuleID moduleId = 1; moduleId <= modulesCount; moduleId += 10) {
+    for (mdMethodDef methodDef = 0x06000001; methodDef <= 0x0600000F; methodDef++) {
+      handler.GetOrAddModule(moduleId)->CreateMethodIfNotExists(methodDef, CreateNoMethod);
+      targetModules.push_back(moduleId);
+      targetMethodDefs.push_back(methodDef);
+    }
+  }
+  handler.AddRejitTargets(targetModules, targetMethodDefs);
+
+  for (size_t i = 0; i < targetModules.size(); i++) {
+    EXPECT_TRUE(handler.HasModuleAndMethod(targetModules[i], targetMethodDefs[i]));
+  }
+
+  std::mt19937 random(42);
+  std::uniform_int_distribution<int> modulesDistribution(1, modulesCount);
+  std::uniform_int_distribution<int> methodsDistribution(1, methodsPerModule);
+  for (int i = 0; i < decisionsCount; i++) {
+    const ModuleID moduleId = modulesDistribution(random);
+    const mdMethodDef methodDef = 0x06000000 + methodsDistribution(random);
+    ASSERT_EQ(handler.GetOrAddModule(moduleId)->ContainsMethod(methodDef), handler.HasModuleAndMethod(moduleId, methodDef));
+  }
+}
@@ -0,0 +1,109 @@
+#include "pch.h"
+
+#include "../../src/Datadog.Trace.ClrProfiler.Native/rejit_preprocessor.h"
+
+#include <vector>
+
+using namespace trace;
+
+static IntegrationDefinition CreateDefinition(const shared::WSTRING& assemblyName, const shared::WSTRING& typeName,
+                                              bool isDerived = false) {
+  return IntegrationDefinition(
+      MethodReference(assemblyName, typeName, WStr("Execute"), Version(0, 0, 0, 0), Version(USHRT_MAX, USHRT_MAX, USHRT_MAX, USHRT_MAX), {}),
+      TypeReference(WStr("Datadog.Trace"), WStr("Integration"), Version(0, 0, 0, 0), Version(USHRT_MAX, USHRT_MAX, USHRT_MAX, USHRT_MAX)),
+      isDerived, true);
+}
+
+TEST(RejitPreprocessorTest, CandidateDefinitionsOfAModule) {
+  TracerRejitPreprocessor preprocessor(nullptr, nullptr);
+
+  std::vector<IntegrationDefinition> definitions = {
+      CreateDefinition(WStr("System.Data"), WStr("System.Data.SqlClient.SqlCommand")),
+      CreateDefinition(WStr("System.Net.Http"), WStr("System.Net.Http.HttpClientHandler")),
+      CreateDefinition(WStr("System.Data.Common"), WStr("System.Data.Common.DbCommand"), true),
+      CreateDefinition(tracemethodintegration_assemblyname, WStr("Samples.ExampleLibrary.Class1")),
+      CreateDefinition(WStr("System.Data"), WStr("System.Data.SqlClient.SqlDataReader")),
+  };
+
+  RejitDefinitionsIndex index;
+  preprocessor.UpdateDefinitionsIndex(definitions, index);
+  EXPECT_EQ(index.indexed_count, 5);
+
+  std::vector<size_t> positions;
+  index.GetCandidateDefinitions(WStr("System.Data"), positions);
+  EXPECT_EQ(positions, std::vector<size_t>({0, 2, 3, 4}));
+
+  index.GetCandidateDefinitions(WStr("System.Net.Http"), positions);
+  EXPECT_EQ(positions, std::vector<size_t>({1, 2, 3}));
+
+  // the derived and trace methods definitions can match any module
+  index.GetCandidateDefinitions(WStr("Samples.ExampleLibrary"), positions);
+  EXPECT_EQ(positions, std::vector<size_t>({2, 3}));
+}
+
+TEST(RejitPreprocessorTest, AppendedDefinitionsAreIndexed) {
+  TracerRejitPreprocessor preprocessor(nullptr, nullptr);
+
+  std::vector<IntegrationDefinition> definitions = {
+      CreateDefinition(WStr("System.Data"), WStr("System.Data.SqlClient.SqlCommand")),
+  };
+
+  RejitDefinitionsIndex index;
+  preprocessor.UpdateDefinitionsIndex(definitions, index);
+
+  std::vector<size_t> positions;
+  index.GetCandidateDefinitions(WStr("Samples.ExampleLibrary"), positions);
+  EXPECT_TRUE(positions.empty());
+
+  definitions.push_back(CreateDefinition(WStr("Samples.ExampleLibrary"), WStr("Samples.ExampleLibrary.Class1")));
+  definitions.push_back(CreateDefinition(WStr("System.Data"), WStr("System.Data.SqlClient.SqlDataReader")));
+  preprocessor.UpdateDefinitionsIndex(definitions, index);
+  EXPECT_EQ(index.indexed_count, 3);
+
+  index.GetCandidateDefinitions(WStr("Samples.ExampleLibrary"), positions);
+  EXPECT_EQ(positions, std::vector<size_t>({1}));
+
+  // the definitions already indexed are not indexed twice
+  index.GetCandidateDefinitions(WStr("System.Data"), positions);
+  EXPECT_EQ(positions, std::vector<size_t>({0, 2}));
+}
+
+// Synthetic startup: 1,000 loaded modules and 500 integration definitions targeting 100 assemblies.
+// A module only goes through the candidate definitions given by the index: they must be the ones
+// that the previous path (going through every definition for every module) would have matched.
+TEST(RejitPreprocessorTest, CandidateDefinitionsMatchAllDefinitionsScan) {
+  const int modulesCount = 1000;
+  const int definitionsCount = 500;
+  const int targetAssembliesCount = 100;
+
+  TracerRejitPreprocessor preprocessor(nullptr, nullptr);
+
+  std::vector<IntegrationDefinition> definitions;
+  for (int i = 0; i < definitionsCount; i++) {
+    const auto assemblyName = WStr("Target.Assembly.") + shared::ToWSTRING(std::to_string(i % targetAssembliesCount));
+    const auto typeName = assemblyName + WStr(".Type") + shared::ToWSTRING(std::to_string(i % 3));
+    definitions.push_back(CreateDefinition(assemblyName, typeName, (i % 100) == 0));
+  }
+
+  RejitDefinitionsIndex index;
+  preprocessor.UpdateDefinitionsIndex(definitions, index);
+
+  // 1 module out of 10 is targeted by integrations
+  std::vector<size_t> positions;
+  for (int i = 0; i < modulesCount; i++) {
+    const auto moduleName = (i % 10) == 0 ? WStr("Target.Assembly.") + shared::ToWSTRING(std::to_string(i / 10))
+                                          : WStr("Application.Module.") + shared::ToWSTRING(std::to_string(i));
+
+    std::vector<size_t> expected;
+    for (size_t position = 0; position < definitions.size(); position++) {
+      const auto& target_method = definitions[position].target_method;
+      if (definitions[position].is_derived || target_method.type.assembly.name == tracemethodintegration_assemblyname ||
+          target_method.type.assembly.name == moduleName) {
+        expected.push_back(position);
+      }
+    }
+
+    index.GetCandidateDefinitions(moduleName, positions);
+    EXPECT_EQ(positions, expected);
+  }
+}